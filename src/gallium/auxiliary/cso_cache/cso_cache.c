@@ -115,11 +115,15 @@ cso_insert_state(struct cso_cache *sc,
 void *
 cso_hash_find_data_from_template(struct cso_hash *hash,
                                  unsigned hash_key,
-                                 void *templ,
+                                 const void *templ,
                                  int size )
 {
    struct cso_hash_iter iter = cso_hash_find(hash, hash_key);
-   while (!cso_hash_iter_is_null(iter)) {
+   /* Entries with the same key are adjacent; stop at the first other key
+    * rather than walking the rest of the table.
+    */
+   while (!cso_hash_iter_is_null(iter) &&
+          cso_hash_iter_key(iter) == hash_key) {
       void *iter_data = cso_hash_iter_data(iter);
       if (!memcmp(iter_data, templ, size)) {
          /* We found a match */
@@ -127,9 +127,16 @@ cso_hash_iter_key(struct cso_hash_iter iter);
 void *
 cso_hash_find_data_from_template(struct cso_hash *hash,
                                  unsigned hash_key,
-                                 void *templ,
+                                 const void *templ,
                                  int size);
 
+/**
+ * Removes the entry with the given key whose data is the given pointer.
+ * Returns false if there's no such entry.
+ */
+bool
+cso_hash_erase_data(struct cso_hash *hash, unsigned key, void *data);
+
 struct cso_node *
 cso_hash_data_next(struct cso_node *node);
 
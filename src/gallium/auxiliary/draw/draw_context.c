@@ -44,6 +44,8 @@
 #include "draw_vs.h"
 #include "draw_gs.h"
 #include "draw_tess.h"
+#include "draw_pt.h"
+#include "translate/translate_cache.h"
 
 #ifdef DRAW_LLVM_AVAILABLE
 #include "gallivm/lp_bld_init.h"
@@ -302,6 +304,21 @@ draw_update_viewport_flags(struct draw_context *draw)
 }
 
 
+/**
+ * Create a translate cache for the draw module.  Translates are JIT
+ * compiled with LLVM only when draw uses LLVM for the shaders anyway,
+ * otherwise the compile time would be wasted on drivers which hardly
+ * translate any vertices.
+ */
+struct translate_cache *
+draw_translate_cache_create(const struct draw_context *draw)
+{
+   if (draw->llvm)
+      return translate_cache_create_llvm();
+   return translate_cache_create();
+}
+
+
 /**
  * Register new primitive rasterization/rendering state.
  * This causes the drawing pipeline to be rebuilt.
@@ -581,6 +598,48 @@ draw_enable_point_sprites(struct draw_context *draw, boolean enable)
 }
 
 
+/**
+ * Tells the draw module whether to keep the vertices it shaded for later
+ * segments and draws, rather than only within a segment.
+ *
+ * Drivers which enable this must call draw_invalidate_vertex_cache()
+ * whenever the contents of the bound vertex or constant buffers may have
+ * changed without them being rebound, e.g. by a transfer or by a shader.
+ */
+void
+draw_enable_vertex_cache(struct draw_context *draw, boolean enable)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+   if (draw->pt.vcache)
+      draw_pt_vcache_enable(draw->pt.vcache, enable);
+}
+
+
+void
+draw_invalidate_vertex_cache(struct draw_context *draw)
+{
+   if (draw->pt.vcache)
+      draw_pt_vcache_invalidate(draw->pt.vcache);
+}
+
+
+/**
+ * Number of vertices looked up in, and found in, the vertex cache.  The
+ * hits are vertex shader invocations saved.
+ */
+void
+draw_get_vertex_cache_stats(struct draw_context *draw,
+                            uint64_t *lookups, uint64_t *hits)
+{
+   if (draw->pt.vcache) {
+      draw_pt_vcache_get_stats(draw->pt.vcache, lookups, hits);
+   } else {
+      *lookups = 0;
+      *hits = 0;
+   }
+}
+
+
 /**
  * Allocate an extra vertex/geometry shader vertex attribute, if it doesn't
  * exist already.
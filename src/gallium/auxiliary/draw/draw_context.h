@@ -121,6 +121,13 @@ void draw_enable_line_stipple(struct draw_context *draw, boolean enable);
 
 void draw_enable_point_sprites(struct draw_context *draw, boolean enable);
 
+void draw_enable_vertex_cache(struct draw_context *draw, boolean enable);
+
+void draw_invalidate_vertex_cache(struct draw_context *draw);
+
+void draw_get_vertex_cache_stats(struct draw_context *draw,
+                                 uint64_t *lookups, uint64_t *hits);
+
 void draw_set_zs_format(struct draw_context *draw, enum pipe_format format);
 
 /* for TGSI constants are 4 * sizeof(float), but for NIR they need to be sizeof(float); */
@@ -794,6 +794,7 @@ draw_create_geometry_shader(struct draw_context *draw,
       gs = &llvm_gs->base;
 
       list_inithead(&llvm_gs->variants.list);
+      cso_hash_init(&llvm_gs->variants_hash);
    } else
 #endif
    {
@@ -960,6 +961,7 @@ draw_delete_geometry_shader(struct draw_context *draw,
       }
 
       assert(shader->variants_cached == 0);
+      cso_hash_deinit(&shader->variants_hash);
 
       if (dgs->llvm_prim_lengths) {
          for (unsigned i = 0; i < dgs->num_vertex_streams * dgs->max_out_prims; ++i) {
@@ -2717,6 +2717,8 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
    gallivm_destroy(variant->gallivm);
 
    list_del(&variant->list_item_local.list);
+   cso_hash_erase_data(&variant->shader->variants_hash, variant->hash_key,
+                       &variant->key);
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_variants--;
@@ -3053,6 +3055,8 @@ draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant)
    gallivm_destroy(variant->gallivm);
 
    list_del(&variant->list_item_local.list);
+   cso_hash_erase_data(&variant->shader->variants_hash, variant->hash_key,
+                       &variant->key);
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_gs_variants--;
@@ -3735,6 +3739,8 @@ draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant)
    gallivm_destroy(variant->gallivm);
 
    list_del(&variant->list_item_local.list);
+   cso_hash_erase_data(&variant->shader->variants_hash, variant->hash_key,
+                       &variant->key);
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_tcs_variants--;
@@ -4286,6 +4292,8 @@ draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant)
    gallivm_destroy(variant->gallivm);
 
    list_del(&variant->list_item_local.list);
+   cso_hash_erase_data(&variant->shader->variants_hash, variant->hash_key,
+                       &variant->key);
    variant->shader->variants_cached--;
    list_del(&variant->list_item_global.list);
    llvm->nr_tes_variants--;
@@ -40,6 +40,7 @@
 
 #include "pipe/p_context.h"
 #include "util/list.h"
+#include "cso_cache/cso_hash.h"
 
 #define GALLIVM_USE_ORCJIT 1
 
@@ -640,6 +641,9 @@ struct draw_llvm_variant
    struct draw_llvm_variant_list_item list_item_global;
    struct draw_llvm_variant_list_item list_item_local;
 
+   /* Hash of the key, indexing the variant in the shader's variants_hash */
+   unsigned hash_key;
+
    /* key is variable-sized, must be last */
    struct draw_llvm_variant_key key;
 };
@@ -673,6 +677,9 @@ struct draw_gs_llvm_variant
    struct draw_gs_llvm_variant_list_item list_item_global;
    struct draw_gs_llvm_variant_list_item list_item_local;
 
+   /* Hash of the key, indexing the variant in the shader's variants_hash */
+   unsigned hash_key;
+
    /* key is variable-sized, must be last */
    struct draw_gs_llvm_variant_key key;
 };
@@ -702,6 +709,9 @@ struct draw_tcs_llvm_variant
    struct draw_tcs_llvm_variant_list_item list_item_global;
    struct draw_tcs_llvm_variant_list_item list_item_local;
 
+   /* Hash of the key, indexing the variant in the shader's variants_hash */
+   unsigned hash_key;
+
    /* key is variable-sized, must be last */
    struct draw_tcs_llvm_variant_key key;
 };
@@ -735,6 +745,9 @@ struct draw_tes_llvm_variant
    struct draw_tes_llvm_variant_list_item list_item_global;
    struct draw_tes_llvm_variant_list_item list_item_local;
 
+   /* Hash of the key, indexing the variant in the shader's variants_hash */
+   unsigned hash_key;
+
    /* key is variable-sized, must be last */
    struct draw_tes_llvm_variant_key key;
 };
@@ -744,6 +757,8 @@ struct llvm_vertex_shader {
 
    unsigned variant_key_size;
    struct draw_llvm_variant_list_item variants;
+   /* The same variants, indexed by key */
+   struct cso_hash variants_hash;
    unsigned variants_created;
    unsigned variants_cached;
 };
@@ -753,6 +768,8 @@ struct llvm_geometry_shader {
 
    unsigned variant_key_size;
    struct draw_gs_llvm_variant_list_item variants;
+   /* The same variants, indexed by key */
+   struct cso_hash variants_hash;
    unsigned variants_created;
    unsigned variants_cached;
 };
@@ -762,6 +779,8 @@ struct llvm_tess_ctrl_shader {
 
    unsigned variant_key_size;
    struct draw_tcs_llvm_variant_list_item variants;
+   /* The same variants, indexed by key */
+   struct cso_hash variants_hash;
    unsigned variants_created;
    unsigned variants_cached;
 };
@@ -771,6 +790,8 @@ struct llvm_tess_eval_shader {
 
    unsigned variant_key_size;
    struct draw_tes_llvm_variant_list_item variants;
+   /* The same variants, indexed by key */
+   struct cso_hash variants_hash;
    unsigned variants_created;
    unsigned variants_cached;
 };
@@ -34,6 +34,7 @@
 #include "draw/draw_pipe.h"
 #include "util/u_debug.h"
 #include "util/u_math.h"
+#include "util/u_memory.h"
 
 
 boolean
@@ -53,6 +54,11 @@ draw_pipeline_init(struct draw_context *draw)
    draw->pipeline.validate  = draw_validate_stage(draw);
    draw->pipeline.first     = draw->pipeline.validate;
 
+   draw->pipeline.tri_batch =
+      MALLOC(DRAW_PIPE_BATCH * sizeof(*draw->pipeline.tri_batch));
+   if (!draw->pipeline.tri_batch)
+      return FALSE;
+
    if (!draw->pipeline.wide_line ||
        !draw->pipeline.wide_point ||
        !draw->pipeline.stipple ||
@@ -110,6 +116,20 @@ draw_pipeline_destroy(struct draw_context *draw)
       draw->pipeline.pstipple->destroy(draw->pipeline.pstipple);
    if (draw->pipeline.rasterize)
       draw->pipeline.rasterize->destroy(draw->pipeline.rasterize);
+   FREE(draw->pipeline.tri_batch);
+}
+
+
+/**
+ * Hand the triangles collected by do_triangle() to the first stage.
+ */
+static void
+flush_tri_batch(struct draw_context *draw)
+{
+   const unsigned count = draw->pipeline.tri_batch_count;
+
+   draw->pipeline.tri_batch_count = 0;
+   draw_pipe_tri_batch(draw->pipeline.first, draw->pipeline.tri_batch, count);
 }
 
 
@@ -122,6 +142,9 @@ do_point(struct draw_context *draw,
 {
    struct prim_header prim;
 
+   if (draw->pipeline.tri_batch_count)
+      flush_tri_batch(draw);
+
    prim.flags = 0;
    prim.pad = 0;
    prim.v[0] = (struct vertex_header *)v0;
@@ -142,6 +165,9 @@ do_line(struct draw_context *draw,
 {
    struct prim_header prim;
 
+   if (draw->pipeline.tri_batch_count)
+      flush_tri_batch(draw);
+
    prim.flags = flags;
    prim.pad = 0;
    prim.v[0] = (struct vertex_header *)v0;
@@ -153,6 +179,7 @@ do_line(struct draw_context *draw,
 
 /**
  * Build primitive to render a triangle with vertices at v0, v1, v2.
+ * Triangles are passed on in batches, see flush_tri_batch().
  * \param flags  bitmask of DRAW_PIPE_EDGE_x, DRAW_PIPE_RESET_STIPPLE
  */
 static void
@@ -162,15 +189,17 @@ do_triangle(struct draw_context *draw,
             char *v1,
             char *v2)
 {
-   struct prim_header prim;
+   struct prim_header *prim =
+      &draw->pipeline.tri_batch[draw->pipeline.tri_batch_count++];
 
-   prim.v[0] = (struct vertex_header *)v0;
-   prim.v[1] = (struct vertex_header *)v1;
-   prim.v[2] = (struct vertex_header *)v2;
-   prim.flags = flags;
-   prim.pad = 0;
+   prim->v[0] = (struct vertex_header *)v0;
+   prim->v[1] = (struct vertex_header *)v1;
+   prim->v[2] = (struct vertex_header *)v2;
+   prim->flags = flags;
+   prim->pad = 0;
 
-   draw->pipeline.first->tri(draw->pipeline.first, &prim);
+   if (draw->pipeline.tri_batch_count == DRAW_PIPE_BATCH)
+      flush_tri_batch(draw);
 }
 
 
@@ -274,8 +303,11 @@ draw_pipeline_run(struct draw_context *draw,
                     vert_info->count - 1);
    }
 
+   flush_tri_batch(draw);
+
    draw->pipeline.verts = NULL;
    draw->pipeline.vertex_count = 0;
+   draw->pipeline.run_serial++;
 }
 
 
@@ -340,10 +372,12 @@ draw_pipeline_run_linear(struct draw_context *draw,
                       (struct vertex_header*)verts,
                       vert_info->stride,
                       count);
+      flush_tri_batch(draw);
    }
 
    draw->pipeline.verts = NULL;
    draw->pipeline.vertex_count = 0;
+   draw->pipeline.run_serial++;
 }
 
 
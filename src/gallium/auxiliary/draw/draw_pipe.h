@@ -38,6 +38,10 @@
 #include "draw_context.h"
 
 
+/** Number of triangles handed to draw_stage::tri_batch at most */
+#define DRAW_PIPE_BATCH 16
+
+
 /**
  * Basic info for a point/line/triangle primitive.
  */
@@ -68,6 +72,13 @@ struct draw_stage
 
    void (*tri)(struct draw_stage *, struct prim_header *);
 
+   /**
+    * Optional: up to DRAW_PIPE_BATCH triangles, in order, for stages
+    * which can test them together.
+    */
+   void (*tri_batch)(struct draw_stage *, struct prim_header *,
+                     unsigned count);
+
    void (*flush)(struct draw_stage *, unsigned flags);
 
    void (*reset_stipple_counter)(struct draw_stage *);
@@ -91,12 +102,31 @@ struct draw_stage *draw_validate_stage(struct draw_context *context);
 void draw_free_temp_verts(struct draw_stage *stage);
 boolean draw_alloc_temp_verts(struct draw_stage *stage, unsigned nr);
 
+void draw_reset_tmp_vertex_ids(struct draw_context *draw);
 void draw_reset_vertex_ids(struct draw_context *draw);
 
 void draw_pipe_passthrough_tri(struct draw_stage *stage, struct prim_header *header);
 void draw_pipe_passthrough_line(struct draw_stage *stage, struct prim_header *header);
 void draw_pipe_passthrough_point(struct draw_stage *stage, struct prim_header *header);
 
+/**
+ * Pass a batch of triangles to a stage, one by one if it doesn't take
+ * batches.
+ */
+static inline void
+draw_pipe_tri_batch(struct draw_stage *stage,
+                    struct prim_header *prims,
+                    unsigned count)
+{
+   if (stage->tri_batch) {
+      if (count)
+         stage->tri_batch(stage, prims, count);
+   } else {
+      for (unsigned i = 0; i < count; i++)
+         stage->tri(stage, &prims[i]);
+   }
+}
+
 void draw_aapoint_prepare_outputs(struct draw_context *context,
                                   struct draw_stage *stage);
 void draw_aaline_prepare_outputs(struct draw_context *context,
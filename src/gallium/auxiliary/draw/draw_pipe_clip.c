@@ -730,6 +730,50 @@ clip_tri(struct draw_stage *stage, struct prim_header *header)
 }
 
 
+/**
+ * Triangles in a batch: the trivial accept and reject tests are done for
+ * all of them first, and the accepted triangles are passed on in runs,
+ * compacted without branching.  Only triangles crossing a plane go
+ * through do_clip_tri().
+ */
+static void
+clip_tri_batch(struct draw_stage *stage,
+               struct prim_header *prims,
+               unsigned count)
+{
+   unsigned or_mask[DRAW_PIPE_BATCH];
+   unsigned and_mask[DRAW_PIPE_BATCH];
+   struct prim_header accepted[DRAW_PIPE_BATCH];
+   unsigned n = 0;
+
+   assert(count <= DRAW_PIPE_BATCH);
+
+   for (unsigned i = 0; i < count; i++) {
+      const unsigned m0 = prims[i].v[0]->clipmask;
+      const unsigned m1 = prims[i].v[1]->clipmask;
+      const unsigned m2 = prims[i].v[2]->clipmask;
+
+      or_mask[i] = m0 | m1 | m2;
+      and_mask[i] = m0 & m1 & m2;
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      if (unlikely(or_mask[i] && !and_mask[i])) {
+         /* keep the order of the triangles */
+         draw_pipe_tri_batch(stage->next, accepted, n);
+         n = 0;
+
+         do_clip_tri(stage, &prims[i], or_mask[i]);
+      } else {
+         accepted[n] = prims[i];
+         n += or_mask[i] == 0;
+      }
+   }
+
+   draw_pipe_tri_batch(stage->next, accepted, n);
+}
+
+
 static enum tgsi_interpolate_mode
 find_interp(const struct draw_fragment_shader *fs,
             enum tgsi_interpolate_mode *indexed_interp,
@@ -894,6 +938,7 @@ clip_init_state(struct draw_stage *stage)
    }
 
    stage->tri = clip_tri;
+   stage->tri_batch = clip_tri_batch;
    stage->line = clip_line;
 }
 
@@ -907,6 +952,16 @@ clip_first_tri(struct draw_stage *stage,
 }
 
 
+static void
+clip_first_tri_batch(struct draw_stage *stage,
+                     struct prim_header *prims,
+                     unsigned count)
+{
+   clip_init_state(stage);
+   stage->tri_batch(stage, prims, count);
+}
+
+
 static void
 clip_first_line(struct draw_stage *stage,
                 struct prim_header *header)
@@ -920,6 +975,7 @@ static void
 clip_flush(struct draw_stage *stage, unsigned flags)
 {
    stage->tri = clip_first_tri;
+   stage->tri_batch = clip_first_tri_batch;
    stage->line = clip_first_line;
    stage->next->flush(stage->next, flags);
 }
@@ -956,6 +1012,7 @@ draw_clip_stage(struct draw_context *draw)
    clipper->stage.point = clip_first_point;
    clipper->stage.line = clip_first_line;
    clipper->stage.tri = clip_first_tri;
+   clipper->stage.tri_batch = clip_first_tri_batch;
    clipper->stage.flush = clip_flush;
    clipper->stage.reset_stipple_counter = clip_reset_stipple_counter;
    clipper->stage.destroy = clip_destroy;
@@ -101,9 +101,57 @@ cull_tri(struct draw_stage *stage,
 }
 
 
+/*
+ * The same for a batch of triangles: the determinants are computed in
+ * one loop over the batch, and the triangles kept are compacted without
+ * branching.
+ */
 static void
-cull_first_tri(struct draw_stage *stage,
-               struct prim_header *header)
+cull_tri_batch(struct draw_stage *stage,
+               struct prim_header *prims,
+               unsigned count)
+{
+   const struct cull_stage *cull = cull_stage(stage);
+   const unsigned pos = draw_current_shader_position_output(stage->draw);
+   float ex[DRAW_PIPE_BATCH], ey[DRAW_PIPE_BATCH];
+   float fx[DRAW_PIPE_BATCH], fy[DRAW_PIPE_BATCH];
+   float det[DRAW_PIPE_BATCH];
+   struct prim_header kept[DRAW_PIPE_BATCH];
+   unsigned n = 0;
+
+   assert(count <= DRAW_PIPE_BATCH);
+
+   for (unsigned i = 0; i < count; i++) {
+      const float *v0 = prims[i].v[0]->data[pos];
+      const float *v1 = prims[i].v[1]->data[pos];
+      const float *v2 = prims[i].v[2]->data[pos];
+
+      ex[i] = v0[0] - v2[0];
+      ey[i] = v0[1] - v2[1];
+      fx[i] = v1[0] - v2[0];
+      fy[i] = v1[1] - v2[1];
+   }
+
+   for (unsigned i = 0; i < count; i++)
+      det[i] = ex[i] * fy[i] - ey[i] * fx[i];
+
+   for (unsigned i = 0; i < count; i++) {
+      /* as in cull_tri(), zero area triangles are back facing */
+      const unsigned ccw = det[i] < 0;
+      const unsigned face = (det[i] != 0 && ccw == cull->front_ccw) ?
+                            PIPE_FACE_FRONT : PIPE_FACE_BACK;
+
+      kept[n] = prims[i];
+      kept[n].det = det[i];
+      n += (face & cull->cull_face) == 0;
+   }
+
+   draw_pipe_tri_batch(stage->next, kept, n);
+}
+
+
+static void
+cull_init_state(struct draw_stage *stage)
 {
    struct cull_stage *cull = cull_stage(stage);
 
@@ -111,14 +159,34 @@ cull_first_tri(struct draw_stage *stage,
    cull->front_ccw = stage->draw->rasterizer->front_ccw;
 
    stage->tri = cull_tri;
+   stage->tri_batch = cull_tri_batch;
+}
+
+
+static void
+cull_first_tri(struct draw_stage *stage,
+               struct prim_header *header)
+{
+   cull_init_state(stage);
    stage->tri(stage, header);
 }
 
 
+static void
+cull_first_tri_batch(struct draw_stage *stage,
+                     struct prim_header *prims,
+                     unsigned count)
+{
+   cull_init_state(stage);
+   stage->tri_batch(stage, prims, count);
+}
+
+
 static void
 cull_flush(struct draw_stage *stage, unsigned flags)
 {
    stage->tri = cull_first_tri;
+   stage->tri_batch = cull_first_tri_batch;
    stage->next->flush(stage->next, flags);
 }
 
@@ -154,6 +222,7 @@ draw_cull_stage(struct draw_context *draw)
    cull->stage.point = draw_pipe_passthrough_point;
    cull->stage.line = draw_pipe_passthrough_line;
    cull->stage.tri = cull_first_tri;
+   cull->stage.tri_batch = cull_first_tri_batch;
    cull->stage.flush = cull_flush;
    cull->stage.reset_stipple_counter = cull_reset_stipple_counter;
    cull->stage.destroy = cull_destroy;
@@ -103,12 +103,10 @@ draw_free_temp_verts(struct draw_stage *stage)
 }
 
 
-/* Reset vertex ids.  This is basically a type of flush.
- *
- * Called only from draw_pipe_vbuf.c
+/* Reset the vertex ids of the stages' temporary vertices.
  */
 void
-draw_reset_vertex_ids(struct draw_context *draw)
+draw_reset_tmp_vertex_ids(struct draw_context *draw)
 {
    struct draw_stage *stage = draw->pipeline.first;
 
@@ -118,6 +116,17 @@ draw_reset_vertex_ids(struct draw_context *draw)
 
       stage = stage->next;
    }
+}
+
+
+/* Reset vertex ids.  This is basically a type of flush.
+ *
+ * Called only from draw_pipe_vbuf.c
+ */
+void
+draw_reset_vertex_ids(struct draw_context *draw)
+{
+   draw_reset_tmp_vertex_ids(draw);
 
    if (draw->pipeline.verts) {
       char *verts = draw->pipeline.verts;
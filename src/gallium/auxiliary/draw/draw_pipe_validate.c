@@ -289,6 +289,16 @@ validate_tri(struct draw_stage *stage,
 }
 
 
+static void
+validate_tri_batch(struct draw_stage *stage,
+                   struct prim_header *prims,
+                   unsigned count)
+{
+   struct draw_stage *pipeline = validate_pipeline(stage);
+   draw_pipe_tri_batch(pipeline, prims, count);
+}
+
+
 static void
 validate_line(struct draw_stage *stage,
               struct prim_header *header)
@@ -349,6 +359,7 @@ draw_validate_stage(struct draw_context *draw)
    stage->point = validate_point;
    stage->line = validate_line;
    stage->tri = validate_tri;
+   stage->tri_batch = validate_tri_batch;
    stage->flush = validate_flush;
    stage->reset_stipple_counter = validate_reset_stipple_counter;
    stage->destroy = validate_destroy;
@@ -73,6 +73,14 @@ struct vbuf_stage {
    unsigned max_indices;
    unsigned nr_indices;
 
+   /** Vertices emitted during pipeline run emitted_run, whose ids must
+    * be reset when the buffer is flushed.
+    */
+   struct vertex_header **emitted;
+   unsigned max_emitted;
+   unsigned nr_emitted;
+   unsigned emitted_run;
+
    /* Cache point size somewhere its address won't change:
     */
    float point_size;
@@ -132,6 +140,16 @@ emit_vertex(struct vbuf_stage *vbuf, struct vertex_header *vertex)
 
       vbuf->vertex_ptr += vbuf->vertex_size/4;
       vertex->vertex_id = vbuf->nr_vertices++;
+
+      if (vbuf->emitted_run != vbuf->stage.draw->pipeline.run_serial) {
+         /* The earlier vertices may be gone, and nothing will look at
+          * their ids again.
+          */
+         vbuf->emitted_run = vbuf->stage.draw->pipeline.run_serial;
+         vbuf->nr_emitted = 0;
+      }
+      if (vbuf->nr_emitted < vbuf->max_emitted)
+         vbuf->emitted[vbuf->nr_emitted++] = vertex;
    }
 
    return (ushort)vertex->vertex_id;
@@ -301,6 +319,34 @@ vbuf_first_point(struct draw_stage *stage, struct prim_header *prim)
 
 
 
+/**
+ * Reset the ids of the vertices emitted into the current buffer.
+ *
+ * Only the vertices of the current pipeline run can still be referenced,
+ * so rather than walking all of them, as draw_reset_vertex_ids() does,
+ * just walk the ones which were emitted.  The buffer typically holds a
+ * few dozen of the up to thousands of vertices in a run.
+ */
+static void
+vbuf_reset_vertex_ids(struct vbuf_stage *vbuf)
+{
+   struct draw_context *draw = vbuf->stage.draw;
+
+   if (vbuf->nr_vertices > vbuf->max_emitted) {
+      draw_reset_vertex_ids(draw);
+   } else {
+      draw_reset_tmp_vertex_ids(draw);
+
+      if (vbuf->emitted_run == draw->pipeline.run_serial) {
+         for (unsigned i = 0; i < vbuf->nr_emitted; i++)
+            vbuf->emitted[i]->vertex_id = UNDEFINED_VERTEX_ID;
+      }
+   }
+
+   vbuf->nr_emitted = 0;
+}
+
+
 /**
  * Flush existing vertex buffer and allocate a new one.
  */
@@ -320,7 +366,7 @@ vbuf_flush_vertices(struct vbuf_stage *vbuf)
 
       /* Reset temporary vertices ids */
       if (vbuf->nr_vertices)
-         draw_reset_vertex_ids(vbuf->stage.draw);
+         vbuf_reset_vertex_ids(vbuf);
 
       /* Free the vertex buffer */
       vbuf->render->release_vertices(vbuf->render);
@@ -356,6 +402,12 @@ vbuf_alloc_vertices(struct vbuf_stage *vbuf)
    if (vbuf->max_vertices >= UNDEFINED_VERTEX_ID)
       vbuf->max_vertices = UNDEFINED_VERTEX_ID - 1;
 
+   if (vbuf->max_vertices > vbuf->max_emitted) {
+      FREE(vbuf->emitted);
+      vbuf->emitted = MALLOC(vbuf->max_vertices * sizeof(vbuf->emitted[0]));
+      vbuf->max_emitted = vbuf->emitted ? vbuf->max_vertices : 0;
+   }
+
    /* Must always succeed -- driver gives us a
     * 'max_vertex_buffer_bytes' which it guarantees it can allocate,
     * and it will flush itself if necessary to do so.  If this does
@@ -397,6 +449,8 @@ vbuf_destroy(struct draw_stage *stage)
    if (vbuf->indices)
       align_free(vbuf->indices);
 
+   FREE(vbuf->emitted);
+
    if (vbuf->render)
       vbuf->render->destroy(vbuf->render);
 
@@ -435,7 +489,7 @@ draw_vbuf_stage(struct draw_context *draw, struct vbuf_render *render)
    if (!vbuf->indices)
       goto fail;
 
-   vbuf->cache = translate_cache_create();
+   vbuf->cache = draw_translate_cache_create(draw);
    if (!vbuf->cache)
       goto fail;
 
@@ -94,6 +94,7 @@ struct pipe_context;
 struct draw_vertex_shader;
 struct draw_stage;
 struct draw_pt_front_end;
+struct pt_vcache;
 struct draw_assembler;
 struct draw_llvm;
 struct vbuf_render;
@@ -172,6 +173,15 @@ struct draw_context
       char *verts;
       unsigned vertex_stride;
       unsigned vertex_count;
+
+      /* Bumped at the end of every run, so that stages holding on to
+       * vertices can tell when they belong to a finished one.
+       */
+      unsigned run_serial;
+
+      /* Triangles not yet handed to the first stage */
+      struct prim_header *tri_batch;
+      unsigned tri_batch_count;
    } pipeline;
 
    struct vbuf_render *render;
@@ -197,6 +207,9 @@ struct draw_context
          struct draw_pt_front_end *vsplit;
       } front;
 
+      /** post-transform vertex cache, for the llvm middle end */
+      struct pt_vcache *vcache;
+
       struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
       unsigned nr_vertex_buffers;
 
@@ -566,6 +579,9 @@ draw_stats_clipper_primitives(struct draw_context *draw,
 void
 draw_update_clip_flags(struct draw_context *draw);
 
+struct translate_cache *
+draw_translate_cache_create(const struct draw_context *draw);
+
 void
 draw_update_viewport_flags(struct draw_context *draw);
 
@@ -129,8 +129,13 @@ draw_pt_arrays(struct draw_context *draw,
       /* update constants, viewport dims, clip planes, etc */
       middle->bind_parameters(middle);
       draw->pt.rebind_parameters = FALSE;
+      if (draw->pt.vcache)
+         draw_pt_vcache_invalidate(draw->pt.vcache);
    }
 
+   if (draw->pt.vcache)
+      draw_pt_vcache_begin_draw(draw->pt.vcache);
+
    for (unsigned i = 0; i < num_draws; i++) {
       /* Sanitize primitive length:
        */
@@ -205,8 +210,13 @@ draw_pt_init(struct draw_context *draw)
       return FALSE;
 
 #ifdef DRAW_LLVM_AVAILABLE
-   if (draw->llvm)
+   if (draw->llvm) {
+      draw->pt.vcache = draw_pt_vcache_create(draw);
+      if (!draw->pt.vcache)
+         return FALSE;
+
       draw->pt.middle.llvm = draw_pt_fetch_pipeline_or_emit_llvm(draw);
+   }
 #endif
 
    return TRUE;
@@ -235,6 +245,11 @@ draw_pt_destroy(struct draw_context *draw)
       draw->pt.front.vsplit->destroy(draw->pt.front.vsplit);
       draw->pt.front.vsplit = NULL;
    }
+
+   if (draw->pt.vcache) {
+      draw_pt_vcache_destroy(draw->pt.vcache);
+      draw->pt.vcache = NULL;
+   }
 }
 
 
@@ -618,6 +633,12 @@ draw_vbo(struct draw_context *draw,
       draw_instances(draw, drawid_offset, use_info, use_draws, num_draws);
    }
 
+   /* Segments may still be in the vertex shader on other threads, but
+    * the buffers are only mapped for the duration of this call.
+    */
+   if (draw->pt.middle.llvm && draw->pt.middle.llvm->drain)
+      draw->pt.middle.llvm->drain(draw->pt.middle.llvm);
+
    /* If requested emit the pipeline statistics for this run */
    if (draw->collect_statistics) {
       draw->render->pipeline_statistics(draw->render, &draw->statistics);
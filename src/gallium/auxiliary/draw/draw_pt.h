@@ -124,6 +124,11 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)(struct draw_pt_middle_end *);
 
+   /* Complete any segments still being processed on other threads.
+    * Optional.
+    */
+   void (*drain)(struct draw_pt_middle_end *);
+
    void (*finish)(struct draw_pt_middle_end *);
    void (*destroy)(struct draw_pt_middle_end *);
 };
@@ -259,6 +264,58 @@ void
 draw_pt_post_vs_destroy(struct pt_post_vs *pvs);
 
 
+/*******************************************************************************
+ * Post-transform vertex cache:
+ */
+struct pt_vcache;
+
+/**
+ * The draw parameters the cached vertices were shaded with.  The ones
+ * the vertex shader doesn't read are ignored.
+ */
+struct pt_vcache_tag {
+   unsigned instance_id;
+   unsigned start_instance;
+   unsigned vertex_id_offset;
+   unsigned drawid;
+   unsigned viewid;
+   unsigned linear;
+};
+
+void
+draw_pt_vcache_enable(struct pt_vcache *vcache, boolean enable);
+
+void
+draw_pt_vcache_prepare(struct pt_vcache *vcache, unsigned vertex_size);
+
+void
+draw_pt_vcache_begin_draw(struct pt_vcache *vcache);
+
+void
+draw_pt_vcache_invalidate(struct pt_vcache *vcache);
+
+unsigned
+draw_pt_vcache_begin(struct pt_vcache *vcache,
+                     const struct pt_vcache_tag *tag);
+
+const struct vertex_header *
+draw_pt_vcache_lookup(struct pt_vcache *vcache, unsigned elt);
+
+void
+draw_pt_vcache_insert(struct pt_vcache *vcache, unsigned serial,
+                      unsigned elt, const struct vertex_header *vertex);
+
+void
+draw_pt_vcache_get_stats(const struct pt_vcache *vcache,
+                         uint64_t *lookups, uint64_t *hits);
+
+struct pt_vcache *
+draw_pt_vcache_create(struct draw_context *draw);
+
+void
+draw_pt_vcache_destroy(struct pt_vcache *vcache);
+
+
 /*******************************************************************************
  * Utils:
  */
@@ -28,6 +28,8 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
+#include "util/hash_table.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_tess.h"
@@ -41,6 +43,54 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/* Upper limit for DRAW_NUM_THREADS */
+#define LLVM_MAX_VS_THREADS 16
+
+/* Segments smaller than this are shaded on the calling thread, unless
+ * earlier ones are still in flight.
+ */
+#define LLVM_VS_JOB_MIN_VERTICES 256
+
+
+struct llvm_middle_end;
+
+/**
+ * One vsplit segment.  Fetch, vertex shading and the clip test can run
+ * on a worker thread, everything after that runs on the calling thread
+ * in segment order.
+ */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct util_queue_fence fence;
+
+   /* The inputs, with the draw state they depend on captured, as it
+    * changes between instances and draws.
+    */
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   unsigned prim_length;
+   unsigned start;
+   unsigned vertex_id_offset;
+   unsigned instance_id;
+   unsigned start_instance;
+   unsigned drawid;
+   unsigned viewid;
+   void *elts;          /**< copies of the fetch and draw elements */
+
+   /* The vertices which weren't in the vertex cache, and where they go
+    * in the segment.  Only these get shaded.
+    */
+   unsigned vcache_serial;
+   unsigned num_misses;
+   unsigned *miss_elts;
+   unsigned *miss_pos;
+   boolean hits_clipped;
+
+   struct draw_vertex_info vert_info;
+   boolean clipped;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -58,6 +108,16 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Worker threads for the vertex shader, and the ring of segments
+    * given to them, see llvm_middle_end_segment().
+    */
+   unsigned num_threads;
+   struct util_queue queue;
+   struct llvm_vs_job *jobs;
+   unsigned num_jobs;
+   unsigned first_job;
+   unsigned pending_jobs;
 };
 
 
@@ -75,19 +135,18 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    struct draw_context *draw = fpme->draw;
    struct draw_llvm *llvm = fpme->llvm;
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
-   struct draw_gs_llvm_variant_list_item *li;
    struct llvm_geometry_shader *shader = llvm_geometry_shader(gs);
    char store[DRAW_GS_LLVM_MAX_VARIANT_KEY_SIZE];
    struct draw_gs_llvm_variant_key *key = draw_gs_llvm_make_variant_key(llvm, store);
 
    /* Search shader's list of variants for the key */
    struct draw_gs_llvm_variant *variant = NULL;
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   const unsigned hash_key = _mesa_hash_data(key, shader->variant_key_size);
+   void *data = cso_hash_find_data_from_template(&shader->variants_hash,
+                                                 hash_key, key,
+                                                 shader->variant_key_size);
+   if (data)
+      variant = container_of(data, struct draw_gs_llvm_variant, key);
 
    if (variant) {
       /* found the variant, move to head of global list (for LRU) */
@@ -123,7 +182,9 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
       variant = draw_gs_llvm_create_variant(llvm, gs->info.num_outputs, key);
 
       if (variant) {
+         variant->hash_key = hash_key;
          list_add(&variant->list_item_local.list, &shader->variants.list);
+         cso_hash_insert(&shader->variants_hash, hash_key, &variant->key);
          list_add(&variant->list_item_global.list, &llvm->gs_variants_list.list);
          llvm->nr_gs_variants++;
          shader->variants_cached++;
@@ -140,7 +201,6 @@ llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
    struct draw_context *draw = fpme->draw;
    struct draw_llvm *llvm = fpme->llvm;
    struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
-   struct draw_tcs_llvm_variant_list_item *li;
    struct llvm_tess_ctrl_shader *shader = llvm_tess_ctrl_shader(tcs);
    char store[DRAW_TCS_LLVM_MAX_VARIANT_KEY_SIZE];
    const struct draw_tcs_llvm_variant_key *key =
@@ -148,12 +208,12 @@ llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
 
    /* Search shader's list of variants for the key */
    struct draw_tcs_llvm_variant *variant = NULL;
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   const unsigned hash_key = _mesa_hash_data(key, shader->variant_key_size);
+   void *data = cso_hash_find_data_from_template(&shader->variants_hash,
+                                                 hash_key, key,
+                                                 shader->variant_key_size);
+   if (data)
+      variant = container_of(data, struct draw_tcs_llvm_variant, key);
 
    if (variant) {
       /* found the variant, move to head of global list (for LRU) */
@@ -190,7 +250,9 @@ llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
       variant = draw_tcs_llvm_create_variant(llvm, 0, key);
 
       if (variant) {
+         variant->hash_key = hash_key;
          list_add(&variant->list_item_local.list, &shader->variants.list);
+         cso_hash_insert(&shader->variants_hash, hash_key, &variant->key);
          list_add(&variant->list_item_global.list, &llvm->tcs_variants_list.list);
          llvm->nr_tcs_variants++;
          shader->variants_cached++;
@@ -208,19 +270,18 @@ llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
    struct draw_llvm *llvm = fpme->llvm;
    struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
    struct draw_tes_llvm_variant *variant = NULL;
-   struct draw_tes_llvm_variant_list_item *li;
    struct llvm_tess_eval_shader *shader = llvm_tess_eval_shader(tes);
    char store[DRAW_TES_LLVM_MAX_VARIANT_KEY_SIZE];
    const struct draw_tes_llvm_variant_key *key =
       draw_tes_llvm_make_variant_key(llvm, store);
 
    /* Search shader's list of variants for the key */
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   const unsigned hash_key = _mesa_hash_data(key, shader->variant_key_size);
+   void *data = cso_hash_find_data_from_template(&shader->variants_hash,
+                                                 hash_key, key,
+                                                 shader->variant_key_size);
+   if (data)
+      variant = container_of(data, struct draw_tes_llvm_variant, key);
 
    if (variant) {
       /* found the variant, move to head of global list (for LRU) */
@@ -257,7 +318,9 @@ llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
       variant = draw_tes_llvm_create_variant(llvm, draw_total_tes_outputs(draw), key);
 
       if (variant) {
+         variant->hash_key = hash_key;
          list_add(&variant->list_item_local.list, &shader->variants.list);
+         cso_hash_insert(&shader->variants_hash, hash_key, &variant->key);
          list_add(&variant->list_item_global.list, &llvm->tes_variants_list.list);
          llvm->nr_tes_variants++;
          shader->variants_cached++;
@@ -328,24 +391,25 @@ llvm_middle_end_prepare(struct draw_pt_middle_end *middle,
     */
    fpme->vertex_size = sizeof(struct vertex_header) + nr * 4 * sizeof(float);
 
+   draw_pt_vcache_prepare(draw->pt.vcache, fpme->vertex_size);
+
    /* return even number */
    *max_vertices = *max_vertices & ~1;
 
    /* Find/create the vertex shader variant */
    {
       struct draw_llvm_variant *variant = NULL;
-      struct draw_llvm_variant_list_item *li;
       struct llvm_vertex_shader *shader = llvm_vertex_shader(vs);
       char store[DRAW_LLVM_MAX_VARIANT_KEY_SIZE];
       struct draw_llvm_variant_key *key = draw_llvm_make_variant_key(llvm, store);
 
       /* Search shader's list of variants for the key */
-      LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-         if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-            variant = li->base;
-            break;
-         }
-      }
+      const unsigned hash_key = _mesa_hash_data(key, shader->variant_key_size);
+      void *data = cso_hash_find_data_from_template(&shader->variants_hash,
+                                                    hash_key, key,
+                                                    shader->variant_key_size);
+      if (data)
+         variant = container_of(data, struct draw_llvm_variant, key);
 
       if (variant) {
          /* found the variant, move to head of global list (for LRU) */
@@ -381,7 +445,9 @@ llvm_middle_end_prepare(struct draw_pt_middle_end *middle,
          variant = draw_llvm_create_variant(llvm, nr, key);
 
          if (variant) {
+            variant->hash_key = hash_key;
             list_add(&variant->list_item_local.list, &shader->variants.list);
+            cso_hash_insert(&shader->variants_hash, hash_key, &variant->key);
             list_add(&variant->list_item_global.list, &llvm->vs_variants_list.list);
             llvm->nr_variants++;
             shader->variants_cached++;
@@ -542,44 +608,154 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Copy the segment's vertices which are in the vertex cache, and make a
+ * list of the ones to shade.
+ */
 static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+llvm_vs_job_lookup(struct llvm_middle_end *fpme,
+                   struct llvm_vs_job *job)
+{
+   struct pt_vcache *vcache = fpme->draw->pt.vcache;
+   const struct draw_fetch_info *fetch_info = &job->fetch_info;
+   const unsigned count = fetch_info->count;
+   const struct pt_vcache_tag tag = {
+      .instance_id = job->instance_id,
+      .start_instance = job->start_instance,
+      .vertex_id_offset = job->vertex_id_offset,
+      .drawid = job->drawid,
+      .viewid = job->viewid,
+      .linear = fetch_info->linear,
+   };
+
+   job->vcache_serial = draw_pt_vcache_begin(vcache, &tag);
+   if (!job->vcache_serial)
+      return;
+
+   job->miss_elts = MALLOC(2 * count * sizeof(unsigned));
+   if (!job->miss_elts) {
+      job->vcache_serial = 0;
+      return;
+   }
+   job->miss_pos = job->miss_elts + count;
+
+   const boolean need_edgeflags =
+      fpme->current_variant->key.need_edgeflags;
+   char *verts = (char *)job->vert_info.verts;
+   unsigned num_misses = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      const unsigned elt = fetch_info->linear ?
+         fetch_info->start + i : fetch_info->elts[i];
+      const struct vertex_header *vertex =
+         draw_pt_vcache_lookup(vcache, elt);
+
+      if (vertex) {
+         memcpy(verts + i * fpme->vertex_size, vertex, fpme->vertex_size);
+         /* The shader only tells us whether any vertex was clipped, so
+          * this is conservative.
+          */
+         job->hits_clipped |= vertex->clipmask ||
+                              (need_edgeflags && !vertex->edgeflag);
+      } else {
+         job->miss_elts[num_misses] = elt;
+         job->miss_pos[num_misses++] = i;
+      }
+   }
+
+   /* Shading a subset of a linear fetch would need it to go through the
+    * elts path, which has another base vertex, so shade it all.
+    */
+   if (fetch_info->linear && num_misses && num_misses < count) {
+      for (unsigned i = 0; i < count; i++) {
+         job->miss_elts[i] = fetch_info->start + i;
+         job->miss_pos[i] = i;
+      }
+      num_misses = count;
+      job->hits_clipped = FALSE;
+   }
+
+   job->num_misses = num_misses;
+}
+
+
+/**
+ * Add the vertices shaded for a segment to the vertex cache.
+ */
+static void
+llvm_vs_job_cache(struct llvm_middle_end *fpme,
+                  struct llvm_vs_job *job)
+{
+   if (job->vcache_serial) {
+      const char *verts = (const char *)job->vert_info.verts;
+
+      for (unsigned i = 0; i < job->num_misses; i++) {
+         draw_pt_vcache_insert(fpme->draw->pt.vcache, job->vcache_serial,
+                               job->miss_elts[i],
+                               (const struct vertex_header *)
+                               (verts + job->miss_pos[i] * fpme->vertex_size));
+      }
+   }
+
+   FREE(job->miss_elts);
+   job->miss_elts = NULL;
+}
+
+
+/**
+ * Set up a segment's vertex shader run: capture the draw state it needs
+ * and allocate the vertices.
+ */
+static boolean
+llvm_vs_job_init(struct llvm_middle_end *fpme,
+                 struct llvm_vs_job *job,
+                 const struct draw_fetch_info *fetch_info,
+                 const struct draw_prim_info *prim_info)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_tess_ctrl_shader *tcs_shader = draw->tcs.tess_ctrl_shader;
-   struct draw_tess_eval_shader *tes_shader = draw->tes.tess_eval_shader;
-   struct draw_prim_info tcs_prim_info;
-   struct draw_prim_info tes_prim_info;
-   struct draw_prim_info gs_prim_info[TGSI_MAX_VERTEX_STREAMS];
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info tcs_vert_info;
-   struct draw_vertex_info tes_vert_info;
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   boolean clipped = 0;
-   ushort *tes_elts_out = NULL;
 
    assert(fetch_info->count > 0);
 
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
+   job->fpme = fpme;
+   job->fetch_info = *fetch_info;
+   job->prim_info = *prim_info;
+   job->prim_length = prim_info->primitive_lengths[0];
+   job->prim_info.primitive_lengths = &job->prim_length;
+   assert(prim_info->primitive_count == 1);
+
+   job->vert_info.count = fetch_info->count;
+   job->vert_info.vertex_size = fpme->vertex_size;
+   job->vert_info.stride = fpme->vertex_size;
+   job->vert_info.verts = (struct vertex_header *)
       MALLOC(fpme->vertex_size *
              align(fetch_info->count, lp_native_vector_width / 32) +
              DRAW_EXTRA_VERTICES_PADDING);
-   if (!llvm_vert_info.verts) {
+   if (!job->vert_info.verts) {
       assert(0);
-      return;
+      return FALSE;
+   }
+
+   if (fetch_info->linear) {
+      job->start = fetch_info->start;
+      job->vertex_id_offset = draw->start_index;
+   } else {
+      job->start = draw->pt.user.eltMax;
+      job->vertex_id_offset = draw->pt.user.eltBias;
    }
+   job->instance_id = draw->instance_id;
+   job->start_instance = draw->start_instance;
+   job->drawid = draw->pt.user.drawid;
+   job->viewid = draw->pt.user.viewid;
+
+   job->vcache_serial = 0;
+   job->num_misses = fetch_info->count;
+   job->miss_elts = NULL;
+   job->miss_pos = NULL;
+   job->hits_clipped = FALSE;
+
+   /* Only indexed draws are worth looking up */
+   if (draw->pt.user.eltSize)
+      llvm_vs_job_lookup(fpme, job);
 
    if (draw->collect_statistics) {
       draw->statistics.ia_vertices += prim_info->count;
@@ -592,40 +768,107 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
-   {
-      unsigned start, vertex_id_offset;
-      const unsigned *elts;
+   return TRUE;
+}
 
-      if (fetch_info->linear) {
-         start = fetch_info->start;
-         vertex_id_offset = draw->start_index;
-         elts = NULL;
-      } else {
-         start = draw->pt.user.eltMax;
-         vertex_id_offset = draw->pt.user.eltBias;
-         elts = fetch_info->elts;
+
+/**
+ * Run the vertex fetch shader, with the clip test and viewport
+ * transform, for a segment.  Called directly with thread_index -1.
+ */
+static void
+llvm_vs_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct llvm_vs_job *job = data;
+   struct llvm_middle_end *fpme = job->fpme;
+   struct draw_context *draw = fpme->draw;
+   unsigned fpstate = 0;
+
+   /* as set by draw_vbo() on the calling thread */
+   if (thread_index >= 0) {
+      fpstate = util_fpstate_get();
+      util_fpstate_set_denorms_to_zero(fpstate);
+   }
+
+   struct vertex_header *verts = job->vert_info.verts;
+   unsigned count = job->fetch_info.count;
+   const unsigned *elts = job->fetch_info.linear ? NULL : job->fetch_info.elts;
+
+   /* Only shade the vertices which weren't in the cache, and put them
+    * in their place afterwards.
+    */
+   if (job->num_misses < count) {
+      assert(!job->fetch_info.linear || !job->num_misses);
+      count = job->num_misses;
+      elts = job->miss_elts;
+      verts = count ? MALLOC(fpme->vertex_size *
+                             align(count, lp_native_vector_width / 32) +
+                             DRAW_EXTRA_VERTICES_PADDING) : NULL;
+      if (count && !verts) {
+         assert(0);
+         count = 0;
+      }
+   }
+
+   job->clipped = FALSE;
+   if (count) {
+      job->clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                                     verts,
+                                                     draw->pt.user.vbuffer,
+                                                     count,
+                                                     job->start,
+                                                     fpme->vertex_size,
+                                                     draw->pt.vertex_buffer,
+                                                     job->instance_id,
+                                                     job->vertex_id_offset,
+                                                     job->start_instance,
+                                                     elts,
+                                                     job->drawid,
+                                                     job->viewid);
+   }
+
+   if (verts != job->vert_info.verts) {
+      for (unsigned i = 0; i < count; i++) {
+         memcpy((char *)job->vert_info.verts +
+                job->miss_pos[i] * fpme->vertex_size,
+                (char *)verts + i * fpme->vertex_size,
+                fpme->vertex_size);
       }
-      /* Run vertex fetch shader */
-      clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                                llvm_vert_info.verts,
-                                                draw->pt.user.vbuffer,
-                                                fetch_info->count,
-                                                start,
-                                                fpme->vertex_size,
-                                                draw->pt.vertex_buffer,
-                                                draw->instance_id,
-                                                vertex_id_offset,
-                                                draw->start_instance,
-                                                elts,
-                                                draw->pt.user.drawid,
-                                                draw->pt.user.viewid);
-
-      /* Finished with fetch and vs */
-      fetch_info = NULL;
-      vert_info = &llvm_vert_info;
+      FREE(verts);
    }
+   job->clipped |= job->hits_clipped;
+
+   if (thread_index >= 0)
+      util_fpstate_set(fpstate);
+}
 
 
+/**
+ * Everything after the vertex shader: tessellation, geometry shader or
+ * primitive assembly, stream output, and the pipeline or emit.
+ */
+static void
+llvm_pipeline_generic(struct llvm_middle_end *fpme,
+                      struct llvm_vs_job *job)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_tess_ctrl_shader *tcs_shader = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes_shader = draw->tes.tess_eval_shader;
+   struct draw_prim_info tcs_prim_info;
+   struct draw_prim_info tes_prim_info;
+   struct draw_prim_info gs_prim_info[TGSI_MAX_VERTEX_STREAMS];
+   struct draw_vertex_info tcs_vert_info;
+   struct draw_vertex_info tes_vert_info;
+   struct draw_vertex_info *vert_info = &job->vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   const struct draw_prim_info *prim_info = &job->prim_info;
+   boolean free_prim_info = FALSE;
+   unsigned opt = fpme->opt;
+   boolean clipped = job->clipped;
+   ushort *tes_elts_out = NULL;
+
    if (opt & PT_SHADE) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
       if (tcs_shader) {
@@ -773,6 +1016,101 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Finish the oldest segment in flight: wait for its vertices, and run
+ * them through the rest of the pipeline.
+ */
+static void
+llvm_middle_end_retire_job(struct llvm_middle_end *fpme)
+{
+   struct llvm_vs_job *job = &fpme->jobs[fpme->first_job];
+
+   assert(fpme->pending_jobs);
+   fpme->first_job = (fpme->first_job + 1) % fpme->num_jobs;
+   fpme->pending_jobs--;
+
+   util_queue_fence_wait(&job->fence);
+   llvm_vs_job_cache(fpme, job);
+   llvm_pipeline_generic(fpme, job);
+
+   FREE(job->elts);
+   job->elts = NULL;
+}
+
+
+/**
+ * Run a segment.  With worker threads, the vertex shader runs on one of
+ * them, while the calling thread emits the earlier segments in order.
+ */
+static void
+llvm_middle_end_segment(struct llvm_middle_end *fpme,
+                        const struct draw_fetch_info *fetch_info,
+                        const struct draw_prim_info *prim_info)
+{
+   if (!fpme->num_threads ||
+       (!fpme->pending_jobs &&
+        fetch_info->count < LLVM_VS_JOB_MIN_VERTICES)) {
+      struct llvm_vs_job job;
+
+      if (llvm_vs_job_init(fpme, &job, fetch_info, prim_info)) {
+         llvm_vs_job_execute(&job, NULL, -1);
+         llvm_vs_job_cache(fpme, &job);
+         llvm_pipeline_generic(fpme, &job);
+      }
+      return;
+   }
+
+   if (fpme->pending_jobs == fpme->num_jobs)
+      llvm_middle_end_retire_job(fpme);
+
+   struct llvm_vs_job *job =
+      &fpme->jobs[(fpme->first_job + fpme->pending_jobs) % fpme->num_jobs];
+
+   if (!llvm_vs_job_init(fpme, job, fetch_info, prim_info))
+      return;
+
+   /* vsplit reuses its element arrays for the next segment */
+   const unsigned fetch_elts_size =
+      fetch_info->linear ? 0 : fetch_info->count * sizeof(unsigned);
+   const unsigned draw_elts_size =
+      prim_info->linear ? 0 : prim_info->count * sizeof(ushort);
+
+   if (fetch_elts_size || draw_elts_size) {
+      job->elts = MALLOC(fetch_elts_size + draw_elts_size);
+      if (!job->elts) {
+         FREE(job->vert_info.verts);
+         FREE(job->miss_elts);
+         job->miss_elts = NULL;
+         return;
+      }
+      if (fetch_elts_size) {
+         memcpy(job->elts, fetch_info->elts, fetch_elts_size);
+         job->fetch_info.elts = job->elts;
+      }
+      if (draw_elts_size) {
+         memcpy((char *)job->elts + fetch_elts_size, prim_info->elts,
+                draw_elts_size);
+         job->prim_info.elts = (const ushort *)
+            ((char *)job->elts + fetch_elts_size);
+      }
+   }
+
+   util_queue_add_job(&fpme->queue, job, &job->fence,
+                      llvm_vs_job_execute, NULL, 0);
+   fpme->pending_jobs++;
+}
+
+
+static void
+llvm_middle_end_drain(struct draw_pt_middle_end *middle)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   while (fpme->pending_jobs)
+      llvm_middle_end_retire_job(fpme);
+}
+
+
 static inline enum pipe_prim_type
 prim_type(enum pipe_prim_type prim, unsigned flags)
 {
@@ -809,7 +1147,7 @@ llvm_middle_end_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
-   llvm_pipeline_generic(middle, &fetch_info, &prim_info);
+   llvm_middle_end_segment(fpme, &fetch_info, &prim_info);
 }
 
 
@@ -837,7 +1175,7 @@ llvm_middle_end_linear_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &count;
 
-   llvm_pipeline_generic(middle, &fetch_info, &prim_info);
+   llvm_middle_end_segment(fpme, &fetch_info, &prim_info);
 }
 
 
@@ -867,7 +1205,7 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
-   llvm_pipeline_generic(middle, &fetch_info, &prim_info);
+   llvm_middle_end_segment(fpme, &fetch_info, &prim_info);
 
    return TRUE;
 }
@@ -876,7 +1214,7 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_middle_end_drain(middle);
 }
 
 
@@ -885,6 +1223,14 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
 
+   if (fpme->jobs) {
+      llvm_middle_end_drain(middle);
+      util_queue_destroy(&fpme->queue);
+      for (unsigned i = 0; i < fpme->num_jobs; i++)
+         util_queue_fence_destroy(&fpme->jobs[i].fence);
+      FREE(fpme->jobs);
+   }
+
    if (fpme->fetch)
       draw_pt_fetch_destroy(fpme->fetch);
 
@@ -918,6 +1264,7 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.drain           = llvm_middle_end_drain;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
@@ -945,6 +1292,25 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   fpme->num_threads = MIN2(debug_get_num_option("DRAW_NUM_THREADS", 0),
+                            LLVM_MAX_VS_THREADS);
+   if (fpme->num_threads) {
+      /* keep each thread busy while the calling thread emits */
+      fpme->num_jobs = 2 * fpme->num_threads;
+      fpme->jobs = CALLOC(fpme->num_jobs, sizeof(*fpme->jobs));
+      if (!fpme->jobs)
+         goto fail;
+      if (!util_queue_init(&fpme->queue, "drawvs", fpme->num_jobs,
+                           fpme->num_threads, 0, NULL)) {
+         FREE(fpme->jobs);
+         fpme->jobs = NULL;
+         fpme->num_threads = 0;
+      } else {
+         for (unsigned i = 0; i < fpme->num_jobs; i++)
+            util_queue_fence_init(&fpme->jobs[i].fence);
+      }
+   }
+
    return &fpme->base;
 
  fail:
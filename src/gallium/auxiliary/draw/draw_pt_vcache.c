@@ -0,0 +1,373 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Post-transform vertex cache.
+ *
+ * vsplit only reuses shaded vertices within a segment.  This keeps the
+ * vertices the middle end shaded, keyed by their fetch index, so that
+ * later segments and later draws can copy them instead of running the
+ * vertex shader again.
+ *
+ * Entries are only valid for the state they were shaded with.  Rather
+ * than keying on all of it, the whole cache is invalidated whenever any
+ * of it changes: the shader and other state seen by the middle end's
+ * prepare(), the constants and other parameters, the vertex buffers, and
+ * the per draw/instance values in struct pt_vcache_tag.  Writes to the
+ * vertex data which draw can't see are up to the driver to report with
+ * draw_invalidate_vertex_cache(), and caching is only enabled for drivers
+ * which do, see draw_enable_vertex_cache().
+ */
+
+#include "util/u_memory.h"
+#include "draw/draw_context.h"
+#include "draw/draw_private.h"
+#include "draw/draw_pt.h"
+#include "draw/draw_vs.h"
+#include "compiler/shader_enums.h"
+#include "nir.h"
+
+#define VCACHE_WAYS 4
+#define VCACHE_SETS 1024
+
+/* Looking a vertex up and inserting it costs about as much as running a
+ * vertex shader of this many instructions, so smaller shaders are left
+ * alone.
+ */
+#define VCACHE_MIN_INSTRUCTIONS 64
+
+struct pt_vcache_set {
+   unsigned elt[VCACHE_WAYS];
+   unsigned serial[VCACHE_WAYS];
+   unsigned next;               /**< way to replace next */
+};
+
+struct pt_vcache {
+   struct draw_context *draw;
+
+   boolean enabled;             /**< by the driver */
+   boolean active;              /**< for the current vertex shader */
+   boolean per_draw;            /**< entries only last for one draw */
+   boolean tag_draw_params;     /**< vertex_id_offset and linear matter */
+   boolean tag_drawid;
+
+   /** Entries with another serial are invalid */
+   unsigned serial;
+   struct pt_vcache_tag tag;
+
+   unsigned vertex_size;
+   unsigned alloc_vertex_size;
+   char *verts;
+
+   /* The vertex buffers the entries were fetched from */
+   struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
+   struct draw_vertex_buffer vbuffer[PIPE_MAX_ATTRIBS];
+   unsigned nr_vertex_buffers;
+
+   uint64_t lookups;
+   uint64_t hits;
+
+   struct pt_vcache_set sets[VCACHE_SETS];
+};
+
+
+void
+draw_pt_vcache_invalidate(struct pt_vcache *vcache)
+{
+   if (++vcache->serial == 0) {
+      memset(vcache->sets, 0, sizeof(vcache->sets));
+      vcache->serial = 1;
+   }
+}
+
+
+void
+draw_pt_vcache_enable(struct pt_vcache *vcache, boolean enable)
+{
+   vcache->enabled = enable;
+   draw_pt_vcache_invalidate(vcache);
+}
+
+
+/**
+ * Whether the vertex shader reads any of the draw parameters which come
+ * from vertex_id_offset, or whether a vertex was fetched linearly.
+ */
+static boolean
+vs_reads_draw_params(const struct draw_vertex_shader *vs)
+{
+   if (vs->state.type == PIPE_SHADER_IR_NIR) {
+      const nir_shader *nir = vs->state.ir.nir;
+
+      return BITSET_TEST(nir->info.system_values_read,
+                         SYSTEM_VALUE_VERTEX_ID_ZERO_BASE) ||
+             BITSET_TEST(nir->info.system_values_read,
+                         SYSTEM_VALUE_BASE_VERTEX) ||
+             BITSET_TEST(nir->info.system_values_read,
+                         SYSTEM_VALUE_FIRST_VERTEX) ||
+             BITSET_TEST(nir->info.system_values_read,
+                         SYSTEM_VALUE_IS_INDEXED_DRAW);
+   }
+
+   for (unsigned i = 0; i < vs->info.num_system_values; i++) {
+      switch (vs->info.system_value_semantic_name[i]) {
+      case TGSI_SEMANTIC_VERTEXID:
+      case TGSI_SEMANTIC_INSTANCEID:
+      case TGSI_SEMANTIC_DRAWID:
+         break;
+      default:
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+
+/**
+ * Whether running the vertex shader costs more than the cache does.
+ * Loops, and the instructions inside them, only count once.
+ */
+static boolean
+vs_is_expensive(const struct draw_vertex_shader *vs)
+{
+   unsigned num_instructions = 0;
+
+   if (vs->state.type != PIPE_SHADER_IR_NIR)
+      return vs->info.num_instructions >= VCACHE_MIN_INSTRUCTIONS;
+
+   nir_foreach_function(function, (nir_shader *)vs->state.ir.nir) {
+      if (!function->impl)
+         continue;
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block)
+            num_instructions++;
+      }
+   }
+   return num_instructions >= VCACHE_MIN_INSTRUCTIONS;
+}
+
+
+/**
+ * Called on state changes, with the size of the middle end's vertices.
+ */
+void
+draw_pt_vcache_prepare(struct pt_vcache *vcache, unsigned vertex_size)
+{
+   const struct draw_vertex_shader *vs = vcache->draw->vs.vertex_shader;
+   const struct tgsi_shader_info *info = &vs->info;
+
+   draw_pt_vcache_invalidate(vcache);
+
+   /* Skipping invocations would lose the shader's side effects, and
+    * doesn't pay off for cheap shaders.
+    */
+   vcache->active = vcache->enabled && !info->writes_memory &&
+                    vs_is_expensive(vs);
+   if (!vcache->active)
+      return;
+
+   /* Resources other than the vertex and constant buffers can be written
+    * behind our back by any draw.
+    */
+   vcache->per_draw = info->file_count[TGSI_FILE_SAMPLER] ||
+                      info->file_count[TGSI_FILE_SAMPLER_VIEW] ||
+                      info->file_count[TGSI_FILE_IMAGE] ||
+                      info->file_count[TGSI_FILE_BUFFER] ||
+                      info->file_count[TGSI_FILE_HW_ATOMIC] ||
+                      info->uses_bindless_samplers ||
+                      info->uses_bindless_images;
+
+   vcache->tag_draw_params = vs_reads_draw_params(vs);
+   vcache->tag_drawid = info->uses_drawid;
+
+   vcache->vertex_size = vertex_size;
+   if (vertex_size > vcache->alloc_vertex_size) {
+      FREE(vcache->verts);
+      vcache->verts = MALLOC(VCACHE_SETS * VCACHE_WAYS * vertex_size);
+      vcache->alloc_vertex_size = vcache->verts ? vertex_size : 0;
+      if (!vcache->verts)
+         vcache->active = FALSE;
+   }
+}
+
+
+/**
+ * Called at the start of each draw, to throw away the entries if the
+ * vertex buffers have changed.
+ */
+void
+draw_pt_vcache_begin_draw(struct pt_vcache *vcache)
+{
+   struct draw_context *draw = vcache->draw;
+   const unsigned nr = draw->pt.nr_vertex_buffers;
+
+   if (!vcache->active)
+      return;
+
+   if (vcache->per_draw ||
+       vcache->nr_vertex_buffers != nr ||
+       memcmp(vcache->vertex_buffer, draw->pt.vertex_buffer,
+              nr * sizeof(vcache->vertex_buffer[0])) ||
+       memcmp(vcache->vbuffer, draw->pt.user.vbuffer,
+              nr * sizeof(vcache->vbuffer[0]))) {
+      draw_pt_vcache_invalidate(vcache);
+
+      memcpy(vcache->vertex_buffer, draw->pt.vertex_buffer,
+             nr * sizeof(vcache->vertex_buffer[0]));
+      memcpy(vcache->vbuffer, draw->pt.user.vbuffer,
+             nr * sizeof(vcache->vbuffer[0]));
+      vcache->nr_vertex_buffers = nr;
+   }
+
+   /* The contents of user buffers can change without anything telling
+    * us, so they're only good for this draw.
+    */
+   for (unsigned i = 0; i < nr; i++) {
+      if (draw->pt.vertex_buffer[i].is_user_buffer) {
+         vcache->nr_vertex_buffers = 0;
+         break;
+      }
+   }
+}
+
+
+/**
+ * Start looking up vertices shaded with the given draw parameters.
+ * Returns the serial to insert the shaded vertices with, or zero if the
+ * cache can't be used.
+ */
+unsigned
+draw_pt_vcache_begin(struct pt_vcache *vcache,
+                     const struct pt_vcache_tag *tag)
+{
+   if (!vcache->active)
+      return 0;
+
+   struct pt_vcache_tag masked = *tag;
+   if (!vcache->tag_draw_params) {
+      masked.vertex_id_offset = 0;
+      masked.linear = FALSE;
+   }
+   if (!vcache->tag_drawid)
+      masked.drawid = 0;
+
+   if (memcmp(&masked, &vcache->tag, sizeof(masked))) {
+      draw_pt_vcache_invalidate(vcache);
+      vcache->tag = masked;
+   }
+
+   return vcache->serial;
+}
+
+
+static inline char *
+vcache_vertex(const struct pt_vcache *vcache, unsigned set, unsigned way)
+{
+   return vcache->verts +
+      (set * VCACHE_WAYS + way) * (size_t)vcache->vertex_size;
+}
+
+
+const struct vertex_header *
+draw_pt_vcache_lookup(struct pt_vcache *vcache, unsigned elt)
+{
+   const unsigned s = elt % VCACHE_SETS;
+   const struct pt_vcache_set *set = &vcache->sets[s];
+
+   vcache->lookups++;
+
+   for (unsigned way = 0; way < VCACHE_WAYS; way++) {
+      if (set->elt[way] == elt && set->serial[way] == vcache->serial) {
+         vcache->hits++;
+         return (const struct vertex_header *)vcache_vertex(vcache, s, way);
+      }
+   }
+
+   return NULL;
+}
+
+
+/**
+ * Add a vertex shaded while the cache had the given serial.
+ */
+void
+draw_pt_vcache_insert(struct pt_vcache *vcache, unsigned serial,
+                      unsigned elt, const struct vertex_header *vertex)
+{
+   const unsigned s = elt % VCACHE_SETS;
+   struct pt_vcache_set *set = &vcache->sets[s];
+   unsigned way;
+
+   if (serial != vcache->serial)
+      return;
+
+   for (way = 0; way < VCACHE_WAYS; way++) {
+      if (set->serial[way] != serial)
+         break;
+      if (set->elt[way] == elt)
+         return;
+   }
+
+   if (way == VCACHE_WAYS) {
+      way = set->next;
+      set->next = (way + 1) % VCACHE_WAYS;
+   }
+
+   set->elt[way] = elt;
+   set->serial[way] = serial;
+   memcpy(vcache_vertex(vcache, s, way), vertex, vcache->vertex_size);
+}
+
+
+void
+draw_pt_vcache_get_stats(const struct pt_vcache *vcache,
+                         uint64_t *lookups, uint64_t *hits)
+{
+   *lookups = vcache->lookups;
+   *hits = vcache->hits;
+}
+
+
+struct pt_vcache *
+draw_pt_vcache_create(struct draw_context *draw)
+{
+   struct pt_vcache *vcache = CALLOC_STRUCT(pt_vcache);
+   if (!vcache)
+      return NULL;
+
+   vcache->draw = draw;
+   vcache->serial = 1;
+
+   return vcache;
+}
+
+
+void
+draw_pt_vcache_destroy(struct pt_vcache *vcache)
+{
+   FREE(vcache->verts);
+   FREE(vcache);
+}
@@ -354,10 +354,6 @@ int draw_tess_eval_shader_run(struct draw_tess_eval_shader *shader,
 #ifdef DRAW_LLVM_AVAILABLE
    struct pipe_tessellation_factors factors;
    struct pipe_tessellator_data data = { 0 };
-   struct pipe_tessellator *ptess = p_tess_init(shader->prim_mode,
-                                                shader->spacing,
-                                                !shader->vertex_order_cw,
-                                                shader->point_mode);
    for (unsigned i = 0; i < input_prim->primitive_count; i++) {
       uint32_t vert_start = output_verts->count;
       uint32_t prim_start = output_prims->primitive_count;
@@ -366,7 +362,7 @@ int draw_tess_eval_shader_run(struct draw_tess_eval_shader *shader,
       llvm_fetch_tess_factors(shader, i, num_input_vertices_per_patch, &factors);
 
       /* tessellate with the factors for this primitive */
-      p_tessellate(ptess, &factors, &data);
+      p_tessellate(shader->ptess, &factors, &data);
 
       if (data.num_domain_points == 0)
          continue;
@@ -404,7 +400,6 @@ int draw_tess_eval_shader_run(struct draw_tess_eval_shader *shader,
          output_prims->primitive_lengths[i] = prim_len;
       }
    }
-   p_tess_destroy(ptess);
 #endif
 
    *elts_out = elts;
@@ -432,6 +427,7 @@ draw_create_tess_ctrl_shader(struct draw_context *draw,
       tcs = &llvm_tcs->base;
 
       list_inithead(&llvm_tcs->variants.list);
+      cso_hash_init(&llvm_tcs->variants_hash);
    } else
 #endif
    {
@@ -496,6 +492,7 @@ void draw_delete_tess_ctrl_shader(struct draw_context *draw,
       }
 
       assert(shader->variants_cached == 0);
+      cso_hash_deinit(&shader->variants_hash);
       align_free(dtcs->tcs_input);
       align_free(dtcs->tcs_output);
    }
@@ -533,6 +530,7 @@ draw_create_tess_eval_shader(struct draw_context *draw,
 
       tes = &llvm_tes->base;
       list_inithead(&llvm_tes->variants.list);
+      cso_hash_init(&llvm_tes->variants_hash);
    } else
 #endif
    {
@@ -583,6 +581,8 @@ draw_create_tess_eval_shader(struct draw_context *draw,
       memset(tes->tes_input, 0, sizeof(struct draw_tes_inputs));
 
       tes->jit_context = &draw->llvm->tes_jit_context;
+      tes->ptess = p_tess_init(tes->prim_mode, tes->spacing,
+                               !tes->vertex_order_cw, tes->point_mode);
       llvm_tes->variant_key_size =
          draw_tes_llvm_variant_key_size(
                                         tes->info.file_max[TGSI_FILE_SAMPLER]+1,
@@ -623,7 +623,9 @@ void draw_delete_tess_eval_shader(struct draw_context *draw,
       }
 
       assert(shader->variants_cached == 0);
+      cso_hash_deinit(&shader->variants_hash);
       align_free(dtes->tes_input);
+      p_tess_destroy(dtes->ptess);
    }
 #endif
    if (dtes->state.type == PIPE_SHADER_IR_NIR && dtes->state.ir.nir)
@@ -30,6 +30,7 @@
 #include "draw_private.h"
 
 struct draw_context;
+struct pipe_tessellator;
 #ifdef DRAW_LLVM_AVAILABLE
 
 #define NUM_PATCH_INPUTS 32
@@ -96,6 +97,9 @@ struct draw_tess_eval_shader {
    struct draw_tes_inputs *tes_input;
    struct draw_tes_jit_context *jit_context;
    struct draw_tes_llvm_variant *current_variant;
+
+   /* Kept across draws for the patterns it caches */
+   struct pipe_tessellator *ptess;
 #endif
 };
 
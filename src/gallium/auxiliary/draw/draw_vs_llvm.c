@@ -77,6 +77,7 @@ vs_llvm_delete(struct draw_vertex_shader *dvs)
    }
 
    assert(shader->variants_cached == 0);
+   cso_hash_deinit(&shader->variants_hash);
    if (dvs->state.ir.nir)
       ralloc_free(dvs->state.ir.nir);
    FREE((void*) dvs->state.tokens);
@@ -126,6 +127,7 @@ draw_create_vs_llvm(struct draw_context *draw,
    vs->base.create_variant = draw_vs_create_variant_generic;
 
    list_inithead(&vs->variants.list);
+   cso_hash_init(&vs->variants_hash);
 
    return &vs->base;
 }
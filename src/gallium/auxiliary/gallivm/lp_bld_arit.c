@@ -1344,6 +1344,9 @@ lp_build_lerp_simple(struct lp_build_context *bld,
          } else if (bld->type.width == 16 && bld->type.length == 16 && util_get_cpu_caps()->has_avx2) {
             res = lp_build_intrinsic_binary(builder, "llvm.x86.avx2.pmul.hr.sw", bld->vec_type, x, lp_build_shl_imm(bld, delta, 7));
             res = lp_build_and(bld, res, lp_build_const_int_vec(bld->gallivm, bld->type, 0xff));
+         } else if (bld->type.width == 16 && bld->type.length == 32 && util_get_cpu_caps()->has_avx512bw) {
+            res = lp_build_intrinsic_binary(builder, "llvm.x86.avx512.pmul.hr.sw.512", bld->vec_type, x, lp_build_shl_imm(bld, delta, 7));
+            res = lp_build_and(bld, res, lp_build_const_int_vec(bld->gallivm, bld->type, 0xff));
          } else {
             res = lp_build_mul(bld, x, delta);
             res = lp_build_shr_imm(bld, res, half_width);
@@ -381,6 +381,49 @@ lp_build_gather_avx2(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * 16 wide version of lp_build_gather_avx2(), for 32 bit elements.
+ */
+static LLVMValueRef
+lp_build_gather_avx512(struct gallivm_state *gallivm,
+                       unsigned length,
+                       unsigned src_width,
+                       struct lp_type dst_type,
+                       LLVMValueRef base_ptr,
+                       LLVMValueRef offsets)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef src_type, src_vec_type;
+   LLVMValueRef res;
+   struct lp_type res_type = dst_type;
+   res_type.length *= length;
+
+   assert(src_width == 32);
+   assert(length == 16);
+   assert(LLVMTypeOf(base_ptr) == LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0));
+
+   if (dst_type.floating) {
+      src_type = LLVMFloatTypeInContext(gallivm->context);
+   } else {
+      src_type = LLVMIntTypeInContext(gallivm->context, src_width);
+   }
+   src_vec_type = LLVMVectorType(src_type, length);
+
+   const char *intrinsic = dst_type.floating ? "llvm.x86.avx512.gather.dps.512" :
+                                               "llvm.x86.avx512.gather.dpi.512";
+   LLVMValueRef passthru = LLVMGetUndef(src_vec_type);
+   LLVMValueRef mask = LLVMConstAllOnes(LLVMInt16TypeInContext(gallivm->context));
+   LLVMValueRef scale = lp_build_const_int32(gallivm, 1);
+
+   LLVMValueRef args[] = { passthru, base_ptr, offsets, mask, scale };
+
+   res = lp_build_intrinsic(builder, intrinsic, src_vec_type, args, 5, 0);
+   res = LLVMBuildBitCast(builder, res, lp_build_vec_type(gallivm, res_type), "");
+
+   return res;
+}
+
+
 /**
  * Gather elements from scatter positions in memory into a single vector.
  * Use for fetching texels from a texture.
@@ -491,6 +534,10 @@ lp_build_gather(struct gallivm_state *gallivm,
               src_width == 32 && (length == 4 || length == 8)) {
       return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
                                   base_ptr, offsets);
+   } else if (util_get_cpu_caps()->has_avx512f && !need_expansion &&
+              src_width == 32 && length == 16) {
+      return lp_build_gather_avx512(gallivm, length, src_width, dst_type,
+                                    base_ptr, offsets);
    /*
     * This looks bad on paper wrt throughtput/latency on Haswell.
     * Even on Broadwell it doesn't look stellar.
@@ -72,6 +72,13 @@ struct gallivm_state
 
    struct lp_cached_code *cache;
    unsigned compiled;
+   /**
+    * Set before gallivm_compile_module() to compile quickly rather than
+    * well, for code which is replaced once optimized code is ready.  It is
+    * cleared if the code comes from the cache instead.  Only ORCJIT
+    * honours it, see LPIRCompiler.
+    */
+   boolean fast_compile;
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
    LLVMValueRef debug_printf_hook;
@@ -3,6 +3,7 @@
 #include "util/macros.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
+#include "util/u_atomic.h"
 #include "util/os_time.h"
 #include "lp_bld.h"
 #include "lp_bld_debug.h"
@@ -35,6 +36,8 @@
 #include <llvm/ADT/StringMap.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include "llvm/ExecutionEngine/JITLink/JITLink.h"
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Support/TargetSelect.h>
@@ -48,6 +51,8 @@
 /* conflict with ObjectLinkingLayer.h */
 #include "util/u_memory.h"
 
+#include <mutex>
+
 #if DETECT_ARCH_RISCV64 || DETECT_ARCH_RISCV32 || (defined(_WIN32) && LLVM_VERSION_MAJOR >= 15)
 /* use ObjectLinkingLayer (JITLINK backend) */
 #define USE_JITLINK
@@ -124,6 +129,109 @@ inline const char* get_module_name(LLVMModuleRef mod) {
 
 once_flag init_lpjit_once_flag = ONCE_FLAG_INIT;
 
+/*
+ * Object cache shared by all modules.  The compile layer may compile
+ * modules on any thread, so the lp_cached_code of each module is looked up
+ * by module name, for as long as its gallivm_state has IR.
+ *
+ * The cached objects are relocatable, they are linked into the module's
+ * JITDylib like freshly compiled ones, and so resolve against its global
+ * mappings the same way.
+ */
+class LPObjectCache : public llvm::ObjectCache {
+public:
+   void add(const char *module_name, struct lp_cached_code *cache) {
+      std::lock_guard<std::mutex> lock(mutex);
+      caches[module_name] = cache;
+   }
+
+   void remove(const char *module_name) {
+      std::lock_guard<std::mutex> lock(mutex);
+      caches.erase(module_name);
+   }
+
+   bool has_object(const llvm::Module *M) {
+      std::lock_guard<std::mutex> lock(mutex);
+      struct lp_cached_code *cache = find(M);
+      return cache && cache->data_size;
+   }
+
+   void notifyObjectCompiled(const llvm::Module *M,
+                             llvm::MemoryBufferRef Obj) override {
+      std::lock_guard<std::mutex> lock(mutex);
+      struct lp_cached_code *cache = find(M);
+      if (!cache || cache->data_size)
+         return;
+      cache->data = malloc(Obj.getBufferSize());
+      if (!cache->data)
+         return;
+      cache->data_size = Obj.getBufferSize();
+      memcpy(cache->data, Obj.getBufferStart(), cache->data_size);
+   }
+
+   std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) override {
+      std::lock_guard<std::mutex> lock(mutex);
+      struct lp_cached_code *cache = find(M);
+      if (!cache || !cache->data_size)
+         return nullptr;
+      /* the link layer may outlive the gallivm_state's IR */
+      return llvm::MemoryBuffer::getMemBufferCopy(
+         llvm::StringRef((const char *)cache->data, cache->data_size),
+         M->getModuleIdentifier());
+   }
+
+private:
+   struct lp_cached_code *find(const llvm::Module *M) {
+      auto I = caches.find(M->getModuleIdentifier());
+      return I == caches.end() ? NULL : I->second;
+   }
+
+   llvm::StringMap<struct lp_cached_code *> caches;
+   std::mutex mutex;
+};
+
+/* named metadata marking modules of gallivm states with fast_compile set */
+const char fast_compile_md[] = "lp.fast_compile";
+
+bool is_fast_compile_module(LLVMModuleRef mod) {
+   return LLVMGetNamedMetadataNumOperands(mod, fast_compile_md) != 0;
+}
+
+/*
+ * Like ConcurrentIRCompiler, but generates the code of fast_compile
+ * modules at -O0, which also selects fast instruction selection.
+ */
+class LPIRCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+public:
+   LPIRCompiler(llvm::orc::JITTargetMachineBuilder JTMB,
+                llvm::ObjectCache *ObjCache)
+      : IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(JTMB.getOptions())),
+        JTMB(std::move(JTMB)), ObjCache(ObjCache) {}
+
+   llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>>
+   operator()(llvm::Module &M) override {
+      llvm::orc::JITTargetMachineBuilder builder = JTMB;
+      if (is_fast_compile_module(llvm::wrap(&M))) {
+#if LLVM_VERSION_MAJOR >= 18
+         builder.setCodeGenOptLevel(llvm::CodeGenOptLevel::None);
+#else
+         builder.setCodeGenOptLevel(llvm::CodeGenOpt::None);
+#endif
+      }
+
+      auto TM = builder.createTargetMachine();
+      if (!TM)
+         return TM.takeError();
+
+      llvm::orc::SimpleCompiler C(**TM, ObjCache);
+      return C(M);
+   }
+
+private:
+   llvm::orc::JITTargetMachineBuilder JTMB;
+   llvm::ObjectCache *ObjCache;
+};
+
 /* A JIT singleton built upon LLJIT */
 class LPJit
 {
@@ -136,6 +244,7 @@ public:
    gallivm_state *find_gallivm_state(LLVMModuleRef mod) {
 #if DEBUG
       using llvm::Module;
+      std::lock_guard<std::mutex> lock(gallivm_modules_mutex);
       auto I = gallivm_modules.find(llvm::unwrap(mod)->getModuleIdentifier());
       if (I == gallivm_modules.end()) {
          debug_printf("No gallivm state found for module: %s", get_module_name(mod));
@@ -154,7 +263,8 @@ public:
          return NULL;
       }
       do {
-         snprintf(name_uniq, size, "%s_%u", name, jit->jit_dylib_count++);
+         snprintf(name_uniq, size, "%s_%u", name,
+                  p_atomic_inc_return(&jit->jit_dylib_count) - 1);
       } while(jit->lljit->getExecutionSession().getJITDylibByName(name_uniq));
       return name_uniq;
    }
@@ -169,6 +279,7 @@ public:
    static void register_gallivm_state(gallivm_state *gallivm) {
 #if DEBUG
       LPJit* jit = get_instance();
+      std::lock_guard<std::mutex> lock(jit->gallivm_modules_mutex);
       jit->gallivm_modules[gallivm->module_name] = gallivm;
 #endif
    }
@@ -176,6 +287,7 @@ public:
    static void deregister_gallivm_state(gallivm_state *gallivm) {
 #if DEBUG
       LPJit* jit = get_instance();
+      std::lock_guard<std::mutex> lock(jit->gallivm_modules_mutex);
       (void)jit->gallivm_modules.erase(gallivm->module_name);
 #endif
    }
@@ -226,6 +338,18 @@ public:
 #endif
    }
 
+   static void register_cached_code(gallivm_state *gallivm) {
+      get_instance()->object_cache.add(gallivm->module_name, gallivm->cache);
+   }
+
+   static void deregister_cached_code(gallivm_state *gallivm) {
+      get_instance()->object_cache.remove(gallivm->module_name);
+   }
+
+   static bool has_cached_object(LLVMModuleRef mod) {
+      return get_instance()->object_cache.has_object(llvm::unwrap(mod));
+   }
+
    static void remove_jd(LLVMOrcJITDylibRef jd) {
       using llvm::orc::ExecutionSession;
       using llvm::orc::JITDylib;
@@ -250,18 +374,26 @@ private:
    static LPJit* jit;
 
    std::unique_ptr<llvm::orc::LLJIT> lljit;
+   LPObjectCache object_cache;
    /* avoid name conflict */
    unsigned jit_dylib_count;
 
 #if DEBUG
    /* map from module name to gallivm_state */
    llvm::StringMap<gallivm_state *> gallivm_modules;
+   std::mutex gallivm_modules_mutex;
 #endif
 };
 
 LPJit* LPJit::jit = NULL;
 
 LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
+   /* the compile layer will use the cached object instead of the IR */
+   if (LPJit::has_cached_object(mod))
+      return LLVMErrorSuccess;
+
+   const bool skip_opt = (gallivm_perf & GALLIVM_PERF_NO_OPT) ||
+                         is_fast_compile_module(mod);
    int64_t time_begin = 0;
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
@@ -280,7 +412,7 @@ LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
    LLVMRunPasses(mod, passes, tm, opts);
 
-   if (!(gallivm_perf & GALLIVM_PERF_NO_OPT))
+   if (!skip_opt)
       strcpy(passes, "sroa,early-cse,simplifycfg,reassociate,mem2reg,instsimplify,instcombine");
    else
       strcpy(passes, "mem2reg");
@@ -305,7 +437,7 @@ LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
    LLVMAddCoroElidePass(cgpassmgr);
 #endif
 
-   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
+   if (!skip_opt) {
       /*
        * TODO: Evaluate passes some more - keeping in mind
        * both quality of generated code and compile times.
@@ -406,9 +538,20 @@ LPJit::LPJit() :jit_dylib_count(0) {
     * or RuntimeDyld as the base layer.
     * intel & perf listeners are not supported by ObjectLinkingLayer yet
     */
+   /* Modules are compiled on whichever thread looks them up first, and
+    * several threads may do so at once (e.g. llvmpipe's background shader
+    * compiles), so use a compiler that doesn't share the target machine.
+    * It checks the object cache before compiling.
+    */
    lljit = ExitOnErr(
       LLJITBuilder()
          .setJITTargetMachineBuilder(std::move(JTMB))
+         .setCompileFunctionCreator(
+            [this](JITTargetMachineBuilder tmb)
+               -> llvm::Expected<std::unique_ptr<IRCompileLayer::IRCompiler>> {
+               return std::make_unique<LPIRCompiler>(std::move(tmb),
+                                                     &object_cache);
+            })
 #ifdef USE_JITLINK
          .setObjectLinkingLayerCreator(
             [&](ExecutionSession &ES, const llvm::Triple &TT) {
@@ -468,8 +611,7 @@ void LPJit::init_native_targets() {
    // Default to 256 until we're confident llvmpipe with 512 is as correct and not slower than 256
    ::lp_native_vector_width = MIN2(util_get_cpu_caps()->max_vector_bits, 256);
    ::lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
-                                                   util_get_cpu_caps()
-                                                   ->max_vector_bits);
+                                                   ::lp_native_vector_width);
 
 #if DETECT_ARCH_PPC_64
    /* Set the NJ bit in VSCR to 0 so denormalized values are handled as
@@ -596,14 +738,15 @@ llvm::orc::JITTargetMachineBuilder LPJit::create_jtdb() {
    MAttrs.push_back(util_get_cpu_caps()->has_f16c ? "+f16c" : "-f16c");
    MAttrs.push_back(util_get_cpu_caps()->has_fma  ? "+fma"  : "-fma");
    MAttrs.push_back(util_get_cpu_caps()->has_avx2 ? "+avx2" : "-avx2");
-   /* disable avx512 and all subvariants */
-   MAttrs.push_back("-avx512cd");
-   MAttrs.push_back("-avx512er");
-   MAttrs.push_back("-avx512f");
-   MAttrs.push_back("-avx512pf");
-   MAttrs.push_back("-avx512bw");
-   MAttrs.push_back("-avx512dq");
-   MAttrs.push_back("-avx512vl");
+
+   /* All avx512 have avx512f */
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512f ? "+avx512f"  : "-avx512f");
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512cd ? "+avx512cd"  : "-avx512cd");
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512er ? "+avx512er"  : "-avx512er");
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512pf ? "+avx512pf"  : "-avx512pf");
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512bw ? "+avx512bw"  : "-avx512bw");
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512dq ? "+avx512dq"  : "-avx512dq");
+   MAttrs.push_back(util_get_cpu_caps()->has_avx512vl ? "+avx512vl"  : "-avx512vl");
 #endif
 #if DETECT_ARCH_ARM
    if (!util_get_cpu_caps()->has_neon) {
@@ -778,10 +921,7 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
    if (!lp_build_init())
       return FALSE;
 
-   // cache is not implemented
    gallivm->cache = cache;
-   if (gallivm->cache)
-      gallivm->cache->data_size = 0;
 
    gallivm->_ts_context = context;
    gallivm->context = LLVMOrcThreadSafeContextGetContext(context);
@@ -831,6 +971,12 @@ gallivm_free_ir(struct gallivm_state *gallivm)
 {
    if (gallivm->module)
       LLVMDisposeModule(gallivm->module);
+
+   if (gallivm->cache) {
+      if (gallivm->module_name)
+         LPJit::deregister_cached_code(gallivm);
+      free(gallivm->cache->data);
+   }
    FREE(gallivm->module_name);
 
    if (gallivm->target) {
@@ -890,16 +1036,18 @@ void
 gallivm_compile_module(struct gallivm_state *gallivm)
 {
    if (gallivm_debug & GALLIVM_DEBUG_DUMP_BC) {
+      const bool skip_opt = (gallivm_perf & GALLIVM_PERF_NO_OPT) ||
+                            gallivm->fast_compile;
       char filename[256];
       assert(gallivm->module_name);
       snprintf(filename, sizeof(filename), "ir_%s.bc", gallivm->module_name);
       LLVMWriteBitcodeToFile(gallivm->module, filename);
       debug_printf("%s written\n", filename);
       debug_printf("Invoke as \"opt %s %s | llc -O%d %s%s\"\n",
-                   gallivm_perf & GALLIVM_PERF_NO_OPT ? "-mem2reg" :
+                   skip_opt ? "-mem2reg" :
                    "-sroa -early-cse -simplifycfg -reassociate "
                    "-mem2reg -constprop -instcombine -gvn",
-                   filename, gallivm_perf & GALLIVM_PERF_NO_OPT ? 0 : 2,
+                   filename, skip_opt ? 0 : 2,
                    "[-mcpu=<-mcpu option>] ",
                    "[-mattr=<-mattr option(s)>]");
    }
@@ -912,6 +1060,22 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
    lp_build_coro_add_malloc_hooks(gallivm);
 
+   if (gallivm->cache && gallivm->cache->data_size) {
+      /* loading the cached code is quicker still, and it is optimized */
+      gallivm->fast_compile = FALSE;
+   } else if (gallivm->fast_compile && gallivm->cache) {
+      /* don't let unoptimized code into the disk cache */
+      gallivm->cache->dont_cache = true;
+   }
+
+   if (gallivm->fast_compile) {
+      LLVMAddNamedMetadataOperand(gallivm->module, fast_compile_md,
+                                  LLVMMDNodeInContext(gallivm->context,
+                                                      NULL, 0));
+   } else if (gallivm->cache) {
+      LPJit::register_cached_code(gallivm);
+   }
+
    LPJit::add_ir_module_to_jd(gallivm->_ts_context, gallivm->module,
       gallivm->_per_module_jd);
    /* ownership of module is now transferred into orc jit,
@@ -245,6 +245,31 @@ lp_build_cmp(struct lp_build_context *bld,
 }
 
 
+
+/**
+ * Like lp_build_cmp(), for a compare function only known at run time.
+ * All the comparisons are done, and the one of func selected.
+ */
+LLVMValueRef
+lp_build_cmp_dynamic(struct lp_build_context *bld,
+                     LLVMValueRef func,
+                     LLVMValueRef a,
+                     LLVMValueRef b)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   LLVMValueRef res = lp_build_cmp(bld, PIPE_FUNC_NEVER, a, b);
+
+   for (unsigned f = PIPE_FUNC_LESS; f <= PIPE_FUNC_ALWAYS; f++) {
+      LLVMValueRef is_func =
+         LLVMBuildICmp(builder, LLVMIntEQ, func,
+                       lp_build_const_int32(bld->gallivm, f), "");
+      res = LLVMBuildSelect(builder, is_func,
+                            lp_build_cmp(bld, f, a, b), res, "");
+   }
+
+   return res;
+}
+
 /**
  * Return (mask & a) | (~mask & b);
  */
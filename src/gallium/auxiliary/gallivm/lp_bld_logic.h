@@ -72,6 +72,15 @@ lp_build_cmp_ordered(struct lp_build_context *bld,
                      LLVMValueRef a,
                      LLVMValueRef b);
 
+/**
+ * @param func is a scalar i32 holding one of PIPE_FUNC_xxx
+ */
+LLVMValueRef
+lp_build_cmp_dynamic(struct lp_build_context *bld,
+                     LLVMValueRef func,
+                     LLVMValueRef a,
+                     LLVMValueRef b);
+
 LLVMValueRef
 lp_build_select_bitwise(struct lp_build_context *bld,
                         LLVMValueRef mask,
@@ -1228,6 +1228,58 @@ mem_access_base_pointer(struct lp_build_nir_context *bld_base,
       return LLVMBuildBitCast(gallivm->builder, ptr, LLVMPointerType(mem_bld->elem_type, 0), "");
 }
 
+/*
+ * Whether a memory access uses the same buffer for all invocations, so its
+ * per invocation addresses can be formed as a vector for a gather or
+ * scatter, instead of looping over the invocations.
+ */
+static bool
+mem_access_has_uniform_base(LLVMValueRef index)
+{
+   if (!index)
+      return true;
+   if (!LLVMIsConstant(index))
+      return false;
+
+   LLVMValueRef first = LLVMGetElementAsConstant(index, 0);
+   if (!first)
+      return false;
+   for (unsigned i = 1; i < LLVMGetVectorSize(LLVMTypeOf(index)); i++) {
+      if (LLVMGetElementAsConstant(index, i) != first)
+         return false;
+   }
+   return true;
+}
+
+/*
+ * Vector of element pointers for channel chan of such an access, and the
+ * mask of invocations which are active and in bounds.
+ */
+static LLVMValueRef
+mem_access_uniform_ptrs(struct lp_build_nir_context *bld_base,
+                        struct lp_build_context *mem_bld,
+                        unsigned bit_size,
+                        LLVMValueRef index, LLVMValueRef offset,
+                        unsigned chan, LLVMValueRef *mask)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef limit;
+   LLVMValueRef base_ptr = mem_access_base_pointer(bld_base, mem_bld, bit_size, index,
+                                                   lp_build_const_int32(gallivm, 0), &limit);
+   LLVMValueRef chan_offset = lp_build_add(uint_bld, offset,
+                                           lp_build_const_int_vec(gallivm, uint_bld->type, chan));
+
+   *mask = mask_vec(bld_base);
+   if (limit) {
+      LLVMValueRef in_bounds = lp_build_cmp(uint_bld, PIPE_FUNC_LESS, chan_offset,
+                                            lp_build_broadcast_scalar(uint_bld, limit));
+      *mask = LLVMBuildAnd(gallivm->builder, *mask, in_bounds, "");
+   }
+
+   return LLVMBuildGEP2(gallivm->builder, mem_bld->elem_type, base_ptr, &chan_offset, 1, "");
+}
+
 static void emit_load_mem(struct lp_build_nir_context *bld_base,
                           unsigned nc,
                           unsigned bit_size,
@@ -1282,6 +1334,19 @@ static void emit_load_mem(struct lp_build_nir_context *bld_base,
       return;
    }
 
+   if (mem_access_has_uniform_base(index)) {
+      for (unsigned c = 0; c < nc; c++) {
+         LLVMValueRef fetch_mask;
+         LLVMValueRef ptrs = mem_access_uniform_ptrs(bld_base, load_bld, bit_size, index,
+                                                     offset, c, &fetch_mask);
+
+         /* out of bounds invocations read 0 */
+         outval[c] = lp_build_masked_gather(gallivm, load_bld->type.length, bit_size,
+                                            load_bld->vec_type, ptrs, fetch_mask);
+      }
+      return;
+   }
+
    /* although the index is dynamically uniform that doesn't count if exec mask isn't set, so read the one-by-one */
 
    LLVMValueRef result[NIR_MAX_VEC_COMPONENTS];
@@ -1391,6 +1456,22 @@ static void emit_store_mem(struct lp_build_nir_context *bld_base,
       return;
    }
 
+   if (mem_access_has_uniform_base(index)) {
+      for (unsigned c = 0; c < nc; c++) {
+         if (!(writemask & (1u << c)))
+            continue;
+
+         LLVMValueRef store_mask;
+         LLVMValueRef ptrs = mem_access_uniform_ptrs(bld_base, store_bld, bit_size, index,
+                                                     offset, c, &store_mask);
+         LLVMValueRef val = (nc == 1) ? dst : LLVMBuildExtractValue(builder, dst, c, "");
+         val = LLVMBuildBitCast(builder, val, store_bld->vec_type, "");
+         lp_build_masked_scatter(gallivm, store_bld->type.length, bit_size,
+                                 ptrs, val, store_mask);
+      }
+      return;
+   }
+
    LLVMValueRef exec_mask = mask_vec(bld_base);
    LLVMValueRef cond = LLVMBuildICmp(gallivm->builder, LLVMIntNE, exec_mask, uint_bld->zero, "");
    struct lp_build_loop_state loop_state;
@@ -2279,6 +2360,10 @@ static void emit_shuffle(struct lp_build_nir_context *bld_base, LLVMValueRef src
       /* freeze `src` in case inactive invocations contain poison */
       src = LLVMBuildFreeze(builder, src, "");
       result[0] = lp_build_intrinsic_binary(builder, "llvm.x86.avx2.permd", int_bld->vec_type, src, index);
+   } else if (util_get_cpu_caps()->has_avx512f && bit_size == 32 && index_bit_size == 32 && int_bld->type.length == 16) {
+      /* freeze `src` in case inactive invocations contain poison */
+      src = LLVMBuildFreeze(builder, src, "");
+      result[0] = lp_build_intrinsic_binary(builder, "llvm.x86.avx512.permvar.si.512", int_bld->vec_type, src, index);
    } else {
       LLVMValueRef res_store = lp_build_alloca(gallivm, int_bld->vec_type, "");
       struct lp_build_loop_state loop_state;
@@ -2128,16 +2128,64 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a texel along the x (axis 0) or y (axis 1)
+ * axis of a tiled image, see lp_tiled_offset().
+ *
+ * The stride is the distance between two rows of tiles, and is only used
+ * for the y axis.
+ */
+LLVMValueRef
+lp_build_tiled_partial_offset(struct lp_build_context *bld,
+                              const struct util_format_description *format_desc,
+                              unsigned axis,
+                              LLVMValueRef coord,
+                              LLVMValueRef stride)
+{
+   const unsigned block_size = format_desc->block.bits / 8;
+   const unsigned block_log2 = util_logbase2(block_size);
+   unsigned tw, th;
+   LLVMValueRef tile, texel;
+
+   assert(axis < 2);
+   assert(format_desc->block.width == 1 && format_desc->block.height == 1);
+   assert(util_is_power_of_two_nonzero(block_size) && block_size <= 16);
+
+   lp_tiled_tile_size(block_size, &tw, &th);
+
+   if (axis == 0) {
+      tile = lp_build_shr_imm(bld, coord, tw);
+      tile = lp_build_shl_imm(bld, tile, LP_TILED_TILE_SIZE_LOG2);
+      texel = lp_build_and(bld, coord,
+                           lp_build_const_int_vec(bld->gallivm, bld->type,
+                                                  (1 << tw) - 1));
+      texel = lp_build_shl_imm(bld, texel, block_log2);
+   } else {
+      tile = lp_build_shr_imm(bld, coord, th);
+      tile = lp_build_mul(bld, tile, stride);
+      texel = lp_build_and(bld, coord,
+                           lp_build_const_int_vec(bld->gallivm, bld->type,
+                                                  (1 << th) - 1));
+      texel = lp_build_shl_imm(bld, texel, tw + block_log2);
+   }
+
+   return lp_build_add(bld, tile, texel);
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
  * x, y, z, y_stride, z_stride are vectors, and they refer to pixels.
+ * If tiled, x and y are laid out as described for lp_tiled_offset(), and
+ * y_stride is the distance between two rows of tiles.
  *
  * Returns the relative offset and i,j sub-block coordinates
  */
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2150,6 +2198,22 @@ lp_build_sample_offset(struct lp_build_context *bld,
    LLVMValueRef x_stride;
    LLVMValueRef offset;
 
+   if (tiled) {
+      offset = lp_build_tiled_partial_offset(bld, format_desc, 0, x, NULL);
+      *out_i = bld->zero;
+      *out_j = bld->zero;
+      if (y && y_stride) {
+         offset = lp_build_add(bld, offset,
+                               lp_build_tiled_partial_offset(bld, format_desc,
+                                                             1, y, y_stride));
+      }
+      if (z && z_stride) {
+         offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+      }
+      *out_offset = offset;
+      return;
+   }
+
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
@@ -36,8 +36,10 @@
 #define LP_BLD_SAMPLE_H
 
 
+#include "pipe/p_defines.h"
 #include "util/format/u_formats.h"
 #include "util/u_debug.h"
+#include "util/u_math.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_swizzle.h"
@@ -186,9 +188,65 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< stored in the tiled layout, see below */
 };
 
 
+/**
+ * Tiled texture layout.
+ *
+ * Drivers set the tiled bit of the static texture state for textures which
+ * store each image (mipmap level, array layer, cube face or 3D slice) as
+ * 4KB tiles, holding a block of texels as square as the texel size allows.
+ * Tiles are stored in row-major order, as are the texels within a tile,
+ * and the row stride is the distance between two rows of tiles.  The
+ * offset of a texel is then the sum of a term depending only on x and one
+ * depending only on y, and neighbouring rows of texels mostly share a page.
+ *
+ * The layout is private to the driver: lp_sampler_static_texture_state()
+ * leaves the bit clear.
+ *
+ * Only formats with 1x1 blocks of 1, 2, 4, 8 or 16 bytes can be tiled.
+ */
+
+#define LP_TILED_TILE_SIZE_LOG2 12
+
+
+/**
+ * Dimensions of the tiles, in texels, for the given block size in bytes.
+ */
+static inline void
+lp_tiled_tile_size(unsigned block_size,
+                   unsigned *width_log2,
+                   unsigned *height_log2)
+{
+   const unsigned texels_log2 =
+      LP_TILED_TILE_SIZE_LOG2 - util_logbase2(block_size);
+
+   *width_log2 = texels_log2 / 2;
+   *height_log2 = texels_log2 - *width_log2;
+}
+
+
+/**
+ * Byte offset of texel (x, y) in a tiled image.
+ */
+static inline unsigned
+lp_tiled_offset(unsigned block_size, unsigned row_stride,
+                unsigned x, unsigned y)
+{
+   const unsigned block_log2 = util_logbase2(block_size);
+   unsigned tw, th;
+
+   lp_tiled_tile_size(block_size, &tw, &th);
+
+   return (y >> th) * row_stride +
+          ((y & ((1 << th) - 1)) << (tw + block_log2)) +
+          ((x >> tw) << LP_TILED_TILE_SIZE_LOG2) +
+          ((x & ((1 << tw) - 1)) << block_log2);
+}
+
+
 /**
  * Sampler static state.
  *
@@ -705,9 +763,18 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+LLVMValueRef
+lp_build_tiled_partial_offset(struct lp_build_context *bld,
+                              const struct util_format_description *format_desc,
+                              unsigned axis,
+                              LLVMValueRef coord,
+                              LLVMValueRef stride);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
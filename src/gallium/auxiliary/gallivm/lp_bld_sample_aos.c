@@ -59,9 +59,35 @@
 #include "lp_bld_quad.h"
 
 
+/**
+ * Compute the byte offset of a wrapped texcoord along the x (0), y (1) or
+ * z (2) axis, taking the tiled layout into account.
+ */
+static void
+lp_build_sample_aos_partial_offset(struct lp_build_sample_context *bld,
+                                   unsigned axis,
+                                   unsigned block_length,
+                                   LLVMValueRef coord,
+                                   LLVMValueRef stride,
+                                   LLVMValueRef *out_offset,
+                                   LLVMValueRef *out_i)
+{
+   if (bld->static_texture_state->tiled && axis < 2) {
+      *out_offset = lp_build_tiled_partial_offset(&bld->int_coord_bld,
+                                                  bld->format_desc,
+                                                  axis, coord, stride);
+      *out_i = bld->int_coord_bld.zero;
+   } else {
+      lp_build_sample_partial_offset(&bld->int_coord_bld, block_length,
+                                     coord, stride, out_offset, out_i);
+   }
+}
+
+
 /**
  * Build LLVM code for texture coord wrapping, for nearest filtering,
  * for scaled integer texcoords.
+ * \param axis  the coordinate axis, 0 for x, 1 for y and 2 for z
  * \param block_length  is the length of the pixel block along the
  *                      coordinate axis
  * \param coord  the incoming texcoord (s,t or r) scaled to the texture size
@@ -76,6 +102,7 @@
  */
 static void
 lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
+                                 unsigned axis,
                                  unsigned block_length,
                                  LLVMValueRef coord,
                                  LLVMValueRef coord_f,
@@ -126,8 +153,8 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
       assert(0);
    }
 
-   lp_build_sample_partial_offset(int_coord_bld, block_length, coord, stride,
-                                  out_offset, out_i);
+   lp_build_sample_aos_partial_offset(bld, axis, block_length, coord, stride,
+                                      out_offset, out_i);
 }
 
 
@@ -196,6 +223,7 @@ lp_build_coord_repeat_npot_linear_int(struct lp_build_sample_context *bld,
 /**
  * Build LLVM code for texture coord wrapping, for linear filtering,
  * for scaled integer texcoords.
+ * \param axis  the coordinate axis, 0 for x, 1 for y and 2 for z
  * \param block_length  is the length of the pixel block along the
  *                      coordinate axis
  * \param coord0  the incoming texcoord (s,t or r) scaled to the texture size
@@ -212,6 +240,7 @@ lp_build_coord_repeat_npot_linear_int(struct lp_build_sample_context *bld,
  */
 static void
 lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
+                                unsigned axis,
                                 unsigned block_length,
                                 LLVMValueRef coord0,
                                 LLVMValueRef *weight_i,
@@ -232,15 +261,16 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
    LLVMValueRef lmask, umask, mask;
 
    /*
-    * If the pixel block covers more than one pixel then there is no easy
-    * way to calculate offset1 relative to offset0. Instead, compute them
-    * independently. Otherwise, try to compute offset0 and offset1 with
-    * a single stride multiplication.
+    * If the pixel block covers more than one pixel, or the image is tiled,
+    * then there is no easy way to calculate offset1 relative to offset0.
+    * Instead, compute them independently. Otherwise, try to compute offset0
+    * and offset1 with a single stride multiplication.
     */
 
    length_minus_one = lp_build_sub(int_coord_bld, length, int_coord_bld->one);
 
-   if (block_length != 1) {
+   if (block_length != 1 ||
+       (bld->static_texture_state->tiled && axis < 2)) {
       LLVMValueRef coord1;
       switch(wrap_mode) {
       case PIPE_TEX_WRAP_REPEAT:
@@ -289,10 +319,10 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
          coord1 = int_coord_bld->zero;
          break;
       }
-      lp_build_sample_partial_offset(int_coord_bld, block_length, coord0, stride,
-                                     offset0, i0);
-      lp_build_sample_partial_offset(int_coord_bld, block_length, coord1, stride,
-                                     offset1, i1);
+      lp_build_sample_aos_partial_offset(bld, axis, block_length,
+                                         coord0, stride, offset0, i0);
+      lp_build_sample_aos_partial_offset(bld, axis, block_length,
+                                         coord1, stride, offset1, i1);
       return;
    }
 
@@ -506,7 +536,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
 
    /* Do texcoord wrapping, compute texel offset */
    lp_build_sample_wrap_nearest_int(bld,
-                                    bld->format_desc->block.width,
+                                    0, bld->format_desc->block.width,
                                     s_ipart, s_float,
                                     width_vec, x_stride, offsets[0],
                                     bld->static_texture_state->pot_width,
@@ -516,7 +546,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    if (dims >= 2) {
       LLVMValueRef y_offset;
       lp_build_sample_wrap_nearest_int(bld,
-                                       bld->format_desc->block.height,
+                                       1, bld->format_desc->block.height,
                                        t_ipart, t_float,
                                        height_vec, row_stride_vec, offsets[1],
                                        bld->static_texture_state->pot_height,
@@ -526,7 +556,7 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
       if (dims >= 3) {
          LLVMValueRef z_offset;
          lp_build_sample_wrap_nearest_int(bld,
-                                          1, /* block length (depth) */
+                                          2, 1, /* block length (depth) */
                                           r_ipart, r_float,
                                           depth_vec, img_stride_vec, offsets[2],
                                           bld->static_texture_state->pot_depth,
@@ -854,7 +884,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    /* do texcoord wrapping and compute texel offsets */
    lp_build_sample_wrap_linear_int(bld,
-                                   bld->format_desc->block.width,
+                                   0, bld->format_desc->block.width,
                                    s_ipart, &s_fpart, s_float,
                                    width_vec, x_stride, offsets[0],
                                    bld->static_texture_state->pot_width,
@@ -884,7 +914,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    if (dims >= 2) {
       lp_build_sample_wrap_linear_int(bld,
-                                      bld->format_desc->block.height,
+                                      1, bld->format_desc->block.height,
                                       t_ipart, &t_fpart, t_float,
                                       height_vec, y_stride, offsets[1],
                                       bld->static_texture_state->pot_height,
@@ -904,7 +934,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
 
    if (dims >= 3) {
       lp_build_sample_wrap_linear_int(bld,
-                                      1, /* block length (depth) */
+                                      2, 1, /* block length (depth) */
                                       r_ipart, &r_fpart, r_float,
                                       depth_vec, z_stride, offsets[2],
                                       bld->static_texture_state->pot_depth,
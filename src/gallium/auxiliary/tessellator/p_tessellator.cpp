@@ -23,6 +23,7 @@
  *
  **************************************************************************/
 
+#include "util/hash_table.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "pipe/p_defines.h"
@@ -31,20 +32,184 @@
 
 #include <new>
 
+/* Patterns are cached in a direct mapped table, which is flushed when the
+ * patterns in it would use more than TESS_CACHE_MAX_SIZE bytes.
+ */
+#define TESS_CACHE_ENTRIES 64
+#define TESS_CACHE_MAX_SIZE (4 << 20)
+
+/* The tess eval shader reads domain points a whole vector at a time */
+#define TESS_DOMAIN_POINT_PADDING 16
+
 namespace pipe_tessellator_wrap
 {
+   /// Domain points and indices generated for one set of tess factors
+   struct tess_pattern
+   {
+      float    factors[6];
+      uint32_t num_domain_points;
+      uint32_t num_indices;
+      size_t   size;
+      float    *domain_points_u;
+      float    *domain_points_v;
+      uint32_t *indices;
+   };
+
    /// Wrapper class for the CHWTessellator reference tessellator from MSFT
-   /// This class will store data not originally stored in CHWTessellator
+   /// This class will store data not originally stored in CHWTessellator,
+   /// and caches the patterns it generates, so that patches with the same
+   /// tess factors, which are common, don't tessellate again.
    class pipe_ts : private CHWTessellator
    {
    private:
       typedef CHWTessellator SUPER;
       enum pipe_prim_type    prim_mode;
-      alignas(32) float      domain_points_u[MAX_POINT_COUNT];
-      alignas(32) float      domain_points_v[MAX_POINT_COUNT];
-      uint32_t               num_domain_points;
+      enum pipe_tess_spacing spacing;
+      tess_pattern           *cache[TESS_CACHE_ENTRIES];
+      size_t                 cache_size;
+
+      static float ClampFactor(float factor, float lower, float upper)
+      {
+         /* NaN clamps to the lower bound, as in the tessellator */
+         if (!(factor > lower))
+            return lower;
+         return factor < upper ? factor : upper;
+      }
+
+      /// Clamp and round the tess factors the way the tessellator does
+      /// before using them, so that all the factors which give the same
+      /// pattern map to the same key.  Unused factors are zeroed.  Returns
+      /// false if the patch is culled.
+      bool QuantizeFactors(const struct pipe_tessellation_factors *tess_factors,
+                           float key[6])
+      {
+         unsigned num_outer = prim_mode == PIPE_PRIM_QUADS ? 4 :
+                              prim_mode == PIPE_PRIM_TRIANGLES ? 3 : 2;
+         unsigned num_inner = prim_mode == PIPE_PRIM_QUADS ? 2 :
+                              prim_mode == PIPE_PRIM_TRIANGLES ? 1 : 0;
+         float lower, upper;
+
+         for (unsigned i = 0; i < num_outer; i++) {
+            if (!(tess_factors->outer_tf[i] > 0))
+               return false;
+         }
+
+         switch (spacing) {
+         case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+            lower = PIPE_TESSELLATOR_MIN_ODD_TESSELLATION_FACTOR;
+            upper = PIPE_TESSELLATOR_MAX_ODD_TESSELLATION_FACTOR;
+            break;
+         case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+            lower = PIPE_TESSELLATOR_MIN_EVEN_TESSELLATION_FACTOR;
+            upper = PIPE_TESSELLATOR_MAX_EVEN_TESSELLATION_FACTOR;
+            break;
+         default:
+            lower = PIPE_TESSELLATOR_MIN_ODD_TESSELLATION_FACTOR;
+            upper = PIPE_TESSELLATOR_MAX_EVEN_TESSELLATION_FACTOR;
+            break;
+         }
+
+         memset(key, 0, 6 * sizeof(float));
+         for (unsigned i = 0; i < num_outer; i++)
+            key[i] = ClampFactor(tess_factors->outer_tf[i], lower, upper);
+         for (unsigned i = 0; i < num_inner; i++)
+            key[4 + i] = ClampFactor(tess_factors->inner_tf[i], lower, upper);
+
+         if (prim_mode == PIPE_PRIM_LINES) {
+            /* the line density is always integer */
+            key[0] = ceilf(ClampFactor(tess_factors->outer_tf[0],
+                                       PIPE_TESSELLATOR_MIN_ISOLINE_DENSITY_TESSELLATION_FACTOR,
+                                       PIPE_TESSELLATOR_MAX_ISOLINE_DENSITY_TESSELLATION_FACTOR));
+         }
+
+         if (spacing == PIPE_TESS_SPACING_EQUAL) {
+            for (unsigned i = 0; i < 6; i++)
+               key[i] = ceilf(key[i]);
+         }
+         return true;
+      }
+
+      tess_pattern *GeneratePattern(const float key[6])
+      {
+         switch (prim_mode)
+            {
+            case PIPE_PRIM_QUADS:
+               SUPER::TessellateQuadDomain(key[0], key[1], key[2], key[3],
+                                           key[4], key[5]);
+               break;
+
+            case PIPE_PRIM_TRIANGLES:
+               SUPER::TessellateTriDomain(key[0], key[1], key[2], key[4]);
+               break;
+
+            case PIPE_PRIM_LINES:
+               SUPER::TessellateIsoLineDomain(key[0], key[1]);
+               break;
+
+            default:
+               assert(0);
+               return NULL;
+            }
+
+         uint32_t num_domain_points = (uint32_t)SUPER::GetPointCount();
+         uint32_t num_indices = (uint32_t)SUPER::GetIndexCount();
+         uint32_t padded_points = align(num_domain_points,
+                                        TESS_DOMAIN_POINT_PADDING);
+         size_t points_size = padded_points * sizeof(float);
+         size_t size = sizeof(tess_pattern) + 2 * points_size +
+                       num_indices * sizeof(uint32_t);
+
+         /* points first, to keep them aligned for the shader */
+         char *mem = (char *)align_malloc(size, 64);
+         if (!mem)
+            return NULL;
+
+         tess_pattern *pattern = (tess_pattern *)(mem + 2 * points_size);
+         memcpy(pattern->factors, key, sizeof(pattern->factors));
+         pattern->num_domain_points = num_domain_points;
+         pattern->num_indices = num_indices;
+         pattern->size = size;
+         pattern->domain_points_u = (float *)mem;
+         pattern->domain_points_v = (float *)(mem + points_size);
+         pattern->indices = (uint32_t *)(pattern + 1);
+
+         DOMAIN_POINT *points = SUPER::GetPoints();
+         for (uint32_t i = 0; i < num_domain_points; i++) {
+            pattern->domain_points_u[i] = points[i].u;
+            pattern->domain_points_v[i] = points[i].v;
+         }
+         for (uint32_t i = num_domain_points; i < padded_points; i++) {
+            pattern->domain_points_u[i] = 0.0f;
+            pattern->domain_points_v[i] = 0.0f;
+         }
+         memcpy(pattern->indices, SUPER::GetIndices(),
+                num_indices * sizeof(uint32_t));
+
+         return pattern;
+      }
+
+      static void FreePattern(tess_pattern *pattern)
+      {
+         align_free(pattern->domain_points_u);
+      }
+
+      void FlushCache()
+      {
+         for (unsigned i = 0; i < TESS_CACHE_ENTRIES; i++) {
+            if (cache[i]) {
+               FreePattern(cache[i]);
+               cache[i] = NULL;
+            }
+         }
+         cache_size = 0;
+      }
 
    public:
+      ~pipe_ts()
+      {
+         FlushCache();
+      }
+
       void Init(enum pipe_prim_type tes_prim_mode,
                 enum pipe_tess_spacing ts_spacing,
                 bool tes_vertex_order_cw, bool tes_point_mode)
@@ -69,57 +234,47 @@ namespace pipe_tessellator_wrap
                      out_prim);
 
          prim_mode          = tes_prim_mode;
-         num_domain_points = 0;
+         spacing            = ts_spacing;
+         memset(cache, 0, sizeof(cache));
+         cache_size         = 0;
       }
 
       void Tessellate(const struct pipe_tessellation_factors *tess_factors,
                       struct pipe_tessellator_data *tess_data)
       {
-         switch (prim_mode)
-            {
-            case PIPE_PRIM_QUADS:
-               SUPER::TessellateQuadDomain(
-                                           tess_factors->outer_tf[0],
-                                           tess_factors->outer_tf[1],
-                                           tess_factors->outer_tf[2],
-                                           tess_factors->outer_tf[3],
-                                           tess_factors->inner_tf[0],
-                                           tess_factors->inner_tf[1]);
-               break;
+         float key[6];
 
-            case PIPE_PRIM_TRIANGLES:
-               SUPER::TessellateTriDomain(
-                                          tess_factors->outer_tf[0],
-                                          tess_factors->outer_tf[1],
-                                          tess_factors->outer_tf[2],
-                                          tess_factors->inner_tf[0]);
-               break;
+         memset(tess_data, 0, sizeof(*tess_data));
 
-            case PIPE_PRIM_LINES:
-               SUPER::TessellateIsoLineDomain(
-                                              tess_factors->outer_tf[0],
-                                              tess_factors->outer_tf[1]);
-               break;
+         if (!QuantizeFactors(tess_factors, key))
+            return;
 
-            default:
-               assert(0);
+         unsigned slot = _mesa_hash_data(key, sizeof(key)) % TESS_CACHE_ENTRIES;
+         tess_pattern *pattern = cache[slot];
+
+         if (!pattern || memcmp(pattern->factors, key, sizeof(key))) {
+            tess_pattern *new_pattern = GeneratePattern(key);
+            if (!new_pattern)
                return;
-            }
 
-         num_domain_points = (uint32_t)SUPER::GetPointCount();
+            if (pattern) {
+               cache_size -= pattern->size;
+               FreePattern(pattern);
+               cache[slot] = NULL;
+            }
+            if (cache_size + new_pattern->size > TESS_CACHE_MAX_SIZE)
+               FlushCache();
 
-         DOMAIN_POINT *points = SUPER::GetPoints();
-         for (uint32_t i = 0; i < num_domain_points; i++) {
-            domain_points_u[i] = points[i].u;
-            domain_points_v[i] = points[i].v;
+            pattern = new_pattern;
+            cache[slot] = pattern;
+            cache_size += pattern->size;
          }
-         tess_data->num_domain_points = num_domain_points;
-         tess_data->domain_points_u = &domain_points_u[0];
-         tess_data->domain_points_v = &domain_points_v[0];
-
-         tess_data->num_indices = (uint32_t)SUPER::GetIndexCount();
 
-         tess_data->indices = (uint32_t*)SUPER::GetIndices();
+         tess_data->num_domain_points = pattern->num_domain_points;
+         tess_data->domain_points_u = pattern->domain_points_u;
+         tess_data->domain_points_v = pattern->domain_points_v;
+         tess_data->num_indices = pattern->num_indices;
+         tess_data->indices = pattern->indices;
       }
    };
 } // namespace Tessellator
@@ -19,6 +19,10 @@
 
 #include "tessellator.hpp"
 #include "util/macros.h"
+#include "util/detect.h"
+#if DETECT_ARCH_SSE
+#include <emmintrin.h>
+#endif
 #if defined(_MSC_VER)
 #include <math.h> // ceil
 #else
@@ -738,12 +742,14 @@ void CHWTessellator::QuadGeneratePoints( const PROCESSED_TESS_FACTORS_QUAD& proc
         int parity = edge&0x1;
         int startPoint = 0;
         int endPoint = processedTessFactors.numPointsForOutsideEdge[edge] - 1;
+        bool reverse = !((edge==1)||(edge==2)); // reverse order
+        FXP fxpParams[MAX_POINTS_PER_EDGE];
+        SetTessellationParity(processedTessFactors.outsideTessFactorParity[edge]);
+        PlacePointsIn1D(processedTessFactors.outsideTessFactorCtx[edge],
+                        reverse ? endPoint : startPoint, reverse ? -1 : 1, endPoint - startPoint, fxpParams);
         for(int p = startPoint; p < endPoint; p++,pointOffset++) // don't include end, since next edge starts with it.
         {
-            FXP fxpParam;
-            int q = ((edge==1)||(edge==2)) ? p : endPoint - p; // reverse order
-            SetTessellationParity(processedTessFactors.outsideTessFactorParity[edge]);
-            PlacePointIn1D(processedTessFactors.outsideTessFactorCtx[edge],q,fxpParam);
+            FXP fxpParam = fxpParams[p - startPoint];
             if( parity )
             {
                 DefinePoint(/*U*/fxpParam,
@@ -777,11 +783,14 @@ void CHWTessellator::QuadGeneratePoints( const PROCESSED_TESS_FACTORS_QUAD& proc
             SetTessellationParity(processedTessFactors.insideTessFactorParity[parity[0]]);
             PlacePointIn1D(processedTessFactors.insideTessFactorCtx[parity[0]],perpendicularAxisPoint,fxpPerpParam);
             SetTessellationParity(processedTessFactors.insideTessFactorParity[parity[1]]);
+            bool reverse = !((edge == 1)||(edge==2));
+            FXP fxpParams[MAX_POINTS_PER_EDGE];
+            PlacePointsIn1D(processedTessFactors.insideTessFactorCtx[parity[1]],
+                            reverse ? endPoint[parity[1]] : startPoint, reverse ? -1 : 1,
+                            endPoint[parity[1]] - startPoint, fxpParams);
             for(int p = startPoint; p < endPoint[parity[1]]; p++, pointOffset++) // don't include end: next edge starts with it.
             {
-                FXP fxpParam;
-                int q = ((edge == 1)||(edge==2)) ? p : endPoint[parity[1]] - (p - startPoint);
-                PlacePointIn1D(processedTessFactors.insideTessFactorCtx[parity[1]],q,fxpParam);
+                FXP fxpParam = fxpParams[p - startPoint];
                 if( parity[1] )
                 {
                     DefinePoint(/*U*/fxpPerpParam,
@@ -803,11 +812,12 @@ void CHWTessellator::QuadGeneratePoints( const PROCESSED_TESS_FACTORS_QUAD& proc
     {
         int startPoint = numRings;
         int endPoint = processedTessFactors.numPointsForInsideTessFactor[U] - 1 - startPoint;
+        FXP fxpParams[MAX_POINTS_PER_EDGE];
         SetTessellationParity(processedTessFactors.insideTessFactorParity[U]);
+        PlacePointsIn1D(processedTessFactors.insideTessFactorCtx[U],startPoint,1,endPoint - startPoint + 1,fxpParams);
         for( int p = startPoint; p <= endPoint; p++, pointOffset++ )
         {
-            FXP fxpParam;
-            PlacePointIn1D(processedTessFactors.insideTessFactorCtx[U],p,fxpParam);
+            FXP fxpParam = fxpParams[p - startPoint];
             DefinePoint(/*U*/fxpParam,
                         /*V*/FXP_ONE_HALF, // middle
                         /*pointStorageOffset*/pointOffset);
@@ -818,12 +828,13 @@ void CHWTessellator::QuadGeneratePoints( const PROCESSED_TESS_FACTORS_QUAD& proc
     {
         int startPoint = numRings;
         int endPoint;
-        FXP fxpParam;
+        FXP fxpParams[MAX_POINTS_PER_EDGE];
         endPoint = processedTessFactors.numPointsForInsideTessFactor[V] - 1 - startPoint;
         SetTessellationParity(processedTessFactors.insideTessFactorParity[V]);
+        PlacePointsIn1D(processedTessFactors.insideTessFactorCtx[V],endPoint,-1,endPoint - startPoint + 1,fxpParams);
         for( int p = endPoint; p >= startPoint; p--, pointOffset++ )
         {
-            PlacePointIn1D(processedTessFactors.insideTessFactorCtx[V],p,fxpParam);
+            FXP fxpParam = fxpParams[endPoint - p];
             DefinePoint(/*U*/FXP_ONE_HALF, // middle
                         /*V*/fxpParam,
                         /*pointStorageOffset*/pointOffset);
@@ -1244,15 +1255,17 @@ void CHWTessellator::TriGeneratePoints( const PROCESSED_TESS_FACTORS_TRI& proces
         int parity = edge&0x1;
         int startPoint = 0;
         int endPoint = processedTessFactors.numPointsForOutsideEdge[edge] - 1;
+        FXP fxpParams[MAX_POINTS_PER_EDGE];
+        // whether to reverse point order given we are defining V or U (W implicit):
+        // edge0, VW, has V decreasing, so reverse 1D points below
+        // edge1, WU, has U increasing, so don't reverse 1D points  below
+        // edge2, UV, has U decreasing, so reverse 1D points below
+        SetTessellationParity(processedTessFactors.outsideTessFactorParity[edge]);
+        PlacePointsIn1D(processedTessFactors.outsideTessFactorCtx[edge],
+                        parity ? startPoint : endPoint, parity ? 1 : -1, endPoint - startPoint, fxpParams);
         for(int p = startPoint; p < endPoint; p++, pointOffset++) // don't include end, since next edge starts with it.
         {
-            FXP fxpParam;
-            int q = (parity) ? p : endPoint - p; // whether to reverse point order given we are defining V or U (W implicit):
-                                                 // edge0, VW, has V decreasing, so reverse 1D points below
-                                                 // edge1, WU, has U increasing, so don't reverse 1D points  below
-                                                 // edge2, UV, has U decreasing, so reverse 1D points below
-            SetTessellationParity(processedTessFactors.outsideTessFactorParity[edge]);
-            PlacePointIn1D(processedTessFactors.outsideTessFactorCtx[edge],q,fxpParam);
+            FXP fxpParam = fxpParams[p - startPoint];
             if( edge == 0 )
             {
                 DefinePoint(/*U*/0,
@@ -1287,14 +1300,16 @@ void CHWTessellator::TriGeneratePoints( const PROCESSED_TESS_FACTORS_TRI& proces
                                          // I (amarp) can draw a picture to explain.
                                          // We know this fixed point math won't over/underflow
             fxpPerpParam = (fxpPerpParam+FXP_ONE_HALF/*round*/)>>FXP_FRACTION_BITS; // get back to n.16
+            FXP fxpParams[MAX_POINTS_PER_EDGE];
+            // whether to reverse point given we are defining V or U (W implicit):
+            // edge0, VW, has V decreasing, so reverse 1D points below
+            // edge1, WU, has U increasing, so don't reverse 1D points  below
+            // edge2, UV, has U decreasing, so reverse 1D points below
+            PlacePointsIn1D(processedTessFactors.insideTessFactorCtx,
+                            parity ? startPoint : endPoint, parity ? 1 : -1, endPoint - startPoint, fxpParams);
             for(int p = startPoint; p < endPoint; p++, pointOffset++) // don't include end: next edge starts with it.
             {
-                FXP fxpParam;
-                int q = (parity) ? p : endPoint - (p - startPoint); // whether to reverse point given we are defining V or U (W implicit):
-                                                         // edge0, VW, has V decreasing, so reverse 1D points below
-                                                         // edge1, WU, has U increasing, so don't reverse 1D points  below
-                                                         // edge2, UV, has U decreasing, so reverse 1D points below
-                PlacePointIn1D(processedTessFactors.insideTessFactorCtx,q,fxpParam);
+                FXP fxpParam = fxpParams[p - startPoint];
                 // edge0 VW, has perpendicular parameter U constant
                 // edge1 WU, has perpendicular parameter V constant
                 // edge2 UV, has perpendicular parameter W constant
@@ -1535,20 +1550,22 @@ void CHWTessellator::IsoLineProcessTessFactors( float TessFactor_V_LineDensity,
 void CHWTessellator::IsoLineGeneratePoints( const PROCESSED_TESS_FACTORS_ISOLINE& processedTessFactors )
 {
     int line, pointOffset;
+    // Every line has the same points along U
+    FXP fxpU[MAX_POINTS_PER_EDGE];
+    SetTessellationParity(processedTessFactors.lineDetailParity);
+    PlacePointsIn1D(processedTessFactors.lineDetailTessFactorCtx,0,1,processedTessFactors.numPointsPerLine,fxpU);
     for(line = 0, pointOffset = 0; line < processedTessFactors.numLines; line++)
     {
+        FXP fxpV;
+        SetTessellationParity(processedTessFactors.lineDensityParity);
+        PlacePointIn1D(processedTessFactors.lineDensityTessFactorCtx,line,fxpV);
+
         for(int point = 0; point < processedTessFactors.numPointsPerLine; point++)
         {
-            FXP fxpU,fxpV;
-            SetTessellationParity(processedTessFactors.lineDensityParity);
-            PlacePointIn1D(processedTessFactors.lineDensityTessFactorCtx,line,fxpV);
-
-            SetTessellationParity(processedTessFactors.lineDetailParity);
-            PlacePointIn1D(processedTessFactors.lineDetailTessFactorCtx,point,fxpU);
-
-            DefinePoint(fxpU,fxpV,pointOffset++);
+            DefinePoint(fxpU[point],fxpV,pointOffset++);
         }
     }
+    SetTessellationParity(processedTessFactors.lineDetailParity);
 }
 
 //---------------------------------------------------------------------------------------------------------------------------------
@@ -1841,6 +1858,68 @@ void CHWTessellator::PlacePointIn1D( const TESS_FACTOR_CONTEXT& TessFactorCtx, i
     }
 }
 
+#if DETECT_ARCH_SSE
+static inline __m128i tess_select( __m128i mask, __m128i a, __m128i b )
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Low 32 bits of the products, as SSE4.1's _mm_mullo_epi32 (see mm_mullo_epi32 in u_sse.h)
+static inline __m128i tess_mullo_epi32( __m128i a, __m128i b )
+{
+    __m128i ba = _mm_mul_epu32(b, a);
+    __m128i b4a4 = _mm_mul_epu32(_mm_srli_epi64(b, 32), _mm_srli_epi64(a, 32));
+    return _mm_or_si128(_mm_and_si128(ba, _mm_setr_epi32(~0,0,~0,0)), _mm_slli_epi64(b4a4, 32));
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------------------
+// CHWTessellator::PlacePointsIn1D()
+//---------------------------------------------------------------------------------------------------------------------------------
+void CHWTessellator::PlacePointsIn1D( const TESS_FACTOR_CONTEXT& TessFactorCtx, int firstPoint, int pointStep, int numPoints,
+                                      FXP* fxpLocations )
+{
+    int i = 0;
+#if DETECT_ARCH_SSE
+    // PlacePointIn1D for four points at once, with its branches turned into selects.
+    // The fixed point math is all done modulo 2^32, exactly as in the scalar version.
+    const __m128i numHalfTessFactorPoints = _mm_set1_epi32(TessFactorCtx.numHalfTessFactorPoints);
+    const __m128i lastPointBeforeHalf = _mm_set1_epi32(TessFactorCtx.numHalfTessFactorPoints - 1);
+    const __m128i mirrorPoint = _mm_set1_epi32((TessFactorCtx.numHalfTessFactorPoints << 1) - (Odd() ? 1 : 0));
+    const __m128i splitPoint = _mm_set1_epi32(TessFactorCtx.splitPointOnFloorHalfTessFactor);
+    const __m128i fxpInvNumSegmentsOnFloor = _mm_set1_epi32(TessFactorCtx.fxpInvNumSegmentsOnFloorTessFactor);
+    const __m128i fxpInvNumSegmentsOnCeil = _mm_set1_epi32(TessFactorCtx.fxpInvNumSegmentsOnCeilTessFactor);
+    const __m128i fxpFraction = _mm_set1_epi32(TessFactorCtx.fxpHalfTessFactorFraction);
+    const __m128i fxpOneMinusFraction = _mm_set1_epi32(FXP_ONE - TessFactorCtx.fxpHalfTessFactorFraction);
+    const __m128i fxpOne = _mm_set1_epi32(FXP_ONE);
+    const __m128i fxpOneHalf = _mm_set1_epi32(FXP_ONE_HALF);
+    const __m128i step = _mm_set1_epi32(4*pointStep);
+    __m128i point = _mm_setr_epi32(firstPoint, firstPoint + pointStep,
+                                   firstPoint + 2*pointStep, firstPoint + 3*pointStep);
+    for( ; i + 4 <= numPoints; i += 4 )
+    {
+        __m128i flip = _mm_cmpgt_epi32(point, lastPointBeforeHalf);
+        __m128i p = tess_select(flip, _mm_sub_epi32(mirrorPoint, point), point);
+        __m128i middle = _mm_cmpeq_epi32(p, numHalfTessFactorPoints);
+        // the compare result is -1 where the point is past the split
+        __m128i indexOnFloorHalfTessFactor = _mm_add_epi32(p, _mm_cmpgt_epi32(p, splitPoint));
+        __m128i fxpLocationOnFloor = tess_mullo_epi32(indexOnFloorHalfTessFactor, fxpInvNumSegmentsOnFloor);
+        __m128i fxpLocationOnCeil = tess_mullo_epi32(p, fxpInvNumSegmentsOnCeil);
+        __m128i fxpLocation = _mm_add_epi32(tess_mullo_epi32(fxpLocationOnFloor, fxpOneMinusFraction),
+                                            tess_mullo_epi32(fxpLocationOnCeil, fxpFraction));
+        fxpLocation = _mm_srli_epi32(_mm_add_epi32(fxpLocation, fxpOneHalf), FXP_FRACTION_BITS);
+        fxpLocation = tess_select(flip, _mm_sub_epi32(fxpOne, fxpLocation), fxpLocation);
+        fxpLocation = tess_select(middle, fxpOneHalf, fxpLocation);
+        _mm_storeu_si128((__m128i*)&fxpLocations[i], fxpLocation);
+        point = _mm_add_epi32(point, step);
+    }
+#endif
+    for( ; i < numPoints; i++ )
+    {
+        PlacePointIn1D(TessFactorCtx, firstPoint + i*pointStep, fxpLocations[i]);
+    }
+}
+
 //---------------------------------------------------------------------------------------------------------------------------------
 // CHWTessellator::StitchRegular
 //---------------------------------------------------------------------------------------------------------------------------------
@@ -68,6 +68,7 @@
 
 #define PIPE_TESSELLATOR_MAX_TESSELLATION_FACTOR 64 // max of even and odd tessFactors
 
+#define MAX_POINTS_PER_EDGE (PIPE_TESSELLATOR_MAX_TESSELLATION_FACTOR+1)
 #define MAX_POINT_COUNT ((PIPE_TESSELLATOR_MAX_TESSELLATION_FACTOR+1)*(PIPE_TESSELLATOR_MAX_TESSELLATION_FACTOR+1))
 #define MAX_INDEX_COUNT (PIPE_TESSELLATOR_MAX_TESSELLATION_FACTOR*PIPE_TESSELLATOR_MAX_TESSELLATION_FACTOR*2*3)
 
@@ -198,6 +199,10 @@ private:
     } TESS_FACTOR_CONTEXT;
     void ComputeTessFactorContext( FXP fxpTessFactor, TESS_FACTOR_CONTEXT& TessFactorCtx );
     void PlacePointIn1D( const TESS_FACTOR_CONTEXT& TessFactorCtx, int point, FXP& fxpLocation );
+    // Same as PlacePointIn1D for numPoints points, starting at firstPoint and stepping by pointStep,
+    // placed several at a time with SIMD where available.
+    void PlacePointsIn1D( const TESS_FACTOR_CONTEXT& TessFactorCtx, int firstPoint, int pointStep, int numPoints,
+                          FXP* fxpLocations );
 
     int NumPointsForTessFactor(FXP fxpTessFactor);
 
@@ -34,7 +34,8 @@
 #include "pipe/p_state.h"
 #include "translate.h"
 
-struct translate *translate_create( const struct translate_key *key )
+static struct translate *create( const struct translate_key *key,
+                                 boolean try_llvm )
 {
    struct translate *translate = NULL;
 
@@ -42,13 +43,31 @@ struct translate *translate_create( const struct translate_key *key )
    translate = translate_sse2_create( key );
    if (translate)
       return translate;
-#else
-   (void)translate;
 #endif
 
+#ifdef DRAW_LLVM_AVAILABLE
+   if (try_llvm) {
+      translate = translate_llvm_create( key );
+      if (translate)
+         return translate;
+   }
+#endif
+
+   (void)translate;
+   (void)try_llvm;
    return translate_generic_create( key );
 }
 
+struct translate *translate_create( const struct translate_key *key )
+{
+   return create( key, FALSE );
+}
+
+struct translate *translate_create_llvm( const struct translate_key *key )
+{
+   return create( key, TRUE );
+}
+
 boolean translate_is_output_format_supported(enum pipe_format format)
 {
    return translate_generic_is_output_format_supported(format);
@@ -135,6 +135,13 @@ struct translate {
 
 struct translate *translate_create( const struct translate_key *key );
 
+/**
+ * Like translate_create(), but the keys SSE can't handle are JIT compiled
+ * with gallivm before falling back to the generic backend.  Compiling
+ * costs milliseconds, so this is only for users which run LLVM anyway.
+ */
+struct translate *translate_create_llvm( const struct translate_key *key );
+
 boolean translate_is_output_format_supported(enum pipe_format format);
 
 static inline int translate_keysize( const struct translate_key *key )
@@ -169,6 +176,8 @@ static inline void translate_key_sanitize( struct translate_key *a )
  */
 struct translate *translate_sse2_create( const struct translate_key *key );
 
+struct translate *translate_llvm_create( const struct translate_key *key );
+
 struct translate *translate_generic_create( const struct translate_key *key );
 
 boolean translate_generic_is_output_format_supported(enum pipe_format format);
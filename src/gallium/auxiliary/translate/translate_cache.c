@@ -35,6 +35,7 @@
 
 struct translate_cache {
    struct cso_hash hash;
+   boolean use_llvm;
 };
 
 struct translate_cache * translate_cache_create( void )
@@ -45,6 +46,15 @@ struct translate_cache * translate_cache_create( void )
    }
 
    cso_hash_init(&cache->hash);
+   cache->use_llvm = FALSE;
+   return cache;
+}
+
+struct translate_cache * translate_cache_create_llvm( void )
+{
+   struct translate_cache *cache = translate_cache_create();
+   if (cache)
+      cache->use_llvm = TRUE;
    return cache;
 }
 
@@ -98,7 +108,8 @@ struct translate * translate_cache_find(struct translate_cache *cache,
 
    if (!translate) {
       /* create/insert */
-      translate = translate_create(key);
+      translate = cache->use_llvm ? translate_create_llvm(key)
+                                  : translate_create(key);
       cso_hash_insert(&cache->hash, hash_key, translate);
    }
 
@@ -39,6 +39,8 @@ struct translate_key;
 struct translate;
 
 struct translate_cache *translate_cache_create( void );
+/** A cache creating its translates with translate_create_llvm() */
+struct translate_cache *translate_cache_create_llvm( void );
 void translate_cache_destroy(struct translate_cache *cache);
 
 /**
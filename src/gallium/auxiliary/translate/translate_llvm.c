@@ -0,0 +1,642 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Vertex fetch and conversion, JIT compiled with gallivm.
+ *
+ * translate_sse gives up on the whole key if any element has channels of
+ * differing or non byte sized widths, or half floats, which leaves keys
+ * with formats like R16G16B16A16_FLOAT or R10G10B10A2_UNORM to
+ * translate_generic's per element function pointers.  This backend
+ * fetches through lp_build_fetch_rgba_aos() instead, so it handles
+ * everything gallivm can fetch, on any architecture LLVM supports.
+ *
+ * Outputs are limited to what draw and u_vbuf ask for in practice: 32 bit
+ * float and integer vectors, and copies of the input format.  Other keys
+ * are left to the other backends.
+ */
+
+#include "util/u_memory.h"
+#include "util/u_debug.h"
+#include "util/format/u_format.h"
+#include "pipe/p_state.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_struct.h"
+#include "translate.h"
+
+
+/** How each element is converted */
+enum translate_llvm_conv {
+   CONV_COPY,        /**< input and output formats are the same */
+   CONV_FLOAT,       /**< fetch to float, store 32 bit floats */
+   CONV_INT,         /**< fetch pure integers, store 32 bit integers */
+   CONV_INSTANCE_ID_FLOAT,
+   CONV_INSTANCE_ID_INT,
+};
+
+/** How the vertices are indexed, one JIT function each */
+enum translate_llvm_index {
+   INDEX_LINEAR,
+   INDEX_ELTS8,
+   INDEX_ELTS16,
+   INDEX_ELTS32,
+   NUM_INDEX_TYPES
+};
+
+struct translate_llvm_buffer {
+   const uint8_t *base_ptr;
+   unsigned stride;
+   unsigned max_index;
+};
+
+typedef void
+(*translate_llvm_func)(const struct translate_llvm_buffer *buffers,
+                       const void *elts,
+                       unsigned start,
+                       unsigned count,
+                       unsigned start_instance,
+                       unsigned instance_id,
+                       void *output_buffer);
+
+struct translate_llvm {
+   struct translate translate;
+
+#if GALLIVM_USE_ORCJIT == 1
+   LLVMOrcThreadSafeContextRef context;
+#else
+   LLVMContextRef context;
+#endif
+   struct gallivm_state *gallivm;
+
+   enum translate_llvm_conv conv[TRANSLATE_MAX_ATTRIBS];
+
+   struct translate_llvm_buffer buffer[PIPE_MAX_ATTRIBS];
+   unsigned nr_buffers;
+
+   translate_llvm_func func[NUM_INDEX_TYPES];
+};
+
+
+static struct translate_llvm *
+translate_llvm(struct translate *translate)
+{
+   return (struct translate_llvm *)translate;
+}
+
+
+static enum pipe_format
+int_output_format(unsigned nr_channels, boolean sign)
+{
+   static const enum pipe_format uint_formats[4] = {
+      PIPE_FORMAT_R32_UINT, PIPE_FORMAT_R32G32_UINT,
+      PIPE_FORMAT_R32G32B32_UINT, PIPE_FORMAT_R32G32B32A32_UINT
+   };
+   static const enum pipe_format sint_formats[4] = {
+      PIPE_FORMAT_R32_SINT, PIPE_FORMAT_R32G32_SINT,
+      PIPE_FORMAT_R32G32B32_SINT, PIPE_FORMAT_R32G32B32A32_SINT
+   };
+
+   return sign ? sint_formats[nr_channels - 1] : uint_formats[nr_channels - 1];
+}
+
+
+/**
+ * Choose the conversion for an element, or return FALSE if this backend
+ * can't do it.
+ */
+static boolean
+choose_conv(const struct translate_element *element,
+            enum translate_llvm_conv *conv)
+{
+   const struct util_format_description *in_desc =
+      util_format_description(element->input_format);
+   const struct util_format_description *out_desc =
+      util_format_description(element->output_format);
+
+   if (!out_desc || out_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       out_desc->nr_channels > 4)
+      return FALSE;
+
+   if (element->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+      switch (element->output_format) {
+      case PIPE_FORMAT_R32_FLOAT:
+         *conv = CONV_INSTANCE_ID_FLOAT;
+         return TRUE;
+      case PIPE_FORMAT_R32_USCALED:
+      case PIPE_FORMAT_R32_SSCALED:
+      case PIPE_FORMAT_R32_UINT:
+      case PIPE_FORMAT_R32_SINT:
+         *conv = CONV_INSTANCE_ID_INT;
+         return TRUE;
+      default:
+         return FALSE;
+      }
+   }
+
+   if (!in_desc || in_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       in_desc->block.width != 1 || in_desc->block.height != 1)
+      return FALSE;
+
+   if (element->input_format == element->output_format) {
+      if (in_desc->block.bits & 7)
+         return FALSE;
+      *conv = CONV_COPY;
+      return TRUE;
+   }
+
+   if (in_desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB)
+      return FALSE;
+
+   if (in_desc->channel[0].pure_integer) {
+      /* Same rules as translate_generic: the signs must match, and no
+       * precision may be lost, which 32 bit outputs can't.
+       */
+      const boolean sign =
+         in_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED;
+
+      if (!util_format_is_pure_integer(element->input_format) ||
+          element->output_format !=
+          int_output_format(out_desc->nr_channels, sign))
+         return FALSE;
+
+      for (unsigned i = 1; i < in_desc->nr_channels; i++) {
+         if (in_desc->channel[i].type != in_desc->channel[0].type)
+            return FALSE;
+      }
+
+      *conv = CONV_INT;
+      return TRUE;
+   }
+
+   switch (element->output_format) {
+   case PIPE_FORMAT_R32_FLOAT:
+   case PIPE_FORMAT_R32G32_FLOAT:
+   case PIPE_FORMAT_R32G32B32_FLOAT:
+   case PIPE_FORMAT_R32G32B32A32_FLOAT:
+      *conv = CONV_FLOAT;
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+/**
+ * Store the first nr_channels of a <4 x i32/float> vector, unaligned.
+ */
+static void
+store_channels(struct gallivm_state *gallivm,
+               LLVMValueRef value,
+               unsigned nr_channels,
+               LLVMValueRef dst)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = LLVMTypeOf(value);
+   LLVMTypeRef elem_type = LLVMGetElementType(vec_type);
+   LLVMValueRef store;
+
+   if (nr_channels == 4) {
+      dst = LLVMBuildBitCast(builder, dst, LLVMPointerType(vec_type, 0), "");
+      store = LLVMBuildStore(builder, value, dst);
+      LLVMSetAlignment(store, 1);
+      return;
+   }
+
+   dst = LLVMBuildBitCast(builder, dst, LLVMPointerType(elem_type, 0), "");
+   for (unsigned i = 0; i < nr_channels; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef ptr = LLVMBuildGEP2(builder, elem_type, dst, &index, 1, "");
+      LLVMValueRef chan = LLVMBuildExtractElement(builder, value, index, "");
+
+      store = LLVMBuildStore(builder, chan, ptr);
+      LLVMSetAlignment(store, 1);
+   }
+}
+
+
+/**
+ * Copy size bytes, in the largest chunks that fit.
+ */
+static void
+copy_bytes(struct gallivm_state *gallivm,
+           LLVMValueRef src,
+           LLVMValueRef dst,
+           unsigned size)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   unsigned offset = 0;
+
+   while (offset < size) {
+      unsigned chunk = 8;
+      while (chunk > size - offset)
+         chunk /= 2;
+
+      LLVMTypeRef chunk_type =
+         LLVMIntTypeInContext(gallivm->context, chunk * 8);
+      LLVMValueRef index = lp_build_const_int32(gallivm, offset);
+      LLVMValueRef src_ptr = LLVMBuildGEP2(builder, i8t, src, &index, 1, "");
+      LLVMValueRef dst_ptr = LLVMBuildGEP2(builder, i8t, dst, &index, 1, "");
+      LLVMValueRef value, store;
+
+      src_ptr = LLVMBuildBitCast(builder, src_ptr,
+                                 LLVMPointerType(chunk_type, 0), "");
+      dst_ptr = LLVMBuildBitCast(builder, dst_ptr,
+                                 LLVMPointerType(chunk_type, 0), "");
+      value = LLVMBuildLoad2(builder, chunk_type, src_ptr, "");
+      LLVMSetAlignment(value, 1);
+      store = LLVMBuildStore(builder, value, dst_ptr);
+      LLVMSetAlignment(store, 1);
+
+      offset += chunk;
+   }
+}
+
+
+/**
+ * Build the function translating count vertices, indexed as given.
+ */
+static LLVMValueRef
+build_run(struct translate_llvm *p,
+          enum translate_llvm_index index_type,
+          const char *name)
+{
+   static const unsigned elt_bits[NUM_INDEX_TYPES] = { 0, 8, 16, 32 };
+   const struct translate_key *key = &p->translate.key;
+   struct gallivm_state *gallivm = p->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(context);
+   LLVMTypeRef i8p = LLVMPointerType(i8t, 0);
+   LLVMTypeRef buffer_members[3] = { i8p, i32t, i32t };
+   LLVMTypeRef buffer_type =
+      LLVMStructTypeInContext(context, buffer_members, 3, 0);
+   LLVMTypeRef arg_types[7];
+   LLVMValueRef func;
+   LLVMValueRef buffers, elts, start, count, start_instance, instance_id;
+   LLVMValueRef output;
+   LLVMValueRef base_ptr[PIPE_MAX_ATTRIBS];
+   LLVMValueRef stride[PIPE_MAX_ATTRIBS];
+   LLVMValueRef max_index[PIPE_MAX_ATTRIBS];
+   struct lp_build_for_loop_state loop;
+
+   arg_types[0] = LLVMPointerType(buffer_type, 0);  /* buffers */
+   arg_types[1] = i8p;                              /* elts */
+   arg_types[2] = i32t;                             /* start */
+   arg_types[3] = i32t;                             /* count */
+   arg_types[4] = i32t;                             /* start_instance */
+   arg_types[5] = i32t;                             /* instance_id */
+   arg_types[6] = i8p;                              /* output_buffer */
+
+   func = LLVMAddFunction(gallivm->module, name,
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           arg_types, ARRAY_SIZE(arg_types),
+                                           0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   buffers = LLVMGetParam(func, 0);
+   elts = LLVMGetParam(func, 1);
+   start = LLVMGetParam(func, 2);
+   count = LLVMGetParam(func, 3);
+   start_instance = LLVMGetParam(func, 4);
+   instance_id = LLVMGetParam(func, 5);
+   output = LLVMGetParam(func, 6);
+
+   LLVMPositionBuilderAtEnd(builder,
+                            LLVMAppendBasicBlockInContext(context, func,
+                                                          "entry"));
+
+   for (unsigned i = 0; i < p->nr_buffers; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef buffer =
+         LLVMBuildGEP2(builder, buffer_type, buffers, &index, 1, "");
+
+      base_ptr[i] = lp_build_struct_get2(gallivm, buffer_type, buffer, 0,
+                                         "base_ptr");
+      stride[i] = lp_build_struct_get2(gallivm, buffer_type, buffer, 1,
+                                       "stride");
+      max_index[i] = lp_build_struct_get2(gallivm, buffer_type, buffer, 2,
+                                          "max_index");
+   }
+
+   if (elt_bits[index_type]) {
+      elts = LLVMBuildBitCast(builder, elts,
+                              LLVMPointerType(LLVMIntTypeInContext(context,
+                                                 elt_bits[index_type]), 0),
+                              "");
+   }
+
+   lp_build_for_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0),
+                           LLVMIntULT, count,
+                           lp_build_const_int32(gallivm, 1));
+   {
+      LLVMValueRef elt;
+      LLVMValueRef vertex;
+
+      if (elt_bits[index_type]) {
+         LLVMTypeRef elt_type =
+            LLVMIntTypeInContext(context, elt_bits[index_type]);
+         elt = lp_build_pointer_get2(builder, elt_type, elts, loop.counter);
+         elt = LLVMBuildZExt(builder, elt, i32t, "");
+      } else {
+         elt = LLVMBuildAdd(builder, start, loop.counter, "");
+      }
+
+      vertex = LLVMBuildMul(builder,
+                            LLVMBuildZExt(builder, loop.counter, i64t, ""),
+                            lp_build_const_int64(gallivm, key->output_stride),
+                            "");
+      vertex = LLVMBuildGEP2(builder, i8t, output, &vertex, 1, "");
+
+      for (unsigned i = 0; i < key->nr_elements; i++) {
+         const struct translate_element *element = &key->element[i];
+         const struct util_format_description *out_desc =
+            util_format_description(element->output_format);
+         LLVMValueRef dst_offset =
+            lp_build_const_int32(gallivm, element->output_offset);
+         LLVMValueRef dst =
+            LLVMBuildGEP2(builder, i8t, vertex, &dst_offset, 1, "");
+
+         if (p->conv[i] == CONV_INSTANCE_ID_FLOAT) {
+            LLVMValueRef value =
+               LLVMBuildUIToFP(builder, instance_id,
+                               LLVMFloatTypeInContext(context), "");
+            dst = LLVMBuildBitCast(builder, dst,
+                                   LLVMPointerType(LLVMTypeOf(value), 0), "");
+            LLVMSetAlignment(LLVMBuildStore(builder, value, dst), 1);
+            continue;
+         }
+         if (p->conv[i] == CONV_INSTANCE_ID_INT) {
+            dst = LLVMBuildBitCast(builder, dst, LLVMPointerType(i32t, 0), "");
+            LLVMSetAlignment(LLVMBuildStore(builder, instance_id, dst), 1);
+            continue;
+         }
+
+         const unsigned buf = element->input_buffer;
+         LLVMValueRef index;
+
+         if (element->instance_divisor) {
+            /* Like translate_generic, don't clamp these: max_index is
+             * for the per vertex data.
+             */
+            index = LLVMBuildUDiv(builder, instance_id,
+                                  lp_build_const_int32(gallivm,
+                                                       element->instance_divisor),
+                                  "");
+            index = LLVMBuildAdd(builder, start_instance, index, "");
+         } else {
+            LLVMValueRef in_range =
+               LLVMBuildICmp(builder, LLVMIntULE, elt, max_index[buf], "");
+            index = LLVMBuildSelect(builder, in_range, elt, max_index[buf], "");
+         }
+
+         LLVMValueRef src_offset =
+            LLVMBuildMul(builder,
+                         LLVMBuildZExt(builder, index, i64t, ""),
+                         LLVMBuildZExt(builder, stride[buf], i64t, ""), "");
+         src_offset = LLVMBuildAdd(builder, src_offset,
+                                   lp_build_const_int64(gallivm,
+                                                        element->input_offset),
+                                   "");
+         LLVMValueRef src =
+            LLVMBuildGEP2(builder, i8t, base_ptr[buf], &src_offset, 1, "");
+
+         if (p->conv[i] == CONV_COPY) {
+            const struct util_format_description *in_desc =
+               util_format_description(element->input_format);
+            copy_bytes(gallivm, src, dst, in_desc->block.bits / 8);
+            continue;
+         }
+
+         /* Pure integers come back as integer bits in a float vector. */
+         LLVMValueRef zero = lp_build_const_int32(gallivm, 0);
+         LLVMValueRef rgba =
+            lp_build_fetch_rgba_aos(gallivm,
+                                    util_format_description(element->input_format),
+                                    lp_float32_vec4_type(), FALSE,
+                                    src, zero, zero, zero, NULL);
+
+         if (p->conv[i] == CONV_INT) {
+            rgba = LLVMBuildBitCast(builder, rgba,
+                                    LLVMVectorType(i32t, 4), "");
+         }
+
+         store_channels(gallivm, rgba, out_desc->nr_channels, dst);
+      }
+   }
+   lp_build_for_loop_end(&loop);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static void UTIL_CDECL
+llvm_run_elts(struct translate *translate,
+              const unsigned *elts,
+              unsigned count,
+              unsigned start_instance,
+              unsigned instance_id,
+              void *output_buffer)
+{
+   struct translate_llvm *p = translate_llvm(translate);
+
+   p->func[INDEX_ELTS32](p->buffer, elts, 0, count,
+                         start_instance, instance_id, output_buffer);
+}
+
+
+static void UTIL_CDECL
+llvm_run_elts16(struct translate *translate,
+                const uint16_t *elts,
+                unsigned count,
+                unsigned start_instance,
+                unsigned instance_id,
+                void *output_buffer)
+{
+   struct translate_llvm *p = translate_llvm(translate);
+
+   p->func[INDEX_ELTS16](p->buffer, elts, 0, count,
+                         start_instance, instance_id, output_buffer);
+}
+
+
+static void UTIL_CDECL
+llvm_run_elts8(struct translate *translate,
+               const uint8_t *elts,
+               unsigned count,
+               unsigned start_instance,
+               unsigned instance_id,
+               void *output_buffer)
+{
+   struct translate_llvm *p = translate_llvm(translate);
+
+   p->func[INDEX_ELTS8](p->buffer, elts, 0, count,
+                        start_instance, instance_id, output_buffer);
+}
+
+
+static void UTIL_CDECL
+llvm_run(struct translate *translate,
+         unsigned start,
+         unsigned count,
+         unsigned start_instance,
+         unsigned instance_id,
+         void *output_buffer)
+{
+   struct translate_llvm *p = translate_llvm(translate);
+
+   p->func[INDEX_LINEAR](p->buffer, NULL, start, count,
+                         start_instance, instance_id, output_buffer);
+}
+
+
+static void
+llvm_set_buffer(struct translate *translate,
+                unsigned buf,
+                const void *ptr,
+                unsigned stride,
+                unsigned max_index)
+{
+   struct translate_llvm *p = translate_llvm(translate);
+
+   if (buf < p->nr_buffers) {
+      p->buffer[buf].base_ptr = ptr;
+      p->buffer[buf].stride = stride;
+      p->buffer[buf].max_index = max_index;
+   }
+}
+
+
+static void
+llvm_release(struct translate *translate)
+{
+   struct translate_llvm *p = translate_llvm(translate);
+
+   if (p->gallivm)
+      gallivm_destroy(p->gallivm);
+#if GALLIVM_USE_ORCJIT == 1
+   if (p->context)
+      LLVMOrcDisposeThreadSafeContext(p->context);
+#else
+   if (p->context)
+      LLVMContextDispose(p->context);
+#endif
+
+   FREE(p);
+}
+
+
+struct translate *
+translate_llvm_create(const struct translate_key *key)
+{
+   static const char *func_names[NUM_INDEX_TYPES] = {
+      "translate_linear", "translate_elts8",
+      "translate_elts16", "translate_elts32"
+   };
+   LLVMValueRef funcs[NUM_INDEX_TYPES];
+   struct translate_llvm *p;
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   if (!lp_build_init())
+      return NULL;
+
+   p = CALLOC_STRUCT(translate_llvm);
+   if (!p)
+      return NULL;
+
+   p->translate.key = *key;
+   p->translate.release = llvm_release;
+   p->translate.set_buffer = llvm_set_buffer;
+   p->translate.run_elts = llvm_run_elts;
+   p->translate.run_elts16 = llvm_run_elts16;
+   p->translate.run_elts8 = llvm_run_elts8;
+   p->translate.run = llvm_run;
+
+   for (unsigned i = 0; i < key->nr_elements; i++) {
+      if (!choose_conv(&key->element[i], &p->conv[i]))
+         goto fail;
+
+      if (key->element[i].type == TRANSLATE_ELEMENT_NORMAL) {
+         if (key->element[i].input_buffer >= PIPE_MAX_ATTRIBS)
+            goto fail;
+         p->nr_buffers = MAX2(p->nr_buffers,
+                              key->element[i].input_buffer + 1);
+      }
+   }
+
+#if GALLIVM_USE_ORCJIT == 1
+   p->context = LLVMOrcCreateNewThreadSafeContext();
+#else
+   p->context = LLVMContextCreate();
+#if LLVM_VERSION_MAJOR >= 15
+   if (p->context)
+      LLVMContextSetOpaquePointers(p->context, false);
+#endif
+#endif
+   if (!p->context)
+      goto fail;
+
+   p->gallivm = gallivm_create("translate", p->context, NULL);
+   if (!p->gallivm)
+      goto fail;
+
+   for (unsigned i = 0; i < NUM_INDEX_TYPES; i++)
+      funcs[i] = build_run(p, i, func_names[i]);
+
+   gallivm_compile_module(p->gallivm);
+
+   for (unsigned i = 0; i < NUM_INDEX_TYPES; i++) {
+#if GALLIVM_USE_ORCJIT == 1
+      (void)funcs;
+      p->func[i] = (translate_llvm_func)
+         gallivm_jit_function(p->gallivm, func_names[i]);
+#else
+      p->func[i] = (translate_llvm_func)
+         gallivm_jit_function(p->gallivm, funcs[i]);
+#endif
+      if (!p->func[i])
+         goto fail;
+   }
+
+   gallivm_free_ir(p->gallivm);
+
+   return &p->translate;
+
+fail:
+   llvm_release(&p->translate);
+   return NULL;
+}
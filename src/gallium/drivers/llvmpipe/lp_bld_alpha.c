@@ -48,6 +48,7 @@
 void
 lp_build_alpha_test(struct gallivm_state *gallivm,
                     unsigned func,
+                    LLVMValueRef dyn_func,
                     struct lp_type type,
                     const struct util_format_description *cbuf_format_desc,
                     struct lp_build_mask_context *mask,
@@ -83,7 +84,10 @@ lp_build_alpha_test(struct gallivm_state *gallivm,
       lp_build_context_init(&bld, gallivm, type);
    }
 
-   LLVMValueRef test = lp_build_cmp(&bld, func, alpha, ref);
+   /* dyn_func is the run time func of generic variants */
+   LLVMValueRef test = dyn_func ?
+      lp_build_cmp_dynamic(&bld, dyn_func, alpha, ref) :
+      lp_build_cmp(&bld, func, alpha, ref);
 
    lp_build_name(test, "alpha_mask");
 
@@ -47,6 +47,7 @@ struct lp_build_mask_context;
 void
 lp_build_alpha_test(struct gallivm_state *gallivm,
                     unsigned func,
+                    LLVMValueRef dyn_func,
                     struct lp_type type,
                     const struct util_format_description *cbuf_format_desc,
                     struct lp_build_mask_context *mask,
@@ -41,6 +41,23 @@ struct lp_build_context;
 struct lp_build_mask_context;
 
 
+/**
+ * Blend state of a colour buffer read at run time, as scalar i32 values.
+ * Generic fragment shader variants blend with these rather than with the
+ * factors, functions and colormask of their key.
+ */
+struct lp_build_blend_dynamic
+{
+   LLVMValueRef rgb_func;
+   LLVMValueRef rgb_src_factor;
+   LLVMValueRef rgb_dst_factor;
+   LLVMValueRef alpha_func;
+   LLVMValueRef alpha_src_factor;
+   LLVMValueRef alpha_dst_factor;
+   LLVMValueRef colormask;
+};
+
+
 LLVMValueRef
 lp_build_blend(struct lp_build_context *bld,
                enum pipe_blend_func func,
@@ -57,6 +74,7 @@ lp_build_blend(struct lp_build_context *bld,
 LLVMValueRef
 lp_build_blend_aos(struct gallivm_state *gallivm,
                    const struct pipe_blend_state *blend,
+                   const struct lp_build_blend_dynamic *dyn,
                    enum pipe_format cbuf_format,
                    struct lp_type type,
                    unsigned rt,
@@ -46,6 +46,7 @@
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
 #include "util/format/u_format.h"
+#include "util/u_dual_blend.h"
 
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_const.h"
@@ -287,10 +288,168 @@ lp_build_blend_factor(struct lp_build_blend_aos_context *bld,
 }
 
 
+/** All the PIPE_BLENDFACTOR_x values */
+static const unsigned blend_factors[] = {
+   PIPE_BLENDFACTOR_ONE,
+   PIPE_BLENDFACTOR_SRC_COLOR,
+   PIPE_BLENDFACTOR_SRC_ALPHA,
+   PIPE_BLENDFACTOR_DST_ALPHA,
+   PIPE_BLENDFACTOR_DST_COLOR,
+   PIPE_BLENDFACTOR_SRC_ALPHA_SATURATE,
+   PIPE_BLENDFACTOR_CONST_COLOR,
+   PIPE_BLENDFACTOR_CONST_ALPHA,
+   PIPE_BLENDFACTOR_SRC1_COLOR,
+   PIPE_BLENDFACTOR_SRC1_ALPHA,
+   PIPE_BLENDFACTOR_INV_SRC_COLOR,
+   PIPE_BLENDFACTOR_INV_SRC_ALPHA,
+   PIPE_BLENDFACTOR_INV_DST_ALPHA,
+   PIPE_BLENDFACTOR_INV_DST_COLOR,
+   PIPE_BLENDFACTOR_INV_CONST_COLOR,
+   PIPE_BLENDFACTOR_INV_CONST_ALPHA,
+   PIPE_BLENDFACTOR_INV_SRC1_COLOR,
+   PIPE_BLENDFACTOR_INV_SRC1_ALPHA,
+};
+
+
+/**
+ * Like lp_build_blend_factor_unswizzled(), for a factor only known at run
+ * time.  Colour factors taken from alpha are swizzled already.
+ */
+static LLVMValueRef
+lp_build_blend_factor_dynamic(struct lp_build_blend_aos_context *bld,
+                              LLVMValueRef factor,
+                              boolean alpha,
+                              unsigned alpha_swizzle,
+                              unsigned num_channels)
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef res = bld->base.zero;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(blend_factors); i++) {
+      /* there's no second source without dual source blending */
+      if (!bld->src1 && util_blend_factor_is_dual_src(blend_factors[i]))
+         continue;
+
+      LLVMValueRef value =
+         lp_build_blend_factor_unswizzled(bld, blend_factors[i], alpha);
+
+      if (!alpha && alpha_swizzle != PIPE_SWIZZLE_NONE &&
+          lp_build_blend_factor_swizzle(blend_factors[i]) ==
+          LP_BUILD_BLEND_SWIZZLE_AAAA) {
+         value = lp_build_swizzle_scalar_aos(&bld->base, value,
+                                             alpha_swizzle, num_channels);
+      }
+
+      LLVMValueRef is_factor =
+         LLVMBuildICmp(builder, LLVMIntEQ, factor,
+                       lp_build_const_int32(gallivm, blend_factors[i]), "");
+      res = LLVMBuildSelect(builder, is_factor, value, res, "");
+   }
+
+   return res;
+}
+
+
+/**
+ * Like lp_build_blend_func(), for a function only known at run time.
+ */
+static LLVMValueRef
+lp_build_blend_func_dynamic(struct lp_build_blend_aos_context *bld,
+                            LLVMValueRef func,
+                            LLVMValueRef src_term,
+                            LLVMValueRef dst_term)
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef res = lp_build_blend_func(&bld->base, PIPE_BLEND_ADD,
+                                          src_term, dst_term);
+
+   for (unsigned f = PIPE_BLEND_SUBTRACT; f <= PIPE_BLEND_MAX; f++) {
+      /* min and max ignore the factors */
+      const boolean factored = f != PIPE_BLEND_MIN && f != PIPE_BLEND_MAX;
+      LLVMValueRef value =
+         lp_build_blend_func(&bld->base, f,
+                             factored ? src_term : bld->src,
+                             factored ? dst_term : bld->dst);
+      LLVMValueRef is_func =
+         LLVMBuildICmp(builder, LLVMIntEQ, func,
+                       lp_build_const_int32(gallivm, f), "");
+      res = LLVMBuildSelect(builder, is_func, value, res, "");
+   }
+
+   return res;
+}
+
+
+/**
+ * Blend with the factors and functions of dyn.  Unlike lp_build_blend(),
+ * this has no special case for the inverse factors of snorm types.
+ */
+static LLVMValueRef
+lp_build_blend_aos_dynamic(struct lp_build_blend_aos_context *bld,
+                           const struct lp_build_blend_dynamic *dyn,
+                           unsigned alpha_swizzle,
+                           unsigned nr_channels)
+{
+   const boolean alpha_only =
+      nr_channels == 1 && alpha_swizzle == PIPE_SWIZZLE_X;
+   const boolean separate_alpha =
+      alpha_swizzle != PIPE_SWIZZLE_NONE && !alpha_only;
+   LLVMValueRef src_factor, dst_factor;
+
+   src_factor = lp_build_blend_factor_dynamic(bld,
+                                              alpha_only ? dyn->alpha_src_factor
+                                                         : dyn->rgb_src_factor,
+                                              alpha_only,
+                                              alpha_swizzle, nr_channels);
+   dst_factor = lp_build_blend_factor_dynamic(bld,
+                                              alpha_only ? dyn->alpha_dst_factor
+                                                         : dyn->rgb_dst_factor,
+                                              alpha_only,
+                                              alpha_swizzle, nr_channels);
+
+   if (separate_alpha) {
+      LLVMValueRef src_alpha_factor =
+         lp_build_blend_factor_dynamic(bld, dyn->alpha_src_factor, TRUE,
+                                       alpha_swizzle, nr_channels);
+      LLVMValueRef dst_alpha_factor =
+         lp_build_blend_factor_dynamic(bld, dyn->alpha_dst_factor, TRUE,
+                                       alpha_swizzle, nr_channels);
+
+      src_factor = lp_build_select_aos(&bld->base, 1 << alpha_swizzle,
+                                       src_alpha_factor, src_factor,
+                                       nr_channels);
+      dst_factor = lp_build_select_aos(&bld->base, 1 << alpha_swizzle,
+                                       dst_alpha_factor, dst_factor,
+                                       nr_channels);
+   }
+
+   LLVMValueRef src_term = lp_build_mul(&bld->base, bld->src, src_factor);
+   LLVMValueRef dst_term = lp_build_mul(&bld->base, bld->dst, dst_factor);
+
+   LLVMValueRef result =
+      lp_build_blend_func_dynamic(bld,
+                                  alpha_only ? dyn->alpha_func : dyn->rgb_func,
+                                  src_term, dst_term);
+
+   if (separate_alpha) {
+      LLVMValueRef alpha =
+         lp_build_blend_func_dynamic(bld, dyn->alpha_func,
+                                     src_term, dst_term);
+      result = lp_build_select_aos(&bld->base, 1 << alpha_swizzle,
+                                   alpha, result, nr_channels);
+   }
+
+   return result;
+}
+
+
 /**
  * Performs blending of src and dst pixels
  *
  * @param blend         the blend state of the shader variant
+ * @param dyn           the blend state to read at run time instead, or NULL
  * @param cbuf_format   format of the colour buffer
  * @param type          data type of the pixel vector
  * @param rt            render target index
@@ -309,6 +468,7 @@ lp_build_blend_factor(struct lp_build_blend_aos_context *bld,
 LLVMValueRef
 lp_build_blend_aos(struct gallivm_state *gallivm,
                    const struct pipe_blend_state *blend,
+                   const struct lp_build_blend_dynamic *dyn,
                    enum pipe_format cbuf_format,
                    struct lp_type type,
                    unsigned rt,
@@ -368,6 +528,9 @@ lp_build_blend_aos(struct gallivm_state *gallivm,
       }
    } else if (!state->blend_enable) {
       result = src;
+   } else if (dyn && !(type.norm && type.sign)) {
+      result = lp_build_blend_aos_dynamic(&bld, dyn, alpha_swizzle,
+                                          nr_channels);
    } else {
       boolean rgb_alpha_same =
          (state->rgb_src_factor == state->rgb_dst_factor &&
@@ -422,11 +585,23 @@ lp_build_blend_aos(struct gallivm_state *gallivm,
    }
 
    /* Check if color mask is necessary */
-   if (!util_format_colormask_full(desc, state->colormask)) {
+   if (dyn || !util_format_colormask_full(desc, state->colormask)) {
       LLVMValueRef color_mask =
          lp_build_const_mask_aos_swizzled(gallivm, bld.base.type,
                                           state->colormask, nr_channels,
                                           swizzle);
+      if (dyn) {
+         for (unsigned colormask = 0; colormask < 0xf; colormask++) {
+            LLVMValueRef is_colormask =
+               LLVMBuildICmp(gallivm->builder, LLVMIntEQ, dyn->colormask,
+                             lp_build_const_int32(gallivm, colormask), "");
+            color_mask = LLVMBuildSelect(gallivm->builder, is_colormask,
+                                         lp_build_const_mask_aos_swizzled(
+                                            gallivm, bld.base.type, colormask,
+                                            nr_channels, swizzle),
+                                         color_mask, "");
+         }
+      }
       lp_build_name(color_mask, "color_mask");
 
       /* Combine with input mask if necessary */
@@ -77,6 +77,20 @@ enum stencil_op {
 };
 
 
+/**
+ * Replicate a scalar i32 of dynamic state into a vector of bld's type.
+ */
+static LLVMValueRef
+lp_build_dynamic_vec(struct lp_build_context *bld,
+                     LLVMValueRef value)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+
+   value = LLVMBuildIntCast2(builder, value, bld->int_elem_type, FALSE, "");
+   return lp_build_broadcast(bld->gallivm, bld->int_vec_type, value);
+}
+
+
 
 /**
  * Do the stencil test comparison (compare FB stencil values against ref value).
@@ -89,6 +103,7 @@ enum stencil_op {
 static LLVMValueRef
 lp_build_stencil_test_single(struct lp_build_context *bld,
                              const struct pipe_stencil_state *stencil,
+                             const struct lp_build_stencil_dynamic *dyn,
                              LLVMValueRef stencilRef,
                              LLVMValueRef stencilVals)
 {
@@ -109,6 +124,13 @@ lp_build_stencil_test_single(struct lp_build_context *bld,
 
    assert(stencil->enabled);
 
+   if (dyn) {
+      LLVMValueRef valuemask = lp_build_dynamic_vec(bld, dyn->valuemask);
+      stencilRef = LLVMBuildAnd(builder, stencilRef, valuemask, "");
+      stencilVals = LLVMBuildAnd(builder, stencilVals, valuemask, "");
+      return lp_build_cmp_dynamic(bld, dyn->func, stencilRef, stencilVals);
+   }
+
    if (stencil->valuemask != stencilMax) {
       /* compute stencilRef = stencilRef & valuemask */
       LLVMValueRef valuemask = lp_build_const_int_vec(bld->gallivm, type, stencil->valuemask);
@@ -132,6 +154,7 @@ lp_build_stencil_test_single(struct lp_build_context *bld,
 static LLVMValueRef
 lp_build_stencil_test(struct lp_build_context *bld,
                       const struct pipe_stencil_state stencil[2],
+                      const struct lp_build_depth_dynamic *dyn,
                       LLVMValueRef stencilRefs[2],
                       LLVMValueRef stencilVals,
                       LLVMValueRef front_facing)
@@ -142,6 +165,7 @@ lp_build_stencil_test(struct lp_build_context *bld,
 
    /* do front face test */
    res = lp_build_stencil_test_single(bld, &stencil[0],
+                                      dyn ? &dyn->stencil[0] : NULL,
                                       stencilRefs[0], stencilVals);
 
    if (stencil[1].enabled && front_facing != NULL) {
@@ -149,6 +173,7 @@ lp_build_stencil_test(struct lp_build_context *bld,
       LLVMValueRef back_res;
 
       back_res = lp_build_stencil_test_single(bld, &stencil[1],
+                                              dyn ? &dyn->stencil[1] : NULL,
                                               stencilRefs[1], stencilVals);
 
       res = lp_build_select(bld, front_facing, res, back_res);
@@ -159,17 +184,13 @@ lp_build_stencil_test(struct lp_build_context *bld,
 
 
 /**
- * Apply the stencil operator (add/sub/keep/etc) to the given vector
- * of stencil values.
- * \return  new stencil values vector
+ * Apply the given PIPE_STENCIL_OP_x to a vector of stencil values.
  */
 static LLVMValueRef
-lp_build_stencil_op_single(struct lp_build_context *bld,
-                           const struct pipe_stencil_state *stencil,
-                           enum stencil_op op,
-                           LLVMValueRef stencilRef,
-                           LLVMValueRef stencilVals)
-
+lp_build_stencil_op_value(struct lp_build_context *bld,
+                          unsigned stencil_op,
+                          LLVMValueRef stencilRef,
+                          LLVMValueRef stencilVals)
 {
    LLVMBuilderRef builder = bld->gallivm->builder;
    struct lp_type type = bld->type;
@@ -177,28 +198,11 @@ lp_build_stencil_op_single(struct lp_build_context *bld,
 
    assert(type.sign);
 
-   unsigned stencil_op;
-   switch (op) {
-   case S_FAIL_OP:
-      stencil_op = stencil->fail_op;
-      break;
-   case Z_FAIL_OP:
-      stencil_op = stencil->zfail_op;
-      break;
-   case Z_PASS_OP:
-      stencil_op = stencil->zpass_op;
-      break;
-   default:
-      assert(0 && "Invalid stencil_op mode");
-      stencil_op = PIPE_STENCIL_OP_KEEP;
-   }
-
    LLVMValueRef res;
    switch (stencil_op) {
    case PIPE_STENCIL_OP_KEEP:
       res = stencilVals;
-      /* we can return early for this case */
-      return res;
+      break;
    case PIPE_STENCIL_OP_ZERO:
       res = bld->zero;
       break;
@@ -234,12 +238,76 @@ lp_build_stencil_op_single(struct lp_build_context *bld,
 }
 
 
+/**
+ * Apply the stencil operator (add/sub/keep/etc) to the given vector
+ * of stencil values.
+ * \return  new stencil values vector
+ */
+static LLVMValueRef
+lp_build_stencil_op_single(struct lp_build_context *bld,
+                           const struct pipe_stencil_state *stencil,
+                           const struct lp_build_stencil_dynamic *dyn,
+                           enum stencil_op op,
+                           LLVMValueRef stencilRef,
+                           LLVMValueRef stencilVals)
+
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+
+   if (dyn) {
+      LLVMValueRef dyn_op;
+      switch (op) {
+      case S_FAIL_OP:
+         dyn_op = dyn->fail_op;
+         break;
+      case Z_FAIL_OP:
+         dyn_op = dyn->zfail_op;
+         break;
+      default:
+         dyn_op = dyn->zpass_op;
+         break;
+      }
+
+      LLVMValueRef res = stencilVals;
+      for (unsigned i = PIPE_STENCIL_OP_ZERO; i <= PIPE_STENCIL_OP_INVERT; i++) {
+         LLVMValueRef is_op =
+            LLVMBuildICmp(builder, LLVMIntEQ, dyn_op,
+                          lp_build_const_int32(bld->gallivm, i), "");
+         res = LLVMBuildSelect(builder, is_op,
+                               lp_build_stencil_op_value(bld, i, stencilRef,
+                                                         stencilVals),
+                               res, "");
+      }
+      return res;
+   }
+
+   unsigned stencil_op;
+   switch (op) {
+   case S_FAIL_OP:
+      stencil_op = stencil->fail_op;
+      break;
+   case Z_FAIL_OP:
+      stencil_op = stencil->zfail_op;
+      break;
+   case Z_PASS_OP:
+      stencil_op = stencil->zpass_op;
+      break;
+   default:
+      assert(0 && "Invalid stencil_op mode");
+      stencil_op = PIPE_STENCIL_OP_KEEP;
+   }
+
+   return lp_build_stencil_op_value(bld, stencil_op, stencilRef, stencilVals);
+}
+
+
 /**
  * Do the one or two-sided stencil test op/update.
  */
 static LLVMValueRef
 lp_build_stencil_op(struct lp_build_context *bld,
                     const struct pipe_stencil_state stencil[2],
+                    const struct lp_build_depth_dynamic *dyn,
                     enum stencil_op op,
                     LLVMValueRef stencilRefs[2],
                     LLVMValueRef stencilVals,
@@ -253,20 +321,34 @@ lp_build_stencil_op(struct lp_build_context *bld,
    assert(stencil[0].enabled);
 
    /* do front face op */
-   res = lp_build_stencil_op_single(bld, &stencil[0], op,
-                                     stencilRefs[0], stencilVals);
+   res = lp_build_stencil_op_single(bld, &stencil[0],
+                                    dyn ? &dyn->stencil[0] : NULL, op,
+                                    stencilRefs[0], stencilVals);
 
    if (stencil[1].enabled && front_facing != NULL) {
       /* do back face op */
       LLVMValueRef back_res;
 
-      back_res = lp_build_stencil_op_single(bld, &stencil[1], op,
+      back_res = lp_build_stencil_op_single(bld, &stencil[1],
+                                            dyn ? &dyn->stencil[1] : NULL, op,
                                             stencilRefs[1], stencilVals);
 
       res = lp_build_select(bld, front_facing, res, back_res);
    }
 
-   if (stencil[0].writemask != 0xff ||
+   if (dyn) {
+      LLVMValueRef writemask =
+         lp_build_dynamic_vec(bld, dyn->stencil[0].writemask);
+      if (stencil[1].enabled && front_facing != NULL) {
+         LLVMValueRef back_writemask =
+            lp_build_dynamic_vec(bld, dyn->stencil[1].writemask);
+         writemask = lp_build_select(bld, front_facing,
+                                     writemask, back_writemask);
+      }
+
+      mask = LLVMBuildAnd(builder, mask, writemask, "");
+      res = lp_build_select_bitwise(bld, mask, res, stencilVals);
+   } else if (stencil[0].writemask != 0xff ||
        (stencil[1].enabled && front_facing != NULL &&
         stencil[1].writemask != 0xff)) {
       /* mask &= stencil[0].writemask */
@@ -514,6 +596,52 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Position in the linear rows of the i-th value of a 2x4 or 4x4 group of
+ * fragment quads.  Swapping the two middle bits is its own inverse, so
+ * this also swizzles the quads back to the linear rows.
+ */
+static inline unsigned
+depth_stamp_swizzle(unsigned i)
+{
+   return (i&1) + (i&2) * 2 + (i&4) / 2 + (i&8);
+}
+
+
+static LLVMValueRef
+depth_row_ptr(struct gallivm_state *gallivm,
+              struct lp_type row_type,
+              LLVMValueRef depth_ptr,
+              LLVMValueRef depth_stride,
+              unsigned row)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
+   LLVMValueRef offset = LLVMBuildMul(builder, depth_stride,
+                                      lp_build_const_int32(gallivm, row), "");
+   LLVMValueRef ptr = LLVMBuildGEP2(builder, int8_type, depth_ptr,
+                                    &offset, 1, "");
+
+   return LLVMBuildBitCast(builder, ptr,
+                           LLVMPointerType(lp_build_vec_type(gallivm, row_type), 0),
+                           "");
+}
+
+
+static LLVMValueRef
+load_depth_row(struct gallivm_state *gallivm,
+               struct lp_type row_type,
+               LLVMValueRef depth_ptr,
+               LLVMValueRef depth_stride,
+               unsigned row)
+{
+   return LLVMBuildLoad2(gallivm->builder,
+                         lp_build_vec_type(gallivm, row_type),
+                         depth_row_ptr(gallivm, row_type, depth_ptr,
+                                       depth_stride, row), "");
+}
+
+
 /**
  * Load depth/stencil values.
  * The stored values are linear, swizzle them.
@@ -565,40 +693,56 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
          shuffles[i] = lp_build_const_int32(gallivm, i);
       }
    } else {
-      unsigned i;
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
+      assert(z_src_type.length == 8 || z_src_type.length == 16);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
-       * We load 2x4 values, and need to swizzle them (order
-       * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
+       * We load 2x4 (or 4x4) values, and need to swizzle them (order
+       * 0,1,4,5,2,3,6,7, then the same for the next two rows) - not so hot
+       * with avx unfortunately.
        */
-      for (i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+      for (unsigned i = 0; i < z_src_type.length; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, depth_stamp_swizzle(i));
       }
    }
 
    depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
 
    /* Load current z/stencil values from z/stencil buffer */
-   LLVMTypeRef load_ptr_type = LLVMPointerType(zs_dst_type, 0);
    LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
-   LLVMValueRef zs_dst_ptr =
-      LLVMBuildGEP2(builder, int8_type, depth_ptr, &depth_offset1, 1, "");
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-   LLVMValueRef zs_dst1 = LLVMBuildLoad2(builder, zs_dst_type, zs_dst_ptr, "");
-   LLVMValueRef zs_dst2;
-   if (is_1d) {
-      zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+   if (z_src_type.length == 16) {
+      /* The whole 4x4 stamp, one row of 4 values at a time */
+      struct lp_type zs_row_type = zs_type;
+      LLVMValueRef zs_rows[4];
+
+      assert(!is_1d);
+      zs_row_type.length = 4;
+      for (unsigned i = 0; i < 4; i++) {
+         zs_rows[i] = load_depth_row(gallivm, zs_row_type, depth_ptr,
+                                     depth_stride, i);
+      }
+      *z_fb = lp_build_concat(gallivm, zs_rows, zs_row_type, 4);
+      *z_fb = LLVMBuildShuffleVector(builder, *z_fb, *z_fb,
+                                     LLVMConstVector(shuffles, zs_type.length), "");
    } else {
-      zs_dst_ptr = LLVMBuildGEP2(builder, int8_type, depth_ptr, &depth_offset2, 1, "");
+      LLVMTypeRef load_ptr_type = LLVMPointerType(zs_dst_type, 0);
+      LLVMValueRef zs_dst_ptr =
+         LLVMBuildGEP2(builder, int8_type, depth_ptr, &depth_offset1, 1, "");
       zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-      zs_dst2 = LLVMBuildLoad2(builder, zs_dst_type, zs_dst_ptr, "");
-   }
+      LLVMValueRef zs_dst1 = LLVMBuildLoad2(builder, zs_dst_type, zs_dst_ptr, "");
+      LLVMValueRef zs_dst2;
+      if (is_1d) {
+         zs_dst2 = lp_build_undef(gallivm, zs_load_type);
+      } else {
+         zs_dst_ptr = LLVMBuildGEP2(builder, int8_type, depth_ptr, &depth_offset2, 1, "");
+         zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
+         zs_dst2 = LLVMBuildLoad2(builder, zs_dst_type, zs_dst_ptr, "");
+      }
 
-   *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
-                                  LLVMConstVector(shuffles, zs_type.length), "");
+      *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
+                                     LLVMConstVector(shuffles, zs_type.length), "");
+   }
    *s_fb = *z_fb;
 
    if (format_desc->block.bits == 8) {
@@ -715,14 +859,15 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
    } else {
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
+      assert(z_src_type.length == 8 || z_src_type.length == 16);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
-       * We load 2x4 values, and need to swizzle them (order
-       * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
+       * We load 2x4 (or 4x4) values, and need to swizzle them (order
+       * 0,1,4,5,2,3,6,7, then the same for the next two rows) - not so hot
+       * with avx unfortunately.
        */
-      for (unsigned i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+      for (unsigned i = 0; i < z_src_type.length; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, depth_stamp_swizzle(i));
       }
    }
 
@@ -752,6 +897,42 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
                                lp_build_int_vec_type(gallivm, zs_type), "");
    }
 
+   if (z_src_type.length == 16) {
+      /* The whole 4x4 stamp, one row of 4 values at a time */
+      struct lp_type zs_row_type = zs_type;
+      LLVMValueRef zs_rows[4];
+
+      assert(!is_1d);
+      zs_row_type.length = 4;
+      if (format_desc->block.bits <= 32) {
+         LLVMValueRef zs_dst = LLVMBuildShuffleVector(builder, z_value, z_value,
+                                                      LLVMConstVector(shuffles, 16), "");
+         for (unsigned i = 0; i < 4; i++) {
+            zs_rows[i] = lp_build_extract_range(gallivm, zs_dst, i * 4, 4);
+         }
+      } else {
+         LLVMValueRef zs_shuffles[LP_MAX_VECTOR_LENGTH / 2];
+         for (unsigned i = 0; i < 16; i++) {
+            zs_shuffles[i*2] = shuffles[i];
+            zs_shuffles[i*2+1] = lp_build_const_int32(gallivm,
+                                                      depth_stamp_swizzle(i) + 16);
+         }
+         for (unsigned i = 0; i < 4; i++) {
+            zs_rows[i] = LLVMBuildShuffleVector(builder, z_value, s_value,
+                                                LLVMConstVector(&zs_shuffles[i * 8], 8),
+                                                "");
+            zs_rows[i] = LLVMBuildBitCast(builder, zs_rows[i],
+                                          lp_build_vec_type(gallivm, zs_row_type), "");
+         }
+      }
+      for (unsigned i = 0; i < 4; i++) {
+         LLVMBuildStore(builder, zs_rows[i],
+                        depth_row_ptr(gallivm, zs_row_type, depth_ptr,
+                                      depth_stride, i));
+      }
+      return;
+   }
+
    if (format_desc->block.bits <= 32) {
       if (z_src_type.length == 4) {
          zs_dst1 = lp_build_extract_range(gallivm, z_value, 0, 2);
@@ -805,6 +986,7 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
  *
  * \param depth  the depth test state
  * \param stencil  the front/back stencil state
+ * \param dyn  the state to read at run time instead, or NULL
  * \param type  the data type of the fragment depth/stencil values
  * \param format_desc  description of the depth/stencil surface
  * \param mask  the alive/dead pixel mask for the quad (vector)
@@ -818,6 +1000,7 @@ void
 lp_build_depth_stencil_test(struct gallivm_state *gallivm,
                             const struct lp_depth_state *depth,
                             const struct pipe_stencil_state stencil[2],
+                            const struct lp_build_depth_dynamic *dyn,
                             struct lp_type z_src_type,
                             const struct util_format_description *format_desc,
                             struct lp_build_mask_context *mask,
@@ -1013,14 +1196,14 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
          }
       }
 
-      s_pass_mask = lp_build_stencil_test(&s_bld, stencil,
+      s_pass_mask = lp_build_stencil_test(&s_bld, stencil, dyn,
                                           stencil_refs, stencil_vals,
                                           front_facing);
 
       /* apply stencil-fail operator */
       {
          LLVMValueRef s_fail_mask = lp_build_andnot(&s_bld, current_mask, s_pass_mask);
-         stencil_vals = lp_build_stencil_op(&s_bld, stencil, S_FAIL_OP,
+         stencil_vals = lp_build_stencil_op(&s_bld, stencil, dyn, S_FAIL_OP,
                                             stencil_refs, stencil_vals,
                                             s_fail_mask, front_facing);
       }
@@ -1065,7 +1248,10 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
       lp_build_name(z_src, "z_src");
 
       /* compare src Z to dst Z, returning 'pass' mask */
-      z_pass = lp_build_cmp(&z_bld, depth->func, z_src, z_dst);
+      if (dyn)
+         z_pass = lp_build_cmp_dynamic(&z_bld, dyn->func, z_src, z_dst);
+      else
+         z_pass = lp_build_cmp(&z_bld, depth->func, z_src, z_dst);
 
       /* mask off bits that failed stencil test */
       if (s_pass_mask) {
@@ -1090,6 +1276,14 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
          /* mask off bits that failed Z test */
          z_pass_mask = LLVMBuildAnd(builder, current_mask, z_pass, "");
 
+         if (dyn) {
+            LLVMValueRef writemask =
+               LLVMBuildICmp(builder, LLVMIntNE, dyn->writemask,
+                             lp_build_const_int32(gallivm, 0), "");
+            z_pass_mask = LLVMBuildSelect(builder, writemask, z_pass_mask,
+                                          s_bld.zero, "");
+         }
+
          /* Mix the old and new Z buffer values.
           * z_dst[i] = zselectmask[i] ? z_src[i] : z_dst[i]
           */
@@ -1102,13 +1296,13 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
 
          /* apply Z-fail operator */
          z_fail_mask = lp_build_andnot(&s_bld, current_mask, z_pass);
-         stencil_vals = lp_build_stencil_op(&s_bld, stencil, Z_FAIL_OP,
+         stencil_vals = lp_build_stencil_op(&s_bld, stencil, dyn, Z_FAIL_OP,
                                             stencil_refs, stencil_vals,
                                             z_fail_mask, front_facing);
 
          /* apply Z-pass operator */
          z_pass_mask = LLVMBuildAnd(builder, current_mask, z_pass, "");
-         stencil_vals = lp_build_stencil_op(&s_bld, stencil, Z_PASS_OP,
+         stencil_vals = lp_build_stencil_op(&s_bld, stencil, dyn, Z_PASS_OP,
                                             stencil_refs, stencil_vals,
                                             z_pass_mask, front_facing);
       }
@@ -1117,7 +1311,7 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
        * passed the stencil test.
        */
       s_pass_mask = LLVMBuildAnd(builder, current_mask, s_pass_mask, "");
-      stencil_vals = lp_build_stencil_op(&s_bld, stencil, Z_PASS_OP,
+      stencil_vals = lp_build_stencil_op(&s_bld, stencil, dyn, Z_PASS_OP,
                                          stencil_refs, stencil_vals,
                                          s_pass_mask, front_facing);
    }
@@ -48,6 +48,33 @@ struct lp_type;
 struct lp_build_mask_context;
 
 
+/**
+ * Stencil state read at run time, as scalar i32 values.
+ */
+struct lp_build_stencil_dynamic
+{
+   LLVMValueRef func;
+   LLVMValueRef fail_op;
+   LLVMValueRef zfail_op;
+   LLVMValueRef zpass_op;
+   LLVMValueRef valuemask;
+   LLVMValueRef writemask;
+};
+
+
+/**
+ * Depth/stencil state which generic fragment shader variants read at run
+ * time.  The depth and stencil tests are enabled in their key whenever the
+ * depth/stencil buffer has depth or stencil, and these say what they do.
+ */
+struct lp_build_depth_dynamic
+{
+   LLVMValueRef func;
+   LLVMValueRef writemask;
+   struct lp_build_stencil_dynamic stencil[2];
+};
+
+
 struct lp_type
 lp_depth_type(const struct util_format_description *format_desc,
               unsigned length);
@@ -57,6 +84,7 @@ void
 lp_build_depth_stencil_test(struct gallivm_state *gallivm,
                             const struct lp_depth_state *depth,
                             const struct pipe_stencil_state stencil[2],
+                            const struct lp_build_depth_dynamic *dyn,
                             struct lp_type z_src_type,
                             const struct util_format_description *format_desc,
                             struct lp_build_mask_context *mask,
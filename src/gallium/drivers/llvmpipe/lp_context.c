@@ -38,8 +38,11 @@
 #include "util/u_memory.h"
 #include "util/list.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_threaded_context.h"
+#include "util/u_debug.h"
 #include "lp_clear.h"
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_perf.h"
 #include "lp_state.h"
@@ -59,8 +62,16 @@ llvmpipe_destroy(struct pipe_context *pipe)
    mtx_lock(&lp_screen->ctx_mutex);
    list_del(&llvmpipe->list);
    mtx_unlock(&lp_screen->ctx_mutex);
+
+   llvmpipe_cancel_fs_compiles(llvmpipe, NULL);
+   llvmpipe_finish_fs_compiles(llvmpipe, TRUE);
+   llvmpipe_finish_cs_compiles(llvmpipe, TRUE);
+
    lp_print_counters();
 
+   llvmpipe_release_retired_storage(llvmpipe, TRUE);
+   util_dynarray_fini(&llvmpipe->retired_storage);
+
    if (llvmpipe->csctx) {
       lp_csctx_destroy(llvmpipe->csctx);
    }
@@ -216,10 +227,14 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
    list_inithead(&llvmpipe->fs_variants_list.list);
+   list_inithead(&llvmpipe->fs_compile_jobs);
 
    list_inithead(&llvmpipe->setup_variants_list.list);
 
    list_inithead(&llvmpipe->cs_variants_list.list);
+   list_inithead(&llvmpipe->cs_compile_jobs);
+
+   util_dynarray_init(&llvmpipe->retired_storage, NULL);
 
    llvmpipe->pipe.screen = screen;
    llvmpipe->pipe.priv = priv;
@@ -328,6 +343,8 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    draw_wide_point_threshold(llvmpipe->draw, 10000.0);
    draw_wide_line_threshold(llvmpipe->draw, 10000.0);
 
+   draw_enable_vertex_cache(llvmpipe->draw, !(LP_PERF & PERF_NO_VCACHE));
+
    /* initial state for clipping - enabled, with no guardband */
    draw_set_driver_clipping(llvmpipe->draw, FALSE, FALSE, FALSE, TRUE);
 
@@ -342,7 +359,20 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    mtx_lock(&lp_screen->ctx_mutex);
    list_addtail(&llvmpipe->list, &lp_screen->ctx_list);
    mtx_unlock(&lp_screen->ctx_mutex);
-   return &llvmpipe->pipe;
+
+   /* The rasterizer threads already keep the cores busy, so only move
+    * state validation, vertex processing and binning to a driver thread
+    * when asked to.
+    */
+   if (!(flags & PIPE_CONTEXT_PREFER_THREADED) ||
+       !debug_get_bool_option("GALLIUM_THREAD", false))
+      return &llvmpipe->pipe;
+
+   return threaded_context_create(&llvmpipe->pipe,
+                                  &lp_screen->transfer_pool,
+                                  llvmpipe_replace_buffer_storage,
+                                  NULL, /* synchronous flushes */
+                                  NULL);
 
  fail:
    llvmpipe_destroy(&llvmpipe->pipe);
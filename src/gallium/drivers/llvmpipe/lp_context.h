@@ -35,6 +35,7 @@
 
 #include "draw/draw_vertex.h"
 #include "util/u_blitter.h"
+#include "util/u_dynarray.h"
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
@@ -109,6 +110,19 @@ struct llvmpipe_context {
 
    unsigned active_primgen_queries;
 
+   /** Counters for the driver specific queries, see lp_query.h */
+   struct {
+      uint64_t draws;
+      uint64_t draw_time;        /**< in nanoseconds, only while queried */
+      uint64_t fs_compiles;
+      uint64_t fs_compile_time;  /**< in microseconds */
+      uint64_t fs_compile_stalls;   /**< compiles done on the draw path */
+      uint64_t fs_async_compiles;
+      uint64_t fs_generic_draws;    /**< draws with a generic FS variant */
+      uint64_t fs_fallback_time;    /**< in microseconds */
+   } counters;
+   unsigned active_driver_queries;
+
    bool queries_disabled;
 
    unsigned dirty; /**< Mask of LP_NEW_x flags */
@@ -154,11 +168,25 @@ struct llvmpipe_context {
 
    unsigned tex_timestamp;
 
+   /** The screen timestamps when the draw module's vertex cache was
+    * last validated.
+    */
+   unsigned vcache_timestamp;
+   unsigned vcache_write_timestamp;
+
    /** List of all fragment shader variants */
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Fragment shader variants being compiled in the background */
+   struct list_head fs_compile_jobs;
+   /** The bound fragment shader variant is a generic stand-in */
+   boolean fs_generic;
+
+   /** Buffer storage replaced while in use, see lp_retired_storage */
+   struct util_dynarray retired_storage;
+
    boolean permit_linear_rasterizer;
    boolean single_vp;
 
@@ -171,6 +199,9 @@ struct llvmpipe_context {
    unsigned nr_cs_instrs;
    struct lp_cs_context *csctx;
 
+   /** Compute shader variants being optimized in the background */
+   struct list_head cs_compile_jobs;
+
    /** Conditional query object and mode */
    struct pipe_query *render_cond_query;
    enum pipe_render_cond_flag render_cond_mode;
@@ -28,10 +28,57 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
 
+/** Aim for this many chunks per thread, to balance uneven iterations */
+#define LP_CS_TPOOL_CHUNKS_PER_THREAD 4
+
+/**
+ * Run chunks of iterations of the task until all are claimed.
+ * Returns the number of iterations run.
+ */
+static unsigned
+lp_cs_tpool_run_task(struct lp_cs_tpool_task *task,
+                     struct lp_cs_local_mem *lmem)
+{
+   unsigned count = 0;
+
+   for (;;) {
+      unsigned start = p_atomic_fetch_add(&task->iter_next, task->iter_chunk);
+      if (start >= task->iter_total)
+         break;
+
+      unsigned end = MIN2(start + task->iter_chunk, task->iter_total);
+      for (unsigned i = start; i < end; i++)
+         task->work(task->data, i, lmem);
+      count += end - start;
+   }
+
+   return count;
+}
+
+/**
+ * Called with the pool mutex held once a thread ran out of iterations
+ * to claim from the task, having run 'count' of them.
+ */
+static void
+lp_cs_tpool_leave_task(struct lp_cs_tpool_task *task, unsigned count)
+{
+   if (list_is_linked(&task->list))
+      list_del(&task->list);
+
+   task->iter_finished += count;
+   task->active--;
+
+   if (task->iter_finished == task->iter_total && !task->active)
+      cnd_broadcast(&task->finish);
+}
+
 static int
 lp_cs_tpool_worker(void *data)
 {
@@ -42,8 +89,8 @@ lp_cs_tpool_worker(void *data)
    mtx_lock(&pool->m);
 
    while (!pool->shutdown) {
-      struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
+      struct lp_cs_tpool_task *task = NULL;
+      unsigned count;
 
       while (list_is_empty(&pool->workqueue) && !pool->shutdown)
          cnd_wait(&pool->new_work, &pool->m);
@@ -51,56 +98,62 @@ lp_cs_tpool_worker(void *data)
       if (pool->shutdown)
          break;
 
-      task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
-                              list);
-
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
+      /* Spread the threads over the queued tasks */
+      list_for_each_entry(struct lp_cs_tpool_task, t, &pool->workqueue, list) {
+         if (!task || t->active < task->active)
+            task = t;
       }
-
-      task->iter_start += iter_per_thread;
-
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
+      task->active++;
 
       mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
-
+      count = lp_cs_tpool_run_task(task, &lmem);
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
-         cnd_broadcast(&task->finish);
+
+      lp_cs_tpool_leave_task(task, count);
    }
    mtx_unlock(&pool->m);
    FREE(lmem.local_mem_ptr);
    return 0;
 }
 
+/**
+ * Create the pool.  If num_nodes is greater than one, the threads are
+ * spread evenly over that many NUMA nodes, in contiguous groups.
+ */
 struct lp_cs_tpool *
-lp_cs_tpool_create(unsigned num_threads)
+lp_cs_tpool_create(unsigned num_threads, unsigned num_nodes)
 {
    struct lp_cs_tpool *pool = CALLOC_STRUCT(lp_cs_tpool);
 
    if (!pool)
       return NULL;
 
+   if (num_threads) {
+      pool->threads = CALLOC(num_threads, sizeof(thrd_t));
+      if (!pool->threads) {
+         FREE(pool);
+         return NULL;
+      }
+   }
+
    (void) mtx_init(&pool->m, mtx_plain);
    cnd_init(&pool->new_work);
 
    list_inithead(&pool->workqueue);
-   assert (num_threads <= LP_MAX_THREADS);
    for (unsigned i = 0; i < num_threads; i++) {
       if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, pool)) {
          num_threads = i;  /* previous thread is max */
          break;
       }
+
+      if (num_nodes > 1) {
+         const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+         unsigned node = i * num_nodes / num_threads;
+
+         util_set_thread_affinity(pool->threads[i],
+                                  caps->node_affinity_mask[node],
+                                  NULL, caps->num_cpu_mask_bits);
+      }
    }
    pool->num_threads = num_threads;
    return pool;
@@ -123,6 +176,7 @@ lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
 
    cnd_destroy(&pool->new_work);
    mtx_destroy(&pool->m);
+   FREE(pool->threads);
    FREE(pool);
 }
 
@@ -150,9 +204,8 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
    task->work = work;
    task->data = data;
    task->iter_total = num_iters;
-
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   task->iter_chunk = MAX2(num_iters / ((pool->num_threads + 1) *
+                                        LP_CS_TPOOL_CHUNKS_PER_THREAD), 1);
 
    cnd_init(&task->finish);
 
@@ -171,11 +224,24 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
 {
    struct lp_cs_tpool_task *task = *task_handle;
 
+   struct lp_cs_local_mem lmem;
+   unsigned count;
+
    if (!pool || !task)
       return;
 
+   /* Help with the task rather than just wait for it */
+   memset(&lmem, 0, sizeof(lmem));
+   mtx_lock(&pool->m);
+   task->active++;
+   mtx_unlock(&pool->m);
+
+   count = lp_cs_tpool_run_task(task, &lmem);
+   FREE(lmem.local_mem_ptr);
+
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   lp_cs_tpool_leave_task(task, count);
+   while (task->iter_finished < task->iter_total || task->active)
       cnd_wait(&task->finish, &pool->m);
    mtx_unlock(&pool->m);
 
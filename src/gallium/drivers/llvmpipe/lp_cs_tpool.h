@@ -28,6 +28,10 @@
  * The item is added to the work queue once, but it must execute
  * number of iterations times. This saves storing a bunch of queue
  * structs with just unique indexes in them.
+ * Iterations are claimed in chunks with an atomic counter, so the pool
+ * mutex is only taken to find a task and when a thread is done with it.
+ * Every task in the queue is worked on, so independent tasks queued from
+ * several contexts run concurrently.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
  */
@@ -45,7 +49,7 @@ struct lp_cs_tpool {
    mtx_t m;
    cnd_t new_work;
 
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
    unsigned num_threads;
    struct list_head workqueue;
    bool shutdown;
@@ -64,13 +68,14 @@ struct lp_cs_tpool_task {
    struct list_head list;
    cnd_t finish;
    unsigned iter_total;
-   unsigned iter_start;
-   unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+   unsigned iter_chunk;      /**< iterations claimed at once */
+   unsigned iter_next;       /**< next unclaimed iteration, atomic */
+   unsigned iter_finished;   /**< protected by the pool mutex */
+   unsigned active;          /**< threads working on the task, ditto */
 };
 
-struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
+struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads,
+                                       unsigned num_nodes);
 void lp_cs_tpool_destroy(struct lp_cs_tpool *);
 
 struct lp_cs_tpool_task *lp_cs_tpool_queue_task(struct lp_cs_tpool *,
@@ -65,6 +65,9 @@
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
 #define PERF_NO_RAST_LINEAR 0x100  	/* disable linear rast */
 #define PERF_NO_SHADE       0x200  	/* disable fragment shaders */
+#define PERF_NO_HIZ         0x400  	/* disable hierarchical depth rejection */
+#define PERF_NO_VCACHE      0x800  	/* disable the post-transform vertex cache */
+#define PERF_INTERP_ONLY    0x1000  	/* interpret compute shaders, never compile */
 
 
 extern int LP_PERF;
@@ -35,14 +35,62 @@
 #include "pipe/p_context.h"
 #include "util/u_draw.h"
 #include "util/u_prim.h"
+#include "util/os_time.h"
+#include "util/perf/cpu_trace.h"
 
 #include "lp_context.h"
 #include "lp_state.h"
 #include "lp_query.h"
 
 #include "draw/draw_context.h"
+#include "lp_screen.h"
 
 
+/**
+ * Whether a draw may write to resources other than the framebuffer.
+ */
+static boolean
+llvmpipe_draw_writes_resources(const struct llvmpipe_context *lp)
+{
+   if (lp->num_so_targets || lp->fs_ssbo_write_mask)
+      return TRUE;
+
+   for (enum pipe_shader_type sh = 0; sh < PIPE_SHADER_COMPUTE; sh++) {
+      if (lp->num_images[sh])
+         return TRUE;
+
+      if (sh == PIPE_SHADER_FRAGMENT)
+         continue;
+
+      for (unsigned i = 0; i < ARRAY_SIZE(lp->ssbos[sh]); i++) {
+         if (lp->ssbos[sh][i].buffer)
+            return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+
+/**
+ * Whether a vertex buffer may be written through a persistent mapping,
+ * which doesn't bump the screen timestamp.
+ */
+static boolean
+llvmpipe_vertex_buffers_mapped(const struct llvmpipe_context *lp)
+{
+   for (unsigned i = 0; i < lp->num_vertex_buffers; i++) {
+      const struct pipe_vertex_buffer *vb = &lp->vertex_buffer[i];
+
+      if (!vb->is_user_buffer && vb->buffer.resource &&
+          (vb->buffer.resource->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                                         PIPE_RESOURCE_FLAG_MAP_COHERENT)))
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
 
 /**
  * Draw vertex arrays, with optional indexing, optional instancing.
@@ -60,6 +108,8 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
    if (!indirect && (!draws[0].count || !info->instance_count))
       return;
 
+   MESA_TRACE_FUNC();
+
    struct llvmpipe_context *lp = llvmpipe_context(pipe);
    struct draw_context *draw = lp->draw;
    const void *mapped_indices = NULL;
@@ -68,14 +118,41 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
    if (!llvmpipe_check_render_cond(lp))
       return;
 
+   /* util_draw_indirect() comes back here for each of the draws */
    if (indirect && indirect->buffer) {
       util_draw_indirect(pipe, info, indirect);
       return;
    }
 
+   int64_t start = 0;
+   if (unlikely(lp->active_driver_queries))
+      start = os_time_get_nano();
+   lp->counters.draws++;
+
+   /* Swap in the fragment shader variants compiled in the background */
+   if (!list_is_empty(&lp->fs_compile_jobs))
+      llvmpipe_finish_fs_compiles(lp, FALSE);
+
    if (lp->dirty)
       llvmpipe_update_derived(lp);
 
+   if (lp->fs_generic)
+      lp->counters.fs_generic_draws++;
+
+   /* Vertices the draw module shaded earlier can only be reused as long
+    * as nothing wrote to the buffers they came from.  Nothing tells when
+    * persistently mapped buffers are written, so vertices from those are
+    * never kept across draws.
+    */
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   if (lp->vcache_timestamp != screen->timestamp ||
+       lp->vcache_write_timestamp != screen->write_timestamp ||
+       llvmpipe_vertex_buffers_mapped(lp)) {
+      draw_invalidate_vertex_cache(draw);
+      lp->vcache_timestamp = screen->timestamp;
+      lp->vcache_write_timestamp = screen->write_timestamp;
+   }
+
    /*
     * Map vertex buffers
     */
@@ -184,6 +261,12 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
     * internally when this condition is seen?)
     */
    draw_flush(draw);
+
+   if (llvmpipe_draw_writes_resources(lp))
+      p_atomic_inc(&screen->write_timestamp);
+
+   if (unlikely(start))
+      lp->counters.draw_time += os_time_get_nano() - start;
 }
 
 
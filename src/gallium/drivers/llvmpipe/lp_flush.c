@@ -41,6 +41,7 @@
 #include "lp_fence.h"
 #include "lp_screen.h"
 #include "lp_rast.h"
+#include "lp_texture.h"
 
 
 /**
@@ -66,6 +67,8 @@ llvmpipe_flush(struct pipe_context *pipe,
    if (fence && (!*fence))
       *fence = (struct pipe_fence_handle *)lp_fence_create(0);
 
+   llvmpipe_release_retired_storage(llvmpipe, FALSE);
+
    /* Enable to dump BMPs of the color/depth buffers each frame */
    if (0) {
       static unsigned frame_no = 1;
@@ -240,6 +240,8 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       elem_types[LP_JIT_CTX_ANISO_FILTER_TABLE] = LLVMPointerType(LLVMFloatTypeInContext(lc), 0);
       elem_types[LP_JIT_CTX_SSBOS] =
          LLVMArrayType(buffer_type, LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CTX_DYNAMIC_STATE] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_JIT_DYN_COUNT);
       context_type = LLVMStructTypeInContext(lc, elem_types,
                                              ARRAY_SIZE(elem_types), 0);
 
@@ -282,6 +284,9 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, aniso_filter_table,
                              gallivm->target, context_type,
                              LP_JIT_CTX_ANISO_FILTER_TABLE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, dynamic_state,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_DYNAMIC_STATE);
       LP_CHECK_STRUCT_SIZE(struct lp_jit_context,
                            gallivm->target, context_type);
 
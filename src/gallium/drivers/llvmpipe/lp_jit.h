@@ -141,6 +141,42 @@ enum {
 };
 
 
+/**
+ * The fixed function state which generic fragment shader variants read at
+ * run time rather than from their key, see make_generic_key().  Each word
+ * packs the fields of the LP_JIT_DYN_*_SHIFT values below.
+ */
+enum {
+   LP_JIT_DYN_DEPTH = 0,         /**< depth and alpha test */
+   LP_JIT_DYN_STENCIL_FRONT,
+   LP_JIT_DYN_STENCIL_BACK,
+   LP_JIT_DYN_BLEND,             /**< one word per colour buffer */
+   LP_JIT_DYN_COUNT = LP_JIT_DYN_BLEND + PIPE_MAX_COLOR_BUFS
+};
+
+/* LP_JIT_DYN_DEPTH */
+#define LP_JIT_DYN_DEPTH_FUNC_SHIFT       0   /**< PIPE_FUNC_x */
+#define LP_JIT_DYN_DEPTH_WRITEMASK_SHIFT  3   /**< 1 bit */
+#define LP_JIT_DYN_ALPHA_FUNC_SHIFT       4   /**< PIPE_FUNC_x */
+
+/* LP_JIT_DYN_STENCIL_FRONT/BACK */
+#define LP_JIT_DYN_STENCIL_FUNC_SHIFT       0   /**< PIPE_FUNC_x */
+#define LP_JIT_DYN_STENCIL_FAIL_OP_SHIFT    3   /**< PIPE_STENCIL_OP_x */
+#define LP_JIT_DYN_STENCIL_ZFAIL_OP_SHIFT   6
+#define LP_JIT_DYN_STENCIL_ZPASS_OP_SHIFT   9
+#define LP_JIT_DYN_STENCIL_VALUEMASK_SHIFT  12  /**< 8 bits */
+#define LP_JIT_DYN_STENCIL_WRITEMASK_SHIFT  20  /**< 8 bits */
+
+/* LP_JIT_DYN_BLEND */
+#define LP_JIT_DYN_BLEND_RGB_FUNC_SHIFT    0   /**< PIPE_BLEND_x */
+#define LP_JIT_DYN_BLEND_RGB_SRC_SHIFT     3   /**< PIPE_BLENDFACTOR_x */
+#define LP_JIT_DYN_BLEND_RGB_DST_SHIFT     8
+#define LP_JIT_DYN_BLEND_ALPHA_FUNC_SHIFT  13
+#define LP_JIT_DYN_BLEND_ALPHA_SRC_SHIFT   16
+#define LP_JIT_DYN_BLEND_ALPHA_DST_SHIFT   21
+#define LP_JIT_DYN_BLEND_COLORMASK_SHIFT   26  /**< 4 bits */
+
+
 /**
  * This structure is passed directly to the generated fragment shader.
  *
@@ -174,6 +210,9 @@ struct lp_jit_context
    uint32_t sample_mask;
 
    const float *aniso_filter_table;
+
+   /** Fixed function state of generic variants, LP_JIT_DYN_x words */
+   uint32_t dynamic_state[LP_JIT_DYN_COUNT];
 };
 
 
@@ -195,6 +234,7 @@ enum {
    LP_JIT_CTX_SSBOS,
    LP_JIT_CTX_SAMPLE_MASK,
    LP_JIT_CTX_ANISO_FILTER_TABLE,
+   LP_JIT_CTX_DYNAMIC_STATE,
    LP_JIT_CTX_COUNT
 };
 
@@ -238,6 +278,9 @@ enum {
 #define lp_jit_context_aniso_filter_table(_gallivm, _type, _ptr) \
    lp_build_struct_get2(_gallivm, _type, _ptr, LP_JIT_CTX_ANISO_FILTER_TABLE, "aniso_filter_table")
 
+#define lp_jit_context_dynamic_state(_gallivm, _type, _ptr) \
+   lp_build_struct_get_ptr2(_gallivm, _type, _ptr, LP_JIT_CTX_DYNAMIC_STATE, "dynamic_state")
+
 
 struct lp_jit_thread_data
 {
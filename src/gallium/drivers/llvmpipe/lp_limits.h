@@ -66,7 +66,19 @@
 
 #define LP_MAX_SAMPLES 4
 
-#define LP_MAX_THREADS 32
+/**
+ * Upper bound the LP_NUM_THREADS, LP_NUM_BIN_THREADS and
+ * LP_NUM_COMPILE_THREADS options are clamped to.  Nothing is sized by it,
+ * the per thread state, queues and queries follow the actual thread
+ * counts.
+ */
+#define LP_MAX_THREADS 256
+
+/**
+ * Max number of NUMA nodes the rasterizer and compute threads are spread
+ * over.  Threads aren't pinned on machines with more nodes than this.
+ */
+#define LP_MAX_NODES 16
 
 
 /**
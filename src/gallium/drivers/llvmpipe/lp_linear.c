@@ -119,9 +119,11 @@ lp_fs_linear_run(const struct lp_rast_state *state,
    struct lp_jit_linear_context jit;
    jit.constants = (const uint8_t (*)[4])constants;
 
-   /* We assume BGRA ordering */
-   assert(variant->key.cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM ||
-          variant->key.cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM);
+   /* We assume BGRA ordering.  Other formats are converted from and to
+    * bgra8 around the call, see lp_rast_linear.c.
+    */
+   assert(lp_linear_check_cbuf_format(variant->key.cbuf_format[0],
+                                      variant->opaque));
 
    jit.blend_color =
          state->jit_context.u8_blend_color[32] +
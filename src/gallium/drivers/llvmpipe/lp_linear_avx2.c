@@ -0,0 +1,471 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/*
+ * AVX2 versions of the linear path kernels, compiled with -mavx2 and
+ * selected at runtime.
+ *
+ * These process eight bgra8 pixels where the SSE2 code in
+ * lp_linear_sampler.c, lp_linear_interp.c, lp_state_fs_linear.c and
+ * lp_linear_format.c processes four, doing the same arithmetic so that
+ * the results are identical.  Most 256 bit integer instructions operate
+ * on two independent 128 bit halves, so pixels come out of
+ * unpack/pack sequences in the same order as with SSE2.
+ */
+
+
+#include <immintrin.h>
+
+#include "util/detect.h"
+
+#include "util/u_math.h"
+#include "util/u_sse.h"
+
+#include "lp_jit.h"
+#include "lp_debug.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
+
+
+#define FIXED16_SHIFT  16
+
+
+/* See lp_linear_format.c */
+#define CONVERT_ROW(name, kernel, n, dst_bytes, src_bytes)              \
+static void                                                             \
+name(void *dst, const void *src, unsigned width)                        \
+{                                                                       \
+   uint8_t *d = dst;                                                    \
+   const uint8_t *s = src;                                              \
+   unsigned i;                                                          \
+                                                                        \
+   for (i = 0; i + (n) <= width; i += (n))                              \
+      kernel(d + i * (dst_bytes), s + i * (src_bytes));                 \
+                                                                        \
+   if (i < width) {                                                     \
+      alignas(32) uint8_t tmp_dst[(n) * (dst_bytes)];                   \
+      alignas(32) uint8_t tmp_src[(n) * (src_bytes)] = { 0 };           \
+      memcpy(tmp_src, s + i * (src_bytes), (width - i) * (src_bytes));  \
+      kernel(tmp_dst, tmp_src);                                         \
+      memcpy(d + i * (dst_bytes), tmp_dst, (width - i) * (dst_bytes));  \
+   }                                                                    \
+}
+
+
+static inline __m256i
+loadu(const void *p)
+{
+   return _mm256_loadu_si256((const __m256i *)p);
+}
+
+
+static inline void
+storeu(void *p, __m256i v)
+{
+   _mm256_storeu_si256((__m256i *)p, v);
+}
+
+
+/* x / 255, rounded to nearest, for x in [0, 255 * 255] */
+static inline __m256i
+div_255_epi16(__m256i x)
+{
+   x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+   return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+
+/* (1-w)*a + w*b, see util_sse2_lerp_epi16() */
+static inline __m256i
+lerp_epi16(__m256i w, __m256i a, __m256i b)
+{
+   __m256i res = _mm256_sub_epi16(b, a);
+   res = _mm256_mullo_epi16(res, w);
+   res = _mm256_srli_epi16(res, 8);
+   return _mm256_add_epi8(res, a);
+}
+
+
+static inline __m256i
+swap_rb_8(__m256i p)
+{
+   const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                            10, 9, 8, 11, 14, 13, 12, 15,
+                                            2, 1, 0, 3, 6, 5, 4, 7,
+                                            10, 9, 8, 11, 14, 13, 12, 15);
+   return _mm256_shuffle_epi8(p, shuffle);
+}
+
+
+static inline void
+swap_rb(uint8_t *dst, const uint8_t *src)
+{
+   storeu(dst, swap_rb_8(loadu(src)));
+}
+
+
+static inline void
+swap_rb_set_alpha(uint8_t *dst, const uint8_t *src)
+{
+   storeu(dst, _mm256_or_si256(swap_rb_8(loadu(src)),
+                               _mm256_set1_epi32(0xff000000)));
+}
+
+
+static inline void
+set_alpha(uint8_t *dst, const uint8_t *src)
+{
+   storeu(dst, _mm256_or_si256(loadu(src), _mm256_set1_epi32(0xff000000)));
+}
+
+
+/* Sixteen b5g6r5 pixels to bgra8 */
+static inline void
+unpack_b5g6r5(uint8_t *dst, const uint8_t *src)
+{
+   const __m256i p = loadu(src);
+   const __m256i mask5 = _mm256_set1_epi16(0x1f);
+   const __m256i mask6 = _mm256_set1_epi16(0x3f);
+
+   __m256i b = _mm256_and_si256(p, mask5);
+   __m256i g = _mm256_and_si256(_mm256_srli_epi16(p, 5), mask6);
+   __m256i r = _mm256_srli_epi16(p, 11);
+
+   b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+   g = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+   r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+
+   const __m256i bg = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+   const __m256i ra = _mm256_or_si256(r, _mm256_set1_epi16(0xff00));
+
+   /* pixels 0-3 and 8-11, 4-7 and 12-15 */
+   const __m256i lo = _mm256_unpacklo_epi16(bg, ra);
+   const __m256i hi = _mm256_unpackhi_epi16(bg, ra);
+
+   storeu(dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+   storeu(dst + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+
+/* Sixteen bgra8 pixels to b5g6r5 */
+static inline void
+pack_b5g6r5(uint8_t *dst, const uint8_t *src)
+{
+   const __m256i lo = loadu(src);
+   const __m256i hi = loadu(src + 32);
+   const __m256i mask8 = _mm256_set1_epi32(0xff);
+
+   /* 16 bit channels of pixels 0-3, 8-11, 4-7, 12-15 */
+   __m256i b = _mm256_packs_epi32(_mm256_and_si256(lo, mask8),
+                                  _mm256_and_si256(hi, mask8));
+   __m256i g = _mm256_packs_epi32(
+      _mm256_and_si256(_mm256_srli_epi32(lo, 8), mask8),
+      _mm256_and_si256(_mm256_srli_epi32(hi, 8), mask8));
+   __m256i r = _mm256_packs_epi32(
+      _mm256_and_si256(_mm256_srli_epi32(lo, 16), mask8),
+      _mm256_and_si256(_mm256_srli_epi32(hi, 16), mask8));
+
+   b = div_255_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(31)));
+   g = div_255_epi16(_mm256_mullo_epi16(g, _mm256_set1_epi16(63)));
+   r = div_255_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(31)));
+
+   __m256i p = _mm256_or_si256(b, _mm256_slli_epi16(g, 5));
+   p = _mm256_or_si256(p, _mm256_slli_epi16(r, 11));
+
+   storeu(dst, _mm256_permute4x64_epi64(p, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+
+/* Eight bgra8 pixels to 10.10.10.2, see lp_linear_format.c */
+static inline __m256i
+pack_10_10_10_2_8(__m256i p, boolean bgr)
+{
+   const __m256i mask8 = _mm256_set1_epi32(0xff);
+
+   __m256i b = _mm256_and_si256(p, mask8);
+   __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask8);
+   __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask8);
+   __m256i a = _mm256_srli_epi32(p, 24);
+
+   b = _mm256_or_si256(_mm256_slli_epi32(b, 2), _mm256_srli_epi32(b, 6));
+   g = _mm256_or_si256(_mm256_slli_epi32(g, 2), _mm256_srli_epi32(g, 6));
+   r = _mm256_or_si256(_mm256_slli_epi32(r, 2), _mm256_srli_epi32(r, 6));
+
+   a = _mm256_add_epi32(a, _mm256_add_epi32(a, a));
+   a = div_255_epi16(a);
+
+   __m256i res = _mm256_or_si256(_mm256_slli_epi32(g, 10),
+                                 _mm256_slli_epi32(a, 30));
+   if (bgr) {
+      res = _mm256_or_si256(res, b);
+      res = _mm256_or_si256(res, _mm256_slli_epi32(r, 20));
+   } else {
+      res = _mm256_or_si256(res, r);
+      res = _mm256_or_si256(res, _mm256_slli_epi32(b, 20));
+   }
+   return res;
+}
+
+
+static inline void
+pack_r10g10b10a2(uint8_t *dst, const uint8_t *src)
+{
+   storeu(dst, pack_10_10_10_2_8(loadu(src), FALSE));
+}
+
+
+static inline void
+pack_b10g10r10a2(uint8_t *dst, const uint8_t *src)
+{
+   storeu(dst, pack_10_10_10_2_8(loadu(src), TRUE));
+}
+
+
+CONVERT_ROW(convert_swap_rb, swap_rb, 8, 4, 4)
+CONVERT_ROW(convert_swap_rb_set_alpha, swap_rb_set_alpha, 8, 4, 4)
+CONVERT_ROW(convert_set_alpha, set_alpha, 8, 4, 4)
+CONVERT_ROW(convert_unpack_b5g6r5, unpack_b5g6r5, 16, 4, 2)
+CONVERT_ROW(convert_pack_b5g6r5, pack_b5g6r5, 16, 2, 4)
+CONVERT_ROW(convert_pack_r10g10b10a2, pack_r10g10b10a2, 8, 4, 4)
+CONVERT_ROW(convert_pack_b10g10r10a2, pack_b10g10r10a2, 8, 4, 4)
+
+
+const struct lp_linear_format
+lp_linear_formats_avx2[] = {
+   { PIPE_FORMAT_B8G8R8A8_UNORM, 4, NULL, NULL },
+   { PIPE_FORMAT_B8G8R8X8_UNORM, 4, convert_set_alpha, NULL },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, 4, convert_swap_rb, convert_swap_rb },
+   { PIPE_FORMAT_R8G8B8X8_UNORM, 4, convert_swap_rb_set_alpha,
+     convert_swap_rb },
+   { PIPE_FORMAT_B5G6R5_UNORM, 2, convert_unpack_b5g6r5,
+     convert_pack_b5g6r5 },
+   { PIPE_FORMAT_R10G10B10A2_UNORM, 4, NULL, convert_pack_r10g10b10a2 },
+   { PIPE_FORMAT_B10G10R10A2_UNORM, 4, NULL, convert_pack_b10g10r10a2 },
+   { PIPE_FORMAT_NONE, 0, NULL, NULL },
+};
+
+
+/* Interpolate in 1.15 space, but produce a packed row of 0.8 values.
+ * See interp_0_8() in lp_linear_interp.c.
+ */
+const uint32_t *
+lp_linear_interp_0_8_avx2(struct lp_linear_elem *elem)
+{
+   struct lp_linear_interp *interp = (struct lp_linear_interp *)elem;
+   uint32_t *row = interp->row;
+   const int width = (interp->width + 3) & ~3;
+
+   /* a0 holds two pixels and dadx steps by two pixels */
+   const __m128i a0 = interp->a0;
+   const __m128i a1 = _mm_add_epi16(a0, interp->dadx);
+   __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(a0), a1, 1);
+   const __m256i dadx =
+      _mm256_broadcastsi128_si256(_mm_add_epi16(interp->dadx, interp->dadx));
+
+   int i;
+   for (i = 0; i + 8 <= width; i += 8) {
+      __m256i l = _mm256_srai_epi16(a, 7);  // pixels 0,1 | 2,3
+      a = _mm256_add_epi16(a, dadx);
+      __m256i h = _mm256_srai_epi16(a, 7);  // pixels 4,5 | 6,7
+      a = _mm256_add_epi16(a, dadx);
+
+      __m256i p = _mm256_packus_epi16(l, h);
+      storeu(&row[i], _mm256_permute4x64_epi64(p, _MM_SHUFFLE(3, 1, 2, 0)));
+   }
+
+   if (i < width) {
+      __m128i l = _mm_srai_epi16(_mm256_castsi256_si128(a), 7);
+      __m128i h = _mm_srai_epi16(_mm256_extracti128_si256(a, 1), 7);
+      _mm_store_si128((__m128i *)&row[i], _mm_packus_epi16(l, h));
+   }
+
+   // advance to next row
+   interp->a0 = _mm_add_epi16(interp->a0, interp->dady);
+   return interp->row;
+}
+
+
+/* Clamped, non-axis-aligned linear filtering, using gathers to fetch
+ * the texels.  See fetch_bgra_clamp_linear() in lp_linear_sampler.c.
+ */
+const uint32_t *
+lp_linear_fetch_bgra_clamp_linear_avx2(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const struct lp_jit_texture *texture = samp->texture;
+   const int *data = (const int *)texture->base;
+   const int stride = texture->row_stride[0] / sizeof(uint32_t);
+   const int width = samp->width;
+   uint32_t *row = samp->row;
+
+   const __m256i steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   __m256i s8 = _mm256_add_epi32(_mm256_set1_epi32(samp->s),
+                   _mm256_mullo_epi32(steps, _mm256_set1_epi32(samp->dsdx)));
+   __m256i t8 = _mm256_add_epi32(_mm256_set1_epi32(samp->t),
+                   _mm256_mullo_epi32(steps, _mm256_set1_epi32(samp->dtdx)));
+   const __m256i dsdx8 = _mm256_set1_epi32(8 * samp->dsdx);
+   const __m256i dtdx8 = _mm256_set1_epi32(8 * samp->dtdx);
+   const __m256i stride8 = _mm256_set1_epi32(stride);
+   const __m256i w8 = _mm256_set1_epi32(texture->width - 1);
+   const __m256i h8 = _mm256_set1_epi32(texture->height - 1);
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i one = _mm256_set1_epi32(1);
+   const __m256i mask8 = _mm256_set1_epi32(0xff);
+
+   /* The row has room for 64 pixels, so may be filled up to a multiple
+    * of eight.
+    */
+   for (int i = 0; i < width; i += 8) {
+      const __m256i s8s = _mm256_srai_epi32(s8, FIXED16_SHIFT);
+      const __m256i t8s = _mm256_srai_epi32(t8, FIXED16_SHIFT);
+      const __m256i cs0 = _mm256_min_epi32(_mm256_max_epi32(s8s, zero), w8);
+      const __m256i cs1 = _mm256_min_epi32(
+         _mm256_max_epi32(_mm256_add_epi32(s8s, one), zero), w8);
+      const __m256i ct0 = _mm256_min_epi32(_mm256_max_epi32(t8s, zero), h8);
+      const __m256i ct1 = _mm256_min_epi32(
+         _mm256_max_epi32(_mm256_add_epi32(t8s, one), zero), h8);
+      const __m256i row0 = _mm256_mullo_epi32(ct0, stride8);
+      const __m256i row1 = _mm256_mullo_epi32(ct1, stride8);
+
+      const __m256i si0 =
+         _mm256_i32gather_epi32(data, _mm256_add_epi32(row0, cs0), 4);
+      const __m256i si1 =
+         _mm256_i32gather_epi32(data, _mm256_add_epi32(row0, cs1), 4);
+      const __m256i si2 =
+         _mm256_i32gather_epi32(data, _mm256_add_epi32(row1, cs0), 4);
+      const __m256i si3 =
+         _mm256_i32gather_epi32(data, _mm256_add_epi32(row1, cs1), 4);
+
+      __m256i ws = _mm256_and_si256(_mm256_srli_epi32(s8, 8), mask8);
+      __m256i wt = _mm256_and_si256(_mm256_srli_epi32(t8, 8), mask8);
+
+      s8 = _mm256_add_epi32(s8, dsdx8);
+      t8 = _mm256_add_epi32(t8, dtdx8);
+
+      /* 8.8 weights, for the pixels in the low and high halves of
+       * each 128 bit lane.
+       */
+      ws = _mm256_or_si256(ws, _mm256_slli_epi32(ws, 16));
+      const __m256i wsl = _mm256_shuffle_epi32(ws, _MM_SHUFFLE(1,1,0,0));
+      const __m256i wsh = _mm256_shuffle_epi32(ws, _MM_SHUFFLE(3,3,2,2));
+
+      wt = _mm256_or_si256(wt, _mm256_slli_epi32(wt, 16));
+      const __m256i wtl = _mm256_shuffle_epi32(wt, _MM_SHUFFLE(1,1,0,0));
+      const __m256i wth = _mm256_shuffle_epi32(wt, _MM_SHUFFLE(3,3,2,2));
+
+      /* Same order of operations as util_sse2_lerp_2d_epi8_fixed88():
+       * first along t, then along s.
+       */
+      const __m256i dst02_lo =
+         lerp_epi16(wtl, _mm256_unpacklo_epi8(si0, zero),
+                         _mm256_unpacklo_epi8(si2, zero));
+      const __m256i dst02_hi =
+         lerp_epi16(wth, _mm256_unpackhi_epi8(si0, zero),
+                         _mm256_unpackhi_epi8(si2, zero));
+      const __m256i dst13_lo =
+         lerp_epi16(wtl, _mm256_unpacklo_epi8(si1, zero),
+                         _mm256_unpacklo_epi8(si3, zero));
+      const __m256i dst13_hi =
+         lerp_epi16(wth, _mm256_unpackhi_epi8(si1, zero),
+                         _mm256_unpackhi_epi8(si3, zero));
+
+      const __m256i dst_lo = lerp_epi16(wsl, dst02_lo, dst13_lo);
+      const __m256i dst_hi = lerp_epi16(wsh, dst02_hi, dst13_hi);
+
+      storeu(&row[i], _mm256_packus_epi16(dst_lo, dst_hi));
+   }
+
+   samp->s += samp->dsdy;
+   samp->t += samp->dtdy;
+
+   return row;
+}
+
+
+/* Combine two rows with a constant 8.8 weight, as in
+ * fetch_bgra_axis_aligned_linear().
+ */
+int
+lp_linear_lerp_rows_avx2(uint32_t *dst,
+                         const uint32_t *src0,
+                         const uint32_t *src1,
+                         int weight,
+                         int width)
+{
+   const __m256i w = _mm256_set1_epi16(weight);
+   const __m256i zero = _mm256_setzero_si256();
+   int i;
+
+   for (i = 0; i + 8 <= width; i += 8) {
+      const __m256i a = loadu(&src0[i]);
+      const __m256i b = loadu(&src1[i]);
+
+      const __m256i lo = lerp_epi16(w, _mm256_unpacklo_epi8(a, zero),
+                                       _mm256_unpacklo_epi8(b, zero));
+      const __m256i hi = lerp_epi16(w, _mm256_unpackhi_epi8(a, zero),
+                                       _mm256_unpackhi_epi8(b, zero));
+
+      storeu(&dst[i], _mm256_packus_epi16(lo, hi));
+   }
+
+   return i;
+}
+
+
+/* Premultiplied alpha blending of a row, see util_sse2_blend_premul_4().
+ */
+int
+lp_linear_blend_premul_avx2(uint32_t *dst,
+                            const uint32_t *src,
+                            int width)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   int i;
+
+   for (i = 0; i + 8 <= width; i += 8) {
+      const __m256i s = loadu(&src[i]);
+      const __m256i d = loadu(&dst[i]);
+      __m256i res[2];
+
+      for (unsigned j = 0; j < 2; j++) {
+         const __m256i sj = j ? _mm256_unpackhi_epi8(s, zero)
+                              : _mm256_unpacklo_epi8(s, zero);
+         const __m256i dj = j ? _mm256_unpackhi_epi8(d, zero)
+                              : _mm256_unpacklo_epi8(d, zero);
+
+         __m256i a = _mm256_shufflehi_epi16(sj, 0xff);
+         a = _mm256_shufflelo_epi16(a, 0xff);
+
+         /* s + d - d * a */
+         const __m256i da = _mm256_srli_epi16(_mm256_mullo_epi16(dj, a), 8);
+         res[j] = _mm256_add_epi16(sj, _mm256_sub_epi16(dj, da));
+      }
+
+      storeu(&dst[i], _mm256_packus_epi16(res[0], res[1]));
+   }
+
+   return i;
+}
@@ -0,0 +1,311 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/*
+ * Conversion of colour buffer and texture rows to and from the bgra8
+ * layout which the linear shaders operate on.
+ *
+ * Widening conversions replicate the high bits, narrowing ones round to
+ * nearest, so that the results are the same as those of util_format.
+ */
+
+
+#include "util/detect.h"
+
+#include "util/u_math.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_sse.h"
+
+#include "lp_jit.h"
+#include "lp_debug.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
+
+
+#if DETECT_ARCH_SSE
+
+
+/* Run a conversion kernel, which converts N pixels at a time, over a
+ * row.  The remainder of the row goes through a temporary.
+ */
+#define CONVERT_ROW(name, kernel, n, dst_bytes, src_bytes)              \
+static void                                                             \
+name(void *dst, const void *src, unsigned width)                        \
+{                                                                       \
+   uint8_t *d = dst;                                                    \
+   const uint8_t *s = src;                                              \
+   unsigned i;                                                          \
+                                                                        \
+   for (i = 0; i + (n) <= width; i += (n))                              \
+      kernel(d + i * (dst_bytes), s + i * (src_bytes));                 \
+                                                                        \
+   if (i < width) {                                                     \
+      alignas(16) uint8_t tmp_dst[(n) * (dst_bytes)];                   \
+      alignas(16) uint8_t tmp_src[(n) * (src_bytes)] = { 0 };           \
+      memcpy(tmp_src, s + i * (src_bytes), (width - i) * (src_bytes));  \
+      kernel(tmp_dst, tmp_src);                                         \
+      memcpy(d + i * (dst_bytes), tmp_dst, (width - i) * (dst_bytes));  \
+   }                                                                    \
+}
+
+
+/* x / 255, rounded to nearest, for x in [0, 255 * 255] */
+static inline __m128i
+div_255_epi16(__m128i x)
+{
+   x = _mm_add_epi16(x, _mm_set1_epi16(128));
+   return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+
+static inline __m128i
+swap_rb_4(__m128i p)
+{
+   const __m128i ga = _mm_set1_epi32(0xff00ff00);
+   __m128i rb = _mm_andnot_si128(ga, p);
+
+   rb = _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16));
+   return _mm_or_si128(_mm_and_si128(p, ga), rb);
+}
+
+
+static inline void
+swap_rb(uint8_t *dst, const uint8_t *src)
+{
+   __m128i p = _mm_loadu_si128((const __m128i *)src);
+   _mm_storeu_si128((__m128i *)dst, swap_rb_4(p));
+}
+
+
+static inline void
+swap_rb_set_alpha(uint8_t *dst, const uint8_t *src)
+{
+   __m128i p = _mm_loadu_si128((const __m128i *)src);
+   p = _mm_or_si128(swap_rb_4(p), _mm_set1_epi32(0xff000000));
+   _mm_storeu_si128((__m128i *)dst, p);
+}
+
+
+static inline void
+set_alpha(uint8_t *dst, const uint8_t *src)
+{
+   __m128i p = _mm_loadu_si128((const __m128i *)src);
+   p = _mm_or_si128(p, _mm_set1_epi32(0xff000000));
+   _mm_storeu_si128((__m128i *)dst, p);
+}
+
+
+/* Eight b5g6r5 pixels to bgra8 */
+static inline void
+unpack_b5g6r5(uint8_t *dst, const uint8_t *src)
+{
+   const __m128i p = _mm_loadu_si128((const __m128i *)src);
+   const __m128i mask5 = _mm_set1_epi16(0x1f);
+   const __m128i mask6 = _mm_set1_epi16(0x3f);
+
+   __m128i b = _mm_and_si128(p, mask5);
+   __m128i g = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+   __m128i r = _mm_srli_epi16(p, 11);
+
+   b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+   g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+   r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+
+   const __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+   const __m128i ra = _mm_or_si128(r, _mm_set1_epi16(0xff00));
+
+   _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(bg, ra));
+   _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(bg, ra));
+}
+
+
+/* Eight bgra8 pixels to b5g6r5 */
+static inline void
+pack_b5g6r5(uint8_t *dst, const uint8_t *src)
+{
+   const __m128i lo = _mm_loadu_si128((const __m128i *)src);
+   const __m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+   const __m128i mask8 = _mm_set1_epi32(0xff);
+
+   /* 16 bit channels, the packs don't saturate */
+   __m128i b = _mm_packs_epi32(_mm_and_si128(lo, mask8),
+                               _mm_and_si128(hi, mask8));
+   __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask8),
+                               _mm_and_si128(_mm_srli_epi32(hi, 8), mask8));
+   __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask8),
+                               _mm_and_si128(_mm_srli_epi32(hi, 16), mask8));
+
+   b = div_255_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(31)));
+   g = div_255_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(63)));
+   r = div_255_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(31)));
+
+   __m128i p = _mm_or_si128(b, _mm_slli_epi16(g, 5));
+   p = _mm_or_si128(p, _mm_slli_epi16(r, 11));
+
+   _mm_storeu_si128((__m128i *)dst, p);
+}
+
+
+/* Four bgra8 pixels to 10.10.10.2, with the channel in the low bits
+ * first either red (rgb10a2) or blue (bgr10a2).
+ */
+static inline __m128i
+pack_10_10_10_2_4(__m128i p, boolean bgr)
+{
+   const __m128i mask8 = _mm_set1_epi32(0xff);
+
+   __m128i b = _mm_and_si128(p, mask8);
+   __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask8);
+   __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), mask8);
+   __m128i a = _mm_srli_epi32(p, 24);
+
+   b = _mm_or_si128(_mm_slli_epi32(b, 2), _mm_srli_epi32(b, 6));
+   g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 6));
+   r = _mm_or_si128(_mm_slli_epi32(r, 2), _mm_srli_epi32(r, 6));
+
+   /* a * 3 / 255, the high halves of the lanes stay zero */
+   a = _mm_add_epi32(a, _mm_add_epi32(a, a));
+   a = div_255_epi16(a);
+
+   __m128i res = _mm_or_si128(_mm_slli_epi32(g, 10), _mm_slli_epi32(a, 30));
+   if (bgr) {
+      res = _mm_or_si128(res, b);
+      res = _mm_or_si128(res, _mm_slli_epi32(r, 20));
+   } else {
+      res = _mm_or_si128(res, r);
+      res = _mm_or_si128(res, _mm_slli_epi32(b, 20));
+   }
+   return res;
+}
+
+
+static inline void
+pack_r10g10b10a2(uint8_t *dst, const uint8_t *src)
+{
+   __m128i p = _mm_loadu_si128((const __m128i *)src);
+   _mm_storeu_si128((__m128i *)dst, pack_10_10_10_2_4(p, FALSE));
+}
+
+
+static inline void
+pack_b10g10r10a2(uint8_t *dst, const uint8_t *src)
+{
+   __m128i p = _mm_loadu_si128((const __m128i *)src);
+   _mm_storeu_si128((__m128i *)dst, pack_10_10_10_2_4(p, TRUE));
+}
+
+
+CONVERT_ROW(convert_swap_rb, swap_rb, 4, 4, 4)
+CONVERT_ROW(convert_swap_rb_set_alpha, swap_rb_set_alpha, 4, 4, 4)
+CONVERT_ROW(convert_set_alpha, set_alpha, 4, 4, 4)
+CONVERT_ROW(convert_unpack_b5g6r5, unpack_b5g6r5, 8, 4, 2)
+CONVERT_ROW(convert_pack_b5g6r5, pack_b5g6r5, 8, 2, 4)
+CONVERT_ROW(convert_pack_r10g10b10a2, pack_r10g10b10a2, 4, 4, 4)
+CONVERT_ROW(convert_pack_b10g10r10a2, pack_b10g10r10a2, 4, 4, 4)
+
+
+static const struct lp_linear_format
+lp_linear_formats[] = {
+   { PIPE_FORMAT_B8G8R8A8_UNORM, 4, NULL, NULL },
+   { PIPE_FORMAT_B8G8R8X8_UNORM, 4, convert_set_alpha, NULL },
+   { PIPE_FORMAT_R8G8B8A8_UNORM, 4, convert_swap_rb, convert_swap_rb },
+   { PIPE_FORMAT_R8G8B8X8_UNORM, 4, convert_swap_rb_set_alpha,
+     convert_swap_rb },
+   { PIPE_FORMAT_B5G6R5_UNORM, 2, convert_unpack_b5g6r5,
+     convert_pack_b5g6r5 },
+   { PIPE_FORMAT_R10G10B10A2_UNORM, 4, NULL, convert_pack_r10g10b10a2 },
+   { PIPE_FORMAT_B10G10R10A2_UNORM, 4, NULL, convert_pack_b10g10r10a2 },
+   { PIPE_FORMAT_NONE, 0, NULL, NULL },
+};
+
+#else  // DETECT_ARCH_SSE
+
+static const struct lp_linear_format
+lp_linear_formats[] = {
+   { PIPE_FORMAT_B8G8R8A8_UNORM, 4, NULL, NULL },
+   { PIPE_FORMAT_B8G8R8X8_UNORM, 4, NULL, NULL },
+   { PIPE_FORMAT_NONE, 0, NULL, NULL },
+};
+
+#endif  // DETECT_ARCH_SSE
+
+
+boolean
+lp_linear_has_avx2(void)
+{
+#ifdef LP_LINEAR_HAVE_AVX2
+   return util_get_cpu_caps()->has_avx2;
+#else
+   return FALSE;
+#endif
+}
+
+
+/**
+ * Look up the conversions for a format, using the SSE2 or, when avx2 is
+ * set, the AVX2 kernels.  Returns NULL if the linear path doesn't handle
+ * the format.
+ */
+const struct lp_linear_format *
+lp_linear_get_format_simd(enum pipe_format format, boolean avx2)
+{
+   const struct lp_linear_format *formats = lp_linear_formats;
+
+#ifdef LP_LINEAR_HAVE_AVX2
+   if (avx2)
+      formats = lp_linear_formats_avx2;
+#endif
+
+   for (unsigned i = 0; formats[i].format != PIPE_FORMAT_NONE; i++) {
+      if (formats[i].format == format)
+         return &formats[i];
+   }
+
+   return NULL;
+}
+
+
+const struct lp_linear_format *
+lp_linear_get_format(enum pipe_format format)
+{
+   return lp_linear_get_format_simd(format, lp_linear_has_avx2());
+}
+
+
+/**
+ * Can the linear path render to a colour buffer of this format?  Formats
+ * which can't be read back without loss of precision are only suitable
+ * for opaque shaders, which don't read the colour buffer.
+ */
+boolean
+lp_linear_check_cbuf_format(enum pipe_format format, boolean opaque)
+{
+   const struct lp_linear_format *linear_format =
+      lp_linear_get_format_simd(format, FALSE);
+
+   return linear_format &&
+          (!linear_format->pack || linear_format->unpack || opaque);
+}
@@ -212,6 +212,12 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
    interp->dady  = _mm_setr_epi16(dsdy_fp[2], dsdy_fp[1], dsdy_fp[0], dsdy_fp[3],
                                   dsdy_fp[2], dsdy_fp[1], dsdy_fp[0], dsdy_fp[3]);
 
+   lp_linear_func fetch = interp_0_8;
+#ifdef LP_LINEAR_HAVE_AVX2
+   if (lp_linear_has_avx2())
+      fetch = lp_linear_interp_0_8_avx2;
+#endif
+
    /* If the value is y-invariant, eagerly calculate it here and then
     * always return the precalculated value.
     */
@@ -219,10 +225,10 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
        dsdy[1] == 0 &&
        dsdy[2] == 0 &&
        dsdy[3] == 0) {
-      interp_0_8(&interp->base);
+      fetch(&interp->base);
       interp->base.fetch = interp_noop;
    } else {
-      interp->base.fetch = interp_0_8;
+      interp->base.fetch = fetch;
    }
 
    return TRUE;
@@ -6,6 +6,11 @@ struct lp_linear_elem;
 
 typedef const uint32_t *(*lp_linear_func)(struct lp_linear_elem *base);
 
+/* Convert a row of width pixels between some format and bgra8.
+ */
+typedef void (*lp_linear_convert_func)(void *dst, const void *src,
+                                       unsigned width);
+
 
 struct lp_linear_elem {
    lp_linear_func fetch;
@@ -43,6 +48,13 @@ struct lp_linear_sampler {
     * The index of stretched_row to receive the next stretched row.
     */
    int stretched_row_index;
+
+   /**
+    * For textures not in bgra8 order: fetch function returning the
+    * texels in the texture's order, and conversion of those into row.
+    */
+   lp_linear_func fetch_texels;
+   lp_linear_convert_func unpack;
 };
 
 /* "Linear" refers to the fact we're on the linear (non-swizzled)
@@ -64,6 +76,26 @@ struct lp_linear_interp {
 };
 
 
+/* Colour buffer and texture formats the linear path handles, by way of
+ * conversion from and to the bgra8 rows the shaders operate on.
+ */
+struct lp_linear_format {
+   enum pipe_format format;
+   unsigned bytes;
+
+   /* bgra8 from the format.  NULL for bgra8 itself, or if the
+    * conversion loses precision, in which case only shaders which don't
+    * read the colour buffer can use the linear path.
+    */
+   lp_linear_convert_func unpack;
+
+   /* The format from bgra8.  NULL if the shaders can write to the
+    * colour buffer directly.
+    */
+   lp_linear_convert_func pack;
+};
+
+
 /* Check for a sampler variant which matches our fetch_row
  * implementation - normalized texcoords, single mipmap with
  * nearest filtering.
@@ -150,6 +182,15 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
 boolean
 lp_linear_check_fastpath(struct lp_fragment_shader_variant *variant);
 
+const struct lp_linear_format *
+lp_linear_get_format(enum pipe_format format);
+
+const struct lp_linear_format *
+lp_linear_get_format_simd(enum pipe_format format, boolean avx2);
+
+boolean
+lp_linear_has_avx2(void);
+
 boolean
 lp_linear_check_sampler(const struct lp_sampler_static_state *sampler,
                         const struct lp_tgsi_texture_info *tex);
@@ -162,6 +203,34 @@ void
 lp_linear_init_noop_sampler(struct lp_linear_sampler *samp);
 
 
+#ifdef LP_LINEAR_HAVE_AVX2
+/* Versions of the linear path kernels using AVX2, built separately with
+ * -mavx2.  Only to be called when lp_linear_has_avx2() returns TRUE.
+ * Functions which process part of a row return the number of pixels
+ * done, leaving the rest to the caller.
+ */
+extern const struct lp_linear_format lp_linear_formats_avx2[];
+
+const uint32_t *
+lp_linear_interp_0_8_avx2(struct lp_linear_elem *elem);
+
+const uint32_t *
+lp_linear_fetch_bgra_clamp_linear_avx2(struct lp_linear_elem *elem);
+
+int
+lp_linear_lerp_rows_avx2(uint32_t *dst,
+                         const uint32_t *src0,
+                         const uint32_t *src1,
+                         int weight,
+                         int width);
+
+int
+lp_linear_blend_premul_avx2(uint32_t *dst,
+                            const uint32_t *src,
+                            int width);
+#endif
+
+
 #define FAIL(s) do {                                    \
       if (LP_DEBUG & DEBUG_LINEAR)                      \
          debug_printf("%s: %s\n", __func__, s);         \
@@ -413,10 +413,16 @@ fetch_bgra_axis_aligned_linear(struct lp_linear_elem *elem)
    const uint32_t * restrict src_row1 = fetch_and_stretch_bgra_row(samp, y + 1);
 
    __m128i wt = _mm_set1_epi16(w);
+   int i = 0;
 
    /* Combine the two rows using a constant weight.
     */
-   for (int i = 0; i < width; i += 4) {
+#ifdef LP_LINEAR_HAVE_AVX2
+   if (lp_linear_has_avx2())
+      i = lp_linear_lerp_rows_avx2(row, src_row0, src_row1, w, width);
+#endif
+
+   for (; i < width; i += 4) {
       __m128i srca = _mm_load_si128((const __m128i *)&src_row0[i]);
       __m128i srcb = _mm_load_si128((const __m128i *)&src_row1[i]);
 
@@ -656,6 +662,21 @@ fetch_bgrx_linear(struct lp_linear_elem *elem)
 }
 
 
+/* Fetch a row of texels of a texture in another channel order, and
+ * convert them into bgra8.
+ */
+static const uint32_t *
+fetch_and_unpack(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const uint32_t *texels = samp->fetch_texels(&samp->base);
+
+   samp->unpack(samp->row, texels, samp->width);
+
+   return samp->row;
+}
+
+
 static boolean
 sampler_is_nearest(const struct lp_linear_sampler *samp,
                    const struct lp_sampler_static_state *sampler_state,
@@ -871,8 +892,21 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
        return FALSE;
    }
 
+   /* Textures in rgba8 channel order are fetched as if they were bgra8,
+    * and the texels swizzled afterwards.
+    */
+   enum pipe_format format = sampler_state->texture_state.format;
+   samp->fetch_texels = NULL;
+   samp->unpack = NULL;
+
+   if (format == PIPE_FORMAT_R8G8B8A8_UNORM ||
+       format == PIPE_FORMAT_R8G8B8X8_UNORM) {
+      samp->unpack = lp_linear_get_format(format)->unpack;
+      format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   }
+
    if (is_nearest) {
-      switch (sampler_state->texture_state.format) {
+      switch (format) {
       case PIPE_FORMAT_B8G8R8A8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgra_clamp;
@@ -882,7 +916,7 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgra_axis_aligned;
          else
             samp->base.fetch = fetch_bgra_memcpy;
-         return TRUE;
+         break;
       case PIPE_FORMAT_B8G8R8X8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgrx_clamp;
@@ -892,18 +926,16 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgrx_axis_aligned;
          else
             samp->base.fetch = fetch_bgrx_memcpy;
-         return TRUE;
-      default:
          break;
+      default:
+         FAIL("unknown format for nearest");
       }
-
-      FAIL("unknown format for nearest");
    } else {
       samp->stretched_row_y[0] = -1;
       samp->stretched_row_y[1] = -1;
       samp->stretched_row_index = 0;
 
-      switch (sampler_state->texture_state.format) {
+      switch (format) {
       case PIPE_FORMAT_B8G8R8A8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgra_clamp_linear;
@@ -911,7 +943,7 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgra_linear;
          else
             samp->base.fetch = fetch_bgra_axis_aligned_linear;
-         return TRUE;
+         break;
       case PIPE_FORMAT_B8G8R8X8_UNORM:
          if (need_wrap)
             samp->base.fetch = fetch_bgrx_clamp_linear;
@@ -919,13 +951,29 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             samp->base.fetch = fetch_bgrx_linear;
          else
             samp->base.fetch = fetch_bgrx_axis_aligned_linear;
-         return TRUE;
-      default:
          break;
+      default:
+         FAIL("unknown format");
+      }
+
+#ifdef LP_LINEAR_HAVE_AVX2
+      /* Gather eight texels at a time.  bgrx textures get their alpha
+       * set afterwards, like other channel orders.
+       */
+      if (need_wrap && lp_linear_has_avx2()) {
+         if (format == PIPE_FORMAT_B8G8R8X8_UNORM)
+            samp->unpack = lp_linear_get_format(format)->unpack;
+         samp->base.fetch = lp_linear_fetch_bgra_clamp_linear_avx2;
       }
+#endif
+   }
 
-      FAIL("unknown format");
+   if (samp->unpack) {
+      samp->fetch_texels = samp->base.fetch;
+      samp->base.fetch = fetch_and_unpack;
    }
+
+   return TRUE;
 }
 
 
@@ -974,7 +1022,9 @@ lp_linear_check_sampler(const struct lp_sampler_static_state *sampler,
    /* These are the only texture formats we support at the moment
     */
    if (sampler->texture_state.format != PIPE_FORMAT_B8G8R8A8_UNORM &&
-       sampler->texture_state.format != PIPE_FORMAT_B8G8R8X8_UNORM)
+       sampler->texture_state.format != PIPE_FORMAT_B8G8R8X8_UNORM &&
+       sampler->texture_state.format != PIPE_FORMAT_R8G8B8A8_UNORM &&
+       sampler->texture_state.format != PIPE_FORMAT_R8G8B8X8_UNORM)
       return FALSE;
 
    /* We don't support sampler view swizzling on the linear path */
@@ -0,0 +1,1432 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * SIMD interpreter for compute shaders in NIR.
+ *
+ * The shader is taken out of SSA form, and each SSA value and register
+ * component gets a slot holding one 32 bit value per invocation.  The
+ * instructions are flattened into a list which refers to the slots.  ALU
+ * instructions are split into components, each running a kernel which is
+ * a plain loop over the invocations, so that the C compiler vectorizes it.
+ *
+ * Divergent control flow is handled like the LLVM code does, with an
+ * execution mask: both sides of an if run with the lanes which take them,
+ * and a loop runs until no lane is left in it.  Workgroups with barriers
+ * run their subgroups in turn up to each barrier.
+ */
+
+#include <math.h>
+
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_atomic.h"
+#include "util/bitscan.h"
+#include "util/rounding.h"
+#include "util/u_dynarray.h"
+#include "util/format/u_format.h"
+#include "compiler/nir/nir.h"
+#include "gallivm/lp_bld_sample.h"
+#include "lp_jit.h"
+#include "lp_state_fs.h"
+#include "lp_nir_interp.h"
+
+
+#define W LP_NIR_INTERP_WIDTH
+#define FULL_MASK ((1u << W) - 1)
+
+/** A 32 bit value for each lane */
+union interp_value {
+   float f[W];
+   int32_t i[W];
+   uint32_t u[W];
+};
+
+typedef void (*interp_kernel)(union interp_value *dst,
+                              const union interp_value *a,
+                              const union interp_value *b,
+                              const union interp_value *c);
+
+enum interp_opcode {
+   INTERP_ALU,
+   INTERP_INTRINSIC,
+   INTERP_TEX,
+   INTERP_IF,
+   INTERP_ELSE,
+   INTERP_ENDIF,
+   INTERP_LOOP,
+   INTERP_BREAK,
+   INTERP_CONTINUE,
+   INTERP_ENDLOOP,
+   INTERP_BARRIER,
+};
+
+struct interp_instr {
+   enum interp_opcode opcode;
+   interp_kernel kernel;
+   /** First slot of the destination and of each source */
+   unsigned dst;
+   unsigned src[4];
+   /**
+    * Where to branch to: the else or endif when no lane takes an if, past
+    * the endloop when no lane enters a loop, and back to the start of the
+    * loop body.  For break and continue, the number of frames above the
+    * loop's.
+    */
+   unsigned target;
+   /** For intrinsics and texture instructions */
+   const nir_instr *instr;
+};
+
+struct lp_nir_interp {
+   /** The translated copy of the shader, which instr refers to */
+   nir_shader *nir;
+
+   struct interp_instr *instrs;
+   unsigned num_instrs;
+
+   /** The load_const values, which are the first slots */
+   union interp_value *consts;
+   unsigned num_consts;
+
+   unsigned num_slots;
+   /** Deepest nesting of ifs and loops */
+   unsigned max_depth;
+   bool has_barrier;
+};
+
+
+/*
+ * ALU kernels.
+ */
+
+#define KERNEL(name, expr)                                              \
+   static void                                                          \
+   kernel_##name(union interp_value *d, const union interp_value *a,    \
+                 const union interp_value *b, const union interp_value *c) \
+   {                                                                    \
+      (void)a; (void)b; (void)c;                                        \
+      for (unsigned i = 0; i < W; i++)                                  \
+         expr;                                                          \
+   }
+
+KERNEL(mov,    d->u[i] = a->u[i])
+
+KERNEL(fadd,   d->f[i] = a->f[i] + b->f[i])
+KERNEL(fsub,   d->f[i] = a->f[i] - b->f[i])
+KERNEL(fmul,   d->f[i] = a->f[i] * b->f[i])
+KERNEL(fdiv,   d->f[i] = a->f[i] / b->f[i])
+KERNEL(ffma,   d->f[i] = a->f[i] * b->f[i] + c->f[i])
+KERNEL(fneg,   d->f[i] = -a->f[i])
+KERNEL(fabs,   d->f[i] = fabsf(a->f[i]))
+KERNEL(fsat,   d->f[i] = a->f[i] > 0.0f ? MIN2(a->f[i], 1.0f) : 0.0f)
+KERNEL(fsign,  d->f[i] = a->f[i] > 0.0f ? 1.0f :
+                         a->f[i] < 0.0f ? -1.0f : 0.0f)
+KERNEL(fmin,   d->f[i] = fminf(a->f[i], b->f[i]))
+KERNEL(fmax,   d->f[i] = fmaxf(a->f[i], b->f[i]))
+KERNEL(frcp,   d->f[i] = 1.0f / a->f[i])
+KERNEL(frsq,   d->f[i] = 1.0f / sqrtf(a->f[i]))
+KERNEL(fsqrt,  d->f[i] = sqrtf(a->f[i]))
+KERNEL(fexp2,  d->f[i] = exp2f(a->f[i]))
+KERNEL(flog2,  d->f[i] = log2f(a->f[i]))
+KERNEL(fpow,   d->f[i] = powf(a->f[i], b->f[i]))
+KERNEL(fsin,   d->f[i] = sinf(a->f[i]))
+KERNEL(fcos,   d->f[i] = cosf(a->f[i]))
+KERNEL(ffloor, d->f[i] = floorf(a->f[i]))
+KERNEL(fceil,  d->f[i] = ceilf(a->f[i]))
+KERNEL(ftrunc, d->f[i] = truncf(a->f[i]))
+KERNEL(ffract, d->f[i] = a->f[i] - floorf(a->f[i]))
+KERNEL(fround_even, d->f[i] = _mesa_roundevenf(a->f[i]))
+
+/* unsigned arithmetic, so that overflow wraps */
+KERNEL(iadd,   d->u[i] = a->u[i] + b->u[i])
+KERNEL(isub,   d->u[i] = a->u[i] - b->u[i])
+KERNEL(imul,   d->u[i] = a->u[i] * b->u[i])
+KERNEL(ineg,   d->u[i] = 0u - a->u[i])
+KERNEL(iabs,   d->u[i] = a->i[i] < 0 ? 0u - a->u[i] : a->u[i])
+KERNEL(isign,  d->i[i] = (a->i[i] > 0) - (a->i[i] < 0))
+KERNEL(imin,   d->i[i] = MIN2(a->i[i], b->i[i]))
+KERNEL(imax,   d->i[i] = MAX2(a->i[i], b->i[i]))
+KERNEL(umin,   d->u[i] = MIN2(a->u[i], b->u[i]))
+KERNEL(umax,   d->u[i] = MAX2(a->u[i], b->u[i]))
+KERNEL(iand,   d->u[i] = a->u[i] & b->u[i])
+KERNEL(ior,    d->u[i] = a->u[i] | b->u[i])
+KERNEL(ixor,   d->u[i] = a->u[i] ^ b->u[i])
+KERNEL(inot,   d->u[i] = ~a->u[i])
+KERNEL(ishl,   d->u[i] = a->u[i] << (b->u[i] & 31))
+KERNEL(ishr,   d->i[i] = a->i[i] >> (b->u[i] & 31))
+KERNEL(ushr,   d->u[i] = a->u[i] >> (b->u[i] & 31))
+KERNEL(imul_high, d->i[i] = ((int64_t)a->i[i] * b->i[i]) >> 32)
+KERNEL(umul_high, d->u[i] = ((uint64_t)a->u[i] * b->u[i]) >> 32)
+
+/* division by zero gives all ones, as with D3D10 */
+KERNEL(udiv,   d->u[i] = b->u[i] ? a->u[i] / b->u[i] : ~0u)
+KERNEL(umod,   d->u[i] = b->u[i] ? a->u[i] % b->u[i] : ~0u)
+KERNEL(idiv,   d->i[i] = !b->i[i] ? -1 :
+                         b->i[i] == -1 ? (int32_t)(0u - a->u[i]) :
+                         a->i[i] / b->i[i])
+KERNEL(irem,   d->i[i] = !b->i[i] ? -1 :
+                         b->i[i] == -1 ? 0 : a->i[i] % b->i[i])
+KERNEL(imod,   d->i[i] = !b->i[i] ? -1 :
+                         b->i[i] == -1 ? 0 :
+                         a->i[i] % b->i[i] && (a->i[i] < 0) != (b->i[i] < 0) ?
+                         a->i[i] % b->i[i] + b->i[i] : a->i[i] % b->i[i])
+
+KERNEL(bit_count, d->u[i] = util_bitcount(a->u[i]))
+KERNEL(ufind_msb, d->i[i] = util_last_bit(a->u[i]) - 1)
+KERNEL(find_lsb,  d->i[i] = ffs(a->i[i]) - 1)
+KERNEL(bitfield_reverse, d->u[i] = util_bitreverse(a->u[i]))
+
+/* booleans are 0 or ~0, whatever their bit size */
+KERNEL(flt,    d->u[i] = a->f[i] < b->f[i] ? ~0u : 0)
+KERNEL(fge,    d->u[i] = a->f[i] >= b->f[i] ? ~0u : 0)
+KERNEL(feq,    d->u[i] = a->f[i] == b->f[i] ? ~0u : 0)
+KERNEL(fneu,   d->u[i] = a->f[i] != b->f[i] ? ~0u : 0)
+KERNEL(ilt,    d->u[i] = a->i[i] < b->i[i] ? ~0u : 0)
+KERNEL(ige,    d->u[i] = a->i[i] >= b->i[i] ? ~0u : 0)
+KERNEL(ieq,    d->u[i] = a->u[i] == b->u[i] ? ~0u : 0)
+KERNEL(ine,    d->u[i] = a->u[i] != b->u[i] ? ~0u : 0)
+KERNEL(ult,    d->u[i] = a->u[i] < b->u[i] ? ~0u : 0)
+KERNEL(uge,    d->u[i] = a->u[i] >= b->u[i] ? ~0u : 0)
+KERNEL(bcsel,  d->u[i] = a->u[i] ? b->u[i] : c->u[i])
+KERNEL(b2f,    d->f[i] = a->u[i] ? 1.0f : 0.0f)
+KERNEL(b2i,    d->u[i] = a->u[i] ? 1 : 0)
+KERNEL(f2b,    d->u[i] = a->f[i] != 0.0f ? ~0u : 0)
+KERNEL(i2b,    d->u[i] = a->u[i] ? ~0u : 0)
+
+KERNEL(f2i32,  d->i[i] = (int32_t)a->f[i])
+KERNEL(f2u32,  d->u[i] = (uint32_t)(int64_t)a->f[i])
+KERNEL(i2f32,  d->f[i] = (float)a->i[i])
+KERNEL(u2f32,  d->f[i] = (float)a->u[i])
+
+
+static interp_kernel
+get_alu_kernel(nir_op op)
+{
+   switch (op) {
+   case nir_op_mov:
+   case nir_op_i2i32:
+   case nir_op_u2u32:
+   case nir_op_f2f32:
+      return kernel_mov;
+   case nir_op_fadd: return kernel_fadd;
+   case nir_op_fsub: return kernel_fsub;
+   case nir_op_fmul: return kernel_fmul;
+   case nir_op_fdiv: return kernel_fdiv;
+   case nir_op_ffma: return kernel_ffma;
+   case nir_op_fneg: return kernel_fneg;
+   case nir_op_fabs: return kernel_fabs;
+   case nir_op_fsat: return kernel_fsat;
+   case nir_op_fsign: return kernel_fsign;
+   case nir_op_fmin: return kernel_fmin;
+   case nir_op_fmax: return kernel_fmax;
+   case nir_op_frcp: return kernel_frcp;
+   case nir_op_frsq: return kernel_frsq;
+   case nir_op_fsqrt: return kernel_fsqrt;
+   case nir_op_fexp2: return kernel_fexp2;
+   case nir_op_flog2: return kernel_flog2;
+   case nir_op_fpow: return kernel_fpow;
+   case nir_op_fsin: return kernel_fsin;
+   case nir_op_fcos: return kernel_fcos;
+   case nir_op_ffloor: return kernel_ffloor;
+   case nir_op_fceil: return kernel_fceil;
+   case nir_op_ftrunc: return kernel_ftrunc;
+   case nir_op_ffract: return kernel_ffract;
+   case nir_op_fround_even: return kernel_fround_even;
+   case nir_op_iadd: return kernel_iadd;
+   case nir_op_isub: return kernel_isub;
+   case nir_op_imul: return kernel_imul;
+   case nir_op_ineg: return kernel_ineg;
+   case nir_op_iabs: return kernel_iabs;
+   case nir_op_isign: return kernel_isign;
+   case nir_op_imin: return kernel_imin;
+   case nir_op_imax: return kernel_imax;
+   case nir_op_umin: return kernel_umin;
+   case nir_op_umax: return kernel_umax;
+   case nir_op_iand: return kernel_iand;
+   case nir_op_ior: return kernel_ior;
+   case nir_op_ixor: return kernel_ixor;
+   case nir_op_inot: return kernel_inot;
+   case nir_op_ishl: return kernel_ishl;
+   case nir_op_ishr: return kernel_ishr;
+   case nir_op_ushr: return kernel_ushr;
+   case nir_op_imul_high: return kernel_imul_high;
+   case nir_op_umul_high: return kernel_umul_high;
+   case nir_op_udiv: return kernel_udiv;
+   case nir_op_umod: return kernel_umod;
+   case nir_op_idiv: return kernel_idiv;
+   case nir_op_irem: return kernel_irem;
+   case nir_op_imod: return kernel_imod;
+   case nir_op_bit_count: return kernel_bit_count;
+   case nir_op_ufind_msb: return kernel_ufind_msb;
+   case nir_op_find_lsb: return kernel_find_lsb;
+   case nir_op_bitfield_reverse: return kernel_bitfield_reverse;
+   case nir_op_flt:
+   case nir_op_flt32:
+      return kernel_flt;
+   case nir_op_fge:
+   case nir_op_fge32:
+      return kernel_fge;
+   case nir_op_feq:
+   case nir_op_feq32:
+      return kernel_feq;
+   case nir_op_fneu:
+   case nir_op_fneu32:
+      return kernel_fneu;
+   case nir_op_ilt:
+   case nir_op_ilt32:
+      return kernel_ilt;
+   case nir_op_ige:
+   case nir_op_ige32:
+      return kernel_ige;
+   case nir_op_ieq:
+   case nir_op_ieq32:
+      return kernel_ieq;
+   case nir_op_ine:
+   case nir_op_ine32:
+      return kernel_ine;
+   case nir_op_ult:
+   case nir_op_ult32:
+      return kernel_ult;
+   case nir_op_uge:
+   case nir_op_uge32:
+      return kernel_uge;
+   case nir_op_bcsel:
+   case nir_op_b32csel:
+      return kernel_bcsel;
+   case nir_op_b2f32: return kernel_b2f;
+   case nir_op_b2i32: return kernel_b2i;
+   case nir_op_b2b1:
+   case nir_op_b2b32:
+      return kernel_mov;
+   case nir_op_f2b1:
+   case nir_op_f2b32:
+      return kernel_f2b;
+   case nir_op_i2b1:
+   case nir_op_i2b32:
+      return kernel_i2b;
+   case nir_op_f2i32: return kernel_f2i32;
+   case nir_op_f2u32: return kernel_f2u32;
+   case nir_op_i2f32: return kernel_i2f32;
+   case nir_op_u2f32: return kernel_u2f32;
+   default:
+      return NULL;
+   }
+}
+
+
+/*
+ * Translation of the shader.
+ */
+
+struct interp_builder {
+   struct lp_nir_interp *interp;
+   struct util_dynarray instrs;
+   unsigned *ssa_slots;
+   unsigned *reg_slots;
+   unsigned depth;
+   /** Depth of the frame of the innermost loop */
+   unsigned loop_depth;
+   bool failed;
+};
+
+
+static bool
+is_32bit(unsigned bit_size)
+{
+   /* booleans are stored as 32 bit values */
+   return bit_size == 32 || bit_size == 1;
+}
+
+
+static unsigned
+src_slot(struct interp_builder *b, const nir_src *src, unsigned comp)
+{
+   if (src->is_ssa) {
+      if (!is_32bit(src->ssa->bit_size))
+         b->failed = true;
+      return b->ssa_slots[src->ssa->index] + comp;
+   }
+
+   if (src->reg.indirect || src->reg.base_offset)
+      b->failed = true;
+   return b->reg_slots[src->reg.reg->index] + comp;
+}
+
+
+/** Assigns the slots of an SSA destination */
+static unsigned
+dest_slot(struct interp_builder *b, const nir_dest *dest)
+{
+   if (dest->is_ssa) {
+      if (!is_32bit(dest->ssa.bit_size))
+         b->failed = true;
+      b->ssa_slots[dest->ssa.index] = b->interp->num_slots;
+      b->interp->num_slots += dest->ssa.num_components;
+      return b->ssa_slots[dest->ssa.index];
+   }
+
+   if (dest->reg.indirect || dest->reg.base_offset)
+      b->failed = true;
+   return b->reg_slots[dest->reg.reg->index];
+}
+
+
+static unsigned
+emit(struct interp_builder *b, enum interp_opcode opcode)
+{
+   struct interp_instr instr;
+
+   memset(&instr, 0, sizeof instr);
+   instr.opcode = opcode;
+   util_dynarray_append(&b->instrs, struct interp_instr, instr);
+
+   return util_dynarray_num_elements(&b->instrs, struct interp_instr) - 1;
+}
+
+
+static struct interp_instr *
+get_instr(struct interp_builder *b, unsigned index)
+{
+   return util_dynarray_element(&b->instrs, struct interp_instr, index);
+}
+
+
+static void
+emit_alu_op(struct interp_builder *b, interp_kernel kernel, unsigned dst,
+            const unsigned src[3])
+{
+   struct interp_instr *instr = get_instr(b, emit(b, INTERP_ALU));
+
+   instr->kernel = kernel;
+   instr->dst = dst;
+   memcpy(instr->src, src, 3 * sizeof *src);
+}
+
+
+static void
+emit_alu(struct interp_builder *b, nir_alu_instr *alu)
+{
+   const nir_op_info *info = &nir_op_infos[alu->op];
+   const bool is_vec = nir_op_is_vec(alu->op);
+   interp_kernel kernel = is_vec ? kernel_mov : get_alu_kernel(alu->op);
+
+   if (!kernel || alu->dest.saturate ||
+       (!is_vec && info->output_size)) {
+      b->failed = true;
+      return;
+   }
+
+   for (unsigned i = 0; i < info->num_inputs; i++) {
+      if (alu->src[i].negate || alu->src[i].abs ||
+          (!is_vec && info->input_sizes[i])) {
+         b->failed = true;
+         return;
+      }
+   }
+
+   const unsigned num_components = nir_dest_num_components(alu->dest.dest);
+   const unsigned write_mask = alu->dest.dest.is_ssa ?
+      BITFIELD_MASK(num_components) : alu->dest.write_mask;
+
+   /*
+    * Components are written one after the other, so a register which is
+    * both read and written is only written once all components are done.
+    */
+   bool reads_dest = false;
+   if (!alu->dest.dest.is_ssa && util_bitcount(write_mask) > 1) {
+      for (unsigned i = 0; i < info->num_inputs; i++) {
+         if (!alu->src[i].src.is_ssa &&
+             alu->src[i].src.reg.reg == alu->dest.dest.reg.reg)
+            reads_dest = true;
+      }
+   }
+
+   const unsigned dst = dest_slot(b, &alu->dest.dest);
+   unsigned tmp = dst;
+   if (reads_dest) {
+      tmp = b->interp->num_slots;
+      b->interp->num_slots += num_components;
+   }
+
+   u_foreach_bit(c, write_mask) {
+      unsigned src[3] = { 0 };
+
+      if (is_vec) {
+         src[0] = src_slot(b, &alu->src[c].src, alu->src[c].swizzle[0]);
+      } else {
+         for (unsigned i = 0; i < info->num_inputs; i++)
+            src[i] = src_slot(b, &alu->src[i].src, alu->src[i].swizzle[c]);
+      }
+
+      emit_alu_op(b, kernel, tmp + c, src);
+   }
+
+   if (reads_dest) {
+      u_foreach_bit(c, write_mask) {
+         const unsigned src[3] = { tmp + c };
+         emit_alu_op(b, kernel_mov, dst + c, src);
+      }
+   }
+}
+
+
+static void
+emit_intrinsic(struct interp_builder *b, nir_intrinsic_instr *intr)
+{
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intr->intrinsic];
+
+   switch (intr->intrinsic) {
+   case nir_intrinsic_scoped_barrier:
+      /* the subgroups run in turn, so memory barriers are implied */
+      if (nir_intrinsic_execution_scope(intr) >= NIR_SCOPE_WORKGROUP) {
+         emit(b, INTERP_BARRIER);
+         b->interp->has_barrier = true;
+      }
+      return;
+   case nir_intrinsic_control_barrier:
+      emit(b, INTERP_BARRIER);
+      b->interp->has_barrier = true;
+      return;
+   case nir_intrinsic_memory_barrier:
+   case nir_intrinsic_group_memory_barrier:
+   case nir_intrinsic_memory_barrier_buffer:
+   case nir_intrinsic_memory_barrier_shared:
+      return;
+   case nir_intrinsic_load_ubo:
+   case nir_intrinsic_load_ssbo:
+   case nir_intrinsic_store_ssbo:
+   case nir_intrinsic_get_ssbo_size:
+   case nir_intrinsic_load_shared:
+   case nir_intrinsic_store_shared:
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_ssbo_atomic_imin:
+   case nir_intrinsic_ssbo_atomic_umin:
+   case nir_intrinsic_ssbo_atomic_imax:
+   case nir_intrinsic_ssbo_atomic_umax:
+   case nir_intrinsic_ssbo_atomic_and:
+   case nir_intrinsic_ssbo_atomic_or:
+   case nir_intrinsic_ssbo_atomic_xor:
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+   case nir_intrinsic_shared_atomic_add:
+   case nir_intrinsic_shared_atomic_imin:
+   case nir_intrinsic_shared_atomic_umin:
+   case nir_intrinsic_shared_atomic_imax:
+   case nir_intrinsic_shared_atomic_umax:
+   case nir_intrinsic_shared_atomic_and:
+   case nir_intrinsic_shared_atomic_or:
+   case nir_intrinsic_shared_atomic_xor:
+   case nir_intrinsic_shared_atomic_exchange:
+   case nir_intrinsic_shared_atomic_comp_swap:
+   case nir_intrinsic_load_local_invocation_id:
+   case nir_intrinsic_load_local_invocation_index:
+   case nir_intrinsic_load_workgroup_id:
+   case nir_intrinsic_load_num_workgroups:
+   case nir_intrinsic_load_workgroup_size:
+   case nir_intrinsic_load_global_invocation_id:
+   case nir_intrinsic_load_work_dim:
+      break;
+   default:
+      b->failed = true;
+      return;
+   }
+
+   const unsigned index = emit(b, INTERP_INTRINSIC);
+   unsigned src[4] = { 0 };
+   for (unsigned i = 0; i < info->num_srcs; i++)
+      src[i] = src_slot(b, &intr->src[i], 0);
+
+   struct interp_instr *instr = get_instr(b, index);
+   memcpy(instr->src, src, sizeof src);
+   instr->instr = &intr->instr;
+   if (info->has_dest)
+      instr->dst = dest_slot(b, &intr->dest);
+}
+
+
+static void
+emit_tex(struct interp_builder *b, nir_tex_instr *tex)
+{
+   if ((tex->op != nir_texop_txf && tex->op != nir_texop_txs) ||
+       tex->is_shadow || tex->is_sparse ||
+       tex->texture_index >= PIPE_MAX_SHADER_SAMPLER_VIEWS ||
+       nir_alu_type_get_type_size(tex->dest_type) != 32) {
+      b->failed = true;
+      return;
+   }
+
+   switch (tex->sampler_dim) {
+   case GLSL_SAMPLER_DIM_1D:
+   case GLSL_SAMPLER_DIM_2D:
+   case GLSL_SAMPLER_DIM_3D:
+   case GLSL_SAMPLER_DIM_RECT:
+   case GLSL_SAMPLER_DIM_BUF:
+      break;
+   default:
+      b->failed = true;
+      return;
+   }
+
+   /* src[1] is the lod, ~0 without one */
+   unsigned src[4] = { 0, ~0u, 0, 0 };
+   for (unsigned i = 0; i < tex->num_srcs; i++) {
+      switch (tex->src[i].src_type) {
+      case nir_tex_src_coord:
+         src[0] = src_slot(b, &tex->src[i].src, 0);
+         break;
+      case nir_tex_src_lod:
+         src[1] = src_slot(b, &tex->src[i].src, 0);
+         break;
+      default:
+         b->failed = true;
+         return;
+      }
+   }
+
+   const unsigned index = emit(b, INTERP_TEX);
+   struct interp_instr *instr = get_instr(b, index);
+   memcpy(instr->src, src, sizeof src);
+   instr->instr = &tex->instr;
+   instr->dst = dest_slot(b, &tex->dest);
+}
+
+
+static void
+emit_cf_list(struct interp_builder *b, struct exec_list *list);
+
+
+static void
+emit_block(struct interp_builder *b, nir_block *block)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu:
+         emit_alu(b, nir_instr_as_alu(instr));
+         break;
+      case nir_instr_type_intrinsic:
+         emit_intrinsic(b, nir_instr_as_intrinsic(instr));
+         break;
+      case nir_instr_type_tex:
+         emit_tex(b, nir_instr_as_tex(instr));
+         break;
+      case nir_instr_type_load_const:
+         /* the slots were assigned upfront */
+         break;
+      case nir_instr_type_deref:
+         /* left over from the locals, the intrinsics using any fail */
+         break;
+      case nir_instr_type_ssa_undef: {
+         nir_ssa_undef_instr *undef = nir_instr_as_ssa_undef(instr);
+         b->ssa_slots[undef->def.index] = b->interp->num_slots;
+         b->interp->num_slots += undef->def.num_components;
+         break;
+      }
+      case nir_instr_type_jump: {
+         nir_jump_instr *jump = nir_instr_as_jump(instr);
+         if (jump->type == nir_jump_break) {
+            get_instr(b, emit(b, INTERP_BREAK))->target =
+               b->depth - 1 - b->loop_depth;
+         } else if (jump->type == nir_jump_continue) {
+            get_instr(b, emit(b, INTERP_CONTINUE))->target =
+               b->depth - 1 - b->loop_depth;
+         } else {
+            b->failed = true;
+         }
+         break;
+      }
+      default:
+         b->failed = true;
+         break;
+      }
+
+      if (b->failed)
+         return;
+   }
+}
+
+
+static void
+emit_if(struct interp_builder *b, nir_if *nif)
+{
+   const unsigned cond = src_slot(b, &nif->condition, 0);
+   const unsigned if_index = emit(b, INTERP_IF);
+   get_instr(b, if_index)->src[0] = cond;
+
+   b->depth++;
+   b->interp->max_depth = MAX2(b->interp->max_depth, b->depth);
+
+   emit_cf_list(b, &nif->then_list);
+   const unsigned else_index = emit(b, INTERP_ELSE);
+   emit_cf_list(b, &nif->else_list);
+   const unsigned endif_index = emit(b, INTERP_ENDIF);
+
+   b->depth--;
+
+   get_instr(b, if_index)->target = else_index;
+   get_instr(b, else_index)->target = endif_index;
+}
+
+
+static void
+emit_loop(struct interp_builder *b, nir_loop *loop)
+{
+   const unsigned loop_index = emit(b, INTERP_LOOP);
+   const unsigned outer_loop_depth = b->loop_depth;
+
+   b->loop_depth = b->depth;
+   b->depth++;
+   b->interp->max_depth = MAX2(b->interp->max_depth, b->depth);
+
+   emit_cf_list(b, &loop->body);
+   const unsigned endloop_index = emit(b, INTERP_ENDLOOP);
+
+   b->depth--;
+   b->loop_depth = outer_loop_depth;
+
+   get_instr(b, loop_index)->target = endloop_index + 1;
+   get_instr(b, endloop_index)->target = loop_index + 1;
+}
+
+
+static void
+emit_cf_list(struct interp_builder *b, struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      switch (node->type) {
+      case nir_cf_node_block:
+         emit_block(b, nir_cf_node_as_block(node));
+         break;
+      case nir_cf_node_if:
+         emit_if(b, nir_cf_node_as_if(node));
+         break;
+      case nir_cf_node_loop:
+         emit_loop(b, nir_cf_node_as_loop(node));
+         break;
+      default:
+         b->failed = true;
+         break;
+      }
+
+      if (b->failed)
+         return;
+   }
+}
+
+
+/** Puts the load_const values into the first slots */
+static bool
+assign_const_slots(struct interp_builder *b, nir_function_impl *impl)
+{
+   struct lp_nir_interp *interp = b->interp;
+   struct util_dynarray consts;
+
+   util_dynarray_init(&consts, NULL);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_load_const)
+            continue;
+
+         nir_load_const_instr *load = nir_instr_as_load_const(instr);
+         if (!is_32bit(load->def.bit_size)) {
+            util_dynarray_fini(&consts);
+            return false;
+         }
+
+         b->ssa_slots[load->def.index] = interp->num_slots;
+         interp->num_slots += load->def.num_components;
+
+         for (unsigned c = 0; c < load->def.num_components; c++) {
+            union interp_value value;
+            const uint32_t u = load->def.bit_size == 1 ?
+               (load->value[c].b ? ~0u : 0) : load->value[c].u32;
+            for (unsigned i = 0; i < W; i++)
+               value.u[i] = u;
+            util_dynarray_append(&consts, union interp_value, value);
+         }
+      }
+   }
+
+   interp->num_consts = interp->num_slots;
+   interp->consts = util_dynarray_begin(&consts);
+   return true;
+}
+
+
+struct lp_nir_interp *
+lp_nir_interp_create(const struct nir_shader *nir)
+{
+   struct lp_nir_interp *interp = CALLOC_STRUCT(lp_nir_interp);
+   if (!interp)
+      return NULL;
+
+   /*
+    * Work on a copy, as the compiles take the shader out of SSA form
+    * themselves, possibly on another thread.
+    */
+   interp->nir = nir_shader_clone(NULL, nir);
+   nir_convert_from_ssa(interp->nir, true);
+   nir_lower_locals_to_regs(interp->nir);
+
+   nir_function_impl *impl = nir_shader_get_entrypoint(interp->nir);
+
+   struct interp_builder b;
+   memset(&b, 0, sizeof b);
+   b.interp = interp;
+   util_dynarray_init(&b.instrs, NULL);
+
+   nir_index_ssa_defs(impl);
+   nir_index_local_regs(impl);
+   b.ssa_slots = CALLOC(impl->ssa_alloc + 1, sizeof *b.ssa_slots);
+   b.reg_slots = CALLOC(impl->reg_alloc + 1, sizeof *b.reg_slots);
+
+   if (interp->nir->scratch_size || !b.ssa_slots || !b.reg_slots ||
+       !assign_const_slots(&b, impl))
+      b.failed = true;
+
+   nir_foreach_register(reg, &impl->registers) {
+      if (reg->num_array_elems || !is_32bit(reg->bit_size))
+         b.failed = true;
+      b.reg_slots[reg->index] = interp->num_slots;
+      interp->num_slots += reg->num_components;
+   }
+
+   if (!b.failed)
+      emit_cf_list(&b, &impl->body);
+
+   FREE(b.ssa_slots);
+   FREE(b.reg_slots);
+   interp->instrs = util_dynarray_begin(&b.instrs);
+   interp->num_instrs =
+      util_dynarray_num_elements(&b.instrs, struct interp_instr);
+
+   if (b.failed) {
+      lp_nir_interp_destroy(interp);
+      return NULL;
+   }
+
+   return interp;
+}
+
+
+void
+lp_nir_interp_destroy(struct lp_nir_interp *interp)
+{
+   ralloc_free(interp->nir);
+   free(interp->instrs);
+   free(interp->consts);
+   FREE(interp);
+}
+
+
+/*
+ * Execution.
+ */
+
+struct interp_frame {
+   /** For ifs the lanes of the else, for loops the lanes which broke */
+   uint32_t mask0;
+   /** For ifs the lanes leaving the then, for loops those continuing */
+   uint32_t mask1;
+};
+
+/** The state of a subgroup */
+struct interp_state {
+   union interp_value *slots;
+   struct interp_frame *frames;
+   unsigned sp;
+   unsigned pc;
+   bool done;
+
+   uint32_t exec;
+   /** exec, as ~0 for each active lane */
+   union interp_value exec_lanes;
+
+   uint32_t local_id[3][W];
+   uint32_t local_index[W];
+};
+
+/** Everything the subgroups of a workgroup share */
+struct interp_launch {
+   const struct lp_nir_interp *interp;
+   const struct lp_sampler_static_state *samplers;
+   unsigned num_samplers;
+   const struct lp_jit_cs_context *context;
+   const uint32_t *block_size;
+   const uint32_t *workgroup_id;
+   const uint32_t *grid_size;
+   uint32_t work_dim;
+   uint8_t *shared;
+};
+
+
+static void
+set_exec(struct interp_state *st, uint32_t exec)
+{
+   st->exec = exec;
+   for (unsigned i = 0; i < W; i++)
+      st->exec_lanes.u[i] = exec & (1u << i) ? ~0u : 0;
+}
+
+
+static uint32_t
+lane_mask(const union interp_value *value)
+{
+   uint32_t mask = 0;
+   for (unsigned i = 0; i < W; i++)
+      mask |= (value->u[i] != 0) << i;
+   return mask;
+}
+
+
+static void
+run_alu(struct interp_state *st, const struct interp_instr *instr)
+{
+   union interp_value *slots = st->slots;
+
+   if (st->exec == FULL_MASK) {
+      instr->kernel(&slots[instr->dst], &slots[instr->src[0]],
+                    &slots[instr->src[1]], &slots[instr->src[2]]);
+      return;
+   }
+
+   union interp_value tmp;
+   instr->kernel(&tmp, &slots[instr->src[0]],
+                 &slots[instr->src[1]], &slots[instr->src[2]]);
+
+   union interp_value *dst = &slots[instr->dst];
+   for (unsigned i = 0; i < W; i++)
+      dst->u[i] = (tmp.u[i] & st->exec_lanes.u[i]) |
+                  (dst->u[i] & ~st->exec_lanes.u[i]);
+}
+
+
+static uint32_t
+atomic_op(nir_intrinsic_op op, uint32_t *ptr, uint32_t data, uint32_t cmp)
+{
+   switch (op) {
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_shared_atomic_add:
+      return p_atomic_add_return(ptr, data) - data;
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_shared_atomic_exchange:
+      return p_atomic_xchg(ptr, data);
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+   case nir_intrinsic_shared_atomic_comp_swap:
+      return p_atomic_cmpxchg(ptr, data, cmp);
+   default:
+      break;
+   }
+
+   uint32_t old = p_atomic_read(ptr), prev;
+   do {
+      uint32_t value;
+      switch (op) {
+      case nir_intrinsic_ssbo_atomic_imin:
+      case nir_intrinsic_shared_atomic_imin:
+         value = MIN2((int32_t)old, (int32_t)data);
+         break;
+      case nir_intrinsic_ssbo_atomic_umin:
+      case nir_intrinsic_shared_atomic_umin:
+         value = MIN2(old, data);
+         break;
+      case nir_intrinsic_ssbo_atomic_imax:
+      case nir_intrinsic_shared_atomic_imax:
+         value = MAX2((int32_t)old, (int32_t)data);
+         break;
+      case nir_intrinsic_ssbo_atomic_umax:
+      case nir_intrinsic_shared_atomic_umax:
+         value = MAX2(old, data);
+         break;
+      case nir_intrinsic_ssbo_atomic_and:
+      case nir_intrinsic_shared_atomic_and:
+         value = old & data;
+         break;
+      case nir_intrinsic_ssbo_atomic_or:
+      case nir_intrinsic_shared_atomic_or:
+         value = old | data;
+         break;
+      default:
+         value = old ^ data;
+         break;
+      }
+      prev = old;
+      old = p_atomic_cmpxchg(ptr, prev, value);
+   } while (old != prev);
+
+   return old;
+}
+
+
+/**
+ * Bounds checked buffer access, out of bounds loads return zero and
+ * stores are dropped.
+ */
+static bool
+buffer_access(const struct lp_jit_buffer *buffers, unsigned num_buffers,
+              uint32_t index, uint32_t offset, unsigned size,
+              unsigned elem_size, uint8_t **ptr)
+{
+   if (index >= num_buffers)
+      return false;
+
+   const uint64_t buffer_size = (uint64_t)buffers[index].num_elements * elem_size;
+   if ((uint64_t)offset + size > buffer_size)
+      return false;
+
+   *ptr = (uint8_t *)buffers[index].u + offset;
+   return true;
+}
+
+
+static void
+run_intrinsic(const struct interp_launch *launch, struct interp_state *st,
+              const struct interp_instr *instr)
+{
+   const nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr->instr);
+   const struct lp_jit_cs_context *context = launch->context;
+   const unsigned num_components = intr->num_components;
+   union interp_value *slots = st->slots;
+   union interp_value *dst = &slots[instr->dst];
+   const union interp_value *src0 = &slots[instr->src[0]];
+   const union interp_value *src1 = &slots[instr->src[1]];
+   const union interp_value *src2 = &slots[instr->src[2]];
+   const union interp_value *src3 = &slots[instr->src[3]];
+
+   switch (intr->intrinsic) {
+   case nir_intrinsic_load_ubo:
+   case nir_intrinsic_load_ssbo: {
+      const bool ubo = intr->intrinsic == nir_intrinsic_load_ubo;
+      u_foreach_bit(l, st->exec) {
+         uint8_t *ptr;
+         bool valid = ubo ?
+            buffer_access(context->constants, ARRAY_SIZE(context->constants),
+                          src0->u[l], src1->u[l], num_components * 4,
+                          sizeof(float), &ptr) :
+            buffer_access(context->ssbos, ARRAY_SIZE(context->ssbos),
+                          src0->u[l], src1->u[l], num_components * 4,
+                          1, &ptr);
+         for (unsigned c = 0; c < num_components; c++) {
+            uint32_t value = 0;
+            if (valid)
+               memcpy(&value, ptr + c * 4, 4);
+            dst[c].u[l] = value;
+         }
+      }
+      break;
+   }
+   case nir_intrinsic_store_ssbo: {
+      const unsigned write_mask = nir_intrinsic_write_mask(intr);
+      u_foreach_bit(l, st->exec) {
+         u_foreach_bit(c, write_mask) {
+            uint8_t *ptr;
+            if (buffer_access(context->ssbos, ARRAY_SIZE(context->ssbos),
+                              src1->u[l], src2->u[l] + c * 4, 4, 1, &ptr))
+               memcpy(ptr, &src0[c].u[l], 4);
+         }
+      }
+      break;
+   }
+   case nir_intrinsic_get_ssbo_size:
+      u_foreach_bit(l, st->exec) {
+         dst->u[l] = src0->u[l] < ARRAY_SIZE(context->ssbos) ?
+            context->ssbos[src0->u[l]].num_elements : 0;
+      }
+      break;
+   case nir_intrinsic_load_shared: {
+      const unsigned base = nir_intrinsic_base(intr);
+      u_foreach_bit(l, st->exec) {
+         for (unsigned c = 0; c < num_components; c++)
+            memcpy(&dst[c].u[l], launch->shared + base + src0->u[l] + c * 4, 4);
+      }
+      break;
+   }
+   case nir_intrinsic_store_shared: {
+      const unsigned base = nir_intrinsic_base(intr);
+      const unsigned write_mask = nir_intrinsic_write_mask(intr);
+      u_foreach_bit(l, st->exec) {
+         u_foreach_bit(c, write_mask)
+            memcpy(launch->shared + base + src1->u[l] + c * 4, &src0[c].u[l], 4);
+      }
+      break;
+   }
+   case nir_intrinsic_ssbo_atomic_add:
+   case nir_intrinsic_ssbo_atomic_imin:
+   case nir_intrinsic_ssbo_atomic_umin:
+   case nir_intrinsic_ssbo_atomic_imax:
+   case nir_intrinsic_ssbo_atomic_umax:
+   case nir_intrinsic_ssbo_atomic_and:
+   case nir_intrinsic_ssbo_atomic_or:
+   case nir_intrinsic_ssbo_atomic_xor:
+   case nir_intrinsic_ssbo_atomic_exchange:
+   case nir_intrinsic_ssbo_atomic_comp_swap:
+      u_foreach_bit(l, st->exec) {
+         uint8_t *ptr;
+         uint32_t old = 0;
+         if (buffer_access(context->ssbos, ARRAY_SIZE(context->ssbos),
+                           src0->u[l], src1->u[l], 4, 1, &ptr))
+            old = atomic_op(intr->intrinsic, (uint32_t *)ptr,
+                            src2->u[l], src3->u[l]);
+         dst->u[l] = old;
+      }
+      break;
+   case nir_intrinsic_shared_atomic_add:
+   case nir_intrinsic_shared_atomic_imin:
+   case nir_intrinsic_shared_atomic_umin:
+   case nir_intrinsic_shared_atomic_imax:
+   case nir_intrinsic_shared_atomic_umax:
+   case nir_intrinsic_shared_atomic_and:
+   case nir_intrinsic_shared_atomic_or:
+   case nir_intrinsic_shared_atomic_xor:
+   case nir_intrinsic_shared_atomic_exchange:
+   case nir_intrinsic_shared_atomic_comp_swap: {
+      const unsigned base = nir_intrinsic_base(intr);
+      u_foreach_bit(l, st->exec) {
+         uint32_t *ptr = (uint32_t *)(launch->shared + base + src0->u[l]);
+         dst->u[l] = atomic_op(intr->intrinsic, ptr, src1->u[l], src2->u[l]);
+      }
+      break;
+   }
+   case nir_intrinsic_load_local_invocation_id:
+      for (unsigned c = 0; c < 3; c++) {
+         u_foreach_bit(l, st->exec)
+            dst[c].u[l] = st->local_id[c][l];
+      }
+      break;
+   case nir_intrinsic_load_local_invocation_index:
+      u_foreach_bit(l, st->exec)
+         dst->u[l] = st->local_index[l];
+      break;
+   case nir_intrinsic_load_global_invocation_id:
+      for (unsigned c = 0; c < 3; c++) {
+         const uint32_t base = launch->workgroup_id[c] * launch->block_size[c];
+         u_foreach_bit(l, st->exec)
+            dst[c].u[l] = base + st->local_id[c][l];
+      }
+      break;
+   case nir_intrinsic_load_workgroup_id:
+   case nir_intrinsic_load_num_workgroups:
+   case nir_intrinsic_load_workgroup_size: {
+      const uint32_t *values =
+         intr->intrinsic == nir_intrinsic_load_workgroup_id ? launch->workgroup_id :
+         intr->intrinsic == nir_intrinsic_load_num_workgroups ? launch->grid_size :
+         launch->block_size;
+      for (unsigned c = 0; c < 3; c++) {
+         u_foreach_bit(l, st->exec)
+            dst[c].u[l] = values[c];
+      }
+      break;
+   }
+   case nir_intrinsic_load_work_dim:
+      u_foreach_bit(l, st->exec)
+         dst->u[l] = launch->work_dim;
+      break;
+   default:
+      unreachable("unsupported intrinsic");
+   }
+}
+
+
+static uint32_t
+swizzle_texel(const uint32_t texel[4], unsigned swizzle, bool integer)
+{
+   switch (swizzle) {
+   case PIPE_SWIZZLE_0:
+      return 0;
+   case PIPE_SWIZZLE_1:
+      return integer ? 1 : fui(1.0f);
+   default:
+      return texel[swizzle];
+   }
+}
+
+
+static void
+run_tex(const struct interp_launch *launch, struct interp_state *st,
+        const struct interp_instr *instr)
+{
+   const nir_tex_instr *tex = nir_instr_as_tex(instr->instr);
+   const struct lp_jit_texture *jit_tex =
+      &launch->context->textures[tex->texture_index];
+   union interp_value *slots = st->slots;
+   union interp_value *dst = &slots[instr->dst];
+   const union interp_value *coord = &slots[instr->src[0]];
+   const union interp_value *lod =
+      instr->src[1] != ~0u ? &slots[instr->src[1]] : NULL;
+
+   const struct lp_static_texture_state *state =
+      tex->texture_index < launch->num_samplers ?
+      &launch->samplers[tex->texture_index].texture_state : NULL;
+   const enum pipe_format format = state ? state->format : PIPE_FORMAT_NONE;
+
+   /* dimensions of the coordinates, the array layer comes last */
+   const unsigned dims = tex->coord_components - tex->is_array;
+   const bool buffer = tex->sampler_dim == GLSL_SAMPLER_DIM_BUF;
+
+   u_foreach_bit(l, st->exec) {
+      const unsigned level = jit_tex->first_level + (lod ? lod->u[l] : 0);
+      const bool level_valid = !buffer ?
+         level <= jit_tex->last_level && level < LP_MAX_TEXTURE_LEVELS :
+         level == 0;
+      const uint32_t size[3] = {
+         buffer ? jit_tex->width : u_minify(jit_tex->width, level),
+         u_minify(jit_tex->height, level),
+         /* depth doubles as the array size */
+         tex->sampler_dim == GLSL_SAMPLER_DIM_3D ?
+            u_minify(jit_tex->depth, level) : jit_tex->depth,
+      };
+
+      if (tex->op == nir_texop_txs) {
+         for (unsigned c = 0; c < nir_dest_num_components(tex->dest); c++)
+            dst[c].u[l] = level_valid ? size[c < dims ? c : 2] : 0;
+         continue;
+      }
+
+      uint32_t texel[4] = { 0 };
+      if (format != PIPE_FORMAT_NONE && level_valid) {
+         uint32_t pos[3] = { 0, 0, 0 };
+         bool inside = true;
+
+         for (unsigned c = 0; c < dims; c++) {
+            pos[c] = coord[c].u[l];
+            inside &= pos[c] < size[c];
+         }
+         if (tex->is_array) {
+            pos[2] = coord[dims].u[l];
+            inside &= pos[2] < size[2];
+         }
+
+         if (inside) {
+            const uint8_t *ptr = (const uint8_t *)jit_tex->base +
+               pos[0] * util_format_get_blocksize(format);
+            if (!buffer) {
+               ptr += jit_tex->mip_offsets[level] +
+                      pos[1] * jit_tex->row_stride[level] +
+                      pos[2] * jit_tex->img_stride[level];
+            }
+            util_format_unpack_rgba(format, texel, ptr, 1);
+         }
+      }
+
+      const bool integer = util_format_is_pure_integer(format);
+      const unsigned swizzles[4] = {
+         state ? state->swizzle_r : PIPE_SWIZZLE_X,
+         state ? state->swizzle_g : PIPE_SWIZZLE_Y,
+         state ? state->swizzle_b : PIPE_SWIZZLE_Z,
+         state ? state->swizzle_a : PIPE_SWIZZLE_W,
+      };
+      for (unsigned c = 0; c < nir_dest_num_components(tex->dest); c++)
+         dst[c].u[l] = swizzle_texel(texel, swizzles[c], integer);
+   }
+}
+
+
+/**
+ * Run a subgroup until it finishes, returning true, or reaches a barrier.
+ */
+static bool
+run_subgroup(const struct interp_launch *launch, struct interp_state *st)
+{
+   const struct lp_nir_interp *interp = launch->interp;
+
+   while (st->pc < interp->num_instrs) {
+      const struct interp_instr *instr = &interp->instrs[st->pc++];
+      struct interp_frame *frame;
+
+      switch (instr->opcode) {
+      case INTERP_ALU:
+         if (st->exec)
+            run_alu(st, instr);
+         break;
+      case INTERP_INTRINSIC:
+         if (st->exec)
+            run_intrinsic(launch, st, instr);
+         break;
+      case INTERP_TEX:
+         if (st->exec)
+            run_tex(launch, st, instr);
+         break;
+      case INTERP_IF: {
+         const uint32_t cond = lane_mask(&st->slots[instr->src[0]]) & st->exec;
+         frame = &st->frames[st->sp++];
+         frame->mask0 = st->exec & ~cond;
+         set_exec(st, cond);
+         if (!cond)
+            st->pc = instr->target;
+         break;
+      }
+      case INTERP_ELSE:
+         frame = &st->frames[st->sp - 1];
+         frame->mask1 = st->exec;
+         set_exec(st, frame->mask0);
+         if (!st->exec)
+            st->pc = instr->target;
+         break;
+      case INTERP_ENDIF:
+         frame = &st->frames[--st->sp];
+         set_exec(st, frame->mask1 | st->exec);
+         break;
+      case INTERP_LOOP:
+         if (!st->exec) {
+            st->pc = instr->target;
+            break;
+         }
+         frame = &st->frames[st->sp++];
+         frame->mask0 = 0;
+         frame->mask1 = 0;
+         break;
+      case INTERP_BREAK:
+         frame = &st->frames[st->sp - 1 - instr->target];
+         frame->mask0 |= st->exec;
+         set_exec(st, 0);
+         break;
+      case INTERP_CONTINUE:
+         frame = &st->frames[st->sp - 1 - instr->target];
+         frame->mask1 |= st->exec;
+         set_exec(st, 0);
+         break;
+      case INTERP_ENDLOOP:
+         frame = &st->frames[st->sp - 1];
+         if (st->exec | frame->mask1) {
+            set_exec(st, st->exec | frame->mask1);
+            frame->mask1 = 0;
+            st->pc = instr->target;
+         } else {
+            set_exec(st, frame->mask0);
+            st->sp--;
+         }
+         break;
+      case INTERP_BARRIER:
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+static void
+init_subgroup(const struct interp_launch *launch, struct interp_state *st,
+              unsigned subgroup)
+{
+   const struct lp_nir_interp *interp = launch->interp;
+   const uint32_t *block_size = launch->block_size;
+   const unsigned num_invocations =
+      block_size[0] * block_size[1] * block_size[2];
+   uint32_t exec = 0;
+
+   memcpy(st->slots, interp->consts,
+          interp->num_consts * sizeof(union interp_value));
+   st->sp = 0;
+   st->pc = 0;
+   st->done = false;
+
+   for (unsigned l = 0; l < W; l++) {
+      const unsigned index = subgroup * W + l;
+      if (index < num_invocations)
+         exec |= 1u << l;
+      st->local_index[l] = index;
+      st->local_id[0][l] = index % block_size[0];
+      st->local_id[1][l] = index / block_size[0] % block_size[1];
+      st->local_id[2][l] = index / (block_size[0] * block_size[1]);
+   }
+
+   set_exec(st, exec);
+}
+
+
+void
+lp_nir_interp_run_cs(const struct lp_nir_interp *interp,
+                     const struct lp_sampler_static_state *samplers,
+                     unsigned num_samplers,
+                     const struct lp_jit_cs_context *context,
+                     const uint32_t block_size[3],
+                     const uint32_t workgroup_id[3],
+                     const uint32_t grid_size[3],
+                     uint32_t work_dim,
+                     struct lp_jit_cs_thread_data *thread_data)
+{
+   const struct interp_launch launch = {
+      .interp = interp,
+      .samplers = samplers,
+      .num_samplers = num_samplers,
+      .context = context,
+      .block_size = block_size,
+      .workgroup_id = workgroup_id,
+      .grid_size = grid_size,
+      .work_dim = work_dim,
+      .shared = thread_data->shared,
+   };
+   const unsigned num_subgroups =
+      DIV_ROUND_UP(block_size[0] * block_size[1] * block_size[2], W);
+   if (!num_subgroups)
+      return;
+
+   /* without barriers the subgroups can run one by one with one state */
+   const unsigned num_states = interp->has_barrier ? num_subgroups : 1;
+   const size_t slots_size = interp->num_slots * sizeof(union interp_value);
+   const size_t frames_size = interp->max_depth * sizeof(struct interp_frame);
+   const size_t state_size = slots_size + frames_size;
+
+   struct interp_state *states = MALLOC(num_states * sizeof *states);
+   uint8_t *mem = MALLOC(num_states * state_size);
+   if (!states || !mem) {
+      FREE(states);
+      FREE(mem);
+      return;
+   }
+
+   for (unsigned i = 0; i < num_states; i++) {
+      states[i].slots = (union interp_value *)(mem + i * state_size);
+      states[i].frames = (struct interp_frame *)(mem + i * state_size +
+                                                 slots_size);
+   }
+
+   if (!interp->has_barrier) {
+      for (unsigned i = 0; i < num_subgroups; i++) {
+         init_subgroup(&launch, &states[0], i);
+         run_subgroup(&launch, &states[0]);
+      }
+   } else {
+      for (unsigned i = 0; i < num_subgroups; i++)
+         init_subgroup(&launch, &states[i], i);
+
+      bool done;
+      do {
+         done = true;
+         for (unsigned i = 0; i < num_subgroups; i++) {
+            if (!states[i].done) {
+               states[i].done = run_subgroup(&launch, &states[i]);
+               done &= states[i].done;
+            }
+         }
+      } while (!done);
+   }
+
+   FREE(states);
+   FREE(mem);
+}
@@ -0,0 +1,81 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * SIMD interpreter for compute shaders in NIR.
+ *
+ * It runs a shader without generating any code, so that the first launch
+ * of a compute shader variant needn't wait for LLVM.  The shader is
+ * translated once into a flat list of instructions, each of which runs a
+ * precompiled kernel over LP_NIR_INTERP_WIDTH invocations at a time.
+ *
+ * Only a subset of NIR is supported: 32 bit ALU operations, UBO, SSBO and
+ * shared memory accesses, texel fetches and structured control flow.
+ * lp_nir_interp_create() returns NULL for other shaders, which are then
+ * always compiled.
+ */
+
+#ifndef LP_NIR_INTERP_H
+#define LP_NIR_INTERP_H
+
+#include <stdint.h>
+
+#include "pipe/p_compiler.h"
+
+
+/** Number of invocations each interpreter instruction handles */
+#define LP_NIR_INTERP_WIDTH 8
+
+struct nir_shader;
+struct lp_nir_interp;
+struct lp_jit_cs_context;
+struct lp_jit_cs_thread_data;
+struct lp_sampler_static_state;
+
+
+struct lp_nir_interp *
+lp_nir_interp_create(const struct nir_shader *nir);
+
+void
+lp_nir_interp_destroy(struct lp_nir_interp *interp);
+
+/**
+ * Run one workgroup, taking the same arguments as lp_jit_cs_func.  The
+ * texture formats come from the variant key's sampler state.
+ */
+void
+lp_nir_interp_run_cs(const struct lp_nir_interp *interp,
+                     const struct lp_sampler_static_state *samplers,
+                     unsigned num_samplers,
+                     const struct lp_jit_cs_context *context,
+                     const uint32_t block_size[3],
+                     const uint32_t workgroup_id[3],
+                     const uint32_t grid_size[3],
+                     uint32_t work_dim,
+                     struct lp_jit_cs_thread_data *thread_data);
+
+
+#endif /* LP_NIR_INTERP_H */
@@ -114,13 +114,36 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_rect_part_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_rect_partially_covered_4, p2, total_4);
 
 
+      debug_printf("llvmpipe: nr_hiz_rejected_64x64:        %9u\n", lp_count.nr_hiz_rejected_64);
+      debug_printf("llvmpipe: nr_hiz_rejected_16x16:        %9u\n", lp_count.nr_hiz_rejected_16);
+      debug_printf("llvmpipe: nr_hiz_scanned_16x16:         %9u\n", lp_count.nr_hiz_scanned_16);
+
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
+      debug_printf("llvmpipe: nr_tile_clear_merged:         %9u\n", lp_count.nr_tile_clear_merged);
+      debug_printf("llvmpipe: nr_tile_clear_elided:         %9u\n", lp_count.nr_tile_clear_elided);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      debug_printf("llvmpipe: nr_bin_chunks:                %9u\n", lp_count.nr_bin_chunks);
+      debug_printf("llvmpipe: nr_bin_replays:               %9u\n", lp_count.nr_bin_replays);
+      debug_printf("llvmpipe: nr_scene_blocks_allocated:    %9u\n", lp_count.nr_scene_blocks_allocated);
+      debug_printf("llvmpipe: nr_scene_blocks_reused:       %9u\n", lp_count.nr_scene_blocks_reused);
+      debug_printf("llvmpipe: nr_scene_forced_flushes:      %9u\n", lp_count.nr_scene_forced_flushes);
+
+      p1 = 100.0 * (float) lp_count.bin_time / (float) (lp_count.bin_time + lp_count.rast_time);
+      p2 = 100.0 * (float) lp_count.rast_time / (float) (lp_count.bin_time + lp_count.rast_time);
+
+      debug_printf("llvmpipe: binning time:                 %.2f sec (%3.0f%%)\n", lp_count.bin_time / 1000000.0, p1);
+      debug_printf("llvmpipe: rasterization time:           %.2f sec (%3.0f%%)\n", lp_count.rast_time / 1000000.0, p2);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      debug_printf("llvmpipe: nr_fs_async_compiles:         %u\n", lp_count.nr_fs_async_compiles);
+      debug_printf("llvmpipe: max FS compile queue depth:   %u\n", lp_count.max_fs_compile_queue_depth);
+      debug_printf("llvmpipe: total FS fallback time:       %.2f sec\n", lp_count.fs_fallback_time / 1000000.0);
+      debug_printf("llvmpipe: nr_shared_variants:           %u\n", lp_count.nr_shared_variants);
+
    }
 }
@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "util/u_atomic.h"
 
 /**
  * Various counters
@@ -61,13 +62,32 @@ struct lp_counters
    unsigned nr_partially_covered_4;
    unsigned nr_rect_fully_covered_4;
    unsigned nr_rect_partially_covered_4;
+   unsigned nr_hiz_rejected_64;  /**< tiles skipped by setup as occluded */
+   unsigned nr_hiz_rejected_16;  /**< 16x16 blocks skipped by the rasterizer */
+   unsigned nr_hiz_scanned_16;   /**< 16x16 blocks whose depth bound was read */
    unsigned nr_non_empty_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
+   unsigned nr_fs_async_compiles;     /**< FS variants compiled in the background */
+   unsigned fs_compile_queue_depth;   /**< FS variants currently being compiled */
+   unsigned max_fs_compile_queue_depth;
+   int64_t fs_fallback_time;  /**< total time fallback FS variants were used, in microseconds */
+   unsigned nr_shared_variants;  /**< variants using code compiled by another context */
+
    unsigned nr_color_tile_clear;
+   unsigned nr_tile_clear_merged;  /**< tile clears replaced by another clear */
+   unsigned nr_tile_clear_elided;  /**< cbuf 0 tile clears overwritten by opaque shading */
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   unsigned nr_bin_chunks;      /**< chunks binned by the binning workers */
+   unsigned nr_bin_replays;     /**< chunks rebinned serially after failure */
+   unsigned nr_scene_blocks_allocated;  /**< scene data blocks allocated */
+   unsigned nr_scene_blocks_reused;     /**< scene data blocks recycled */
+   unsigned nr_scene_forced_flushes;    /**< scenes flushed for running full */
+   int64_t bin_time;   /**< total setup/binning time, in microseconds */
+   int64_t rast_time;  /**< total rasterization time of all threads, in microseconds */
 };
 
 
@@ -79,10 +99,14 @@ extern struct lp_counters lp_count;
 #define LP_COUNT(counter) lp_count.counter++
 #define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
 #define LP_COUNT_GET(counter) (lp_count.counter)
+#define LP_COUNT_ADD_ATOMIC(counter, incr) p_atomic_add(&lp_count.counter, (incr))
+#define LP_COUNT_MAX(counter, value) lp_count.counter = MAX2(lp_count.counter, (value))
 #else
 #define LP_COUNT(counter) do {} while (0)
 #define LP_COUNT_ADD(counter, incr) (void)(incr)
 #define LP_COUNT_GET(counter) 0
+#define LP_COUNT_ADD_ATOMIC(counter, incr) (void)(incr)
+#define LP_COUNT_MAX(counter, value) (void)(value)
 #endif
 
 
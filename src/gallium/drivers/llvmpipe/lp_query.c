@@ -41,6 +41,7 @@
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_setup.h"
 
 
 static struct llvmpipe_query *
@@ -50,17 +51,102 @@ llvmpipe_query(struct pipe_query *p)
 }
 
 
+/**
+ * The current value of the counter behind a driver specific query, times
+ * in microseconds.
+ */
+static uint64_t
+driver_query_value(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   const struct lp_rasterizer *rast =
+      llvmpipe_screen(llvmpipe->pipe.screen)->rast;
+   const struct lp_setup_counters *setup =
+      lp_setup_get_counters(llvmpipe->setup);
+
+   if (type >= LP_QUERY_THREAD_COUNTERS) {
+      const unsigned thread = (type - LP_QUERY_THREAD_COUNTERS) / 2;
+
+      if (type == LP_QUERY_THREAD_BUSY_TIME(thread))
+         return lp_rast_get_counter(rast, thread, LP_RAST_COUNTER_BUSY) / 1000;
+      return lp_rast_get_counter(rast, thread, LP_RAST_COUNTER_TILES);
+   }
+
+   switch (type) {
+   case LP_QUERY_DRAW_CALLS:
+      return llvmpipe->counters.draws;
+   case LP_QUERY_DRAW_TIME:
+      return llvmpipe->counters.draw_time / 1000;
+   case LP_QUERY_FS_COMPILES:
+      return llvmpipe->counters.fs_compiles;
+   case LP_QUERY_FS_COMPILE_TIME:
+      return llvmpipe->counters.fs_compile_time;
+   case LP_QUERY_FS_COMPILE_STALLS:
+      return llvmpipe->counters.fs_compile_stalls;
+   case LP_QUERY_FS_ASYNC_COMPILES:
+      return llvmpipe->counters.fs_async_compiles;
+   case LP_QUERY_FS_GENERIC_DRAWS:
+      return llvmpipe->counters.fs_generic_draws;
+   case LP_QUERY_FS_FALLBACK_TIME:
+      return llvmpipe->counters.fs_fallback_time;
+   case LP_QUERY_VCACHE_LOOKUPS:
+   case LP_QUERY_VCACHE_HITS: {
+      uint64_t lookups, hits;
+      draw_get_vertex_cache_stats(llvmpipe->draw, &lookups, &hits);
+      return type == LP_QUERY_VCACHE_LOOKUPS ? lookups : hits;
+   }
+   case LP_QUERY_SCENES:
+      return setup->scenes;
+   case LP_QUERY_FULL_SCENES:
+      return setup->full_scenes;
+   case LP_QUERY_SCENE_WAIT_TIME:
+      return setup->scene_wait_time / 1000;
+   case LP_QUERY_SCENE_BLOCKS_ALLOCATED:
+      return setup->scene_blocks_allocated;
+   case LP_QUERY_SCENE_BLOCKS_REUSED:
+      return setup->scene_blocks_reused;
+   case LP_QUERY_BIN_CHUNKS:
+      return setup->bin_chunks;
+   case LP_QUERY_BIN_REPLAYS:
+      return setup->bin_replays;
+   case LP_QUERY_BIN_TIME:
+      return setup->bin_time / 1000;
+   case LP_QUERY_RAST_SCENES:
+      /* every thread takes part in every scene */
+      return lp_rast_get_counter(rast, 0, LP_RAST_COUNTER_SCENES);
+   case LP_QUERY_RAST_TILES:
+      return lp_rast_get_counter(rast, -1, LP_RAST_COUNTER_TILES);
+   case LP_QUERY_RAST_BUSY_TIME:
+   case LP_QUERY_RAST_WAIT_TIME:
+   case LP_QUERY_RAST_IDLE_TIME:
+      return lp_rast_get_counter(rast, -1, type - LP_QUERY_RAST_SCENES) / 1000;
+   default:
+      assert(0);
+      return 0;
+   }
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
-   assert(type < PIPE_QUERY_TYPES);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
+
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= PIPE_QUERY_DRIVER_SPECIFIC &&
+           type < LP_QUERY_THREAD_TILES(num_threads)));
 
-   struct llvmpipe_query *pq = CALLOC_STRUCT(llvmpipe_query);
+   struct llvmpipe_query *pq =
+      CALLOC(1, sizeof(struct llvmpipe_query) +
+                2 * num_threads * sizeof(uint64_t));
    if (pq) {
       pq->type = type;
       pq->index = index;
+      pq->num_threads = num_threads;
+      pq->start = &pq->counts[0];
+      pq->end = &pq->counts[num_threads];
    }
 
    return (struct pipe_query *) pq;
@@ -113,6 +199,11 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       }
    }
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      *result = pq->end[0];
+      return true;
+   }
+
    /* Sum the results from each of the threads:
     */
    *result = 0;
@@ -333,6 +424,10 @@ llvmpipe_get_query_result_resource(struct pipe_context *pipe,
          }
          break;
       default:
+         if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+            value = pq->end[0];
+            break;
+         }
          fprintf(stderr, "Unknown query type %d\n", pq->type);
          break;
       }
@@ -375,6 +470,8 @@ llvmpipe_get_query_result_resource(struct pipe_context *pipe,
       }
       }
    }
+
+   p_atomic_inc(&screen->write_timestamp);
 }
 
 
@@ -384,6 +481,15 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   /* Driver queries count what happens between begin and end, rather
+    * than the work binned in between.
+    */
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->start[0] = driver_query_value(llvmpipe, pq->type);
+      llvmpipe->active_driver_queries++;
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -392,8 +498,8 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe_finish(pipe, __func__);
    }
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_threads * sizeof(pq->start[0]));
+   memset(pq->end, 0, pq->num_threads * sizeof(pq->end[0]));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -446,6 +552,13 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->end[0] = driver_query_value(llvmpipe, pq->type) - pq->start[0];
+      assert(llvmpipe->active_driver_queries);
+      llvmpipe->active_driver_queries--;
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -570,3 +683,119 @@ llvmpipe_init_query_funcs(struct llvmpipe_context *llvmpipe)
 }
 
 
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *_screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+#define QUERY(NAME, ENUM, UNITS) \
+   {NAME, ENUM, {0}, UNITS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("lp-draw-calls", LP_QUERY_DRAW_CALLS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-draw-time", LP_QUERY_DRAW_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-fs-compiles", LP_QUERY_FS_COMPILES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-fs-compile-time", LP_QUERY_FS_COMPILE_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-fs-compile-stalls", LP_QUERY_FS_COMPILE_STALLS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-fs-async-compiles", LP_QUERY_FS_ASYNC_COMPILES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-fs-generic-draws", LP_QUERY_FS_GENERIC_DRAWS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-fs-fallback-time", LP_QUERY_FS_FALLBACK_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-vcache-lookups", LP_QUERY_VCACHE_LOOKUPS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-vcache-hits", LP_QUERY_VCACHE_HITS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-scenes", LP_QUERY_SCENES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-full-scenes", LP_QUERY_FULL_SCENES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-scene-wait-time", LP_QUERY_SCENE_WAIT_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-scene-blocks-allocated", LP_QUERY_SCENE_BLOCKS_ALLOCATED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-scene-blocks-reused", LP_QUERY_SCENE_BLOCKS_REUSED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-bin-chunks", LP_QUERY_BIN_CHUNKS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-bin-replays", LP_QUERY_BIN_REPLAYS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-bin-time", LP_QUERY_BIN_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-rast-scenes", LP_QUERY_RAST_SCENES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-rast-tiles", LP_QUERY_RAST_TILES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("lp-rast-busy-time", LP_QUERY_RAST_BUSY_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-rast-wait-time", LP_QUERY_RAST_WAIT_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("lp-rast-idle-time", LP_QUERY_RAST_IDLE_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+   };
+#undef QUERY
+
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   const unsigned num_threads =
+      screen->thread_query_names ? MAX2(1, screen->num_threads) : 0;
+
+   if (!info)
+      return ARRAY_SIZE(queries) + 2 * num_threads;
+
+   if (index < ARRAY_SIZE(queries)) {
+      *info = queries[index];
+      return 1;
+   }
+
+   /* followed by the tile count and busy time of each thread */
+   index -= ARRAY_SIZE(queries);
+   if (index >= 2 * num_threads)
+      return 0;
+
+   const unsigned busy = index / num_threads;
+   const unsigned thread = index % num_threads;
+
+   memset(info, 0, sizeof(*info));
+   info->name = screen->thread_query_names[2 * thread + busy];
+   if (busy) {
+      info->query_type = LP_QUERY_THREAD_BUSY_TIME(thread);
+      info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+   } else {
+      info->query_type = LP_QUERY_THREAD_TILES(thread);
+      info->type = PIPE_DRIVER_QUERY_TYPE_UINT64;
+   }
+   info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+
+   return 1;
+}
+
+
+/**
+ * Called once the number of rasterizer threads is known.
+ */
+void
+llvmpipe_init_screen_query_funcs(struct llvmpipe_screen *screen)
+{
+   const unsigned num_threads = MAX2(1, screen->num_threads);
+
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+
+   /* without them, only the per thread queries are missing */
+   screen->thread_query_names =
+      CALLOC(2 * num_threads, sizeof *screen->thread_query_names);
+   if (!screen->thread_query_names)
+      return;
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      snprintf(screen->thread_query_names[2 * i],
+               sizeof *screen->thread_query_names, "lp-rast-tiles-%u", i);
+      snprintf(screen->thread_query_names[2 * i + 1],
+               sizeof *screen->thread_query_names, "lp-rast-busy-time-%u", i);
+   }
+}
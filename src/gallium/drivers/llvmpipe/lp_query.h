@@ -35,15 +35,61 @@
 
 #include <limits.h>
 #include "util/u_thread.h"
+#include "util/u_threaded_context.h"
 #include "lp_limits.h"
 
 
 struct llvmpipe_context;
+struct llvmpipe_screen;
+
+
+/**
+ * Driver specific queries, listed by llvmpipe_get_driver_query_info().
+ * The rasterizer is shared by the screen's contexts, so the LP_QUERY_RAST_*
+ * and per thread queries count the work of all of them.
+ */
+enum lp_query_type {
+   LP_QUERY_DRAW_CALLS = PIPE_QUERY_DRIVER_SPECIFIC,
+   LP_QUERY_DRAW_TIME,           /**< validation, vertex processing, binning */
+   LP_QUERY_FS_COMPILES,
+   LP_QUERY_FS_COMPILE_TIME,
+   LP_QUERY_FS_COMPILE_STALLS,   /**< compiles done on the draw path */
+   LP_QUERY_FS_ASYNC_COMPILES,
+   LP_QUERY_FS_GENERIC_DRAWS,    /**< draws with a generic FS variant */
+   LP_QUERY_FS_FALLBACK_TIME,    /**< generic variants waiting for async ones */
+   LP_QUERY_VCACHE_LOOKUPS,      /**< draw module's post-transform cache */
+   LP_QUERY_VCACHE_HITS,         /**< i.e. vertex shader invocations saved */
+   LP_QUERY_SCENES,
+   LP_QUERY_FULL_SCENES,         /**< flushed for running out of space */
+   LP_QUERY_SCENE_WAIT_TIME,
+   LP_QUERY_SCENE_BLOCKS_ALLOCATED, /**< scene memory, in data blocks */
+   LP_QUERY_SCENE_BLOCKS_REUSED,
+   LP_QUERY_BIN_CHUNKS,          /**< chunks binned in parallel */
+   LP_QUERY_BIN_REPLAYS,         /**< those rebinned serially */
+   LP_QUERY_BIN_TIME,            /**< setup and binning, see LP_QUERY_DRAW_TIME */
+   LP_QUERY_RAST_SCENES,         /**< in enum lp_rast_counter order */
+   LP_QUERY_RAST_TILES,
+   LP_QUERY_RAST_BUSY_TIME,
+   LP_QUERY_RAST_WAIT_TIME,
+   LP_QUERY_RAST_IDLE_TIME,
+   LP_QUERY_THREAD_COUNTERS,     /**< see LP_QUERY_THREAD_TILES() */
+};
+
+/**
+ * The per thread queries follow the others, as many as there are
+ * rasterizer threads.
+ */
+#define LP_QUERY_THREAD_TILES(thread) \
+   (LP_QUERY_THREAD_COUNTERS + 2 * (thread))
+#define LP_QUERY_THREAD_BUSY_TIME(thread) \
+   (LP_QUERY_THREAD_COUNTERS + 2 * (thread) + 1)
 
 
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   struct threaded_query base;      /* must be first */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_threads;            /* size of start/end */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned index;
@@ -51,11 +97,15 @@ struct llvmpipe_query {
    unsigned num_primitives_written[PIPE_MAX_VERTEX_STREAMS];
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   uint64_t counts[];               /* storage for start and end */
 };
 
 
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
+extern void llvmpipe_init_screen_query_funcs(struct llvmpipe_screen *);
+
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
 #endif /* LP_QUERY_H */
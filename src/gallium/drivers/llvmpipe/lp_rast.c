@@ -28,13 +28,17 @@
 #include <limits.h>
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
 #include "util/u_memset.h"
+#include "util/u_atomic.h"
+#include "util/u_framebuffer.h"
 #include "util/os_time.h"
+#include "util/perf/cpu_trace.h"
 
 #include "lp_scene_queue.h"
 #include "lp_context.h"
@@ -67,25 +71,16 @@ const float lp_sample_pos_4x[4][2] = { { 0.375, 0.125 },
 
 /**
  * Begin rasterizing a scene.
- * Called once per scene by one thread.
+ * Called once per scene, before the scene is handed to the threads.
  */
 static void
 lp_rast_begin(struct lp_rasterizer *rast,
               struct lp_scene *scene)
 {
-   rast->curr_scene = scene;
-
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
    lp_scene_begin_rasterization(scene);
-   lp_scene_bin_iter_begin(scene);
-}
-
-
-static void
-lp_rast_end(struct lp_rasterizer *rast)
-{
-   rast->curr_scene = NULL;
+   lp_scene_bin_iter_begin(scene, rast->num_threads, rast->num_nodes);
 }
 
 
@@ -114,6 +109,10 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
+   task->hiz_valid = 0;
+   task->hiz_test = FALSE;
+   task->hiz_update = FALSE;
+
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i]) {
          task->color_tiles[i] = scene->cbufs[i].map +
@@ -130,31 +129,14 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
 
 
 /**
- * Clear the rasterizer's current color tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Write the pending clear of a colour buffer to the current tile.
+ * Clears always clear all bound layers.
  */
 static void
-lp_rast_clear_color(struct lp_rasterizer_task *task,
-                    const union lp_rast_cmd_arg arg)
+write_clear_color(struct lp_rasterizer_task *task, unsigned cbuf)
 {
    const struct lp_scene *scene = task->scene;
-   const unsigned cbuf = arg.clear_rb->cbuf;
-
-   /* we never bin clear commands for non-existing buffers */
-   assert(cbuf < scene->fb.nr_cbufs);
-   assert(scene->fb.cbufs[cbuf]);
-
    const enum pipe_format format = scene->fb.cbufs[cbuf]->format;
-   union util_color uc = arg.clear_rb->color_val;
-
-   /*
-    * this is pretty rough since we have target format (bunch of bytes...)
-    * here. dump it as raw 4 dwords.
-    */
-   LP_DBG(DEBUG_RAST,
-          "%s clear value (target format %d) raw 0x%x,0x%x,0x%x,0x%x\n",
-          __func__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
 
    for (unsigned s = 0; s < scene->cbufs[cbuf].nr_samples; s++) {
       void *map = (char *) scene->cbufs[cbuf].map
@@ -169,121 +151,257 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                     task->width,
                     task->height,
                     scene->fb_max_layer + 1,
-                    &uc);
+                    &task->clear_color[cbuf]);
    }
-
-   /* this will increase for each rb which probably doesn't mean much */
-   LP_COUNT(nr_color_tile_clear);
 }
 
 
 /**
- * Clear the rasterizer's current z/stencil tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Write the pending depth/stencil clear to the current tile.
  */
 static void
-lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
-                       const union lp_rast_cmd_arg arg)
+write_clear_zstencil(struct lp_rasterizer_task *task)
 {
    const struct lp_scene *scene = task->scene;
-   uint64_t clear_value64 = arg.clear_zstencil.value;
-   uint64_t clear_mask64 = arg.clear_zstencil.mask;
+   uint64_t clear_value64 = task->clear_zs_value;
+   uint64_t clear_mask64 = task->clear_zs_mask;
    uint32_t clear_value = (uint32_t) clear_value64;
    uint32_t clear_mask = (uint32_t) clear_mask64;
    const unsigned height = task->height;
    const unsigned width = task->width;
    const unsigned dst_stride = scene->zsbuf.stride;
 
-   LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
-           __func__, clear_value, clear_mask);
-
-   /*
-    * Clear the area of the depth/depth buffer matching this tile.
-    */
-
-   if (scene->fb.zsbuf) {
-      for (unsigned s = 0; s < scene->zsbuf.nr_samples; s++) {
-         uint8_t *dst_layer =
-            task->depth_tile + (s * scene->zsbuf.sample_stride);
-         const unsigned block_size =
-            util_format_get_blocksize(scene->fb.zsbuf->format);
+   for (unsigned s = 0; s < scene->zsbuf.nr_samples; s++) {
+      uint8_t *dst_layer =
+         task->depth_tile + (s * scene->zsbuf.sample_stride);
+      const unsigned block_size =
+         util_format_get_blocksize(scene->fb.zsbuf->format);
 
-         clear_value &= clear_mask;
+      clear_value &= clear_mask;
 
-         for (unsigned layer = 0; layer <= scene->fb_max_layer; layer++) {
-            uint8_t *dst = dst_layer;
+      for (unsigned layer = 0; layer <= scene->fb_max_layer; layer++) {
+         uint8_t *dst = dst_layer;
 
-            switch (block_size) {
-            case 1:
-               assert(clear_mask == 0xff);
+         switch (block_size) {
+         case 1:
+            assert(clear_mask == 0xff);
+            for (unsigned i = 0; i < height; i++) {
+               uint8_t *row = (uint8_t *)dst;
+               memset(row, (uint8_t) clear_value, width);
+               dst += dst_stride;
+            }
+            break;
+         case 2:
+            if (clear_mask == 0xffff) {
                for (unsigned i = 0; i < height; i++) {
-                  uint8_t *row = (uint8_t *)dst;
-                  memset(row, (uint8_t) clear_value, width);
+                  uint16_t *row = (uint16_t *)dst;
+                  for (unsigned j = 0; j < width; j++)
+                     *row++ = (uint16_t) clear_value;
                   dst += dst_stride;
                }
-               break;
-            case 2:
-               if (clear_mask == 0xffff) {
-                  for (unsigned i = 0; i < height; i++) {
-                     uint16_t *row = (uint16_t *)dst;
-                     for (unsigned j = 0; j < width; j++)
-                        *row++ = (uint16_t) clear_value;
-                     dst += dst_stride;
-                  }
-               } else {
-                  for (unsigned i = 0; i < height; i++) {
-                     uint16_t *row = (uint16_t *)dst;
-                     for (unsigned j = 0; j < width; j++) {
-                        uint16_t tmp = ~clear_mask & *row;
-                        *row++ = clear_value | tmp;
-                     }
-                     dst += dst_stride;
+            } else {
+               for (unsigned i = 0; i < height; i++) {
+                  uint16_t *row = (uint16_t *)dst;
+                  for (unsigned j = 0; j < width; j++) {
+                     uint16_t tmp = ~clear_mask & *row;
+                     *row++ = clear_value | tmp;
                   }
+                  dst += dst_stride;
                }
-               break;
-            case 4:
-               if (clear_mask == 0xffffffff) {
-                  for (unsigned i = 0; i < height; i++) {
-                     util_memset32(dst, clear_value, width);
-                     dst += dst_stride;
-                  }
-               } else {
-                  for (unsigned i = 0; i < height; i++) {
-                     uint32_t *row = (uint32_t *)dst;
-                     for (unsigned j = 0; j < width; j++) {
-                        uint32_t tmp = ~clear_mask & *row;
-                        *row++ = clear_value | tmp;
-                     }
-                     dst += dst_stride;
-                  }
+            }
+            break;
+         case 4:
+            if (clear_mask == 0xffffffff) {
+               for (unsigned i = 0; i < height; i++) {
+                  util_memset32(dst, clear_value, width);
+                  dst += dst_stride;
                }
-               break;
-            case 8:
-               clear_value64 &= clear_mask64;
-               if (clear_mask64 == 0xffffffffffULL) {
-                  for (unsigned i = 0; i < height; i++) {
-                     util_memset64(dst, clear_value64, width);
-                     dst += dst_stride;
+            } else {
+               for (unsigned i = 0; i < height; i++) {
+                  uint32_t *row = (uint32_t *)dst;
+                  for (unsigned j = 0; j < width; j++) {
+                     uint32_t tmp = ~clear_mask & *row;
+                     *row++ = clear_value | tmp;
                   }
-               } else {
-                  for (unsigned i = 0; i < height; i++) {
-                     uint64_t *row = (uint64_t *)dst;
-                     for (unsigned j = 0; j < width; j++) {
-                        uint64_t tmp = ~clear_mask64 & *row;
-                        *row++ = clear_value64 | tmp;
-                     }
-                     dst += dst_stride;
+                  dst += dst_stride;
+               }
+            }
+            break;
+         case 8:
+            clear_value64 &= clear_mask64;
+            if (clear_mask64 == 0xffffffffffULL) {
+               for (unsigned i = 0; i < height; i++) {
+                  util_memset64(dst, clear_value64, width);
+                  dst += dst_stride;
+               }
+            } else {
+               for (unsigned i = 0; i < height; i++) {
+                  uint64_t *row = (uint64_t *)dst;
+                  for (unsigned j = 0; j < width; j++) {
+                     uint64_t tmp = ~clear_mask64 & *row;
+                     *row++ = clear_value64 | tmp;
                   }
+                  dst += dst_stride;
                }
-               break;
-
-            default:
-               assert(0);
-               break;
             }
-            dst_layer += scene->zsbuf.layer_stride;
+            break;
+
+         default:
+            assert(0);
+            break;
          }
+         dst_layer += scene->zsbuf.layer_stride;
+      }
+   }
+}
+
+
+/**
+ * Write the given pending clears to the current tile.
+ */
+static void
+write_clears(struct lp_rasterizer_task *task, unsigned clears)
+{
+   u_foreach_bit(i, clears & ~LP_RAST_CLEAR_ZS)
+      write_clear_color(task, i);
+   if (clears & LP_RAST_CLEAR_ZS)
+      write_clear_zstencil(task);
+
+   task->clear_pending &= ~clears;
+}
+
+
+/**
+ * Write the pending clears which the command about to run on the current
+ * tile depends on.  Called before each command while task->clear_pending
+ * is set.
+ *
+ * The only clear which is ever dropped rather than written is the one of
+ * colour buffer 0, when an opaque shade or blit overwrites the whole tile
+ * of a single sample, single layer framebuffer.  Pending depth/stencil
+ * clears are always written, as no command overwrites that tile entirely.
+ */
+void
+lp_rast_resolve_clears(struct lp_rasterizer_task *task,
+                       unsigned cmd, const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned resolve = task->clear_pending;
+
+   switch (cmd) {
+   case LP_RAST_OP_CLEAR_COLOR:
+   case LP_RAST_OP_CLEAR_ZSTENCIL:
+   case LP_RAST_OP_SET_STATE:
+   case LP_RAST_OP_BEGIN_QUERY:
+   case LP_RAST_OP_END_QUERY:
+      /* don't touch the tile */
+      return;
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+   case LP_RAST_OP_BLIT:
+      if (arg.shade_tile->disable)
+         return;
+
+      /*
+       * Opaque shaders don't use depth/stencil.  They write every pixel of
+       * colour buffer 0, but only one sample (they're never multisample
+       * variants) and only the layer the primitive is on, see
+       * lp_setup_whole_tile().  Other colour buffers may be blended.
+       */
+      resolve &= ~LP_RAST_CLEAR_ZS;
+      if (scene->fb_max_layer == 0 &&
+          scene->cbufs[0].nr_samples == 1 &&
+          (resolve & 1)) {
+         resolve &= ~1;
+         task->clear_pending &= ~1;
+         LP_COUNT(nr_tile_clear_elided);
+      }
+      break;
+   default:
+      break;
+   }
+
+   write_clears(task, resolve);
+}
+
+
+/**
+ * Clear the rasterizer's current color tile.
+ * This is a bin command called during bin processing.
+ * Clear commands always clear all bound layers.  The clear is only
+ * recorded here, and written by lp_rast_resolve_clears() once something
+ * uses the tile.
+ */
+void
+lp_rast_clear_color(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   const unsigned cbuf = arg.clear_rb->cbuf;
+
+   /* we never bin clear commands for non-existing buffers */
+   assert(cbuf < scene->fb.nr_cbufs);
+   assert(scene->fb.cbufs[cbuf]);
+
+   const enum pipe_format format = scene->fb.cbufs[cbuf]->format;
+   union util_color uc = arg.clear_rb->color_val;
+
+   /*
+    * this is pretty rough since we have target format (bunch of bytes...)
+    * here. dump it as raw 4 dwords.
+    */
+   LP_DBG(DEBUG_RAST,
+          "%s clear value (target format %d) raw 0x%x,0x%x,0x%x,0x%x\n",
+          __func__, format, uc.ui[0], uc.ui[1], uc.ui[2], uc.ui[3]);
+
+   if (task->clear_pending & (1 << cbuf))
+      LP_COUNT(nr_tile_clear_merged);
+
+   task->clear_color[cbuf] = uc;
+   task->clear_pending |= 1 << cbuf;
+
+   /* this will increase for each rb which probably doesn't mean much */
+   LP_COUNT(nr_color_tile_clear);
+}
+
+
+/**
+ * Clear the rasterizer's current z/stencil tile.
+ * This is a bin command called during bin processing.
+ * Clear commands always clear all bound layers.  As with colour, the
+ * clear is only recorded, merged with any pending one.
+ */
+static void
+lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
+                       const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   const uint64_t clear_value64 = arg.clear_zstencil.value;
+   const uint64_t clear_mask64 = arg.clear_zstencil.mask;
+
+   LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
+           __func__, (uint32_t) clear_value64, (uint32_t) clear_mask64);
+
+   if (scene->fb.zsbuf) {
+      if (task->clear_pending & LP_RAST_CLEAR_ZS) {
+         if (!(task->clear_zs_mask & ~clear_mask64))
+            LP_COUNT(nr_tile_clear_merged);
+         task->clear_zs_value = (task->clear_zs_value & ~clear_mask64) |
+                                (clear_value64 & clear_mask64);
+         task->clear_zs_mask |= clear_mask64;
+      } else {
+         task->clear_zs_value = clear_value64 & clear_mask64;
+         task->clear_zs_mask = clear_mask64;
+         task->clear_pending |= LP_RAST_CLEAR_ZS;
+      }
+
+      float depth;
+      if (scene->hiz &&
+          lp_rast_clear_depth_value(scene->fb.zsbuf->format,
+                                    arg.clear_zstencil.value,
+                                    arg.clear_zstencil.mask, &depth)) {
+         for (unsigned i = 0; i < ARRAY_SIZE(task->hiz_zmax); i++)
+            task->hiz_zmax[i] = depth;
+         task->hiz_valid = 0xffff;
       }
    }
 }
@@ -317,9 +435,26 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
    const struct lp_fragment_shader_variant *variant = state->variant;
 
+   /* skip the 16x16 blocks where the primitive is known to be hidden */
+   unsigned hiz_mask = 0;
+   if (task->hiz_test) {
+      for (unsigned y = 0; y < task->height; y += 16) {
+         for (unsigned x = 0; x < task->width; x += 16) {
+            if (lp_rast_hiz_occluded(task, inputs, tile_x + x, tile_y + y,
+                                     tile_x + x + 15, tile_y + y + 15)) {
+               hiz_mask |= 1 << (y / 16 * 4 + x / 16);
+               LP_COUNT(nr_hiz_rejected_16);
+            }
+         }
+      }
+   }
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (unsigned y = 0; y < task->height; y += 4){
       for (unsigned x = 0; x < task->width; x += 4) {
+         if (hiz_mask & (1 << (y / 16 * 4 + x / 16)))
+            continue;
+
          /* color buffer */
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
@@ -377,6 +512,13 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          END_JIT_CALL();
       }
    }
+
+   if (task->hiz_update) {
+      for (unsigned y = 0; y < task->height; y += 16) {
+         for (unsigned x = 0; x < task->width; x += 16)
+            lp_rast_hiz_covered_16(task, inputs, tile_x + x, tile_y + y);
+      }
+   }
 }
 
 
@@ -682,7 +824,114 @@ void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
+   const struct lp_fragment_shader_variant *variant = arg.set_state->variant;
+
    task->state = arg.set_state;
+
+   task->hiz_test = task->scene->hiz && variant->hiz_test;
+   task->hiz_update = task->scene->hiz && variant->hiz_update;
+   if (variant->hiz_invalidate)
+      task->hiz_valid = 0;
+}
+
+
+/**
+ * Get the depth bound of the 16x16 block of the current tile at bx, by,
+ * reading the depth values if it isn't known.
+ */
+static float
+lp_rast_hiz_block_bound(struct lp_rasterizer_task *task,
+                        unsigned bx, unsigned by)
+{
+   const unsigned i = by * 4 + bx;
+
+   if (!(task->hiz_valid & (1 << i))) {
+      const struct lp_scene *scene = task->scene;
+      const enum pipe_format format = scene->fb.zsbuf->format;
+      const unsigned x = bx * 16, y = by * 16;
+      const unsigned width = x < task->width ? MIN2(task->width - x, 16) : 0;
+      const unsigned height = y < task->height ? MIN2(task->height - y, 16) : 0;
+      const uint8_t *depth = task->depth_tile +
+                             y * scene->zsbuf.stride +
+                             x * scene->zsbuf.format_bytes;
+      float zmax = -INFINITY;
+
+      for (unsigned row = 0; row < height; row++) {
+         float values[16];
+
+         util_format_unpack_z_float(format, values, depth, width);
+         for (unsigned col = 0; col < width; col++) {
+            if (values[col] > zmax)
+               zmax = values[col];
+         }
+         depth += scene->zsbuf.stride;
+      }
+
+      task->hiz_zmax[i] = zmax;
+      task->hiz_valid |= 1 << i;
+      LP_COUNT(nr_hiz_scanned_16);
+   }
+
+   return task->hiz_zmax[i];
+}
+
+
+/**
+ * Whether the primitive is known to fail the depth test in the pixels
+ * [x0, x1] x [y0, y1] (window coords) of the current tile.
+ */
+boolean
+lp_rast_hiz_occluded(struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs,
+                     int x0, int y0, int x1, int y1)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   float bound = -INFINITY;
+   float zmin, zmax;
+
+   assert(task->hiz_test);
+
+   for (unsigned by = (y0 - task->y) / 16; by <= (y1 - task->y) / 16; by++) {
+      for (unsigned bx = (x0 - task->x) / 16; bx <= (x1 - task->x) / 16; bx++)
+         bound = MAX2(bound, lp_rast_hiz_block_bound(task, bx, by));
+   }
+
+   lp_rast_depth_bounds(inputs, task->scene->hiz_quantum,
+                        variant->key.restrict_depth_values,
+                        x0, y0, x1, y1, &zmin, &zmax);
+
+   return lp_rast_depth_occluded(zmin, bound,
+                                 variant->key.depth.func == PIPE_FUNC_LEQUAL);
+}
+
+
+/**
+ * Tighten the depth bound of the 16x16 block at x, y (window coords),
+ * which the primitive fully covers.
+ */
+void
+lp_rast_hiz_covered_16(struct lp_rasterizer_task *task,
+                       const struct lp_rast_shader_inputs *inputs,
+                       int x, int y)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   const unsigned i = (y - task->y) / 16 * 4 + (x - task->x) / 16;
+   float zmin, zmax;
+
+   assert(task->hiz_update);
+
+   lp_rast_depth_bounds(inputs, task->scene->hiz_quantum,
+                        variant->key.restrict_depth_values,
+                        x, y, x + 15, y + 15, &zmin, &zmax);
+
+   /* Not a usable bound if NaN */
+   if (!(zmax < INFINITY))
+      return;
+
+   if (!(task->hiz_valid & (1 << i)) || zmax < task->hiz_zmax[i]) {
+      task->hiz_zmax[i] = zmax;
+      task->hiz_valid |= 1 << i;
+   }
 }
 
 
@@ -692,6 +941,9 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
 static void
 lp_rast_tile_end(struct lp_rasterizer_task *task)
 {
+   /* the clears nothing used yet, the tile is the resource's memory */
+   if (task->clear_pending)
+      write_clears(task, task->clear_pending);
 
    for (unsigned i = 0; i < task->scene->num_active_queries; ++i) {
       lp_rast_end_query(task,
@@ -712,8 +964,8 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
 #define RECT  ((LP_RAST_FLAGS_RECT<<1)-1)     /* direct rectangle rasterizer */
 #define BLIT  ((LP_RAST_FLAGS_BLIT<<1)-1)     /* write direct-to-dest */
 
-static const unsigned
-rast_flags[] = {
+const unsigned
+lp_rast_op_flags[] = {
    BLIT,                        /* clear color */
    TRI,                         /* clear zstencil */
    TRI,                         /* triangle_1 */
@@ -910,22 +1162,58 @@ dispatch_tri_debug[] =
 };
 
 
-struct lp_bin_info
-lp_characterize_bin(const struct cmd_bin *bin)
+/**
+ * Fill in a dispatch table, indexed by LP_RAST_OP_x, using the triangle
+ * functions which compute the coverage masks with the given vector
+ * extension.  Returns FALSE if it wasn't built or isn't supported by the
+ * CPU.
+ */
+boolean
+lp_rast_init_dispatch(lp_rast_cmd_func *dispatch, enum lp_rast_simd simd)
 {
-   unsigned andflags = ~0, j = 0;
+   switch (simd) {
+   case LP_RAST_SIMD_DEFAULT:
+      break;
+#ifdef LP_RAST_HAVE_AVX2
+   case LP_RAST_SIMD_AVX2:
+      if (!util_get_cpu_caps()->has_avx2)
+         return FALSE;
+      break;
+#endif
+#ifdef LP_RAST_HAVE_AVX512
+   case LP_RAST_SIMD_AVX512:
+      if (!util_get_cpu_caps()->has_avx512f)
+         return FALSE;
+      break;
+#endif
+   default:
+      return FALSE;
+   }
 
-   STATIC_ASSERT(ARRAY_SIZE(rast_flags) == LP_RAST_OP_MAX);
+   memcpy(dispatch, dispatch_tri, sizeof dispatch_tri);
+
+#ifdef LP_RAST_HAVE_AVX2
+   if (simd == LP_RAST_SIMD_AVX2)
+      lp_rast_tri_init_dispatch_avx2(dispatch);
+#endif
+#ifdef LP_RAST_HAVE_AVX512
+   if (simd == LP_RAST_SIMD_AVX512)
+      lp_rast_tri_init_dispatch_avx512(dispatch);
+#endif
+
+   return TRUE;
+}
 
-   for (const struct cmd_block *block = bin->head; block; block = block->next) {
-      for (unsigned k = 0; k < block->count; k++, j++) {
-         andflags &= rast_flags[block->cmd[k]];
-      }
-   }
 
+struct lp_bin_info
+lp_characterize_bin(const struct cmd_bin *bin)
+{
+   STATIC_ASSERT(ARRAY_SIZE(lp_rast_op_flags) == LP_RAST_OP_MAX);
+
+   /* Accumulated by lp_scene_bin_command() */
    struct lp_bin_info info;
-   info.type = andflags;
-   info.count = j;
+   info.type = ~bin->not_flags;
+   info.count = bin->count;
 
    return info;
 }
@@ -940,6 +1228,8 @@ blit_rasterize_bin(struct lp_rasterizer_task *task,
    if (0) debug_printf("%s\n", __func__);
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
+         if (task->clear_pending)
+            lp_rast_resolve_clears(task, block->cmd[k], block->arg[k]);
          dispatch_blit[block->cmd[k]](task, block->arg[k]);
       }
    }
@@ -955,7 +1245,9 @@ tri_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
-         dispatch_tri[block->cmd[k]](task, block->arg[k]);
+         if (task->clear_pending)
+            lp_rast_resolve_clears(task, block->cmd[k], block->arg[k]);
+         task->rast->dispatch_tri[block->cmd[k]](task, block->arg[k]);
       }
    }
 }
@@ -969,6 +1261,8 @@ debug_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
+         if (task->clear_pending)
+            lp_rast_resolve_clears(task, block->cmd[k], block->arg[k]);
          dispatch_tri_debug[block->cmd[k]](task, block->arg[k]);
       }
    }
@@ -985,6 +1279,8 @@ static void
 rasterize_bin(struct lp_rasterizer_task *task,
               const struct cmd_bin *bin, int x, int y)
 {
+   MESA_TRACE_SCOPE_SLOW("lp_rast_tile");
+
    struct lp_bin_info info = lp_characterize_bin(bin);
 
    lp_rast_tile_begin(task, bin, x, y);
@@ -1032,6 +1328,29 @@ is_empty_bin(const struct cmd_bin *bin)
 }
 
 
+/**
+ * Wait until the bin of the previous scene for the given tile is done.
+ * All bins of the previous scene have been handed out before any thread
+ * starts on this one, and no thread waits on a later scene, so whoever
+ * owns that bin is making progress.
+ * \return the time waited, in nanoseconds
+ */
+static int64_t
+wait_for_tile(const unsigned *tile_done, unsigned seq)
+{
+   if (p_atomic_read(tile_done) == seq)
+      return 0;
+
+   MESA_TRACE_FUNC();
+
+   int64_t start = os_time_get_nano();
+   while (p_atomic_read(tile_done) != seq)
+      thrd_yield();
+
+   return os_time_get_nano() - start;
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -1040,6 +1359,13 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   MESA_TRACE_FUNC();
+
+   struct lp_rasterizer *rast = task->rast;
+   int64_t start = os_time_get_nano();
+   int64_t wait = 0;
+   unsigned tiles = 0;
+
    task->scene = scene;
 
    /* Clear the cache tags. This should not always be necessary but
@@ -1053,20 +1379,49 @@ rasterize_scene(struct lp_rasterizer_task *task,
 #endif
 #endif
 
-   if (!task->rast->no_rast) {
-      /* loop over scene bins, rasterize each */
-      {
-         struct cmd_bin *bin;
-         int i, j;
+   /* The scene may not overlap with the previous one, wait for all threads
+    * to be done with it.
+    */
+   if (scene->rast_prev_fence && !lp_fence_signalled(scene->rast_prev_fence)) {
+      MESA_TRACE_SCOPE("lp_rast_wait_scene");
+      lp_fence_wait(scene->rast_prev_fence);
+      wait = os_time_get_nano() - start;
+   }
 
-         assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-            if (!is_empty_bin(bin))
-               rasterize_bin(task, bin, i, j);
+   /* loop over scene bins, rasterize each */
+   {
+      struct lp_scene_bin_iter iter = { .group = task->node };
+      struct cmd_bin *bin;
+      int i, j;
+
+      assert(scene);
+      while ((bin = lp_scene_bin_iter_next(scene, &iter, &i, &j))) {
+         unsigned *tile_done = NULL;
+
+         if (rast->tile_done) {
+            tile_done = &rast->tile_done[j * scene->tiles_x + i];
+            if (scene->rast_overlap)
+               wait += wait_for_tile(tile_done, scene->rast_seq - 1);
+         }
+
+         if (!rast->no_rast && !is_empty_bin(bin)) {
+            rasterize_bin(task, bin, i, j);
+            tiles++;
          }
+
+         if (tile_done)
+            p_atomic_set(tile_done, scene->rast_seq);
       }
    }
 
+   const int64_t busy = os_time_get_nano() - start - wait;
+   p_atomic_inc(&task->counters[LP_RAST_COUNTER_SCENES]);
+   p_atomic_add(&task->counters[LP_RAST_COUNTER_TILES], tiles);
+   p_atomic_add(&task->counters[LP_RAST_COUNTER_BUSY], busy);
+   p_atomic_add(&task->counters[LP_RAST_COUNTER_WAIT], wait);
+
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      LP_COUNT_ADD_ATOMIC(rast_time, busy / 1000);
 
 #if LP_BUILD_FORMAT_CACHE_DEBUG
    {
@@ -1090,6 +1445,74 @@ rasterize_scene(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Does the scene access resources in a way which forbids overlapping it
+ * with the scenes queued before or after it?  Overlapping scenes are only
+ * ordered per tile of their (shared) framebuffer, so this is the case
+ * when the scene writes anything else, or reads one of its render targets.
+ */
+static boolean
+scene_needs_serialize(const struct lp_scene *scene)
+{
+   if (scene->writeable_resources)
+      return TRUE;
+
+   for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct pipe_surface *cbuf = scene->fb.cbufs[i];
+      if (cbuf && lp_scene_is_resource_referenced(scene, cbuf->texture))
+         return TRUE;
+   }
+
+   if (scene->fb.zsbuf &&
+       lp_scene_is_resource_referenced(scene, scene->fb.zsbuf->texture))
+      return TRUE;
+
+   return FALSE;
+}
+
+
+/**
+ * Drop the references to the previous scene's surfaces.  The context
+ * which created them may have been destroyed since, but llvmpipe
+ * surfaces don't need it to be freed.
+ */
+static void
+release_last_fb(struct lp_rasterizer *rast)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(rast->last_fb.cbufs); i++) {
+      if (rast->last_fb.cbufs[i])
+         pipe_surface_release_no_context(&rast->last_fb.cbufs[i]);
+   }
+
+   if (rast->last_fb.zsbuf)
+      pipe_surface_release_no_context(&rast->last_fb.zsbuf);
+}
+
+
+/**
+ * Decide how the scene is ordered against the previously queued one.
+ * Must be called before rast->last_fence is updated.
+ */
+static void
+pipeline_scene(struct lp_rasterizer *rast,
+               struct lp_scene *scene)
+{
+   const boolean serialize = scene_needs_serialize(scene);
+
+   scene->rast_seq = ++rast->last_seq;
+   scene->rast_overlap = !serialize && !rast->last_serialize &&
+      util_framebuffer_state_equal(&rast->last_fb, &scene->fb);
+
+   if (!scene->rast_overlap) {
+      lp_fence_reference(&scene->rast_prev_fence, rast->last_fence);
+      release_last_fb(rast);
+      util_copy_framebuffer_state(&rast->last_fb, &scene->fb);
+   }
+
+   rast->last_serialize = serialize;
+}
+
+
 /**
  * Called by setup module when it has something for us to render.
  */
@@ -1099,6 +1522,9 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
 {
    LP_DBG(DEBUG_SETUP, "%s\n", __func__);
 
+   if (rast->num_threads)
+      pipeline_scene(rast, scene);
+
    lp_fence_reference(&rast->last_fence, scene->fence);
    if (rast->last_fence)
       rast->last_fence->issued = TRUE;
@@ -1116,15 +1542,14 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
 
       rasterize_scene(&rast->tasks[0], scene);
 
-      lp_rast_end(rast);
-
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    } else {
       /* threaded rendering! */
       unsigned i;
 
+      /* map the framebuffer surfaces */
+      lp_rast_begin(rast, scene);
+
       lp_scene_enqueue(rast->full_scenes, scene);
 
       /* signal the threads that there's work to do */
@@ -1153,12 +1578,35 @@ lp_rast_finish(struct lp_rasterizer *rast)
 }
 
 
+/**
+ * Read a counter of one rasterizer thread, or the sum over all threads
+ * if 'thread' is negative.
+ */
+uint64_t
+lp_rast_get_counter(const struct lp_rasterizer *rast, int thread,
+                    enum lp_rast_counter counter)
+{
+   uint64_t value = 0;
+
+   for (int i = 0; i < (int)MAX2(1, rast->num_threads); i++) {
+      if (thread < 0 || thread == i)
+         value += p_atomic_read(&rast->tasks[i].counters[counter]);
+   }
+
+   return value;
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
  *   3. signal that we're done
+ *
+ * There is no synchronization between the threads at scene boundaries,
+ * a thread done with its share of a scene's bins moves on to the next
+ * queued scene right away.  Scene completion is tracked by its fence.
  */
 static int
 thread_function(void *init_data)
@@ -1177,42 +1625,41 @@ thread_function(void *init_data)
    unsigned fpstate = util_fpstate_get();
    util_fpstate_set_denorms_to_zero(fpstate);
 
+   if (rast->num_nodes > 1) {
+      const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+      util_set_current_thread_affinity(caps->node_affinity_mask[task->node],
+                                       NULL, caps->num_cpu_mask_bits);
+
+      /* Memory ends up on the node of the thread first touching it, so
+       * replace the texture cache allocated at creation with our own.
+       */
+      struct lp_build_format_cache *cache =
+         align_malloc(sizeof(struct lp_build_format_cache), 16);
+      if (cache) {
+         align_free(task->thread_data.cache);
+         task->thread_data.cache = cache;
+      }
+   }
+
    while (1) {
       /* wait for work */
       if (debug)
          debug_printf("thread %d waiting for work\n", task->thread_index);
+      int64_t idle_start = os_time_get_nano();
       util_semaphore_wait(&task->work_ready);
+      p_atomic_add(&task->counters[LP_RAST_COUNTER_IDLE],
+                   os_time_get_nano() - idle_start);
 
       if (rast->exit_flag)
          break;
 
-      if (task->thread_index == 0) {
-         /* thread[0]:
-          *  - get next scene to rasterize
-          *  - map the framebuffer surfaces
-          */
-         lp_rast_begin(rast, lp_scene_dequeue(rast->full_scenes, TRUE));
-      }
-
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
-       */
-      util_barrier_wait(&rast->barrier);
-
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task, rast->curr_scene);
-
-      /* wait for all threads to finish with this scene */
-      util_barrier_wait(&rast->barrier);
-
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
-         lp_rast_end(rast);
-      }
+      rasterize_scene(task, lp_scene_dequeue(rast->full_scenes,
+                                             task->thread_index, TRUE));
 
       /* signal done with work */
       if (debug)
@@ -1252,9 +1699,11 @@ create_rast_threads(struct lp_rasterizer *rast)
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
  * \param num_threads  number of rasterizer threads to create
+ * \param num_nodes  number of NUMA nodes to spread the threads over,
+ *                   one to leave thread placement to the OS
  */
 struct lp_rasterizer *
-lp_rast_create(unsigned num_threads)
+lp_rast_create(unsigned num_threads, unsigned num_nodes)
 {
    struct lp_rasterizer *rast;
    unsigned i;
@@ -1264,15 +1713,19 @@ lp_rast_create(unsigned num_threads)
       goto no_rast;
    }
 
-   rast->full_scenes = lp_scene_queue_create();
-   if (!rast->full_scenes) {
-      goto no_full_scenes;
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(struct lp_rasterizer_task));
+   rast->threads = CALLOC(MAX2(1, num_threads), sizeof(thrd_t));
+   if (!rast->tasks || !rast->threads) {
+      goto no_thread_data_cache;
    }
 
+   rast->num_nodes = num_threads > 1 ? MAX2(1, num_nodes) : 1;
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->node = i * rast->num_nodes / MAX2(1, num_threads);
       task->thread_data.cache =
          align_malloc(sizeof(struct lp_build_format_cache), 16);
       if (!task->thread_data.cache) {
@@ -1284,11 +1737,24 @@ lp_rast_create(unsigned num_threads)
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
+   /* Use the widest vector extension available for the coverage masks */
+   if (!lp_rast_init_dispatch(rast->dispatch_tri, LP_RAST_SIMD_AVX512) &&
+       !lp_rast_init_dispatch(rast->dispatch_tri, LP_RAST_SIMD_AVX2))
+      lp_rast_init_dispatch(rast->dispatch_tri, LP_RAST_SIMD_DEFAULT);
+
    create_rast_threads(rast);
 
-   /* for synchronizing rasterization threads */
+   /* Created after the threads, as every queued scene is handed to each
+    * thread which actually exists.  The threads won't touch the queue
+    * before anything has been queued.
+    */
+   rast->full_scenes = lp_scene_queue_create(MAX2(1, rast->num_threads));
    if (rast->num_threads > 0) {
-      util_barrier_init(&rast->barrier, rast->num_threads);
+      rast->tile_done = CALLOC(TILES_X * TILES_Y, sizeof(unsigned));
+   }
+   if (!rast->full_scenes || (rast->num_threads > 0 && !rast->tile_done)) {
+      lp_rast_destroy(rast);
+      return NULL;
    }
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
@@ -1296,14 +1762,16 @@ lp_rast_create(unsigned num_threads)
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      if (rast->tasks[i].thread_data.cache) {
-         align_free(rast->tasks[i].thread_data.cache);
+   if (rast->tasks) {
+      for (i = 0; i < MAX2(1, num_threads); i++) {
+         if (rast->tasks[i].thread_data.cache) {
+            align_free(rast->tasks[i].thread_data.cache);
+         }
       }
    }
 
-   lp_scene_queue_destroy(rast->full_scenes);
-no_full_scenes:
+   FREE(rast->tasks);
+   FREE(rast->threads);
    FREE(rast);
 no_rast:
    return NULL;
@@ -1352,14 +1820,14 @@ lp_rast_destroy(struct lp_rasterizer *rast)
    }
 
    lp_fence_reference(&rast->last_fence, NULL);
+   release_last_fb(rast);
+   FREE(rast->tile_done);
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_destroy(&rast->barrier);
-   }
-
-   lp_scene_queue_destroy(rast->full_scenes);
+   if (rast->full_scenes)
+      lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->tasks);
+   FREE(rast->threads);
    FREE(rast);
 }
 
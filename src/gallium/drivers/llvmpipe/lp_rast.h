@@ -38,6 +38,7 @@
 #define LP_RAST_H
 
 #include "pipe/p_compiler.h"
+#include "util/u_math.h"
 #include "util/u_pack_color.h"
 #include "util/u_rect.h"
 #include "lp_jit.h"
@@ -229,8 +230,110 @@ GET_PLANES(const struct lp_rast_triangle *tri)
 }
 
 
+/**
+ * Hierarchical depth.
+ *
+ * Setup keeps an upper bound of the depth values in each tile, and the
+ * rasterizer one for each 16x16 block of the tile it works on.  Bounds are
+ * dropped (set to INFINITY) by depth writes which could raise the values,
+ * set by depth clears, and tightened by primitives fully covering a tile or
+ * block.  A primitive whose depth is entirely beyond the bound of a tile or
+ * block fails the LESS/LEQUAL depth test there and is skipped.
+ *
+ * Compute the range of the primitive's depth plane over the pixels
+ * [x0, x1] x [y0, y1], widened to allow for pixel center offsets, float
+ * rounding and, with 'quantum', the depth buffer precision.
+ */
+static inline void
+lp_rast_depth_bounds(const struct lp_rast_shader_inputs *inputs,
+                     float quantum, boolean clamp,
+                     int x0, int y0, int x1, int y1,
+                     float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float zx0 = dzdx * (float)(x0 - 1);
+   const float zx1 = dzdx * (float)(x1 + 2);
+   const float zy0 = dzdy * (float)(y0 - 1);
+   const float zy1 = dzdy * (float)(y1 + 2);
+   const float pad = quantum +
+      (fabsf(a0) + MAX2(fabsf(zx0), fabsf(zx1)) +
+       MAX2(fabsf(zy0), fabsf(zy1))) * (1.0f / (1 << 20));
+   float lo = a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1);
+   float hi = a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1);
+
+   if (clamp) {
+      lo = CLAMP(lo, 0.0f, 1.0f);
+      hi = CLAMP(hi, 0.0f, 1.0f);
+   }
+
+   *zmin = lo - pad;
+   *zmax = hi + pad;
+}
+
+
+/**
+ * Whether a depth/stencil clear with the given packed value and mask sets
+ * the depth values, and to which.
+ */
+static inline boolean
+lp_rast_clear_depth_value(enum pipe_format format,
+                          uint64_t value, uint64_t mask,
+                          float *depth)
+{
+   const uint64_t zmask = util_pack64_mask_z(format, ~0);
+
+   if ((mask & zmask) != zmask)
+      return FALSE;
+
+   /* Unpack from the value as the rasterizer stores it */
+   switch (util_format_get_blocksize(format)) {
+   case 2: {
+      const uint16_t value16 = value;
+      util_format_unpack_z_float(format, depth, &value16, 1);
+      break;
+   }
+   case 4: {
+      const uint32_t value32 = value;
+      util_format_unpack_z_float(format, depth, &value32, 1);
+      break;
+   }
+   default:
+      util_format_unpack_z_float(format, depth, &value, 1);
+      break;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Whether depth values not below 'zmin' fail the depth test against
+ * depth values not above 'bound'.  False if either is NaN.
+ */
+static inline boolean
+lp_rast_depth_occluded(float zmin, float bound, boolean lequal)
+{
+   return lequal ? zmin > bound : zmin >= bound;
+}
+
+
+/**
+ * Counters each rasterizer thread keeps, for the driver queries.
+ */
+enum lp_rast_counter {
+   LP_RAST_COUNTER_SCENES,   /**< scenes the thread worked on */
+   LP_RAST_COUNTER_TILES,    /**< non-empty tiles rasterized */
+   LP_RAST_COUNTER_BUSY,     /**< time spent rasterizing, in nanoseconds */
+   LP_RAST_COUNTER_WAIT,     /**< time spent waiting for the previous scene */
+   LP_RAST_COUNTER_IDLE,     /**< time spent waiting for a scene */
+   LP_RAST_COUNTER_COUNT
+};
+
+
 struct lp_rasterizer *
-lp_rast_create(unsigned num_threads);
+lp_rast_create(unsigned num_threads, unsigned num_nodes);
 
 void
 lp_rast_destroy(struct lp_rasterizer *);
@@ -242,6 +345,10 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
 void
 lp_rast_finish(struct lp_rasterizer *rast);
 
+uint64_t
+lp_rast_get_counter(const struct lp_rasterizer *rast, int thread,
+                    enum lp_rast_counter counter);
+
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -420,6 +527,9 @@ struct lp_bin_info {
    unsigned count:24;
 };
 
+/** The LP_RAST_FLAGS_x of the paths each LP_RAST_OP_x can go through */
+extern const unsigned lp_rast_op_flags[];
+
 struct lp_bin_info
 lp_characterize_bin(const struct cmd_bin *bin);
 
@@ -31,6 +31,7 @@
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
+#include "util/u_sse.h"
 
 #include "lp_scene_queue.h"
 #include "lp_debug.h"
@@ -40,25 +41,96 @@
 #include "lp_rast.h"
 #include "lp_rast_priv.h"
 #include "lp_scene.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
 
 
-static void
-lp_rast_linear_clear(struct lp_rasterizer_task *task,
-                     const union lp_rast_cmd_arg arg)
+/* Run the linear shader, or the blit version of it, on a box within
+ * the tile.  Returns FALSE if the shaders can't handle the inputs,
+ * without having touched the colour buffer.
+ *
+ * The shaders operate on bgra8 rows.  Other colour buffer formats go
+ * through the task's bgra8 copy of the tile.
+ */
+static boolean
+lp_rast_linear_shade(struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs,
+                     int x, int y, int width, int height)
 {
-   LP_DBG(DEBUG_RAST, "%s\n", __func__);
+   const struct lp_rast_state *state = task->state;
+   const struct lp_fragment_shader_variant *variant = state->variant;
+   const struct lp_scene *scene = task->scene;
+   const struct lp_linear_format *format = task->linear_format;
+   uint8_t *color = scene->cbufs[0].map;
+   unsigned stride = scene->cbufs[0].stride;
 
-   union util_color uc = arg.clear_rb->color_val;
+   if (!variant->jit_linear &&
+       !(variant->jit_linear_blit && inputs->is_blit))
+      return FALSE;
 
-   const struct lp_scene *scene = task->scene;
-   util_fill_rect(scene->cbufs[0].map,
-                  PIPE_FORMAT_B8G8R8A8_UNORM,
-                  scene->cbufs[0].stride,
-                  task->x,
-                  task->y,
-                  task->width,
-                  task->height,
-                  &uc);
+   if (format->pack) {
+      const unsigned tile_stride = TILE_SIZE * 4;
+      uint8_t *tile = task->linear_tile +
+         (y - task->y) * tile_stride + (x - task->x) * 4;
+
+      /* For formats which can't be unpacked exactly, only shaders which
+       * don't read the colour buffer have a linear variant.
+       */
+      if (!variant->opaque) {
+         assert(format->unpack);
+         for (int i = 0; i < height; i++) {
+            format->unpack(tile + i * tile_stride,
+                           color + (y + i) * stride + x * format->bytes,
+                           width);
+         }
+      }
+
+      /* The shaders address the colour buffer by absolute x, y.  Point
+       * them at where the framebuffer would start if the tile were part
+       * of it.
+       */
+      color = (uint8_t *)((uintptr_t)task->linear_tile -
+                          task->x * 4 - task->y * tile_stride);
+      stride = tile_stride;
+   }
+
+   boolean done = FALSE;
+
+   if (variant->jit_linear_blit && inputs->is_blit) {
+      done = variant->jit_linear_blit(state,
+                                      x, y,
+                                      width, height,
+                                      GET_A0(inputs),
+                                      GET_DADX(inputs),
+                                      GET_DADY(inputs),
+                                      color,
+                                      stride);
+   }
+
+   if (!done && variant->jit_linear) {
+      done = variant->jit_linear(state,
+                                 x, y,
+                                 width, height,
+                                 GET_A0(inputs),
+                                 GET_DADX(inputs),
+                                 GET_DADY(inputs),
+                                 color,
+                                 stride);
+   }
+
+   if (done && format->pack) {
+      const uint8_t *tile = color + y * stride + x * 4;
+      uint8_t *dst = scene->cbufs[0].map +
+         y * scene->cbufs[0].stride + x * format->bytes;
+
+      for (int i = 0; i < height; i++) {
+         format->pack(dst, tile, width);
+         tile += stride;
+         dst += scene->cbufs[0].stride;
+      }
+   }
+
+   return done;
 }
 
 
@@ -78,36 +150,10 @@ lp_rast_linear_tile(struct lp_rasterizer_task *task,
       return;
    }
 
-   const struct lp_fragment_shader_variant *variant = state->variant;
-   const struct lp_scene *scene = task->scene;
-
-   if (variant->jit_linear_blit && inputs->is_blit) {
-      if (variant->jit_linear_blit(state,
-                                   task->x,
-                                   task->y,
-                                   task->width,
-                                   task->height,
-                                   GET_A0(inputs),
-                                   GET_DADX(inputs),
-                                   GET_DADY(inputs),
-                                   scene->cbufs[0].map,
-                                   scene->cbufs[0].stride))
-         return;
-   }
-
-   if (variant->jit_linear) {
-      if (variant->jit_linear(state,
-                              task->x,
-                              task->y,
-                              task->width,
-                              task->height,
-                              GET_A0(inputs),
-                              GET_DADX(inputs),
-                              GET_DADY(inputs),
-                              scene->cbufs[0].map,
-                              scene->cbufs[0].stride))
-         return;
-   }
+   if (lp_rast_linear_shade(task, inputs,
+                            task->x, task->y,
+                            task->width, task->height))
+      return;
 
    {
       struct u_rect box;
@@ -127,7 +173,6 @@ static void
 lp_rast_linear_rect(struct lp_rasterizer_task *task,
                     const union lp_rast_cmd_arg arg)
 {
-   const struct lp_scene *scene = task->scene;
    const struct lp_rast_rectangle *rect = arg.rectangle;
    const struct lp_rast_shader_inputs *inputs = &rect->inputs;
 
@@ -149,33 +194,8 @@ lp_rast_linear_rect(struct lp_rasterizer_task *task,
     * the binner currently doesn't try to classify sub-tile
     * primitives.  Can detect them here though.
     */
-   const struct lp_rast_state *state = task->state;
-   struct lp_fragment_shader_variant *variant = state->variant;
-   if (variant->jit_linear_blit && inputs->is_blit) {
-      if (variant->jit_linear_blit(state,
-                                   box.x0, box.y0,
-                                   width, height,
-                                   GET_A0(inputs),
-                                   GET_DADX(inputs),
-                                   GET_DADY(inputs),
-                                   scene->cbufs[0].map,
-                                   scene->cbufs[0].stride)) {
-         return;
-      }
-   }
-
-   if (variant->jit_linear) {
-      if (variant->jit_linear(state,
-                              box.x0, box.y0,
-                              width, height,
-                              GET_A0(inputs),
-                              GET_DADX(inputs),
-                              GET_DADY(inputs),
-                              scene->cbufs[0].map,
-                              scene->cbufs[0].stride)) {
-         return;
-      }
-   }
+   if (lp_rast_linear_shade(task, inputs, box.x0, box.y0, width, height))
+      return;
 
    lp_rast_linear_rect_fallback(task, inputs, &box);
 }
@@ -183,7 +203,7 @@ lp_rast_linear_rect(struct lp_rasterizer_task *task,
 
 static const lp_rast_cmd_func
 dispatch_linear[] = {
-   lp_rast_linear_clear,        /* clear_color */
+   lp_rast_clear_color,         /* clear_color */
    NULL,                        /* clear_zstencil */
    NULL,                        /* triangle_1 */
    NULL,                        /* triangle_2 */
@@ -231,7 +251,8 @@ dispatch_linear[] = {
 
 
 /* Assumptions for this path:
- *   - Single color buffer, PIPE_FORMAT_B8G8R8A8_UNORM
+ *   - Single color buffer, in one of the formats lp_linear_get_format()
+ *     knows about
  *   - No depth buffer
  *   - All primitives in bins are rect, tile, blit or clear.
  *   - All shaders have a linear variant.
@@ -244,10 +265,16 @@ lp_linear_rasterize_bin(struct lp_rasterizer_task *task,
 
    if (0) debug_printf("%s\n", __func__);
 
+   task->linear_format =
+      lp_linear_get_format(task->scene->fb.cbufs[0]->format);
+   assert(task->linear_format);
+
    const struct cmd_block *block;
    for (block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
          assert(dispatch_linear[block->cmd[k]]);
+         if (task->clear_pending)
+            lp_rast_resolve_clears(task, block->cmd[k], block->arg[k]);
          dispatch_linear[block->cmd[k]](task, block->arg[k]);
       }
    }
@@ -97,7 +97,8 @@ shade_quads(struct lp_rasterizer_task *task,
    const struct lp_fragment_shader_variant *variant = state->variant;
    const struct lp_scene *scene = task->scene;
    const unsigned stride = scene->cbufs[0].stride;
-   uint8_t *cbufs[1] = { scene->cbufs[0].map + y * stride + x * 4 };
+   uint8_t *cbufs[1] = { scene->cbufs[0].map + y * stride +
+                          x * scene->cbufs[0].format_bytes };
    unsigned strides[1] = { stride };
 
    assert(!variant->key.depth.enabled);
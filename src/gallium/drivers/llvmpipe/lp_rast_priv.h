@@ -42,6 +42,9 @@
 #define TILE_VECTOR_HEIGHT 4
 #define TILE_VECTOR_WIDTH 4
 
+/** lp_rasterizer_task::clear_pending bit of the depth/stencil buffer */
+#define LP_RAST_CLEAR_ZS (1 << PIPE_MAX_COLOR_BUFS)
+
 /* If we crash in a jitted function, we can examine jit_line and jit_state
  * to get some info.  This is not thread-safe, however.
  */
@@ -74,6 +77,7 @@ extern const struct lp_rasterizer_task *jit_task;
 
 
 struct lp_rasterizer;
+struct lp_linear_format;
 struct cmd_bin;
 
 /**
@@ -91,15 +95,48 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /**
+    * Depth bounds of the tile's 16x16 blocks, valid where set in
+    * hiz_valid, see lp_rast_depth_bounds().  hiz_test/hiz_update
+    * reflect the current state.
+    */
+   float hiz_zmax[16];
+   unsigned hiz_valid;
+   boolean hiz_test;
+   boolean hiz_update;
+
+   /**
+    * Clears of the current tile which weren't written yet, see
+    * lp_rast_resolve_clears().  Bit i stands for colour buffer i, and
+    * LP_RAST_CLEAR_ZS for the depth/stencil buffer.
+    */
+   unsigned clear_pending;
+   union util_color clear_color[PIPE_MAX_COLOR_BUFS];
+   uint64_t clear_zs_value;
+   uint64_t clear_zs_mask;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
    /** "my" index */
    unsigned thread_index;
 
+   /** NUMA node the thread runs on, see lp_rasterizer::num_nodes */
+   unsigned node;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   /**
+    * Linear path: colour buffer format of the current bin, and bgra8
+    * copy of the tile for the shaders when that isn't bgra8.
+    */
+   const struct lp_linear_format *linear_format;
+   alignas(16) uint8_t linear_tile[TILE_SIZE * TILE_SIZE * 4];
+
+   /** Only written by the thread, but read by others */
+   uint64_t counters[LP_RAST_COUNTER_COUNT];
+
    util_semaphore work_ready;
    util_semaphore work_done;
 };
@@ -118,19 +155,38 @@ struct lp_rasterizer
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
 
-   /** The scene currently being rasterized by the threads */
-   struct lp_scene *curr_scene;
-
    /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
 
-   /** For synchronizing the rasterization threads */
-   util_barrier barrier;
+   /**
+    * Number of NUMA nodes the threads are spread over.  Each thread is
+    * pinned to its node, and preferably works on the part of the
+    * framebuffer assigned to that node.  One if threads aren't pinned.
+    */
+   unsigned num_nodes;
 
    struct lp_fence *last_fence;
+
+   /** Sequence number of the most recently queued scene */
+   unsigned last_seq;
+
+   /** Framebuffer of the most recently queued scene */
+   struct pipe_framebuffer_state last_fb;
+
+   /** Whether a following scene must not overlap the last queued one */
+   boolean last_serialize;
+
+   /**
+    * Per tile, sequence number of the last scene whose bin for that tile
+    * has been rasterized.  Only used with threads.
+    */
+   unsigned *tile_done;
+
+   /** Rasterization functions, indexed by LP_RAST_OP_x */
+   lp_rast_cmd_func dispatch_tri[LP_RAST_OP_MAX];
 };
 
 
@@ -140,6 +196,16 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
                                 unsigned x, unsigned y,
                                 uint64_t mask);
 
+boolean
+lp_rast_hiz_occluded(struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs,
+                     int x0, int y0, int x1, int y1);
+
+void
+lp_rast_hiz_covered_16(struct lp_rasterizer_task *task,
+                       const struct lp_rast_shader_inputs *inputs,
+                       int x, int y);
+
 void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
@@ -288,6 +354,34 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    }
 }
 
+
+/**
+ * Shade all pixels in a 4x4 block.
+ */
+static inline void
+block_full_4(struct lp_rasterizer_task *task,
+             const struct lp_rast_triangle *tri,
+             int x, int y)
+{
+   lp_rast_shade_quads_all(task, &tri->inputs, x, y);
+}
+
+
+/**
+ * Shade all pixels in a 16x16 block.
+ */
+static inline void
+block_full_16(struct lp_rasterizer_task *task,
+              const struct lp_rast_triangle *tri,
+              int x, int y)
+{
+   assert(x % 16 == 0);
+   assert(y % 16 == 0);
+   for (unsigned iy = 0; iy < 16; iy += 4)
+      for (unsigned ix = 0; ix < 16; ix += 4)
+         block_full_4(task, tri, x + ix, y + iy);
+}
+
 void
 lp_rast_triangle_1(struct lp_rasterizer_task *, const union lp_rast_cmd_arg);
 
@@ -453,10 +547,37 @@ void
 lp_rast_triangle_ms_32_4_16(struct lp_rasterizer_task *,
                             const union lp_rast_cmd_arg);
 
+
+/**
+ * Vector extensions the triangle coverage masks can be computed with.
+ */
+enum lp_rast_simd {
+   LP_RAST_SIMD_DEFAULT,        /**< SSE2, AltiVec or plain C */
+   LP_RAST_SIMD_AVX2,           /**< 8 edge function values at a time */
+   LP_RAST_SIMD_AVX512,         /**< 16 edge function values at a time */
+};
+
+boolean
+lp_rast_init_dispatch(lp_rast_cmd_func *dispatch, enum lp_rast_simd simd);
+
+void
+lp_rast_tri_init_dispatch_avx2(lp_rast_cmd_func *dispatch);
+
+void
+lp_rast_tri_init_dispatch_avx512(lp_rast_cmd_func *dispatch);
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
 
+void
+lp_rast_clear_color(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg);
+
+void
+lp_rast_resolve_clears(struct lp_rasterizer_task *task,
+                       unsigned cmd, const union lp_rast_cmd_arg arg);
+
 void
 lp_debug_bin(const struct cmd_bin *bin, int x, int y);
 
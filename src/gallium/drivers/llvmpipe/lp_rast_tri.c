@@ -35,33 +35,6 @@
 #include "lp_perf.h"
 #include "lp_rast_priv.h"
 
-/**
- * Shade all pixels in a 4x4 block.
- */
-static void
-block_full_4(struct lp_rasterizer_task *task,
-             const struct lp_rast_triangle *tri,
-             int x, int y)
-{
-   lp_rast_shade_quads_all(task, &tri->inputs, x, y);
-}
-
-
-/**
- * Shade all pixels in a 16x16 block.
- */
-static void
-block_full_16(struct lp_rasterizer_task *task,
-              const struct lp_rast_triangle *tri,
-              int x, int y)
-{
-   assert(x % 16 == 0);
-   assert(y % 16 == 0);
-   for (unsigned iy = 0; iy < 16; iy += 4)
-      for (unsigned ix = 0; ix < 16; ix += 4)
-         block_full_4(task, tri, x + ix, y + iy);
-}
-
 static inline unsigned
 build_mask_linear(int32_t c, int32_t dcdx, int32_t dcdy)
 {
@@ -297,6 +270,14 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    const int x = (arg.triangle.plane_mask & 0xff) + task->x;
    const int y = (arg.triangle.plane_mask >> 8) + task->y;
 
+   if (task->hiz_test &&
+       lp_rast_hiz_occluded(task, &tri->inputs, x, y,
+                            MIN2(x + 15, task->x + TILE_SIZE - 1),
+                            MIN2(y + 15, task->y + TILE_SIZE - 1))) {
+      LP_COUNT(nr_hiz_rejected_16);
+      return;
+   }
+
    struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
    unsigned nr = 0;
 
@@ -580,6 +561,14 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    const int x = (arg.triangle.plane_mask & 0xff) + task->x;
    const int y = (arg.triangle.plane_mask >> 8) + task->y;
 
+   if (task->hiz_test &&
+       lp_rast_hiz_occluded(task, &tri->inputs, x, y,
+                            MIN2(x + 15, task->x + TILE_SIZE - 1),
+                            MIN2(y + 15, task->y + TILE_SIZE - 1))) {
+      LP_COUNT(nr_hiz_rejected_16);
+      return;
+   }
+
    struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
    unsigned nr = 0;
 
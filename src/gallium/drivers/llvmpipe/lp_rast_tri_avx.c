@@ -0,0 +1,542 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Rasterization for binned triangles within a tile, with the coverage
+ * masks of a 4x4 grid of blocks or pixels computed 8 (AVX2) or all 16
+ * (AVX-512) edge function values at a time.
+ *
+ * This file is built once for each, with the compiler flags enabling the
+ * instructions and LP_RAST_AVX512 defined for the latter.  The functions
+ * are only reached through the dispatch table filled in by
+ * lp_rast_tri_init_dispatch_avx2/avx512(), which lp_rast_init_dispatch()
+ * only calls if the CPU supports them.
+ */
+
+#include <immintrin.h>
+#include "util/u_math.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+
+
+#ifdef LP_RAST_AVX512
+
+#define SIMD(x) x##_avx512
+
+typedef __m512i vec16;
+
+/**
+ * The values c + dcdx * (i % 4) + dcdy * (i / 4) for i in [0, 16), that
+ * is the edge function over a 4x4 grid in row-major order.
+ */
+static inline vec16
+vec16_grid(int c, int dcdx, int dcdy)
+{
+   const __m512i row = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1,
+                                         2, 2, 2, 2, 3, 3, 3, 3);
+   __m128i cstep = _mm_setr_epi32(c, c+dcdx, c+dcdx*2, c+dcdx*3);
+   __m128i ystep = _mm_setr_epi32(0, dcdy, dcdy*2, dcdy*3);
+
+   return _mm512_add_epi32(_mm512_broadcast_i32x4(cstep),
+                           _mm512_permutexvar_epi32(row,
+                                                    _mm512_castsi128_si512(ystep)));
+}
+
+static inline vec16
+vec16_add(vec16 a, int b)
+{
+   return _mm512_add_epi32(a, _mm512_set1_epi32(b));
+}
+
+static inline vec16
+vec16_or(vec16 a, vec16 b)
+{
+   return _mm512_or_si512(a, b);
+}
+
+static inline unsigned
+vec16_sign_bits(vec16 a)
+{
+   return _mm512_cmplt_epi32_mask(a, _mm512_setzero_si512());
+}
+
+static inline void
+vec16_store(int32_t *dst, vec16 a)
+{
+   _mm512_storeu_si512(dst, a);
+}
+
+#else /* LP_RAST_AVX512 */
+
+#define SIMD(x) x##_avx2
+
+/* Rows 0-1 and 2-3 of the 4x4 grid */
+typedef struct {
+   __m256i lo, hi;
+} vec16;
+
+static inline vec16
+vec16_grid(int c, int dcdx, int dcdy)
+{
+   __m256i cstep =
+      _mm256_broadcastsi128_si256(_mm_setr_epi32(c, c+dcdx, c+dcdx*2, c+dcdx*3));
+   __m256i xdcdy = _mm256_set1_epi32(dcdy);
+   vec16 r;
+
+   r.lo = _mm256_add_epi32(cstep,
+                           _mm256_blend_epi32(_mm256_setzero_si256(), xdcdy, 0xf0));
+   r.hi = _mm256_add_epi32(r.lo, _mm256_add_epi32(xdcdy, xdcdy));
+   return r;
+}
+
+static inline vec16
+vec16_add(vec16 a, int b)
+{
+   __m256i xb = _mm256_set1_epi32(b);
+   vec16 r;
+
+   r.lo = _mm256_add_epi32(a.lo, xb);
+   r.hi = _mm256_add_epi32(a.hi, xb);
+   return r;
+}
+
+static inline vec16
+vec16_or(vec16 a, vec16 b)
+{
+   vec16 r;
+
+   r.lo = _mm256_or_si256(a.lo, b.lo);
+   r.hi = _mm256_or_si256(a.hi, b.hi);
+   return r;
+}
+
+static inline unsigned
+vec16_sign_bits(vec16 a)
+{
+   return _mm256_movemask_ps(_mm256_castsi256_ps(a.lo)) |
+          _mm256_movemask_ps(_mm256_castsi256_ps(a.hi)) << 8;
+}
+
+static inline void
+vec16_store(int32_t *dst, vec16 a)
+{
+   _mm256_storeu_si256((__m256i *)dst, a.lo);
+   _mm256_storeu_si256((__m256i *)(dst + 8), a.hi);
+}
+
+#endif /* LP_RAST_AVX512 */
+
+
+static inline void
+build_masks_avx(int c,
+                int cdiff,
+                int dcdx,
+                int dcdy,
+                unsigned *outmask,
+                unsigned *partmask)
+{
+   vec16 cstep = vec16_grid(c, dcdx, dcdy);
+
+   *outmask |= vec16_sign_bits(cstep);
+   *partmask |= vec16_sign_bits(vec16_add(cstep, cdiff));
+}
+
+
+static inline unsigned
+build_mask_linear_avx(int c, int dcdx, int dcdy)
+{
+   return vec16_sign_bits(vec16_grid(c, dcdx, dcdy));
+}
+
+
+#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_avx((int)c, (int)cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_avx((int)c, dcdx, dcdy)
+
+
+/*
+ * The functions generated from lp_rast_tri_tmp.h are only reached through
+ * the dispatch table, declaring them static here keeps them local.
+ */
+#define DECLARE_TRI(n) \
+   static void SIMD(lp_rast_triangle_##n)(struct lp_rasterizer_task *, \
+                                          const union lp_rast_cmd_arg)
+
+DECLARE_TRI(1);
+DECLARE_TRI(2);
+DECLARE_TRI(3);
+DECLARE_TRI(4);
+DECLARE_TRI(5);
+DECLARE_TRI(6);
+DECLARE_TRI(7);
+DECLARE_TRI(8);
+DECLARE_TRI(32_1);
+DECLARE_TRI(32_2);
+DECLARE_TRI(32_3);
+DECLARE_TRI(32_4);
+DECLARE_TRI(32_5);
+DECLARE_TRI(32_6);
+DECLARE_TRI(32_7);
+DECLARE_TRI(32_8);
+DECLARE_TRI(ms_1);
+DECLARE_TRI(ms_2);
+DECLARE_TRI(ms_3);
+DECLARE_TRI(ms_4);
+DECLARE_TRI(ms_5);
+DECLARE_TRI(ms_6);
+DECLARE_TRI(ms_7);
+DECLARE_TRI(ms_8);
+
+#undef DECLARE_TRI
+
+
+#define RASTER_64 1
+
+#define TAG(x) SIMD(x##_1)
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_2)
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_3)
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_4)
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_5)
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_6)
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_7)
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_8)
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+#undef RASTER_64
+
+#define TAG(x) SIMD(x##_32_1)
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_2)
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_3)
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_4)
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_5)
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_6)
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_7)
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_32_8)
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+#define MULTISAMPLE 1
+#define RASTER_64 1
+
+#define TAG(x) SIMD(x##_ms_1)
+#define NR_PLANES 1
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_2)
+#define NR_PLANES 2
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_3)
+#define NR_PLANES 3
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_4)
+#define NR_PLANES 4
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_5)
+#define NR_PLANES 5
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_6)
+#define NR_PLANES 6
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_7)
+#define NR_PLANES 7
+#include "lp_rast_tri_tmp.h"
+
+#define TAG(x) SIMD(x##_ms_8)
+#define NR_PLANES 8
+#include "lp_rast_tri_tmp.h"
+
+#undef MULTISAMPLE
+#undef RASTER_64
+
+
+/**
+ * Edge function values of the three planes of a triangle at the top-left
+ * pixel of a 16x16 block, adjusted so that the sign bit alone tells
+ * whether a pixel is outside, and their steps.
+ */
+struct tri3_setup {
+   int32_t c[3];
+   int32_t dcdx[3];
+   int32_t dcdy[3];
+};
+
+
+static inline void
+tri3_setup(struct tri3_setup *setup,
+           const struct lp_rast_plane *plane,
+           int x, int y)
+{
+   for (unsigned j = 0; j < 3; j++) {
+      setup->dcdx[j] = -plane[j].dcdx;
+      setup->dcdy[j] = plane[j].dcdy;
+      /* The values fit in 32 bits, the intermediate ones needn't */
+      setup->c[j] = (int32_t)((uint32_t)plane[j].c +
+                              (uint32_t)setup->dcdx[j] * x +
+                              (uint32_t)setup->dcdy[j] * y - 1);
+   }
+}
+
+
+/**
+ * Mask of the pixels of the 4x4 block whose top-left pixel has the edge
+ * function values c[] which are outside the triangle.
+ */
+static inline unsigned
+tri3_outside_mask(const vec16 *span, const int32_t *c)
+{
+   return vec16_sign_bits(vec16_or(vec16_or(vec16_add(span[0], c[0]),
+                                            vec16_add(span[1], c[1])),
+                                   vec16_add(span[2], c[2])));
+}
+
+
+/**
+ * Rasterize a three plane triangle contained in a 16x16 block.  All 16
+ * 4x4 blocks are trivially rejected at once, then the pixel masks of the
+ * remaining blocks are computed for all three planes at once.
+ */
+static void
+SIMD(lp_rast_triangle_32_3_16)(struct lp_rasterizer_task *task,
+                               const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   const int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   const int y = (arg.triangle.plane_mask >> 8) + task->y;
+
+   if (task->hiz_test &&
+       lp_rast_hiz_occluded(task, &tri->inputs, x, y,
+                            MIN2(x + 15, task->x + TILE_SIZE - 1),
+                            MIN2(y + 15, task->y + TILE_SIZE - 1))) {
+      LP_COUNT(nr_hiz_rejected_16);
+      return;
+   }
+
+   struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
+   unsigned nr = 0;
+   struct tri3_setup setup;
+   int32_t cblock[3][16];
+   vec16 span[3];
+   unsigned rejmask = 0;
+
+   tri3_setup(&setup, plane, x, y);
+
+   for (unsigned j = 0; j < 3; j++) {
+      const vec16 cstep = vec16_grid(setup.c[j],
+                                     setup.dcdx[j] * 4,
+                                     setup.dcdy[j] * 4);
+      const int rej4 = (int)(plane[j].eo << 2) + 1;
+
+      rejmask |= vec16_sign_bits(vec16_add(cstep, rej4));
+      vec16_store(cblock[j], cstep);
+      span[j] = vec16_grid(0, setup.dcdx[j], setup.dcdy[j]);
+   }
+
+   unsigned inmask = ~rejmask & 0xffff;
+
+   while (inmask) {
+      const int i = ffs(inmask) - 1;
+      const int32_t c[3] = { cblock[0][i], cblock[1][i], cblock[2][i] };
+      const unsigned mask = tri3_outside_mask(span, c);
+
+      inmask &= ~(1 << i);
+
+      out[nr].i = i >> 2;
+      out[nr].j = i & 3;
+      out[nr].mask = mask;
+      if (mask != 0xffff)
+         nr++;
+   }
+
+   for (unsigned i = 0; i < nr; i++)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x + 4 * out[i].j,
+                               y + 4 * out[i].i,
+                               0xffff & ~out[i].mask);
+}
+
+
+static void
+SIMD(lp_rast_triangle_32_3_4)(struct lp_rasterizer_task *task,
+                              const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   const int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   const int y = (arg.triangle.plane_mask >> 8) + task->y;
+   struct tri3_setup setup;
+   vec16 span[3];
+
+   tri3_setup(&setup, plane, x, y);
+
+   for (unsigned j = 0; j < 3; j++)
+      span[j] = vec16_grid(0, setup.dcdx[j], setup.dcdy[j]);
+
+   const unsigned mask = tri3_outside_mask(span, setup.c);
+
+   if (mask != 0xffff)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x,
+                               y,
+                               0xffff & ~mask);
+}
+
+
+static void
+SIMD(lp_rast_triangle_3_16)(struct lp_rasterizer_task *task,
+                            const union lp_rast_cmd_arg arg)
+{
+   union lp_rast_cmd_arg arg2;
+   arg2.triangle.tri = arg.triangle.tri;
+   arg2.triangle.plane_mask = (1<<3)-1;
+   SIMD(lp_rast_triangle_3)(task, arg2);
+}
+
+
+static void
+SIMD(lp_rast_triangle_4_16)(struct lp_rasterizer_task *task,
+                            const union lp_rast_cmd_arg arg)
+{
+   union lp_rast_cmd_arg arg2;
+   arg2.triangle.tri = arg.triangle.tri;
+   arg2.triangle.plane_mask = (1<<4)-1;
+   SIMD(lp_rast_triangle_4)(task, arg2);
+}
+
+
+static void
+SIMD(lp_rast_triangle_ms_3_16)(struct lp_rasterizer_task *task,
+                               const union lp_rast_cmd_arg arg)
+{
+   union lp_rast_cmd_arg arg2;
+   arg2.triangle.tri = arg.triangle.tri;
+   arg2.triangle.plane_mask = (1<<3)-1;
+   SIMD(lp_rast_triangle_ms_3)(task, arg2);
+}
+
+
+static void
+SIMD(lp_rast_triangle_ms_4_16)(struct lp_rasterizer_task *task,
+                               const union lp_rast_cmd_arg arg)
+{
+   union lp_rast_cmd_arg arg2;
+   arg2.triangle.tri = arg.triangle.tri;
+   arg2.triangle.plane_mask = (1<<4)-1;
+   SIMD(lp_rast_triangle_ms_4)(task, arg2);
+}
+
+
+/**
+ * Replace the triangle entries of a dispatch table, indexed by
+ * LP_RAST_OP_x.  lp_rast_triangle_32_4_16 is left alone, as it's already
+ * specialized for SSE.
+ */
+void
+SIMD(lp_rast_tri_init_dispatch)(lp_rast_cmd_func *dispatch)
+{
+   dispatch[LP_RAST_OP_TRIANGLE_1] = SIMD(lp_rast_triangle_1);
+   dispatch[LP_RAST_OP_TRIANGLE_2] = SIMD(lp_rast_triangle_2);
+   dispatch[LP_RAST_OP_TRIANGLE_3] = SIMD(lp_rast_triangle_3);
+   dispatch[LP_RAST_OP_TRIANGLE_4] = SIMD(lp_rast_triangle_4);
+   dispatch[LP_RAST_OP_TRIANGLE_5] = SIMD(lp_rast_triangle_5);
+   dispatch[LP_RAST_OP_TRIANGLE_6] = SIMD(lp_rast_triangle_6);
+   dispatch[LP_RAST_OP_TRIANGLE_7] = SIMD(lp_rast_triangle_7);
+   dispatch[LP_RAST_OP_TRIANGLE_8] = SIMD(lp_rast_triangle_8);
+   dispatch[LP_RAST_OP_TRIANGLE_3_4] = SIMD(lp_rast_triangle_3_16);
+   dispatch[LP_RAST_OP_TRIANGLE_3_16] = SIMD(lp_rast_triangle_3_16);
+   dispatch[LP_RAST_OP_TRIANGLE_4_16] = SIMD(lp_rast_triangle_4_16);
+   dispatch[LP_RAST_OP_TRIANGLE_32_1] = SIMD(lp_rast_triangle_32_1);
+   dispatch[LP_RAST_OP_TRIANGLE_32_2] = SIMD(lp_rast_triangle_32_2);
+   dispatch[LP_RAST_OP_TRIANGLE_32_3] = SIMD(lp_rast_triangle_32_3);
+   dispatch[LP_RAST_OP_TRIANGLE_32_4] = SIMD(lp_rast_triangle_32_4);
+   dispatch[LP_RAST_OP_TRIANGLE_32_5] = SIMD(lp_rast_triangle_32_5);
+   dispatch[LP_RAST_OP_TRIANGLE_32_6] = SIMD(lp_rast_triangle_32_6);
+   dispatch[LP_RAST_OP_TRIANGLE_32_7] = SIMD(lp_rast_triangle_32_7);
+   dispatch[LP_RAST_OP_TRIANGLE_32_8] = SIMD(lp_rast_triangle_32_8);
+   dispatch[LP_RAST_OP_TRIANGLE_32_3_4] = SIMD(lp_rast_triangle_32_3_4);
+   dispatch[LP_RAST_OP_TRIANGLE_32_3_16] = SIMD(lp_rast_triangle_32_3_16);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_1] = SIMD(lp_rast_triangle_ms_1);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_2] = SIMD(lp_rast_triangle_ms_2);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_3] = SIMD(lp_rast_triangle_ms_3);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_4] = SIMD(lp_rast_triangle_ms_4);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_5] = SIMD(lp_rast_triangle_ms_5);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_6] = SIMD(lp_rast_triangle_ms_6);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_7] = SIMD(lp_rast_triangle_ms_7);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_8] = SIMD(lp_rast_triangle_ms_8);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_3_4] = SIMD(lp_rast_triangle_ms_3_16);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_3_16] = SIMD(lp_rast_triangle_ms_3_16);
+   dispatch[LP_RAST_OP_MS_TRIANGLE_4_16] = SIMD(lp_rast_triangle_ms_4_16);
+}
@@ -315,13 +315,20 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       int py = y + iy;
       int64_t cx[NR_PLANES];
 
+      partial_mask &= ~(1 << i);
+
+      if (task->hiz_test &&
+          lp_rast_hiz_occluded(task, &tri->inputs,
+                               px, py, px + 15, py + 15)) {
+         LP_COUNT(nr_hiz_rejected_16);
+         continue;
+      }
+
       for (j = 0; j < NR_PLANES; j++)
          cx[j] = (c[j]
                   - IMUL64(plane[j].dcdx, ix)
                   + IMUL64(plane[j].dcdy, iy));
 
-      partial_mask &= ~(1 << i);
-
       LP_COUNT(nr_partially_covered_16);
       TAG(do_block_16)(task, tri, plane, px, py, cx);
    }
@@ -337,8 +344,18 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
+      if (task->hiz_test &&
+          lp_rast_hiz_occluded(task, &tri->inputs,
+                               px, py, px + 15, py + 15)) {
+         LP_COUNT(nr_hiz_rejected_16);
+         continue;
+      }
+
       LP_COUNT(nr_fully_covered_16);
       block_full_16(task, tri, px, py);
+
+      if (task->hiz_update)
+         lp_rast_hiz_covered_16(task, &tri->inputs, px, py);
    }
 }
 
@@ -373,6 +390,14 @@ TRI_16(struct lp_rasterizer_task *task,
    x += task->x;
    y += task->y;
 
+   if (task->hiz_test &&
+       lp_rast_hiz_occluded(task, &tri->inputs, x, y,
+                            MIN2(x + 15, task->x + TILE_SIZE - 1),
+                            MIN2(y + 15, task->y + TILE_SIZE - 1))) {
+      LP_COUNT(nr_hiz_rejected_16);
+      return;
+   }
+
    for (unsigned j = 0; j < NR_PLANES; j++) {
       const int dcdx = -plane[j].dcdx * 4;
       const int dcdy = plane[j].dcdy * 4;
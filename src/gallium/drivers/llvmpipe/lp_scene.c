@@ -25,6 +25,8 @@
  *
  **************************************************************************/
 
+#include "util/detect_os.h"
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -37,6 +39,11 @@
 #include "lp_context.h"
 #include "lp_state_fs.h"
 #include "lp_setup_context.h"
+#include "lp_perf.h"
+
+#if DETECT_OS_LINUX
+#include <sys/mman.h>
+#endif
 
 
 #define RESOURCE_REF_SZ 32
@@ -57,6 +64,189 @@ struct shader_ref {
 };
 
 
+#define LP_SCENE_SLAB_SIZE (2 * 1024 * 1024)
+
+/** A slab of data blocks, aligned to its size */
+struct lp_scene_slab {
+   struct list_head list;
+   struct data_block *free;
+   unsigned num_free;
+   struct data_block blocks[];
+};
+
+#define LP_SCENE_SLAB_BLOCKS \
+   ((LP_SCENE_SLAB_SIZE - sizeof(struct lp_scene_slab)) / \
+    sizeof(struct data_block))
+
+
+static inline struct lp_scene_slab *
+lp_scene_block_slab(struct data_block *block)
+{
+   return (struct lp_scene_slab *)
+      ((uintptr_t)block & ~(uintptr_t)(LP_SCENE_SLAB_SIZE - 1));
+}
+
+
+/**
+ * \param max_free  number of free blocks to keep around
+ */
+void
+lp_scene_block_pool_init(struct lp_scene_block_pool *pool,
+                         unsigned max_free)
+{
+   (void) mtx_init(&pool->mutex, mtx_plain);
+   list_inithead(&pool->slabs);
+   pool->num_free = 0;
+   pool->max_free = max_free;
+   pool->blocks_allocated = 0;
+   pool->blocks_reused = 0;
+}
+
+
+void
+lp_scene_block_pool_destroy(struct lp_scene_block_pool *pool)
+{
+   list_for_each_entry_safe(struct lp_scene_slab, slab, &pool->slabs, list) {
+      assert(slab->num_free == LP_SCENE_SLAB_BLOCKS);
+      align_free(slab);
+   }
+   list_inithead(&pool->slabs);
+   mtx_destroy(&pool->mutex);
+}
+
+
+void
+lp_scene_block_pool_get_counters(struct lp_scene_block_pool *pool,
+                                 uint64_t *allocated,
+                                 uint64_t *reused)
+{
+   mtx_lock(&pool->mutex);
+   *allocated = pool->blocks_allocated;
+   *reused = pool->blocks_reused;
+   mtx_unlock(&pool->mutex);
+}
+
+
+void
+lp_scene_block_pool_set_max_free(struct lp_scene_block_pool *pool,
+                                 unsigned max_free)
+{
+   mtx_lock(&pool->mutex);
+   pool->max_free = max_free;
+   mtx_unlock(&pool->mutex);
+}
+
+
+static struct lp_scene_slab *
+lp_scene_slab_create(void)
+{
+   struct lp_scene_slab *slab =
+      align_malloc(LP_SCENE_SLAB_SIZE, LP_SCENE_SLAB_SIZE);
+   if (!slab)
+      return NULL;
+
+#if DETECT_OS_LINUX && defined(MADV_HUGEPAGE)
+   madvise(slab, LP_SCENE_SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+
+   slab->free = NULL;
+   for (unsigned i = LP_SCENE_SLAB_BLOCKS; i-- > 0; ) {
+      slab->blocks[i].next = slab->free;
+      slab->free = &slab->blocks[i];
+   }
+   slab->num_free = LP_SCENE_SLAB_BLOCKS;
+
+   return slab;
+}
+
+
+static struct data_block *
+lp_scene_block_pool_get(struct lp_scene_block_pool *pool)
+{
+   struct lp_scene_slab *slab = NULL;
+   struct data_block *block;
+
+   mtx_lock(&pool->mutex);
+
+   if (pool->num_free) {
+      list_for_each_entry(struct lp_scene_slab, s, &pool->slabs, list) {
+         if (s->num_free) {
+            slab = s;
+            break;
+         }
+      }
+      assert(slab);
+      pool->blocks_reused++;
+      LP_COUNT_ADD_ATOMIC(nr_scene_blocks_reused, 1);
+   } else {
+      slab = lp_scene_slab_create();
+      if (!slab) {
+         mtx_unlock(&pool->mutex);
+         return NULL;
+      }
+      list_add(&slab->list, &pool->slabs);
+      pool->num_free += slab->num_free;
+      pool->blocks_allocated += slab->num_free;
+      LP_COUNT_ADD_ATOMIC(nr_scene_blocks_allocated, slab->num_free);
+   }
+
+   block = slab->free;
+   slab->free = block->next;
+   slab->num_free--;
+   pool->num_free--;
+
+   /* Full slabs go last, so that we don't have to look at them */
+   if (!slab->num_free) {
+      list_del(&slab->list);
+      list_addtail(&slab->list, &pool->slabs);
+   }
+
+   mtx_unlock(&pool->mutex);
+
+   return block;
+}
+
+
+/**
+ * Return a list of blocks, up to but excluding 'end', to the pool.
+ */
+static void
+lp_scene_block_pool_put(struct lp_scene_block_pool *pool,
+                        struct data_block *head,
+                        struct data_block *end)
+{
+   struct data_block *block, *next;
+
+   if (head == end)
+      return;
+
+   mtx_lock(&pool->mutex);
+
+   for (block = head; block != end; block = next) {
+      struct lp_scene_slab *slab = lp_scene_block_slab(block);
+
+      next = block->next;
+
+      if (!slab->num_free)
+         list_move_to(&slab->list, &pool->slabs);
+
+      block->next = slab->free;
+      slab->free = block;
+      slab->num_free++;
+      pool->num_free++;
+
+      if (slab->num_free == LP_SCENE_SLAB_BLOCKS &&
+          pool->num_free >= pool->max_free + LP_SCENE_SLAB_BLOCKS) {
+         list_del(&slab->list);
+         pool->num_free -= LP_SCENE_SLAB_BLOCKS;
+         align_free(slab);
+      }
+   }
+
+   mtx_unlock(&pool->mutex);
+}
+
+
 /**
  * Create a new scene object.
  * \param queue  the queue to put newly rendered/emptied scenes into
@@ -73,8 +263,6 @@ lp_scene_create(struct lp_setup_context *setup)
    scene->setup = setup;
    scene->data.head = &scene->data.first;
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -101,8 +289,9 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_scene_end_rasterization(scene);
-   mtx_destroy(&scene->mutex);
    free(scene->tiles);
+   free(scene->bin_order);
+   free(scene->runs);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
 }
@@ -147,6 +336,8 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
    struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
 
    bin->last_state = NULL;
+   bin->count = 0;
+   bin->not_flags = 0;
    bin->head = bin->tail;
    if (bin->tail) {
       bin->tail->next = NULL;
@@ -299,23 +490,20 @@ lp_scene_end_rasterization(struct lp_scene *scene)
       }
    }
 
-   /* Free all scene data blocks:
+   /* Return all scene data blocks to the pool:
     */
    {
       struct data_block_list *list = &scene->data;
-      struct data_block *block, *tmp;
 
-      for (block = list->head; block; block = tmp) {
-         tmp = block->next;
-         if (block != &list->first)
-            FREE(block);
-      }
+      lp_scene_block_pool_put(&scene->setup->block_pool,
+                              list->head, &list->first);
 
       list->head = &list->first;
       list->head->next = NULL;
    }
 
    lp_fence_reference(&scene->fence, NULL);
+   lp_fence_reference(&scene->rast_prev_fence, NULL);
 
    scene->resources = NULL;
    scene->writeable_resources = NULL;
@@ -353,12 +541,13 @@ lp_scene_new_cmd_block(struct lp_scene *scene,
 struct data_block *
 lp_scene_new_data_block(struct lp_scene *scene)
 {
-   if (scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
+   if (scene->scene_size + DATA_BLOCK_SIZE > scene->max_size) {
       if (0) debug_printf("%s: failed\n", __func__);
       scene->alloc_failed = TRUE;
       return NULL;
    } else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
+      struct data_block *block =
+         lp_scene_block_pool_get(&scene->setup->block_pool);
       if (!block)
          return NULL;
 
@@ -372,7 +561,6 @@ lp_scene_new_data_block(struct lp_scene *scene)
    }
 }
 
-
 /**
  * Return number of bytes used for all bin data within a scene.
  * This does not include resources (textures) referenced by the scene.
@@ -533,60 +721,188 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/** Gather the even bits of v */
+static inline unsigned
+morton_compact(unsigned v)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+   v &= 0x55555555;
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0f0f0f0f;
+   v = (v | (v >> 4)) & 0x00ff00ff;
+   v = (v | (v >> 8)) & 0x0000ffff;
+   return v;
+}
+
+
+/**
+ * List the bins in Morton (Z) order, so that any contiguous range of
+ * bins covers a compact area of the framebuffer.
+ */
+static void
+build_bin_order(struct lp_scene *scene)
+{
+   const unsigned size = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                     scene->tiles_y));
+   unsigned n = 0;
+
+   for (unsigned code = 0; code < size * size; code++) {
+      const unsigned x = morton_compact(code);
+      const unsigned y = morton_compact(code >> 1);
+
+      if (x < scene->tiles_x && y < scene->tiles_y)
+         scene->bin_order[n++] = y * scene->tiles_x + x;
    }
-   return TRUE;
+
+   assert(n == lp_scene_get_num_bins(scene));
+
+   scene->order_tiles_x = scene->tiles_x;
+   scene->order_tiles_y = scene->tiles_y;
+}
+
+
+/**
+ * Rough estimate of the cost of rasterizing a bin, from what
+ * lp_scene_bin_command() accumulated while binning.
+ */
+static unsigned
+bin_cost(const struct cmd_bin *bin)
+{
+   if (!bin->head)
+      return 0;
+
+   const struct lp_bin_info info = lp_characterize_bin(bin);
+
+   /* Blits and linear rectangles are far cheaper per command than
+    * the general triangle path.
+    */
+   if (info.type & (LP_RAST_FLAGS_BLIT | LP_RAST_FLAGS_RECT))
+      return 1 + info.count;
+
+   return 1 + info.count * 4;
+}
+
+
+static int
+compare_runs(const void *a, const void *b)
+{
+   const struct lp_scene_bin_run *ra = a;
+   const struct lp_scene_bin_run *rb = b;
+
+   if (ra->cost != rb->cost)
+      return ra->cost > rb->cost ? -1 : 1;
+
+   return ra->start < rb->start ? -1 : ra->start > rb->start;
 }
 
 
+/**
+ * Build the schedule the rasterizer threads take bins from.
+ *
+ * The bins are cut into runs of Morton ordered tiles, so that a thread
+ * works on neighbouring tiles which likely share texture and framebuffer
+ * cache lines.  With multiple threads the most expensive runs are handed
+ * out first, which keeps threads from being left with a single expensive
+ * run at the end of the scene.
+ *
+ * The runs are split into num_groups groups covering compact areas of
+ * the framebuffer.  Threads take runs from their own group first, so
+ * that each NUMA node keeps working on, and first touching, the same
+ * part of the framebuffer from scene to scene.
+ *
+ * Called once per scene, before it is handed to the threads.
+ */
 void
-lp_scene_bin_iter_begin(struct lp_scene *scene)
+lp_scene_bin_iter_begin(struct lp_scene *scene, unsigned num_threads,
+                        unsigned num_groups)
 {
-   scene->curr_x = scene->curr_y = -1;
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+
+   if (scene->order_tiles_x != scene->tiles_x ||
+       scene->order_tiles_y != scene->tiles_y)
+      build_bin_order(scene);
+
+   /* Aim for several runs per thread, and round down to a power of four
+    * so that runs cover square areas where possible.
+    */
+   unsigned run_length = MAX2(num_bins, 1);
+   if (num_threads > 1) {
+      run_length = num_bins / (num_threads * LP_SCENE_RUNS_PER_THREAD);
+      run_length = CLAMP(run_length, 1, LP_SCENE_MAX_RUN_LENGTH);
+      run_length = 1 << (util_logbase2(run_length) & ~1);
+   }
+
+   assert(num_groups >= 1 && num_groups <= LP_MAX_NODES);
+   scene->num_groups = num_groups;
+   scene->num_runs = 0;
+
+   for (unsigned g = 0; g < num_groups; g++) {
+      struct lp_scene_bin_group *group = &scene->groups[g];
+      const unsigned first =
+         g * num_bins / num_groups / run_length * run_length;
+      const unsigned last = g + 1 == num_groups ? num_bins :
+         (g + 1) * num_bins / num_groups / run_length * run_length;
+
+      group->next_run = scene->num_runs;
+
+      for (unsigned start = first; start < last; start += run_length) {
+         struct lp_scene_bin_run *run = &scene->runs[scene->num_runs++];
+
+         run->start = start;
+         run->end = MIN2(start + run_length, last);
+         run->cost = 0;
+
+         if (num_threads > 1) {
+            for (unsigned i = run->start; i < run->end; i++)
+               run->cost += bin_cost(&scene->tiles[scene->bin_order[i]]);
+         }
+      }
+
+      group->end_run = scene->num_runs;
+
+      if (num_threads > 1) {
+         qsort(&scene->runs[group->next_run],
+               group->end_run - group->next_run,
+               sizeof scene->runs[0], compare_runs);
+      }
+   }
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next bin to be rendered, and its position.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on, each with its own iterator.  Threads grab
+ * a whole run of bins at a time, lock-free, from their preferred group
+ * until it runs out, then from the others.  NULL is only returned once
+ * every bin of the scene has been handed out.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next(struct lp_scene *scene,
+                       struct lp_scene_bin_iter *iter,
+                       int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   while (iter->pos == iter->end) {
+      if (iter->groups_done == scene->num_groups)
+         return NULL;
 
-   mtx_lock(&scene->mutex);
+      struct lp_scene_bin_group *group =
+         &scene->groups[iter->group % scene->num_groups];
+      const unsigned run = p_atomic_inc_return(&group->next_run) - 1;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   } else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+      if (run < group->end_run) {
+         iter->pos = scene->runs[run].start;
+         iter->end = scene->runs[run].end;
+      } else {
+         iter->group++;
+         iter->groups_done++;
+      }
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   const unsigned idx = scene->bin_order[iter->pos++];
+   *x = idx % scene->tiles_x;
+   *y = idx / scene->tiles_x;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return &scene->tiles[idx];
 }
 
 
@@ -598,6 +914,8 @@ lp_scene_begin_binning(struct lp_scene *scene,
 
    util_copy_framebuffer_state(&scene->fb, fb);
 
+   scene->max_size = scene->setup->scene_max_size;
+
    scene->tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
    scene->tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
    assert(scene->tiles_x <= TILES_X);
@@ -607,10 +925,15 @@ lp_scene_begin_binning(struct lp_scene *scene,
    if (scene->num_alloced_tiles < num_required_tiles) {
       scene->tiles = reallocarray(scene->tiles, num_required_tiles,
                                   sizeof(struct cmd_bin));
-      if (!scene->tiles)
+      scene->bin_order = reallocarray(scene->bin_order, num_required_tiles,
+                                      sizeof(unsigned));
+      scene->runs = reallocarray(scene->runs, num_required_tiles,
+                                 sizeof(struct lp_scene_bin_run));
+      if (!scene->tiles || !scene->bin_order || !scene->runs)
          return;
       memset(scene->tiles, 0, sizeof(struct cmd_bin) * num_required_tiles);
       scene->num_alloced_tiles = num_required_tiles;
+      scene->order_tiles_x = scene->order_tiles_y = 0;
    }
 
    /*
@@ -639,6 +962,29 @@ lp_scene_begin_binning(struct lp_scene *scene,
 
    scene->fb_max_layer = max_layer;
    scene->fb_max_samples = util_framebuffer_get_num_samples(fb);
+
+   /*
+    * Depth bounds are only kept for single sampled, single layer depth
+    * buffers, and start out unknown.
+    */
+   scene->hiz = FALSE;
+   if (fb->zsbuf && max_layer == 0 && scene->fb_max_samples == 1 &&
+       !(LP_PERF & PERF_NO_HIZ)) {
+      const struct util_format_description *desc =
+         util_format_description(fb->zsbuf->format);
+
+      if (util_format_has_depth(desc)) {
+         const struct util_format_channel_description *chan =
+            &desc->channel[desc->swizzle[0]];
+
+         scene->hiz = TRUE;
+         scene->hiz_quantum = chan->type == UTIL_FORMAT_TYPE_FLOAT ? 0.0f :
+            (float)(1.0 / (double)((1ull << chan->size) - 1));
+      }
+   }
+
+   for (unsigned i = 0; i < num_required_tiles; i++)
+      scene->tiles[i].hiz_zmax = INFINITY;
    if (scene->fb_max_samples == 4) {
       for (unsigned i = 0; i < 4; i++) {
          scene->fixed_sample_pos[i][0] = util_iround(lp_sample_pos_4x[i][0] * FIXED_ONE);
@@ -648,6 +994,102 @@ lp_scene_begin_binning(struct lp_scene *scene,
 }
 
 
+/**
+ * Prepare a chunk scene for binning part of the primitives of 'scene'
+ * (the scene currently being built) on another thread.  The chunk uses
+ * the same framebuffer and may allocate at most 'max_size' bytes.
+ */
+void
+lp_scene_begin_chunk(struct lp_scene *chunk,
+                     struct lp_scene *scene,
+                     unsigned max_size)
+{
+   lp_scene_begin_binning(chunk, &scene->fb);
+
+   chunk->had_queries = scene->had_queries;
+
+   /* The data blocks are handed over to the parent scene when merging,
+    * which isn't possible for the embedded first block, so don't use it.
+    */
+   chunk->data.first.used = DATA_BLOCK_SIZE;
+   chunk->max_size = max_size;
+
+   for (unsigned i = 0; i < lp_scene_get_num_bins(scene); i++)
+      chunk->tiles[i].hiz_zmax = scene->tiles[i].hiz_zmax;
+}
+
+
+/**
+ * Append the commands binned into a chunk scene to the scene's bins and
+ * transfer ownership of the chunk's data.  The chunk is left empty.
+ */
+void
+lp_scene_merge_chunk(struct lp_scene *scene,
+                     struct lp_scene *chunk)
+{
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+
+   assert(chunk->tiles_x == scene->tiles_x);
+   assert(chunk->tiles_y == scene->tiles_y);
+
+   for (unsigned i = 0; i < num_bins; i++) {
+      struct cmd_bin *bin = &scene->tiles[i];
+      const struct cmd_bin *chunk_bin = &chunk->tiles[i];
+
+      if (!chunk_bin->head)
+         continue;
+
+      if (bin->tail)
+         bin->tail->next = chunk_bin->head;
+      else
+         bin->head = chunk_bin->head;
+      bin->tail = chunk_bin->tail;
+      bin->last_state = chunk_bin->last_state;
+      bin->count += chunk_bin->count;
+      bin->not_flags |= chunk_bin->not_flags;
+
+      /* The chunk started out from the scene's bound at the start of the
+       * draw, which earlier chunks may have tightened since.  A dropped
+       * bound can't be told from one which was never known.
+       */
+      if (chunk_bin->hiz_zmax == INFINITY)
+         bin->hiz_zmax = INFINITY;
+      else
+         bin->hiz_zmax = MIN2(bin->hiz_zmax, chunk_bin->hiz_zmax);
+   }
+
+   /* Splice the chunk's data blocks in after our current block, or in
+    * front of the embedded first block, which ends the list of blocks
+    * returned to the pool.
+    */
+   struct data_block *head = chunk->data.head;
+   if (head != &chunk->data.first) {
+      struct data_block *block = head;
+
+      for (;;) {
+         scene->scene_size += sizeof *block;
+         if (block->next == &chunk->data.first)
+            break;
+         block = block->next;
+      }
+
+      if (scene->data.head == &scene->data.first) {
+         block->next = &scene->data.first;
+         scene->data.head = head;
+      } else {
+         block->next = scene->data.head->next;
+         scene->data.head->next = head;
+      }
+
+      chunk->data.head = &chunk->data.first;
+      chunk->data.first.next = NULL;
+   }
+
+   /* Nothing left to free, just resets the bins and drops the fb refs */
+   lp_scene_end_rasterization(chunk);
+}
+
+
 void
 lp_scene_end_binning(struct lp_scene *scene)
 {
@@ -35,9 +35,12 @@
 #ifndef LP_SCENE_H
 #define LP_SCENE_H
 
+#include "util/list.h"
 #include "util/u_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_state_fs.h"
 
 struct lp_scene_queue;
 struct lp_rast_state;
@@ -59,9 +62,18 @@ struct lp_rast_state;
  */
 #define DATA_BLOCK_SIZE (64 * 1024)
 
-/* Scene temporary storage is clamped to this size:
+/* Bins are handed to the rasterizer threads in runs of up to this many
+ * tiles, aiming for this many runs per thread.
+ */
+#define LP_SCENE_MAX_RUN_LENGTH 16
+#define LP_SCENE_RUNS_PER_THREAD 8
+
+/* Scene temporary storage is initially clamped to this size.  Contexts
+ * which keep filling up their scenes raise their limit up to
+ * LP_SCENE_MAX_SIZE_LIMIT, see lp_setup_adapt_scene_size().
  */
 #define LP_SCENE_MAX_SIZE (36*1024*1024)
+#define LP_SCENE_MAX_SIZE_LIMIT (288*1024*1024)
 
 /* The maximum amount of texture storage referenced by a scene is
  * clamped to this size:
@@ -98,6 +110,9 @@ struct cmd_bin {
    const struct lp_rast_state *last_state;  /* most recent state set in bin */
    struct cmd_block *head;
    struct cmd_block *tail;
+   unsigned count;      /**< number of commands, see lp_characterize_bin() */
+   unsigned not_flags;  /**< LP_RAST_FLAGS_x missing from some command */
+   float hiz_zmax;  /**< depth bound of the tile, see lp_rast_depth_bounds() */
 };
 
 
@@ -116,6 +131,56 @@ struct data_block_list {
    struct data_block *head;
 };
 
+
+/**
+ * Data blocks are carved out of 2MB slabs, so that they may be backed by
+ * huge pages, and recycled through a pool owned by the setup context
+ * rather than freed at the end of each scene.  The pool keeps up to
+ * max_free blocks around, completely free slabs beyond that are released.
+ * Scenes binned on the binning workers allocate from it too, hence the
+ * mutex.
+ */
+struct lp_scene_block_pool {
+   mtx_t mutex;
+   struct list_head slabs;    /**< slabs with free blocks come first */
+   unsigned num_free;
+   unsigned max_free;
+   uint64_t blocks_allocated; /**< blocks of all the slabs created */
+   uint64_t blocks_reused;    /**< blocks handed out from existing slabs */
+};
+
+/**
+ * A run of bins, consecutive in the scene's bin_order, which a single
+ * rasterizer thread works through in one go.
+ */
+struct lp_scene_bin_run {
+   unsigned start, end;   /**< range of bin_order */
+   unsigned cost;         /**< estimated rasterization cost */
+};
+
+
+/**
+ * The runs covering a contiguous range of the bin order, i.e. a compact
+ * area of the framebuffer, preferably rasterized by the threads of one
+ * NUMA node.
+ */
+struct lp_scene_bin_group {
+   unsigned next_run;     /**< next run to hand out, atomically updated */
+   unsigned end_run;      /**< one past the group's last run */
+};
+
+
+/**
+ * Per-thread state for iterating over a scene's bins.
+ * Must be zero-initialized, except for the thread's preferred group.
+ */
+struct lp_scene_bin_iter {
+   unsigned pos, end;
+   unsigned group;        /**< group runs are currently taken from */
+   unsigned groups_done;  /**< number of groups found out of runs */
+};
+
+
 struct resource_ref;
 
 struct shader_ref;
@@ -163,6 +228,10 @@ struct lp_scene {
    /* max samples for bound framebuffer */
    unsigned fb_max_samples;
 
+   /* Whether depth bounds are kept, and the depth buffer precision */
+   boolean hiz;
+   float hiz_quantum;
+
    /** the framebuffer to render the scene into */
    struct pipe_framebuffer_state fb;
 
@@ -181,6 +250,9 @@ struct lp_scene {
     */
    unsigned scene_size;
 
+   /** Limit for scene_size, set when binning begins */
+   unsigned max_size;
+
    /** Sum of sizes of all resources referenced by the scene.  Sums
     * all the textures read by the scene:
     */
@@ -189,14 +261,35 @@ struct lp_scene {
    boolean alloc_failed;
    boolean permit_linear_rasterizer;
 
+   /**
+    * Rasterizer pipelining state, set when the scene is queued.
+    * If rast_overlap is set the scene's bins may be rasterized while the
+    * previously queued scene is still in flight, each bin only waits for
+    * the same tile of the previous scene.  Otherwise rasterization starts
+    * once rast_prev_fence (the previous scene's fence) has signalled.
+    */
+   unsigned rast_seq;
+   boolean rast_overlap;
+   struct lp_fence *rast_prev_fence;
+
    /**
     * Number of active tiles in each dimension.
     * This basically the framebuffer size divided by tile size
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /**
+    * Bin schedule, see lp_scene_bin_iter_begin().
+    * bin_order has all the bins' indices in Morton order, runs are
+    * contiguous ranges of it, handed out to the threads through the
+    * groups' next_run.
+    */
+   unsigned *bin_order;
+   unsigned order_tiles_x, order_tiles_y;  /**< bin_order was built for */
+   struct lp_scene_bin_run *runs;
+   unsigned num_runs;
+   struct lp_scene_bin_group groups[LP_MAX_NODES];
+   unsigned num_groups;
 
    unsigned num_alloced_tiles;
    struct cmd_bin *tiles;
@@ -215,6 +308,18 @@ boolean lp_scene_is_oom(struct lp_scene *scene);
 
 struct data_block *lp_scene_new_data_block(struct lp_scene *scene);
 
+void lp_scene_block_pool_init(struct lp_scene_block_pool *pool,
+                              unsigned max_free);
+
+void lp_scene_block_pool_set_max_free(struct lp_scene_block_pool *pool,
+                                      unsigned max_free);
+
+void lp_scene_block_pool_destroy(struct lp_scene_block_pool *pool);
+
+void lp_scene_block_pool_get_counters(struct lp_scene_block_pool *pool,
+                                      uint64_t *allocated,
+                                      uint64_t *reused);
+
 struct cmd_block *lp_scene_new_cmd_block(struct lp_scene *scene,
                                          struct cmd_bin *bin);
 
@@ -247,7 +352,7 @@ lp_scene_alloc(struct lp_scene *scene, unsigned size)
    if (LP_DEBUG & DEBUG_MEM)
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
                    size, block->used, (unsigned)DATA_BLOCK_SIZE,
-                   scene->scene_size, LP_SCENE_MAX_SIZE);
+                   scene->scene_size, scene->max_size);
 
    if (block->used + size > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block(scene);
@@ -281,7 +386,7 @@ lp_scene_alloc_aligned(struct lp_scene *scene, unsigned size,
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
                    size + alignment - 1,
                    block->used, (unsigned)DATA_BLOCK_SIZE,
-                   scene->scene_size, LP_SCENE_MAX_SIZE);
+                   scene->scene_size, scene->max_size);
 
    if (block->used + size + alignment - 1 > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block(scene);
@@ -342,6 +447,9 @@ lp_scene_bin_command(struct lp_scene *scene,
       tail->count++;
    }
 
+   bin->count++;
+   bin->not_flags |= ~lp_rast_op_flags[cmd & LP_RAST_OP_MASK];
+
    return TRUE;
 }
 
@@ -357,6 +465,8 @@ lp_scene_bin_cmd_with_state(struct lp_scene *scene,
 
    if (state != bin->last_state) {
       bin->last_state = state;
+      if (state->variant->hiz_invalidate)
+         bin->hiz_zmax = INFINITY;
       if (!lp_scene_bin_command(scene, x, y,
                                 LP_RAST_OP_SET_STATE,
                                 lp_rast_arg_state(state)))
@@ -396,10 +506,13 @@ lp_scene_get_num_bins(const struct lp_scene *scene)
 
 
 void
-lp_scene_bin_iter_begin(struct lp_scene *scene);
+lp_scene_bin_iter_begin(struct lp_scene *scene, unsigned num_threads,
+                        unsigned num_groups);
 
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y);
+lp_scene_bin_iter_next(struct lp_scene *scene,
+                       struct lp_scene_bin_iter *iter,
+                       int *x, int *y);
 
 
 
@@ -413,6 +526,18 @@ void
 lp_scene_end_binning(struct lp_scene *scene);
 
 
+/* Bin into a private chunk scene on behalf of another scene
+ */
+void
+lp_scene_begin_chunk(struct lp_scene *chunk,
+                     struct lp_scene *scene,
+                     unsigned max_size);
+
+void
+lp_scene_merge_chunk(struct lp_scene *scene,
+                     struct lp_scene *chunk);
+
+
 /* Begin/end rasterization of a scene
  */
 void
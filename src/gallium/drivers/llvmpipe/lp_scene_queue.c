@@ -27,9 +27,11 @@
 
 
 /**
- * Scene queue.  We'll use two queues.  One contains "full" scenes which
- * are produced by the "setup" code.  The other contains "empty" scenes
- * which are produced by the "rast" code when it finishes rendering a scene.
+ * Scene queue.  Full scenes are produced by the "setup" code and consumed
+ * by the "rast" code.  Every scene is handed to each of the queue's
+ * readers (the rasterizer threads), which consume scenes at their own
+ * pace, so one thread may already be working on the next scene while
+ * others are still finishing the current one.
  */
 
 #include "util/u_thread.h"
@@ -37,6 +39,7 @@
 #include "lp_scene_queue.h"
 #include "util/u_math.h"
 #include "lp_setup_context.h"
+#include "lp_limits.h"
 
 
 #define SCENE_QUEUE_SIZE MAX_SCENES
@@ -55,9 +58,11 @@ struct lp_scene_queue
 
    /* These values wrap around, so that head == tail means empty.  When used
     * to index the array, we use them modulo the queue size.  This scheme
-    * works because the queue size is a power of two.
+    * works because the queue size is a power of two.  Each reader has its
+    * own head, a slot can only be reused once all readers are past it.
     */
-   unsigned head;
+   unsigned num_readers;
+   unsigned *head;
    unsigned tail;
 };
 
@@ -65,7 +70,7 @@ struct lp_scene_queue
 
 /** Allocate a new scene queue */
 struct lp_scene_queue *
-lp_scene_queue_create(void)
+lp_scene_queue_create(unsigned num_readers)
 {
    /* Circular queue behavior depends on size being a power of two. */
    STATIC_ASSERT(SCENE_QUEUE_SIZE > 0);
@@ -76,6 +81,14 @@ lp_scene_queue_create(void)
    if (!queue)
       return NULL;
 
+   assert(num_readers > 0);
+   queue->num_readers = num_readers;
+   queue->head = CALLOC(num_readers, sizeof(unsigned));
+   if (!queue->head) {
+      FREE(queue);
+      return NULL;
+   }
+
    (void) mtx_init(&queue->mutex, mtx_plain);
    cnd_init(&queue->change);
 
@@ -89,30 +102,49 @@ lp_scene_queue_destroy(struct lp_scene_queue *queue)
 {
    cnd_destroy(&queue->change);
    mtx_destroy(&queue->mutex);
+   FREE(queue->head);
    FREE(queue);
 }
 
 
-/** Remove first lp_scene from head of queue */
+/** Number of queue slots which some reader has not dequeued yet */
+static unsigned
+queue_used_slots(const struct lp_scene_queue *queue)
+{
+   unsigned used = 0;
+
+   for (unsigned i = 0; i < queue->num_readers; i++)
+      used = MAX2(used, queue->tail - queue->head[i]);
+
+   return used;
+}
+
+
+/** Remove first lp_scene from the given reader's head of queue */
 struct lp_scene *
-lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait)
+lp_scene_dequeue(struct lp_scene_queue *queue, unsigned reader,
+                 boolean wait)
 {
+   assert(reader < queue->num_readers);
+
    mtx_lock(&queue->mutex);
 
    if (wait) {
       /* Wait for queue to be not empty. */
-      while (queue->head == queue->tail)
+      while (queue->head[reader] == queue->tail)
          cnd_wait(&queue->change, &queue->mutex);
    } else {
-      if (queue->head == queue->tail) {
+      if (queue->head[reader] == queue->tail) {
          mtx_unlock(&queue->mutex);
          return NULL;
       }
    }
 
-   struct lp_scene *scene = queue->scenes[queue->head++ % SCENE_QUEUE_SIZE];
+   struct lp_scene *scene =
+      queue->scenes[queue->head[reader]++ % SCENE_QUEUE_SIZE];
 
-   cnd_signal(&queue->change);
+   /* Both the producer and the other readers may be waiting. */
+   cnd_broadcast(&queue->change);
    mtx_unlock(&queue->mutex);
 
    return scene;
@@ -126,11 +158,11 @@ lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene)
    mtx_lock(&queue->mutex);
 
    /* Wait for free space. */
-   while (queue->tail - queue->head >= SCENE_QUEUE_SIZE)
+   while (queue_used_slots(queue) >= SCENE_QUEUE_SIZE)
       cnd_wait(&queue->change, &queue->mutex);
 
    queue->scenes[queue->tail++ % SCENE_QUEUE_SIZE] = scene;
 
-   cnd_signal(&queue->change);
+   cnd_broadcast(&queue->change);
    mtx_unlock(&queue->mutex);
 }
@@ -36,13 +36,14 @@ struct lp_scene;
 
 
 struct lp_scene_queue *
-lp_scene_queue_create(void);
+lp_scene_queue_create(unsigned num_readers);
 
 void
 lp_scene_queue_destroy(struct lp_scene_queue *queue);
 
 struct lp_scene *
-lp_scene_dequeue(struct lp_scene_queue *queue, boolean wait);
+lp_scene_dequeue(struct lp_scene_queue *queue, unsigned reader,
+                 boolean wait);
 
 void
 lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene);
@@ -27,6 +27,7 @@
 
 
 #include "util/u_memory.h"
+#include "util/u_inlines.h"
 #include "util/u_math.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
@@ -39,8 +40,11 @@
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_nir.h"
 #include "util/disk_cache.h"
+#include "util/hash_table.h"
 #include "util/os_misc.h"
 #include "util/os_time.h"
+#include "util/u_threaded_context.h"
+#include "util/perf/u_perfetto.h"
 #include "lp_texture.h"
 #include "lp_fence.h"
 #include "lp_jit.h"
@@ -52,10 +56,14 @@
 #include "lp_rast.h"
 #include "lp_cs_tpool.h"
 #include "lp_flush.h"
+#include "lp_query.h"
 
 #include "frontend/sw_winsys.h"
 
 #include "nir.h"
+#include "nir_serialize.h"
+#include "tgsi/tgsi_parse.h"
+#include "util/mesa-sha1.h"
 
 
 #ifdef DEBUG
@@ -96,6 +104,9 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
+   { "no_vcache",      PERF_NO_VCACHE, NULL },
+   { "interp_only",    PERF_INTERP_ONLY, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -840,6 +851,9 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
 
    assert(texture->dt);
 
+   if (_pipe)
+      _pipe = threaded_context_unwrap_sync(_pipe);
+
    if (texture->dt) {
       if (_pipe)
          llvmpipe_flush_resource(_pipe, resource, 0, true, true,
@@ -850,6 +864,66 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
 }
 
 
+#if GALLIVM_USE_ORCJIT == 1
+static void
+lp_compile_contexts_free(struct llvmpipe_screen *screen)
+{
+   for (unsigned i = 0; i < screen->num_compile_threads; i++) {
+      if (screen->compile_contexts[i])
+         LLVMOrcDisposeThreadSafeContext(screen->compile_contexts[i]);
+   }
+
+   FREE(screen->compile_contexts);
+   screen->compile_contexts = NULL;
+}
+
+
+/**
+ * Start the background shader compile threads.  An LLVM context can't be
+ * used by several threads at once, so every thread gets its own.  Only
+ * ORCJIT can compile in one context and run the code in another.
+ */
+static bool
+lp_compile_queue_init(struct llvmpipe_screen *screen)
+{
+   screen->compile_contexts = CALLOC(screen->num_compile_threads,
+                                     sizeof *screen->compile_contexts);
+   if (!screen->compile_contexts)
+      return false;
+
+   for (unsigned i = 0; i < screen->num_compile_threads; i++) {
+      screen->compile_contexts[i] = LLVMOrcCreateNewThreadSafeContext();
+      if (!screen->compile_contexts[i])
+         goto fail;
+#if LLVM_VERSION_MAJOR >= 15
+      LLVMContextSetOpaquePointers(
+         LLVMOrcThreadSafeContextGetContext(screen->compile_contexts[i]),
+         false);
+#endif
+   }
+
+   if (!util_queue_init(&screen->compile_queue, "lpcomp", 64,
+                        screen->num_compile_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL))
+      goto fail;
+
+   return true;
+
+fail:
+   lp_compile_contexts_free(screen);
+   return false;
+}
+
+
+static void
+lp_compile_queue_destroy(struct llvmpipe_screen *screen)
+{
+   util_queue_destroy(&screen->compile_queue);
+   lp_compile_contexts_free(screen);
+}
+#endif
+
+
 static void
 llvmpipe_destroy_screen(struct pipe_screen *_screen)
 {
@@ -859,19 +933,38 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
    if (screen->cs_tpool)
       lp_cs_tpool_destroy(screen->cs_tpool);
 
+   if (screen->late_init_done && screen->num_bin_threads)
+      util_queue_destroy(&screen->bin_queue);
+
+#if GALLIVM_USE_ORCJIT == 1
+   if (screen->late_init_done && screen->num_compile_threads)
+      lp_compile_queue_destroy(screen);
+#endif
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
    lp_jit_screen_cleanup(screen);
 
    disk_cache_destroy(screen->disk_shader_cache);
+
+   if (screen->shared_code) {
+      /* The contexts have released all the code by now */
+      assert(!_mesa_hash_table_num_entries(screen->shared_code));
+      _mesa_hash_table_destroy(screen->shared_code, NULL);
+      mtx_destroy(&screen->shared_code_mutex);
+   }
+
    if (winsys->destroy)
       winsys->destroy(winsys);
 
    glsl_type_singleton_decref();
 
+   slab_destroy_parent(&screen->transfer_pool);
+
    mtx_destroy(&screen->rast_mutex);
    mtx_destroy(&screen->cs_mutex);
+   FREE(screen->thread_query_names);
    FREE(screen);
 }
 
@@ -1004,6 +1097,139 @@ lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
 }
 
 
+/**
+ * SHA1 of the IR of a shader, which the IR cache keys of its variants are
+ * made of.  Compiles may lower the NIR in place, so this is computed once
+ * at shader creation.
+ */
+void
+lp_shader_ir_sha1(const struct pipe_shader_state *state,
+                  unsigned char ir_sha1[20])
+{
+   struct blob blob;
+
+   blob_init(&blob);
+   if (state->type == PIPE_SHADER_IR_NIR) {
+      nir_serialize(&blob, state->ir.nir, true);
+   } else {
+      /* Only for the shared code, TGSI shaders aren't cached on disk */
+      blob_write_bytes(&blob, state->tokens,
+                       tgsi_num_tokens(state->tokens) *
+                       sizeof(struct tgsi_token));
+   }
+
+   _mesa_sha1_compute(blob.data, blob.size, ir_sha1);
+   blob_finish(&blob);
+}
+
+
+static uint32_t
+shared_code_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+
+static bool
+shared_code_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+
+/**
+ * Look for the code of a variant in the screen's shared code, and return a
+ * reference to it, or NULL.
+ */
+struct lp_shared_code *
+lp_shared_code_find(struct llvmpipe_screen *screen,
+                    const unsigned char ir_sha1_cache_key[20])
+{
+   struct lp_shared_code *code = NULL;
+
+   if (!screen->shared_code)
+      return NULL;
+
+   mtx_lock(&screen->shared_code_mutex);
+   struct hash_entry *entry =
+      _mesa_hash_table_search(screen->shared_code, ir_sha1_cache_key);
+   if (entry) {
+      code = entry->data;
+      pipe_reference(NULL, &code->reference);
+   }
+   mtx_unlock(&screen->shared_code_mutex);
+
+   return code;
+}
+
+
+/**
+ * Take over the compiled code of a variant, to share it with the variants
+ * of the other contexts with the same key.  The caller holds the only
+ * reference to the result.  Returns NULL if the code isn't to be shared.
+ */
+struct lp_shared_code *
+lp_shared_code_create(struct llvmpipe_screen *screen,
+                      const unsigned char ir_sha1_cache_key[20],
+                      struct gallivm_state *gallivm,
+                      const void *variant, size_t variant_size)
+{
+   if (!screen->shared_code)
+      return NULL;
+
+   struct lp_shared_code *code = CALLOC_STRUCT(lp_shared_code);
+   if (!code)
+      return NULL;
+
+   code->variant = mem_dup(variant, variant_size);
+   if (!code->variant) {
+      FREE(code);
+      return NULL;
+   }
+
+   pipe_reference_init(&code->reference, 1);
+   memcpy(code->ir_sha1_cache_key, ir_sha1_cache_key, 20);
+   code->gallivm = gallivm;
+
+   /* Another context may have compiled the same variant meanwhile, in
+    * which case this copy just stays private to the caller.
+    */
+   mtx_lock(&screen->shared_code_mutex);
+   if (!_mesa_hash_table_search(screen->shared_code, code->ir_sha1_cache_key))
+      _mesa_hash_table_insert(screen->shared_code, code->ir_sha1_cache_key,
+                              code);
+   mtx_unlock(&screen->shared_code_mutex);
+
+   return code;
+}
+
+
+void
+lp_shared_code_reference(struct llvmpipe_screen *screen,
+                         struct lp_shared_code **ptr,
+                         struct lp_shared_code *code)
+{
+   struct lp_shared_code *old = *ptr;
+
+   /* Lookups mustn't find the code while it's being destroyed */
+   mtx_lock(&screen->shared_code_mutex);
+   if (pipe_reference(old ? &old->reference : NULL,
+                      code ? &code->reference : NULL)) {
+      struct hash_entry *entry =
+         _mesa_hash_table_search(screen->shared_code, old->ir_sha1_cache_key);
+      if (entry && entry->data == old)
+         _mesa_hash_table_remove(screen->shared_code, entry);
+
+      gallivm_destroy(old->gallivm);
+      FREE(old->variant);
+      FREE(old);
+   }
+   mtx_unlock(&screen->shared_code_mutex);
+
+   *ptr = code;
+}
+
+
 bool
 llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
 {
@@ -1013,19 +1239,32 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
    if (screen->late_init_done)
       goto out;
 
-   screen->rast = lp_rast_create(screen->num_threads);
+   screen->rast = lp_rast_create(screen->num_threads, screen->num_nodes);
    if (!screen->rast) {
       ret = false;
       goto out;
    }
 
-   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads);
+   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads,
+                                         screen->num_nodes);
    if (!screen->cs_tpool) {
       lp_rast_destroy(screen->rast);
       ret = false;
       goto out;
    }
 
+   if (screen->num_bin_threads &&
+       !util_queue_init(&screen->bin_queue, "lpbin", screen->num_bin_threads,
+                        screen->num_bin_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL))
+      screen->num_bin_threads = 0;
+
+#if GALLIVM_USE_ORCJIT == 1
+   if (screen->num_compile_threads &&
+       !lp_compile_queue_init(screen))
+      screen->num_compile_threads = 0;
+#endif
+
    lp_disk_cache_create(screen);
    screen->late_init_done = true;
 out:
@@ -1051,6 +1290,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    LP_PERF = debug_get_flags_option("LP_PERF", lp_perf_flags, 0 );
 
+   /* For the MESA_TRACE_* points, when not created through EGL */
+   util_perfetto_init();
+
    screen = CALLOC_STRUCT(llvmpipe_screen);
    if (!screen)
       return NULL;
@@ -1091,11 +1333,39 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    screen->allow_cl = !!getenv("LP_CL");
    screen->use_tgsi = (LP_DEBUG & DEBUG_TGSI_IR);
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", FALSE);
    screen->num_threads = util_get_cpu_caps()->nr_cpus > 1
       ? util_get_cpu_caps()->nr_cpus : 0;
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS",
                                               screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
+   llvmpipe_init_screen_query_funcs(screen);
+   screen->num_bin_threads = debug_get_num_option("LP_NUM_BIN_THREADS", 0);
+   screen->num_bin_threads = MIN2(screen->num_bin_threads, LP_MAX_THREADS);
+#if GALLIVM_USE_ORCJIT == 1 && !defined(USE_GLOBAL_LLVM_CONTEXT)
+   screen->num_compile_threads = debug_get_num_option("LP_NUM_COMPILE_THREADS", 0);
+   screen->num_compile_threads = MIN2(screen->num_compile_threads, LP_MAX_THREADS);
+#endif
+
+   /* With MCJIT the code belongs to the LLVM context of the context which
+    * compiled it, so it can't outlive that.
+    */
+#if GALLIVM_USE_ORCJIT == 1
+   if (debug_get_bool_option("LP_SHARED_VARIANTS", FALSE)) {
+      screen->shared_code = _mesa_hash_table_create(NULL, shared_code_hash,
+                                                    shared_code_equal);
+      (void) mtx_init(&screen->shared_code_mutex, mtx_plain);
+   }
+#endif
+
+   /* Spread the threads over the NUMA nodes, if there are enough of them
+    * to give each node at least one.
+    */
+   screen->num_nodes = util_get_cpu_caps()->num_nodes;
+   if (screen->num_nodes > LP_MAX_NODES ||
+       screen->num_nodes > screen->num_threads ||
+       !debug_get_bool_option("LP_NUMA", TRUE))
+      screen->num_nodes = 1;
 
    lp_build_init(); /* get lp_native_vector_width initialised */
 
@@ -1105,6 +1375,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    list_inithead(&screen->ctx_list);
    (void) mtx_init(&screen->ctx_mutex, mtx_plain);
+   slab_create_parent(&screen->transfer_pool,
+                      sizeof(struct llvmpipe_transfer), 64);
    (void) mtx_init(&screen->cs_mutex, mtx_plain);
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
@@ -36,13 +36,18 @@
 
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
+#include "pipe/p_state.h"
 #include "util/u_thread.h"
+#include "util/u_queue.h"
 #include "util/list.h"
+#include "util/slab.h"
 #include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_misc.h"
 
 struct sw_winsys;
 struct lp_cs_tpool;
+struct hash_table;
 
 struct llvmpipe_screen
 {
@@ -52,28 +57,85 @@ struct llvmpipe_screen
 
    unsigned num_threads;
 
+   /** NUMA nodes the rasterizer and compute threads are pinned to */
+   unsigned num_nodes;
+
+   /** Names of the per thread driver queries, two per thread */
+   char (*thread_query_names)[32];
+
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
 
+   /* Increments whenever resources may have been written by shaders or
+    * stream output, which unlike transfers don't touch the timestamp, and
+    * on memory barriers and flushes of mapped ranges.
+    */
+   unsigned write_timestamp;
+
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
 
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
+   /** Worker threads for parallel binning, see lp_setup_bin.c */
+   unsigned num_bin_threads;
+   struct util_queue bin_queue;
+
+   /**
+    * Worker threads compiling fragment shader variants in the background,
+    * each with its own LLVM context, see llvmpipe_update_fs().
+    */
+   unsigned num_compile_threads;
+   struct util_queue compile_queue;
+#if GALLIVM_USE_ORCJIT == 1
+   LLVMOrcThreadSafeContextRef *compile_contexts;
+#else
+   LLVMContextRef *compile_contexts;
+#endif
+
    bool use_tgsi;
    bool allow_cl;
 
+   /** Store sampler-only textures tiled, see llvmpipe_texture_can_tile() */
+   bool tiled_textures;
+
    mtx_t late_mutex;
    bool late_init_done;
 
    mtx_t ctx_mutex;
    struct list_head ctx_list;
 
+   /** Transfers of contexts wrapped in a u_threaded_context */
+   struct slab_parent_pool transfer_pool;
+
    char renderer_string[100];
 
    struct disk_cache *disk_shader_cache;
+
+   /**
+    * JIT code of the shader variants, shared between all the contexts
+    * with LP_SHARED_VARIANTS.  Maps IR cache keys to lp_shared_code.
+    */
+   struct hash_table *shared_code;
+   mtx_t shared_code_mutex;
+};
+
+
+/**
+ * The JIT code of a shader variant, and the results of its compilation,
+ * for the variants with the same IR cache key in all the contexts.
+ */
+struct lp_shared_code
+{
+   struct pipe_reference reference;
+   unsigned char ir_sha1_cache_key[20];
+
+   struct gallivm_state *gallivm;
+
+   /** Copy of the variant which generated the code, stage specific */
+   void *variant;
 };
 
 
@@ -88,6 +150,25 @@ lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
                             struct lp_cached_code *cache,
                             unsigned char ir_sha1_cache_key[20]);
 
+void
+lp_shader_ir_sha1(const struct pipe_shader_state *state,
+                  unsigned char ir_sha1[20]);
+
+struct lp_shared_code *
+lp_shared_code_find(struct llvmpipe_screen *screen,
+                    const unsigned char ir_sha1_cache_key[20]);
+
+struct lp_shared_code *
+lp_shared_code_create(struct llvmpipe_screen *screen,
+                      const unsigned char ir_sha1_cache_key[20],
+                      struct gallivm_state *gallivm,
+                      const void *variant, size_t variant_size);
+
+void
+lp_shared_code_reference(struct llvmpipe_screen *screen,
+                         struct lp_shared_code **ptr,
+                         struct lp_shared_code *code);
+
 bool
 llvmpipe_screen_late_init(struct llvmpipe_screen *screen);
 
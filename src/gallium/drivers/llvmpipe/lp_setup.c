@@ -43,8 +43,10 @@
 #include "util/u_viewport.h"
 #include "draw/draw_pipe.h"
 #include "util/os_time.h"
+#include "util/perf/cpu_trace.h"
 #include "lp_context.h"
 #include "lp_memory.h"
+#include "lp_perf.h"
 #include "lp_scene.h"
 #include "lp_texture.h"
 #include "lp_debug.h"
@@ -70,9 +72,12 @@ lp_setup_wait_empty_scene(struct lp_setup_context *setup)
 {
    /* just use the first scene if we run out */
    if (setup->scenes[0]->fence) {
+      MESA_TRACE_FUNC();
       debug_printf("%s: wait for scene %d\n",
                    __func__, setup->scenes[0]->fence->id);
+      int64_t start = os_time_get_nano();
       lp_fence_wait(setup->scenes[0]->fence);
+      setup->counters.scene_wait_time += os_time_get_nano() - start;
       lp_scene_end_rasterization(setup->scenes[0]);
    }
    return 0;
@@ -198,6 +203,42 @@ lp_setup_reset(struct lp_setup_context *setup)
 }
 
 
+/**
+ * Adapt the scene size limit to the working set.  Scenes which ran out of
+ * space and had to be flushed early double it, and if none of the last
+ * LP_SETUP_SCENE_SIZE_PERIOD scenes used more than a quarter of it, it's
+ * halved again.  Freed blocks for one scene of that size are kept around.
+ */
+static void
+lp_setup_adapt_scene_size(struct lp_setup_context *setup,
+                          const struct lp_scene *scene)
+{
+   unsigned max_size = setup->scene_max_size;
+
+   setup->scene_size_peak = MAX2(setup->scene_size_peak, scene->scene_size);
+
+   if (scene->alloc_failed) {
+      LP_COUNT(nr_scene_forced_flushes);
+      max_size = MIN2(max_size * 2, LP_SCENE_MAX_SIZE_LIMIT);
+   } else if (++setup->num_sized_scenes < LP_SETUP_SCENE_SIZE_PERIOD) {
+      return;
+   } else if (setup->scene_size_peak < max_size / 4) {
+      max_size = MAX2(max_size / 2, LP_SCENE_MAX_SIZE);
+   }
+
+   setup->scene_size_peak = 0;
+   setup->num_sized_scenes = 0;
+
+   if (max_size != setup->scene_max_size) {
+      LP_DBG(DEBUG_SETUP, "scene size limit %u -> %u\n",
+             setup->scene_max_size, max_size);
+      setup->scene_max_size = max_size;
+      lp_scene_block_pool_set_max_free(&setup->block_pool,
+                                       max_size / sizeof(struct data_block));
+   }
+}
+
+
 /** Rasterize all scene's bins */
 static void
 lp_setup_rasterize_scene(struct lp_setup_context *setup)
@@ -205,6 +246,12 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
 
+   lp_setup_adapt_scene_size(setup, scene);
+
+   setup->counters.scenes++;
+   if (scene->alloc_failed)
+      setup->counters.full_scenes++;
+
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
@@ -221,6 +268,25 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
 }
 
 
+/**
+ * Set the depth bound of all tiles after binning a depth/stencil clear.
+ */
+static void
+set_cleared_depth_bounds(struct lp_scene *scene,
+                         uint64_t zsvalue, uint64_t zsmask)
+{
+   float depth;
+
+   if (!scene->hiz ||
+       !lp_rast_clear_depth_value(scene->fb.zsbuf->format,
+                                  zsvalue, zsmask, &depth))
+      return;
+
+   for (unsigned i = 0; i < lp_scene_get_num_bins(scene); i++)
+      scene->tiles[i].hiz_zmax = depth;
+}
+
+
 static boolean
 begin_binning(struct lp_setup_context *setup)
 {
@@ -285,6 +351,8 @@ begin_binning(struct lp_setup_context *setup)
                                          setup->clear.zsmask))) {
             return FALSE;
          }
+         set_cleared_depth_bounds(scene, setup->clear.zsvalue,
+                                  setup->clear.zsmask);
       }
    }
 
@@ -354,13 +422,16 @@ set_scene_state(struct lp_setup_context *setup,
       if (!begin_binning(setup))
          goto fail;
       break;
-   case SETUP_FLUSHED:
+   case SETUP_FLUSHED: {
+      /* name the flush by its reason in traces */
+      MESA_TRACE_SCOPE(reason);
       if (old_state == SETUP_CLEARED)
          if (!execute_clears(setup))
             goto fail;
       lp_setup_rasterize_scene(setup);
       assert(setup->scene == NULL);
       break;
+   }
    default:
       assert(0 && "invalid setup state mode");
       goto fail;
@@ -389,6 +460,17 @@ lp_setup_flush(struct lp_setup_context *setup,
 }
 
 
+const struct lp_setup_counters *
+lp_setup_get_counters(struct lp_setup_context *setup)
+{
+   /* The binning workers allocate from the pool too */
+   lp_scene_block_pool_get_counters(&setup->block_pool,
+                                    &setup->counters.scene_blocks_allocated,
+                                    &setup->counters.scene_blocks_reused);
+   return &setup->counters;
+}
+
+
 void
 lp_setup_bind_framebuffer(struct lp_setup_context *setup,
                           const struct pipe_framebuffer_state *fb)
@@ -517,6 +599,8 @@ lp_setup_try_clear_zs(struct lp_setup_context *setup,
                                    LP_RAST_OP_CLEAR_ZSTENCIL,
                                    lp_rast_arg_clearzs(zsvalue, zsmask)))
          return FALSE;
+
+      set_cleared_depth_bounds(scene, zsvalue, zsmask);
    } else {
       /* Put ourselves into the 'pre-clear' state, specifically to try
        * and accumulate multiple clears to color and depth_stencil
@@ -774,6 +858,25 @@ lp_setup_set_stencil_ref_values(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Set the LP_JIT_DYN_x words generic fragment shader variants read.
+ */
+void
+lp_setup_set_fs_dynamic_state(struct lp_setup_context *setup,
+                              const uint32_t *dynamic_state)
+{
+   LP_DBG(DEBUG_SETUP, "%s\n", __func__);
+
+   uint32_t *current = setup->fs.current.jit_context.dynamic_state;
+   const size_t size = LP_JIT_DYN_COUNT * sizeof *current;
+
+   if (memcmp(current, dynamic_state, size) != 0) {
+      memcpy(current, dynamic_state, size);
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+}
+
+
 void
 lp_setup_set_blend_color(struct lp_setup_context *setup,
                          const struct pipe_blend_color *blend_color)
@@ -1527,8 +1630,11 @@ lp_setup_destroy(struct lp_setup_context *setup)
       lp_scene_destroy(scene);
    }
 
+   lp_setup_bin_destroy(setup);
+
    LP_DBG(DEBUG_SETUP, "number of scenes used: %d\n", setup->num_active_scenes);
    slab_destroy(&setup->scene_slab);
+   lp_scene_block_pool_destroy(&setup->block_pool);
 
    FREE(setup);
 }
@@ -1549,13 +1655,14 @@ lp_setup_create(struct pipe_context *pipe,
       goto no_setup;
    }
 
-   lp_setup_init_vbuf(setup);
-
    /* Used only in update_state():
     */
    setup->pipe = pipe;
 
    setup->num_threads = screen->num_threads;
+
+   lp_setup_init_vbuf(setup);
+
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -1567,6 +1674,9 @@ lp_setup_create(struct pipe_context *pipe,
    slab_create(&setup->scene_slab,
                sizeof(struct lp_scene),
                INITIAL_SCENES);
+   setup->scene_max_size = LP_SCENE_MAX_SIZE;
+   lp_scene_block_pool_init(&setup->block_pool,
+                            LP_SCENE_MAX_SIZE / sizeof(struct data_block));
    /* create just one scene for starting point */
    setup->scenes[0] = lp_scene_create(setup);
    if (!setup->scenes[0]) {
@@ -1592,6 +1702,7 @@ no_scenes:
          lp_scene_destroy(setup->scenes[i]);
       }
    }
+   lp_scene_block_pool_destroy(&setup->block_pool);
 
    setup->vbuf->destroy(setup->vbuf);
 no_vbuf:
@@ -1731,6 +1842,11 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 
    assert(setup->state == SETUP_ACTIVE);
 
+   if (setup->bin_worker) {
+      setup->bin_failed = TRUE;
+      return FALSE;
+   }
+
    if (!set_scene_state(setup, SETUP_FLUSHED, __func__))
       return FALSE;
 
@@ -45,6 +45,18 @@ struct pipe_fence_handle;
 struct lp_setup_variant;
 struct lp_setup_context;
 
+/** Counters for the driver queries */
+struct lp_setup_counters {
+   uint64_t scenes;           /**< scenes queued for rasterization */
+   uint64_t full_scenes;      /**< those flushed for running full */
+   uint64_t scene_wait_time;  /**< waiting for a free scene, in nanoseconds */
+   uint64_t bin_chunks;       /**< chunks binned in parallel */
+   uint64_t bin_replays;      /**< those rebinned serially after failing */
+   uint64_t bin_time;         /**< setup and binning, in nanoseconds */
+   uint64_t scene_blocks_allocated;  /**< see struct lp_scene_block_pool */
+   uint64_t scene_blocks_reused;
+};
+
 void
 lp_setup_reset(struct lp_setup_context *setup);
 
@@ -63,6 +75,9 @@ void
 lp_setup_flush(struct lp_setup_context *setup,
                const char *reason);
 
+const struct lp_setup_counters *
+lp_setup_get_counters(struct lp_setup_context *setup);
+
 void
 lp_setup_bind_framebuffer(struct lp_setup_context *setup,
                           const struct pipe_framebuffer_state *fb);
@@ -103,6 +118,10 @@ void
 lp_setup_set_stencil_ref_values(struct lp_setup_context *setup,
                                 const ubyte refs[2]);
 
+void
+lp_setup_set_fs_dynamic_state(struct lp_setup_context *setup,
+                              const uint32_t *dynamic_state);
+
 void
 lp_setup_set_blend_color(struct lp_setup_context *setup,
                          const struct pipe_blend_color *blend_color);
@@ -0,0 +1,379 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Parallel binning.
+ *
+ * While a draw call from the vbuf code is walked, the point/line/triangle
+ * functions are replaced with ones which merely record the primitives.
+ * The recorded primitives are then split into chunks, and each chunk is
+ * set up and binned by a worker (the application thread takes the first
+ * one) using a private copy of the primitive setup state, see
+ * copy_bin_state(), and a private chunk scene.
+ * Once all chunks are done their bins are appended to the current scene's
+ * bins in primitive order, so the rasterizer sees exactly the same command
+ * order as with serial binning.
+ *
+ * Workers can't flush the scene when it runs out of space.  Chunks from
+ * the first failed one onwards are discarded and binned again on the
+ * application thread, which flushes as usual.
+ */
+
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_prim.h"
+#include "util/u_queue.h"
+#include "util/perf/cpu_trace.h"
+#include "lp_context.h"
+#include "lp_perf.h"
+#include "lp_scene.h"
+#include "lp_screen.h"
+#include "lp_setup_context.h"
+
+
+/** Don't bother with draws having fewer vertices than this */
+#define LP_BIN_MIN_VERTICES 256
+
+/** Minimum number of primitives per chunk */
+#define LP_BIN_MIN_CHUNK_PRIMS 64
+
+
+struct lp_setup_bin_prim {
+   const float (*v[3])[4];
+};
+
+
+struct lp_setup_bin_chunk {
+   struct util_queue_fence fence;
+   struct lp_scene *scene;
+   enum pipe_prim_type reduced_prim;
+   const struct lp_setup_bin_prim *prims;
+   unsigned num_prims;
+
+   /** Private setup context binning into 'scene', see copy_bin_state() */
+   struct lp_setup_context setup;
+};
+
+
+static void
+record_point(struct lp_setup_context *setup,
+             const float (*v0)[4])
+{
+   struct lp_setup_bin_prim *prim = &setup->bin.prims[setup->bin.num_prims++];
+
+   assert(setup->bin.num_prims <= setup->bin.max_prims);
+   prim->v[0] = v0;
+}
+
+
+static void
+record_line(struct lp_setup_context *setup,
+            const float (*v0)[4],
+            const float (*v1)[4])
+{
+   struct lp_setup_bin_prim *prim = &setup->bin.prims[setup->bin.num_prims++];
+
+   assert(setup->bin.num_prims <= setup->bin.max_prims);
+   prim->v[0] = v0;
+   prim->v[1] = v1;
+}
+
+
+static void
+record_triangle(struct lp_setup_context *setup,
+                const float (*v0)[4],
+                const float (*v1)[4],
+                const float (*v2)[4])
+{
+   struct lp_setup_bin_prim *prim = &setup->bin.prims[setup->bin.num_prims++];
+
+   assert(setup->bin.num_prims <= setup->bin.max_prims);
+   prim->v[0] = v0;
+   prim->v[1] = v1;
+   prim->v[2] = v2;
+}
+
+
+static void
+bin_prims(struct lp_setup_context *setup,
+          enum pipe_prim_type reduced_prim,
+          const struct lp_setup_bin_prim *prims,
+          unsigned num_prims)
+{
+   switch (reduced_prim) {
+   case PIPE_PRIM_POINTS:
+      for (unsigned i = 0; i < num_prims && !setup->bin_failed; i++)
+         setup->point(setup, prims[i].v[0]);
+      break;
+   case PIPE_PRIM_LINES:
+      for (unsigned i = 0; i < num_prims && !setup->bin_failed; i++)
+         setup->line(setup, prims[i].v[0], prims[i].v[1]);
+      break;
+   case PIPE_PRIM_TRIANGLES:
+      for (unsigned i = 0; i < num_prims && !setup->bin_failed; i++)
+         setup->triangle(setup, prims[i].v[0], prims[i].v[1], prims[i].v[2]);
+      break;
+   default:
+      assert(0);
+   }
+}
+
+
+/**
+ * Copy the state the point/line/triangle functions read to a chunk's
+ * setup context.  Everything else in it stays zero.  Keep this in sync
+ * with lp_setup_tri.c, lp_setup_line.c, lp_setup_point.c and the binning
+ * helpers in lp_setup_rect.c.
+ */
+static void
+copy_bin_state(struct lp_setup_context *dst,
+               const struct lp_setup_context *src)
+{
+   dst->pipe = src->pipe;
+   dst->state = src->state;
+   dst->view_index = src->view_index;
+   dst->sprite_coord_enable = src->sprite_coord_enable;
+   dst->sprite_coord_origin = src->sprite_coord_origin;
+
+   dst->flatshade_first = src->flatshade_first;
+   dst->ccw_is_frontface = src->ccw_is_frontface;
+   dst->point_size_per_vertex = src->point_size_per_vertex;
+   dst->legacy_points = src->legacy_points;
+   dst->rasterizer_discard = src->rasterizer_discard;
+   dst->multisample = src->multisample;
+   dst->rectangular_lines = src->rectangular_lines;
+   dst->cullmode = src->cullmode;
+   dst->bottom_edge_rule = src->bottom_edge_rule;
+   dst->pixel_offset = src->pixel_offset;
+   dst->line_width = src->line_width;
+   dst->point_size = src->point_size;
+   dst->psize_slot = src->psize_slot;
+   dst->viewport_index_slot = src->viewport_index_slot;
+   dst->layer_slot = src->layer_slot;
+   dst->face_slot = src->face_slot;
+
+   dst->fb.width = src->fb.width;
+   dst->fb.height = src->fb.height;
+   memcpy(dst->draw_regions, src->draw_regions, sizeof dst->draw_regions);
+
+   dst->fs.stored = src->fs.stored;
+   dst->fs.current.variant = src->fs.current.variant;
+   /* Only read by the opaque and blit checks */
+   dst->fs.current.jit_context.constants[0] =
+      src->fs.current.jit_context.constants[0];
+   dst->fs.current.jit_context.textures[0] =
+      src->fs.current.jit_context.textures[0];
+   dst->setup.variant = src->setup.variant;
+
+   dst->point = src->point;
+   dst->line = src->line;
+   dst->triangle = src->triangle;
+   dst->rect = src->rect;
+}
+
+
+static void
+bin_chunk_execute(void *data, void *gdata, int thread_index)
+{
+   MESA_TRACE_FUNC();
+
+   struct lp_setup_bin_chunk *chunk = data;
+
+   bin_prims(&chunk->setup, chunk->reduced_prim,
+             chunk->prims, chunk->num_prims);
+}
+
+
+static boolean
+bin_init(struct lp_setup_context *setup, unsigned num_chunks)
+{
+   setup->bin.chunks = CALLOC(num_chunks, sizeof(struct lp_setup_bin_chunk));
+   if (!setup->bin.chunks)
+      return FALSE;
+
+   for (unsigned i = 0; i < num_chunks; i++) {
+      struct lp_setup_bin_chunk *chunk = &setup->bin.chunks[i];
+
+      chunk->scene = lp_scene_create(setup);
+      if (!chunk->scene)
+         break;
+
+      util_queue_fence_init(&chunk->fence);
+      setup->bin.num_chunks++;
+   }
+
+   if (setup->bin.num_chunks < 2) {
+      lp_setup_bin_destroy(setup);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Called by the vbuf draw functions before walking a draw call of 'nr'
+ * vertices.  Returns TRUE if the primitives should be binned in parallel,
+ * in which case they're only recorded until lp_setup_bin_end().
+ */
+boolean
+lp_setup_bin_begin(struct lp_setup_context *setup, unsigned nr)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+   struct llvmpipe_context *lp = llvmpipe_context(setup->pipe);
+
+   if (!screen->num_bin_threads || nr < LP_BIN_MIN_VERTICES)
+      return FALSE;
+
+   /* The linear rasterizer paths bin rectangles directly, pipeline
+    * statistics are counted per primitive and discarded primitives
+    * aren't worth the trouble.
+    */
+   if (setup->permit_linear_rasterizer ||
+       setup->rasterizer_discard ||
+       lp->active_statistics_queries)
+      return FALSE;
+
+   if (!setup->bin.chunks &&
+       !bin_init(setup, screen->num_bin_threads + 1))
+      return FALSE;
+
+   /* Line loops may emit one primitive more than there are vertices */
+   if (setup->bin.max_prims < nr + 1) {
+      FREE(setup->bin.prims);
+      setup->bin.prims = MALLOC((nr + 1) * sizeof(struct lp_setup_bin_prim));
+      if (!setup->bin.prims) {
+         setup->bin.max_prims = 0;
+         return FALSE;
+      }
+      setup->bin.max_prims = nr + 1;
+   }
+
+   setup->bin.num_prims = 0;
+   setup->bin.point = setup->point;
+   setup->bin.line = setup->line;
+   setup->bin.triangle = setup->triangle;
+
+   setup->point = record_point;
+   setup->line = record_line;
+   setup->triangle = record_triangle;
+
+   return TRUE;
+}
+
+
+/**
+ * Bin the primitives recorded since lp_setup_bin_begin().
+ */
+void
+lp_setup_bin_end(struct lp_setup_context *setup)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+   struct lp_scene *scene = setup->scene;
+   const enum pipe_prim_type reduced_prim = u_reduced_prim(setup->prim);
+   const struct lp_setup_bin_prim *prims = setup->bin.prims;
+   const unsigned num_prims = setup->bin.num_prims;
+
+   setup->point = setup->bin.point;
+   setup->line = setup->bin.line;
+   setup->triangle = setup->bin.triangle;
+
+   const unsigned num_chunks = MIN2(setup->bin.num_chunks,
+                                    num_prims / LP_BIN_MIN_CHUNK_PRIMS);
+   if (num_chunks < 2) {
+      bin_prims(setup, reduced_prim, prims, num_prims);
+      return;
+   }
+
+   const unsigned chunk_prims = DIV_ROUND_UP(num_prims, num_chunks);
+   const unsigned chunk_size =
+      (scene->max_size - MIN2(scene->scene_size, scene->max_size)) /
+      num_chunks;
+
+   for (unsigned i = 0; i < num_chunks; i++) {
+      struct lp_setup_bin_chunk *chunk = &setup->bin.chunks[i];
+      const unsigned start = MIN2(i * chunk_prims, num_prims);
+
+      lp_scene_begin_chunk(chunk->scene, scene, chunk_size);
+
+      chunk->reduced_prim = reduced_prim;
+      chunk->prims = &prims[start];
+      chunk->num_prims = MIN2(chunk_prims, num_prims - start);
+
+      copy_bin_state(&chunk->setup, setup);
+      chunk->setup.scene = chunk->scene;
+      chunk->setup.bin_worker = TRUE;
+      chunk->setup.bin_failed = FALSE;
+
+      if (i > 0) {
+         util_queue_add_job(&screen->bin_queue, chunk, &chunk->fence,
+                            bin_chunk_execute, NULL, 0);
+      }
+   }
+
+   bin_chunk_execute(&setup->bin.chunks[0], NULL, 0);
+
+   unsigned replay = num_prims;
+   for (unsigned i = 0; i < num_chunks; i++) {
+      struct lp_setup_bin_chunk *chunk = &setup->bin.chunks[i];
+
+      if (i > 0)
+         util_queue_fence_wait(&chunk->fence);
+
+      if (replay == num_prims && !chunk->setup.bin_failed) {
+         lp_scene_merge_chunk(scene, chunk->scene);
+      } else {
+         if (replay == num_prims) {
+            replay = chunk->prims - prims;
+            setup->counters.bin_replays += num_chunks - i;
+            LP_COUNT_ADD(nr_bin_replays, num_chunks - i);
+         }
+         lp_scene_end_rasterization(chunk->scene);
+      }
+   }
+
+   setup->counters.bin_chunks += num_chunks;
+   LP_COUNT_ADD(nr_bin_chunks, num_chunks);
+
+   if (replay < num_prims)
+      bin_prims(setup, reduced_prim, &prims[replay], num_prims - replay);
+}
+
+
+void
+lp_setup_bin_destroy(struct lp_setup_context *setup)
+{
+   for (unsigned i = 0; i < setup->bin.num_chunks; i++) {
+      struct lp_setup_bin_chunk *chunk = &setup->bin.chunks[i];
+
+      util_queue_fence_destroy(&chunk->fence);
+      lp_scene_destroy(chunk->scene);
+   }
+
+   FREE(setup->bin.chunks);
+   FREE(setup->bin.prims);
+   memset(&setup->bin, 0, sizeof setup->bin);
+}
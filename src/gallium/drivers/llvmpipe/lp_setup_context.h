@@ -53,12 +53,17 @@
 #define LP_SETUP_NEW_SSBOS       0x20
 
 struct lp_setup_variant;
+struct lp_setup_bin_chunk;
+struct lp_setup_bin_prim;
 
 
 /** Max number of scenes */
 #define INITIAL_SCENES 4
 #define MAX_SCENES 64
 
+/** Number of scenes after which the scene size limit may shrink */
+#define LP_SETUP_SCENE_SIZE_PERIOD 32
+
 
 
 /**
@@ -92,6 +97,11 @@ struct lp_setup_context
    unsigned scene_idx;
 
    struct slab_mempool scene_slab;
+   struct lp_scene_block_pool block_pool;
+   unsigned scene_max_size;      /**< see lp_setup_adapt_scene_size() */
+   unsigned scene_size_peak;     /**< since the limit was last checked */
+   unsigned num_sized_scenes;    /**< ditto */
+   struct lp_setup_counters counters;
    int num_active_scenes;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
@@ -194,6 +204,36 @@ struct lp_setup_context
            const float (*v3)[4],
            const float (*v4)[4],
            const float (*v5)[4]);
+
+   /** Parallel binning state, see lp_setup_bin.c */
+   struct {
+      unsigned num_chunks;
+      struct lp_setup_bin_chunk *chunks;
+
+      /* Primitives recorded by the current draw call */
+      struct lp_setup_bin_prim *prims;
+      unsigned num_prims;
+      unsigned max_prims;
+
+      /* The point/line/triangle functions replaced while recording */
+      void (*point)(struct lp_setup_context *,
+                    const float (*v0)[4]);
+      void (*line)(struct lp_setup_context *,
+                   const float (*v0)[4],
+                   const float (*v1)[4]);
+      void (*triangle)(struct lp_setup_context *,
+                       const float (*v0)[4],
+                       const float (*v1)[4],
+                       const float (*v2)[4]);
+   } bin;
+
+   /**
+    * Set in the private setup copies the binning workers operate on.
+    * Workers can't flush the scene, bin_failed is raised instead and
+    * the chunk gets rebinned on the application thread.
+    */
+   boolean bin_worker;
+   boolean bin_failed;
 };
 
 
@@ -282,6 +322,12 @@ lp_setup_alloc_triangle(struct lp_scene *scene,
                         unsigned nr_planes,
                         unsigned *tri_size);
 
+void
+lp_setup_tri_planes(struct lp_rast_plane *plane,
+                    const int32_t *x,
+                    const int32_t *y,
+                    boolean bottom_edge_rule);
+
 struct lp_rast_rectangle *
 lp_setup_alloc_rectangle(struct lp_scene *scene,
                          unsigned nr_inputs);
@@ -306,5 +352,14 @@ lp_setup_bin_rectangle(struct lp_setup_context *setup,
                        struct lp_rast_rectangle *rect,
                        boolean opaque);
 
+boolean
+lp_setup_bin_begin(struct lp_setup_context *setup, unsigned nr);
+
+void
+lp_setup_bin_end(struct lp_setup_context *setup);
+
+void
+lp_setup_bin_destroy(struct lp_setup_context *setup);
+
 
 #endif
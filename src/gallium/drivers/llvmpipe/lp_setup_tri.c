@@ -257,6 +257,70 @@ check_opaque(const struct lp_setup_context *setup,
 }
 
 
+/**
+ * Compute the edge equations of a counter-clockwise triangle whose
+ * vertices are given in fixed point.  This is the plain C version of the
+ * plane setup in do_triangle_ccw().
+ */
+void
+lp_setup_tri_planes(struct lp_rast_plane *plane,
+                    const int32_t *x,
+                    const int32_t *y,
+                    boolean bottom_edge_rule)
+{
+   plane[0].dcdy = x[0] - x[1];
+   plane[1].dcdy = x[1] - x[2];
+   plane[2].dcdy = x[2] - x[0];
+   plane[0].dcdx = y[0] - y[1];
+   plane[1].dcdx = y[1] - y[2];
+   plane[2].dcdx = y[2] - y[0];
+
+   for (int i = 0; i < 3; i++) {
+      /* half-edge constants, will be iterated over the whole render
+       * target.
+       */
+      plane[i].c = IMUL64(plane[i].dcdx, x[i]) -
+                   IMUL64(plane[i].dcdy, y[i]);
+
+      /* correct for top-left vs. bottom-left fill convention.
+       */
+      if (plane[i].dcdx < 0) {
+         /* both fill conventions want this - adjust for left edges */
+         plane[i].c++;
+      }
+      else if (plane[i].dcdx == 0) {
+         if (bottom_edge_rule == 0) {
+            /* correct for top-left fill convention:
+             */
+            if (plane[i].dcdy > 0)
+               plane[i].c++;
+         } else {
+            /* correct for bottom-left fill convention:
+             */
+            if (plane[i].dcdy < 0)
+               plane[i].c++;
+         }
+      }
+
+      /* Scale up to match c:
+       */
+      assert((plane[i].dcdx << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdx);
+      assert((plane[i].dcdy << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdy);
+      plane[i].dcdx <<= FIXED_ORDER;
+      plane[i].dcdy <<= FIXED_ORDER;
+
+      /* find trivial reject offsets for each edge for a single-pixel
+       * sized block.  These will be scaled up at each recursive level to
+       * match the active blocksize.  Scaling in this way works best if
+       * the blocks are square.
+       */
+      plane[i].eo = 0;
+      if (plane[i].dcdx < 0) plane[i].eo -= plane[i].dcdx;
+      if (plane[i].dcdy > 0) plane[i].eo += plane[i].dcdy;
+   }
+}
+
+
 /**
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
@@ -660,56 +724,8 @@ do_triangle_ccw(struct lp_setup_context *setup,
    } else
 #endif
    {
-      plane[0].dcdy = position->dx01;
-      plane[1].dcdy = position->x[1] - position->x[2];
-      plane[2].dcdy = position->dx20;
-      plane[0].dcdx = position->dy01;
-      plane[1].dcdx = position->y[1] - position->y[2];
-      plane[2].dcdx = position->dy20;
-
-      for (int i = 0; i < 3; i++) {
-         /* half-edge constants, will be iterated over the whole render
-          * target.
-          */
-         plane[i].c = IMUL64(plane[i].dcdx, position->x[i]) -
-                      IMUL64(plane[i].dcdy, position->y[i]);
-
-         /* correct for top-left vs. bottom-left fill convention.
-          */
-         if (plane[i].dcdx < 0) {
-            /* both fill conventions want this - adjust for left edges */
-            plane[i].c++;
-         }
-         else if (plane[i].dcdx == 0) {
-            if (setup->bottom_edge_rule == 0) {
-               /* correct for top-left fill convention:
-                */
-               if (plane[i].dcdy > 0)
-                  plane[i].c++;
-            } else {
-               /* correct for bottom-left fill convention:
-                */
-               if (plane[i].dcdy < 0)
-                  plane[i].c++;
-            }
-         }
-
-         /* Scale up to match c:
-          */
-         assert((plane[i].dcdx << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdx);
-         assert((plane[i].dcdy << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdy);
-         plane[i].dcdx <<= FIXED_ORDER;
-         plane[i].dcdy <<= FIXED_ORDER;
-
-         /* find trivial reject offsets for each edge for a single-pixel
-          * sized block.  These will be scaled up at each recursive level to
-          * match the active blocksize.  Scaling in this way works best if
-          * the blocks are square.
-          */
-         plane[i].eo = 0;
-         if (plane[i].dcdx < 0) plane[i].eo -= plane[i].dcdx;
-         if (plane[i].dcdy > 0) plane[i].eo += plane[i].dcdy;
-      }
+      lp_setup_tri_planes(plane, position->x, position->y,
+                          setup->bottom_edge_rule);
    }
 
    if (0) {
@@ -770,6 +786,64 @@ floor_pot(uint32_t n)
 }
 
 
+/**
+ * Whether the primitive is known to fail the depth test in tile tx, ty,
+ * going by the part of its bounding box inside the tile.
+ */
+static inline boolean
+hiz_tile_occluded(struct lp_setup_context *setup,
+                  const struct lp_rast_shader_inputs *inputs,
+                  const struct u_rect *bbox,
+                  int tx, int ty)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   struct lp_scene *scene = setup->scene;
+   const float bound = lp_scene_get_bin(scene, tx, ty)->hiz_zmax;
+   float zmin, zmax;
+
+   if (bound == INFINITY)
+      return FALSE;
+
+   lp_rast_depth_bounds(inputs, scene->hiz_quantum,
+                        variant->key.restrict_depth_values,
+                        MAX2(bbox->x0, tx * TILE_SIZE),
+                        MAX2(bbox->y0, ty * TILE_SIZE),
+                        MIN2(bbox->x1, tx * TILE_SIZE + TILE_SIZE - 1),
+                        MIN2(bbox->y1, ty * TILE_SIZE + TILE_SIZE - 1),
+                        &zmin, &zmax);
+
+   return lp_rast_depth_occluded(zmin, bound,
+                                 variant->key.depth.func == PIPE_FUNC_LEQUAL);
+}
+
+
+/**
+ * Tighten the depth bound of tile tx, ty, which the primitive fully covers.
+ */
+static inline void
+hiz_tile_covered(struct lp_setup_context *setup,
+                 const struct lp_rast_shader_inputs *inputs,
+                 int tx, int ty)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   struct lp_scene *scene = setup->scene;
+   struct cmd_bin *bin = lp_scene_get_bin(scene, tx, ty);
+   float zmin, zmax;
+
+   lp_rast_depth_bounds(inputs, scene->hiz_quantum,
+                        variant->key.restrict_depth_values,
+                        tx * TILE_SIZE, ty * TILE_SIZE,
+                        tx * TILE_SIZE + TILE_SIZE - 1,
+                        ty * TILE_SIZE + TILE_SIZE - 1,
+                        &zmin, &zmax);
+
+   if (zmax < bin->hiz_zmax)
+      bin->hiz_zmax = zmax;
+}
+
+
 boolean
 lp_setup_bin_triangle(struct lp_setup_context *setup,
                       struct lp_rast_triangle *tri,
@@ -780,6 +854,10 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                       unsigned viewport_index)
 {
    struct lp_scene *scene = setup->scene;
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   const boolean hiz_test = scene->hiz && variant->hiz_test;
+   const boolean hiz_update = scene->hiz && variant->hiz_update;
    unsigned cmd;
 
    /* What is the largest power-of-two boundary this triangle crosses:
@@ -821,6 +899,12 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
              ix0 == bbox->x1 / TILE_SIZE);
 
+      if (hiz_test &&
+          hiz_tile_occluded(setup, &tri->inputs, &trimmed_box, ix0, iy0)) {
+         LP_COUNT(nr_hiz_rejected_64);
+         return TRUE;
+      }
+
       if (nr_planes == 3) {
          if (sz < 4) {
             /* Triangle is contained in a single 4x4 stamp:
@@ -942,6 +1026,12 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                if (in)
                   break;  /* exiting triangle, all done with this row */
                LP_COUNT(nr_empty_64);
+            } else if (hiz_test &&
+                       hiz_tile_occluded(setup, &tri->inputs,
+                                         &trimmed_box, x, y)) {
+               /* the triangle is behind everything in the tile */
+               in = TRUE;
+               LP_COUNT(nr_hiz_rejected_64);
             } else if (partial) {
                /* Not trivially accepted by at least one plane -
                 * rasterize/shade partial tile
@@ -965,6 +1055,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                in = TRUE;
                if (!lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque))
                   goto fail;
+               if (hiz_update)
+                  hiz_tile_covered(setup, &tri->inputs, x, y);
             }
 
             /* Iterate cx values across the region: */
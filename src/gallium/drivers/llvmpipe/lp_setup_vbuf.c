@@ -42,6 +42,9 @@
 #include "draw/draw_vertex.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/os_time.h"
+#include "lp_debug.h"
+#include "lp_screen.h"
 #include "lp_state_fs.h"
 #include "lp_perf.h"
 
@@ -53,6 +56,13 @@
 
 #define LP_MAX_VBUF_SIZE    4096
 
+/* With parallel binning let the draw module hand over larger batches of
+ * vertices, so each draw call can be split into enough chunks.
+ */
+#define LP_MAX_BIN_VBUF_INDEXES (12 * 1020)
+
+#define LP_MAX_BIN_VBUF_SIZE    (256 * 1024)
+
 
 
 /** cast wrapper */
@@ -179,12 +189,16 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
 
    assert(setup->setup.variant);
 
+   const int64_t t0 = os_time_get_nano();
+
    if (!lp_setup_update_state(setup, TRUE))
       return;
 
    const bool uses_constant_interp =
       setup->setup.variant->key.uses_constant_interp;
 
+   const boolean parallel = lp_setup_bin_begin(setup, nr);
+
    switch (setup->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -370,6 +384,14 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   if (parallel)
+      lp_setup_bin_end(setup);
+
+   const int64_t bin_time = os_time_get_nano() - t0;
+   setup->counters.bin_time += bin_time;
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      LP_COUNT_ADD(bin_time, bin_time / 1000);
 }
 
 
@@ -387,12 +409,16 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    const boolean flatshade_first = setup->flatshade_first;
    unsigned i;
 
+   const int64_t t0 = os_time_get_nano();
+
    if (!lp_setup_update_state(setup, TRUE))
       return;
 
    const bool uses_constant_interp =
       setup->setup.variant->key.uses_constant_interp;
 
+   const boolean parallel = lp_setup_bin_begin(setup, nr);
+
    switch (setup->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -632,6 +658,14 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   if (parallel)
+      lp_setup_bin_end(setup);
+
+   const int64_t bin_time = os_time_get_nano() - t0;
+   setup->counters.bin_time += bin_time;
+   if (LP_DEBUG & DEBUG_COUNTERS)
+      LP_COUNT_ADD(bin_time, bin_time / 1000);
 }
 
 
@@ -705,8 +739,15 @@ lp_setup_pipeline_statistics(
 void
 lp_setup_init_vbuf(struct lp_setup_context *setup)
 {
-   setup->base.max_indices = LP_MAX_VBUF_INDEXES;
-   setup->base.max_vertex_buffer_bytes = LP_MAX_VBUF_SIZE;
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+
+   if (screen->num_bin_threads) {
+      setup->base.max_indices = LP_MAX_BIN_VBUF_INDEXES;
+      setup->base.max_vertex_buffer_bytes = LP_MAX_BIN_VBUF_SIZE;
+   } else {
+      setup->base.max_indices = LP_MAX_VBUF_INDEXES;
+      setup->base.max_vertex_buffer_bytes = LP_MAX_VBUF_SIZE;
+   }
 
    setup->base.get_vertex_info = lp_setup_get_vertex_info;
    setup->base.allocate_vertices = lp_setup_allocate_vertices;
@@ -25,8 +25,10 @@
 
 #include "util/u_memory.h"
 #include "util/os_time.h"
+#include "util/hash_table.h"
 #include "util/u_dump.h"
 #include "util/u_string.h"
+#include "util/perf/cpu_trace.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_parse.h"
 #include "gallivm/lp_bld_const.h"
@@ -45,6 +47,7 @@
 #include "lp_memory.h"
 #include "lp_query.h"
 #include "lp_cs_tpool.h"
+#include "lp_nir_interp.h"
 #include "frontend/sw_winsys.h"
 #include "nir/nir_to_tgsi_info.h"
 #include "util/mesa-sha1.h"
@@ -66,8 +69,7 @@ struct lp_cs_job_info {
 
 
 static void
-generate_compute(struct llvmpipe_context *lp,
-                 struct lp_compute_shader *shader,
+generate_compute(struct lp_compute_shader *shader,
                  struct lp_compute_shader_variant *variant)
 {
    struct gallivm_state *gallivm = variant->gallivm;
@@ -467,9 +469,16 @@ generate_compute(struct llvmpipe_context *lp,
 
       if (shader->base.type == PIPE_SHADER_IR_TGSI)
          lp_build_tgsi_soa(gallivm, shader->base.tokens, &params, NULL);
-      else
-         lp_build_nir_soa(gallivm, shader->base.ir.nir, &params,
+      else {
+         /* The translation lowers the NIR in place and the fast and the
+          * optimized compiles of a variant run concurrently, so work on a
+          * private copy.
+          */
+         struct nir_shader *nir = nir_shader_clone(NULL, shader->base.ir.nir);
+         lp_build_nir_soa(gallivm, nir, &params,
                           NULL);
+         ralloc_free(nir);
+      }
 
       mask_val = lp_build_mask_end(&mask);
 
@@ -528,13 +537,25 @@ llvmpipe_create_compute_state(struct pipe_context *pipe,
       nir_tgsi_scan_shader(shader->base.ir.nir, &shader->info.base, false);
    }
 
+   lp_shader_ir_sha1(&shader->base, shader->ir_sha1);
+
    list_inithead(&shader->variants.list);
+   cso_hash_init(&shader->variants_hash);
 
    int nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
    int nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
    int nr_images = shader->info.base.file_max[TGSI_FILE_IMAGE] + 1;
    shader->variant_key_size = lp_cs_variant_key_size(MAX2(nr_samplers, nr_sampler_views), nr_images);
 
+   /*
+    * Interpret the shader while it compiles in the background, so that
+    * launches needn't wait for LLVM.
+    */
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   if (shader->base.type == PIPE_SHADER_IR_NIR &&
+       (screen->num_compile_threads || (LP_PERF & PERF_INTERP_ONLY)))
+      shader->interp = lp_nir_interp_create(shader->base.ir.nir);
+
    return shader;
 }
 
@@ -553,6 +574,91 @@ llvmpipe_bind_compute_state(struct pipe_context *pipe,
 }
 
 
+/**
+ * A compute shader variant being recompiled with optimizations on the
+ * screen's compile queue.
+ */
+struct lp_cs_compile_job
+{
+   struct list_head list;
+   struct util_queue_fence fence;
+   struct llvmpipe_screen *screen;
+   /** The unoptimized variant, NULL once it was removed */
+   struct lp_compute_shader_variant *variant;
+   /** Receives the optimized code for the same key */
+   struct lp_compute_shader_variant *optimized;
+   boolean compiled;
+};
+
+
+static void
+release_variant_code(struct llvmpipe_context *lp,
+                     struct lp_compute_shader_variant *variant)
+{
+   if (variant->code) {
+      lp_shared_code_reference(llvmpipe_screen(lp->pipe.screen),
+                               &variant->code, NULL);
+   } else if (variant->gallivm) {
+      gallivm_destroy(variant->gallivm);
+   }
+   variant->gallivm = NULL;
+
+#if GALLIVM_USE_ORCJIT == 1
+   if(variant->function_name)
+      FREE(variant->function_name);
+   variant->function_name = NULL;
+#endif
+}
+
+
+static void
+finish_cs_compile(struct llvmpipe_context *lp,
+                  struct lp_cs_compile_job *job)
+{
+   struct lp_compute_shader_variant *variant = job->variant;
+   struct lp_compute_shader_variant *optimized = job->optimized;
+
+   util_queue_fence_wait(&job->fence);
+   util_queue_fence_destroy(&job->fence);
+   list_del(&job->list);
+
+   if (job->compiled && variant) {
+      /* Launches are synchronous, so nothing runs the old code anymore */
+      release_variant_code(lp, variant);
+
+      variant->gallivm = optimized->gallivm;
+      variant->code = optimized->code;
+      variant->jit_function = optimized->jit_function;
+#if GALLIVM_USE_ORCJIT == 1
+      variant->function_name = optimized->function_name;
+#endif
+      lp->nr_cs_instrs -= variant->nr_instrs;
+      lp->nr_cs_instrs += optimized->nr_instrs;
+      variant->nr_instrs = optimized->nr_instrs;
+   } else if (job->compiled) {
+      release_variant_code(lp, optimized);
+   }
+
+   FREE(optimized);
+   FREE(job);
+}
+
+
+/**
+ * Swap the code optimized in the background into the variants.  Unless
+ * 'wait' is set, only the finished compiles are handled.
+ */
+void
+llvmpipe_finish_cs_compiles(struct llvmpipe_context *lp, boolean wait)
+{
+   list_for_each_entry_safe(struct lp_cs_compile_job, job,
+                            &lp->cs_compile_jobs, list) {
+      if (wait || util_queue_fence_is_signalled(&job->fence))
+         finish_cs_compile(lp, job);
+   }
+}
+
+
 /**
  * Remove shader variant from two lists: the shader's variant list
  * and the context's variant list.
@@ -570,10 +676,18 @@ llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_cs_variants, variant->nr_instrs, lp->nr_cs_instrs);
    }
 
-   gallivm_destroy(variant->gallivm);
+   list_for_each_entry(struct lp_cs_compile_job, job,
+                       &lp->cs_compile_jobs, list) {
+      if (job->variant == variant)
+         job->variant = NULL;
+   }
+
+   release_variant_code(lp, variant);
 
    /* remove from shader's list */
    list_del(&variant->list_item_local.list);
+   cso_hash_erase_data(&variant->shader->variants_hash, variant->hash_key,
+                       &variant->key);
    variant->shader->variants_cached--;
 
    /* remove from context's list */
@@ -581,10 +695,6 @@ llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
    lp->nr_cs_variants--;
    lp->nr_cs_instrs -= variant->nr_instrs;
 
-#if GALLIVM_USE_ORCJIT == 1
-   if(variant->function_name)
-      FREE(variant->function_name);
-#endif
    FREE(variant);
 }
 
@@ -603,10 +713,20 @@ llvmpipe_delete_compute_state(struct pipe_context *pipe,
       pipe_resource_reference(&shader->global_buffers[i], NULL);
    FREE(shader->global_buffers);
 
+   /* The background compiles read the shader */
+   list_for_each_entry_safe(struct lp_cs_compile_job, job,
+                            &llvmpipe->cs_compile_jobs, list) {
+      if (job->optimized->shader == shader)
+         finish_cs_compile(llvmpipe, job);
+   }
+
    /* Delete all the variants */
    LIST_FOR_EACH_ENTRY_SAFE(li, next, &shader->variants.list, list) {
       llvmpipe_remove_cs_shader_variant(llvmpipe, li->base);
    }
+   cso_hash_deinit(&shader->variants_hash);
+   if (shader->interp)
+      lp_nir_interp_destroy(shader->interp);
    if (shader->base.ir.nir)
       ralloc_free(shader->base.ir.nir);
    tgsi_free_tokens(shader->base.tokens);
@@ -654,16 +774,16 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if ((shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) || i > 31) {
-            lp_sampler_static_texture_state(&cs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+            llvmpipe_sampler_static_texture_state(&cs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
          }
       }
    } else {
       key->nr_sampler_views = key->nr_samplers;
       for (unsigned i = 0; i < key->nr_sampler_views; ++i) {
          if ((shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) || i > 31) {
-            lp_sampler_static_texture_state(&cs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+            llvmpipe_sampler_static_texture_state(&cs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
          }
       }
    }
@@ -765,66 +885,72 @@ static void
 lp_cs_get_ir_cache_key(struct lp_compute_shader_variant *variant,
                        unsigned char ir_sha1_cache_key[20])
 {
-   struct blob blob = { 0 };
-   unsigned ir_size;
-   void *ir_binary;
-
-   blob_init(&blob);
-   nir_serialize(&blob, variant->shader->base.ir.nir, true);
-   ir_binary = blob.data;
-   ir_size = blob.size;
-
    struct mesa_sha1 ctx;
    _mesa_sha1_init(&ctx);
    _mesa_sha1_update(&ctx, &variant->key, variant->shader->variant_key_size);
-   _mesa_sha1_update(&ctx, ir_binary, ir_size);
+   _mesa_sha1_update(&ctx, variant->shader->ir_sha1,
+                     sizeof variant->shader->ir_sha1);
    _mesa_sha1_final(&ctx, ir_sha1_cache_key);
-
-   blob_finish(&blob);
 }
 
 
-static struct lp_compute_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_compute_shader *shader,
-                 const struct lp_compute_shader_variant_key *key)
+/**
+ * Generate the code of a compute shader variant, or take it from the code
+ * shared with the other contexts.
+ *
+ * This doesn't touch any context state, so that it can run on the
+ * screen's compile threads, with their own LLVM context.  With 'fast' set
+ * the code is compiled without optimizations, see queue_variant_reopt().
+ */
+static boolean
+compile_variant(struct llvmpipe_screen *screen,
+#if GALLIVM_USE_ORCJIT == 1
+                LLVMOrcThreadSafeContextRef context,
+#else
+                LLVMContextRef context,
+#endif
+                struct lp_compute_shader_variant *variant,
+                boolean fast)
 {
-   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
-
-   struct lp_compute_shader_variant *variant =
-      MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
-   if (!variant)
-      return NULL;
-
-   memset(variant, 0, sizeof(*variant));
-
-   char module_name[64];
-   snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
-            shader->no, shader->variants_created);
-
-   variant->shader = shader;
-   memcpy(&variant->key, key, shader->variant_key_size);
+   struct lp_compute_shader *shader = variant->shader;
 
    unsigned char ir_sha1_cache_key[20];
    struct lp_cached_code cached = { 0 };
    bool needs_caching = false;
-   if (shader->base.ir.nir) {
+   if (shader->base.ir.nir || screen->shared_code) {
       lp_cs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
+      struct lp_shared_code *code =
+         lp_shared_code_find(screen, ir_sha1_cache_key);
+      if (code) {
+         const struct lp_compute_shader_variant *src = code->variant;
+
+         variant->gallivm = code->gallivm;
+         variant->code = code;
+         variant->jit_function = src->jit_function;
+         variant->nr_instrs = src->nr_instrs;
+         LP_COUNT_ADD_ATOMIC(nr_shared_variants, 1);
+         return TRUE;
+      }
+   }
+
+   int64_t t0 = os_time_get();
+
+   if (shader->base.ir.nir) {
       lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
       if (!cached.data_size)
          needs_caching = true;
    }
 
-   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
+            shader->no, variant->no);
 
-   variant->list_item_global.base = variant;
-   variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
+   variant->gallivm = gallivm_create(module_name, context, &cached);
+   if (!variant->gallivm)
+      return FALSE;
+
+   variant->gallivm->fast_compile = fast;
 
    if ((LP_DEBUG & DEBUG_CS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_cs_variant(variant);
@@ -832,7 +958,7 @@ generate_variant(struct llvmpipe_context *lp,
 
    lp_jit_init_cs_types(variant);
 
-   generate_compute(lp, shader, variant);
+   generate_compute(shader, variant);
 
 #if GALLIVM_USE_ORCJIT == 1
 /* module has been moved into ORCJIT after gallivm_compile_module */
@@ -856,10 +982,150 @@ generate_variant(struct llvmpipe_context *lp,
       lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
    }
    gallivm_free_ir(variant->gallivm);
+
+   LP_COUNT_ADD_ATOMIC(llvm_compile_time, os_time_get() - t0);
+   LP_COUNT_ADD_ATOMIC(nr_llvm_compiles, 1);
+
+   /* Unoptimized code is replaced soon, so don't hand it out */
+   if (screen->shared_code && !variant->gallivm->fast_compile) {
+      variant->code = lp_shared_code_create(screen, ir_sha1_cache_key,
+                                            variant->gallivm,
+                                            variant, sizeof *variant);
+   }
+   return TRUE;
+}
+
+
+static struct lp_compute_shader_variant *
+create_variant(struct lp_compute_shader *shader,
+               const struct lp_compute_shader_variant_key *key)
+{
+   struct lp_compute_shader_variant *variant =
+      MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   memset(variant, 0, sizeof(*variant));
+
+   variant->shader = shader;
+   memcpy(&variant->key, key, shader->variant_key_size);
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+
    return variant;
 }
 
 
+/**
+ * Whether the interpreter can read all the textures the key samples from.
+ * It fetches single texels with util_format_unpack_rgba(), addressing them
+ * in the linear layout.
+ */
+static boolean
+interp_can_sample(const struct lp_compute_shader_variant_key *key)
+{
+   const struct lp_sampler_static_state *samplers =
+      lp_cs_variant_key_samplers(key);
+
+   for (unsigned i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); i++) {
+      const struct lp_static_texture_state *state = &samplers[i].texture_state;
+
+      if (state->format == PIPE_FORMAT_NONE)
+         continue;
+
+      const struct util_format_description *desc =
+         util_format_description(state->format);
+
+      if (!desc ||
+          desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+          util_format_is_depth_or_stencil(state->format) ||
+          desc->block.width != 1 ||
+          state->tiled)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
+   struct lp_compute_shader_variant *variant = create_variant(shader, key);
+   if (!variant)
+      return NULL;
+
+   variant->no = shader->variants_created++;
+
+   /* Interpreted until the code is compiled, see queue_variant_reopt() */
+   if (shader->interp && interp_can_sample(key))
+      return variant;
+
+   /*
+    * Launches wait for the code, so with compile threads around get some
+    * quickly and have them optimize it meanwhile.
+    */
+   const boolean fast = screen->num_compile_threads &&
+                        !(gallivm_perf & GALLIVM_PERF_NO_OPT);
+
+   if (!compile_variant(screen, lp->context, variant, fast)) {
+      FREE(variant);
+      return NULL;
+   }
+
+   return variant;
+}
+
+
+static void
+cs_compile_job_execute(void *data, void *gdata, int thread_index)
+{
+   MESA_TRACE_FUNC();
+
+   struct lp_cs_compile_job *job = data;
+   struct llvmpipe_screen *screen = job->screen;
+
+   job->compiled = compile_variant(screen,
+                                   screen->compile_contexts[thread_index],
+                                   job->optimized, FALSE);
+}
+
+
+/**
+ * Recompile an unoptimized or interpreted variant in the background.  Its
+ * code is replaced in llvmpipe_finish_cs_compiles().
+ */
+static void
+queue_variant_reopt(struct llvmpipe_context *lp,
+                    struct lp_compute_shader_variant *variant)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
+   struct lp_cs_compile_job *job = CALLOC_STRUCT(lp_cs_compile_job);
+   if (!job)
+      return;
+
+   job->optimized = create_variant(variant->shader, &variant->key);
+   if (!job->optimized) {
+      FREE(job);
+      return;
+   }
+
+   job->optimized->no = variant->no;
+   job->variant = variant;
+   job->screen = screen;
+   util_queue_fence_init(&job->fence);
+   list_addtail(&job->list, &lp->cs_compile_jobs);
+
+   util_queue_add_job(&screen->compile_queue, job, &job->fence,
+                      cs_compile_job_execute, NULL, 0);
+}
+
+
 static void
 lp_cs_ctx_set_cs_variant(struct lp_cs_context *csctx,
                          struct lp_compute_shader_variant *variant)
@@ -876,15 +1142,14 @@ llvmpipe_update_cs(struct llvmpipe_context *lp)
    struct lp_compute_shader_variant_key *key =
       make_variant_key(lp, shader, store);
    struct lp_compute_shader_variant *variant = NULL;
-   struct lp_cs_variant_list_item *li;
+   const unsigned hash_key = _mesa_hash_data(key, shader->variant_key_size);
 
    /* Search the variants for one which matches the key */
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   void *data = cso_hash_find_data_from_template(&shader->variants_hash,
+                                                 hash_key, key,
+                                                 shader->variant_key_size);
+   if (data)
+      variant = container_of(data, struct lp_compute_shader_variant, key);
 
    if (variant) {
       /* Move this variant to the head of the list to implement LRU
@@ -942,21 +1207,21 @@ llvmpipe_update_cs(struct llvmpipe_context *lp)
       /*
        * Generate the new variant.
        */
-      int64_t t0, t1, dt;
-      t0 = os_time_get();
       variant = generate_variant(lp, shader, key);
-      t1 = os_time_get();
-      dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
       /* Put the new variant into the list */
       if (variant) {
+         variant->hash_key = hash_key;
          list_add(&variant->list_item_local.list, &shader->variants.list);
+         cso_hash_insert(&shader->variants_hash, hash_key, &variant->key);
          list_add(&variant->list_item_global.list, &lp->cs_variants_list.list);
          lp->nr_cs_variants++;
          lp->nr_cs_instrs += variant->nr_instrs;
          shader->variants_cached++;
+
+         if (variant->gallivm ? variant->gallivm->fast_compile :
+                                !(LP_PERF & PERF_INTERP_ONLY))
+            queue_variant_reopt(lp, variant);
       }
    }
    /* Bind this variant */
@@ -1382,6 +1647,25 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
    grid_y += job_info->grid_base[1];
    grid_x += job_info->grid_base[0];
    struct lp_compute_shader_variant *variant = job_info->current->variant;
+   if (!variant->jit_function) {
+      const uint32_t block_size[3] = {
+         job_info->block_size[0], job_info->block_size[1],
+         job_info->block_size[2] };
+      const uint32_t workgroup_id[3] = { grid_x, grid_y, grid_z };
+      const uint32_t grid_size[3] = {
+         job_info->grid_size[0], job_info->grid_size[1],
+         job_info->grid_size[2] };
+
+      lp_nir_interp_run_cs(variant->shader->interp,
+                           lp_cs_variant_key_samplers(&variant->key),
+                           MAX2(variant->key.nr_samplers,
+                                variant->key.nr_sampler_views),
+                           &job_info->current->jit_context,
+                           block_size, workgroup_id, grid_size,
+                           job_info->work_dim, &thread_data);
+      return;
+   }
+
    variant->jit_function(&job_info->current->jit_context,
                          job_info->block_size[0], job_info->block_size[1], job_info->block_size[2],
                          grid_x, grid_y, grid_z,
@@ -1427,11 +1711,16 @@ llvmpipe_launch_grid(struct pipe_context *pipe,
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct lp_cs_job_info job_info;
 
+   MESA_TRACE_FUNC();
+
    if (!llvmpipe_check_render_cond(llvmpipe))
       return;
 
    memset(&job_info, 0, sizeof(job_info));
 
+   if (!list_is_empty(&llvmpipe->cs_compile_jobs))
+      llvmpipe_finish_cs_compiles(llvmpipe, FALSE);
+
    llvmpipe_cs_update_derived(llvmpipe, info->input);
 
    fill_grid_size(pipe, info, job_info.grid_size);
@@ -1458,6 +1747,8 @@ llvmpipe_launch_grid(struct pipe_context *pipe,
    }
    if (!llvmpipe->queries_disabled)
       llvmpipe->pipeline_statistics.cs_invocations += num_tasks * info->block[0] * info->block[1] * info->block[2];
+
+   p_atomic_inc(&screen->write_timestamp);
 }
 
 
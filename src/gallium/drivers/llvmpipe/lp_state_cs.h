@@ -28,13 +28,17 @@
 
 #include "util/u_thread.h"
 #include "pipe/p_state.h"
+#include "cso_cache/cso_hash.h"
 
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "lp_jit.h"
 #include "lp_state_fs.h"
 
+struct llvmpipe_context;
 struct lp_compute_shader_variant;
+struct lp_nir_interp;
+struct lp_shared_code;
 
 struct lp_compute_shader_variant_key
 {
@@ -78,6 +82,8 @@ struct lp_cs_variant_list_item
 struct lp_compute_shader_variant
 {
    struct gallivm_state *gallivm;
+   /* Code shared with the other contexts, which owns gallivm if set */
+   struct lp_shared_code *code;
 
    LLVMTypeRef jit_cs_context_type;
    LLVMTypeRef jit_cs_context_ptr_type;
@@ -97,6 +103,9 @@ struct lp_compute_shader_variant
 
    struct lp_compute_shader *shader;
 
+   /* Hash of the key, indexing the variant in the shader's variants_hash */
+   unsigned hash_key;
+
    /* For debugging/profiling purposes */
    unsigned no;
 
@@ -108,6 +117,8 @@ struct lp_compute_shader {
    struct pipe_shader_state base;
 
    struct lp_cs_variant_list_item variants;
+   /* The same variants, indexed by key */
+   struct cso_hash variants_hash;
 
    struct lp_tgsi_info info;
 
@@ -120,8 +131,14 @@ struct lp_compute_shader {
    unsigned variants_cached;
    bool zero_initialize_shared_memory;
 
+   /** See lp_shader_ir_sha1() */
+   unsigned char ir_sha1[20];
+
    int max_global_buffers;
    struct pipe_resource **global_buffers;
+
+   /* Runs the variants until their code is compiled, may be NULL */
+   struct lp_nir_interp *interp;
 };
 
 struct lp_cs_exec {
@@ -160,4 +177,7 @@ struct lp_cs_context {
 struct lp_cs_context *lp_csctx_create(struct pipe_context *pipe);
 void lp_csctx_destroy(struct lp_cs_context *csctx);
 
+void
+llvmpipe_finish_cs_compiles(struct llvmpipe_context *lp, boolean wait);
+
 #endif
@@ -27,6 +27,7 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/perf/cpu_trace.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "draw/draw_vertex.h"
@@ -186,18 +187,20 @@ compute_vertex_info(struct llvmpipe_context *llvmpipe)
 static void
 check_linear_rasterizer(struct llvmpipe_context *lp)
 {
-   const bool bgr8 =
+   /* The shaders' linear variants further check the format against
+    * whether they read the colour buffer.
+    */
+   const bool linear_cbuf =
       (lp->framebuffer.nr_cbufs == 1 && lp->framebuffer.cbufs[0] &&
        util_res_sample_count(lp->framebuffer.cbufs[0]->texture) == 1 &&
        lp->framebuffer.cbufs[0]->texture->target == PIPE_TEXTURE_2D &&
-       (lp->framebuffer.cbufs[0]->format == PIPE_FORMAT_B8G8R8A8_UNORM ||
-        lp->framebuffer.cbufs[0]->format == PIPE_FORMAT_B8G8R8X8_UNORM));
+       lp_linear_check_cbuf_format(lp->framebuffer.cbufs[0]->format, TRUE));
 
    /* permit_linear means guardband, hence fake scissor, which we can only
     * handle if there's just one vp. */
    const bool single_vp = lp->viewport_index_slot < 0;
    const bool permit_linear = (!lp->framebuffer.zsbuf &&
-                               bgr8 &&
+                               linear_cbuf &&
                                single_vp);
 
    /* Tell draw that we're happy doing our own x/y clipping.
@@ -259,6 +262,8 @@ llvmpipe_update_derived_clear(struct llvmpipe_context *llvmpipe)
 void
 llvmpipe_update_derived(struct llvmpipe_context *llvmpipe)
 {
+   MESA_TRACE_FUNC();
+
    struct llvmpipe_screen *lp_screen = llvmpipe_screen(llvmpipe->pipe.screen);
 
    /* Check for updated textures.
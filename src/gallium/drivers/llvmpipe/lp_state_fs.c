@@ -68,6 +68,8 @@
 #include "util/u_dual_blend.h"
 #include "util/u_upload_mgr.h"
 #include "util/os_time.h"
+#include "util/hash_table.h"
+#include "util/perf/cpu_trace.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -567,7 +569,7 @@ fs_fb_fetch(const struct lp_build_fs_iface *iface,
    }
 
    /* fragment shader executes on 4x4 blocks. depending on vector width it can
-    * execute 2 or 4 iterations.  only move to the next row once the top row
+    * execute 1, 2 or 4 iterations.  only move to the next row once the top row
     * has completed 8 wide 1 iteration, 4 wide 2 iterations */
    LLVMValueRef x_offset = NULL, y_offset = NULL;
    if (!key->resource_1d) {
@@ -587,14 +589,14 @@ fs_fb_fetch(const struct lp_build_fs_iface *iface,
       unsigned x = i % block_width;
       unsigned y = i / block_width;
 
-      if (block_size == 8) {
+      if (block_size >= 8) {
          /* remap the raw slots into the fragment shader execution mode. */
          /* this math took me way too long to work out, I'm sure it's
-          * overkill.
+          * overkill.  16 wide adds the second row of quads.
           */
-         x = (i & 1) + ((i >> 2) << 1);
+         x = (i & 1) + ((i >> 1) & 2);
          if (!key->resource_1d)
-            y = (i & 2) >> 1;
+            y = ((i & 2) >> 1) + ((i >> 2) & 2);
       }
 
       LLVMValueRef x_val;
@@ -632,13 +634,116 @@ fs_fb_fetch(const struct lp_build_fs_iface *iface,
 }
 
 
+/**
+ * Fetch the 'bits' wide field at 'shift' of the LP_JIT_DYN_x word 'index'.
+ */
+static LLVMValueRef
+load_dynamic_state(struct gallivm_state *gallivm,
+                   LLVMTypeRef context_type,
+                   LLVMValueRef context_ptr,
+                   unsigned index,
+                   unsigned shift,
+                   unsigned bits)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef array_type =
+      LLVMArrayType(LLVMInt32TypeInContext(gallivm->context),
+                    LP_JIT_DYN_COUNT);
+   LLVMValueRef words =
+      lp_jit_context_dynamic_state(gallivm, context_type, context_ptr);
+   LLVMValueRef word =
+      lp_build_array_get2(gallivm, array_type, words,
+                          lp_build_const_int32(gallivm, index));
+
+   if (shift)
+      word = LLVMBuildLShr(builder, word,
+                           lp_build_const_int32(gallivm, shift), "");
+   return LLVMBuildAnd(builder, word,
+                       lp_build_const_int32(gallivm, (1u << bits) - 1), "");
+}
+
+
+static void
+load_depth_dynamic_state(struct gallivm_state *gallivm,
+                         LLVMTypeRef context_type,
+                         LLVMValueRef context_ptr,
+                         struct lp_build_depth_dynamic *dyn)
+{
+   dyn->func = load_dynamic_state(gallivm, context_type, context_ptr,
+                                  LP_JIT_DYN_DEPTH,
+                                  LP_JIT_DYN_DEPTH_FUNC_SHIFT, 3);
+   dyn->writemask = load_dynamic_state(gallivm, context_type, context_ptr,
+                                       LP_JIT_DYN_DEPTH,
+                                       LP_JIT_DYN_DEPTH_WRITEMASK_SHIFT, 1);
+
+   for (unsigned i = 0; i < 2; i++) {
+      struct lp_build_stencil_dynamic *stencil = &dyn->stencil[i];
+      const unsigned index = LP_JIT_DYN_STENCIL_FRONT + i;
+
+      stencil->func =
+         load_dynamic_state(gallivm, context_type, context_ptr, index,
+                            LP_JIT_DYN_STENCIL_FUNC_SHIFT, 3);
+      stencil->fail_op =
+         load_dynamic_state(gallivm, context_type, context_ptr, index,
+                            LP_JIT_DYN_STENCIL_FAIL_OP_SHIFT, 3);
+      stencil->zfail_op =
+         load_dynamic_state(gallivm, context_type, context_ptr, index,
+                            LP_JIT_DYN_STENCIL_ZFAIL_OP_SHIFT, 3);
+      stencil->zpass_op =
+         load_dynamic_state(gallivm, context_type, context_ptr, index,
+                            LP_JIT_DYN_STENCIL_ZPASS_OP_SHIFT, 3);
+      stencil->valuemask =
+         load_dynamic_state(gallivm, context_type, context_ptr, index,
+                            LP_JIT_DYN_STENCIL_VALUEMASK_SHIFT, 8);
+      stencil->writemask =
+         load_dynamic_state(gallivm, context_type, context_ptr, index,
+                            LP_JIT_DYN_STENCIL_WRITEMASK_SHIFT, 8);
+   }
+}
+
+
+static void
+load_blend_dynamic_state(struct gallivm_state *gallivm,
+                         LLVMTypeRef context_type,
+                         LLVMValueRef context_ptr,
+                         unsigned rt,
+                         struct lp_build_blend_dynamic *dyn)
+{
+   const unsigned index = LP_JIT_DYN_BLEND + rt;
+
+   dyn->rgb_func =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_RGB_FUNC_SHIFT, 3);
+   dyn->rgb_src_factor =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_RGB_SRC_SHIFT, 5);
+   dyn->rgb_dst_factor =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_RGB_DST_SHIFT, 5);
+   dyn->alpha_func =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_ALPHA_FUNC_SHIFT, 3);
+   dyn->alpha_src_factor =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_ALPHA_SRC_SHIFT, 5);
+   dyn->alpha_dst_factor =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_ALPHA_DST_SHIFT, 5);
+   dyn->colormask =
+      load_dynamic_state(gallivm, context_type, context_ptr, index,
+                         LP_JIT_DYN_BLEND_COLORMASK_SHIFT, 4);
+}
+
+
 /**
  * Generate the fragment shader, depth/stencil test, and alpha tests.
+ * With dynamic_state, the tests do what the LP_JIT_DYN_x state says.
  */
 static void
 generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key,
+                 boolean dynamic_state,
                  LLVMBuilderRef builder,
                  struct lp_type type,
                  LLVMTypeRef context_type,
@@ -745,6 +850,10 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
    LLVMTypeRef int_vec_type = lp_build_vec_type(gallivm, int_type);
 
+   struct lp_build_depth_dynamic depth_dyn;
+   if (dynamic_state)
+      load_depth_dynamic_state(gallivm, context_type, context_ptr, &depth_dyn);
+
    LLVMValueRef stencil_refs[2];
    stencil_refs[0] = lp_jit_context_stencil_ref_front_value(gallivm, context_type, context_ptr);
    stencil_refs[1] = lp_jit_context_stencil_ref_back_value(gallivm, context_type, context_ptr);
@@ -912,6 +1021,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
       lp_build_depth_stencil_test(gallivm,
                                   &key->depth,
                                   key->stencil,
+                                  dynamic_state ? &depth_dyn : NULL,
                                   type,
                                   zs_format_desc,
                                   key->multisample ? NULL : &mask,
@@ -1066,9 +1176,16 @@ generate_fs_loop(struct gallivm_state *gallivm,
    if (shader->base.type == PIPE_SHADER_IR_TGSI)
       lp_build_tgsi_soa(gallivm, tokens, &params,
                         outputs);
-   else
-      lp_build_nir_soa(gallivm, shader->base.ir.nir, &params,
+   else {
+      /* The translation lowers the NIR in place and variants may be
+       * compiled on the compile queue threads concurrently, so work on a
+       * private copy.
+       */
+      struct nir_shader *nir = nir_shader_clone(NULL, shader->base.ir.nir);
+      lp_build_nir_soa(gallivm, nir, &params,
                        outputs);
+      ralloc_free(nir);
+   }
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -1086,7 +1203,14 @@ generate_fs_loop(struct gallivm_state *gallivm,
 
          cbuf_format_desc = util_format_description(key->cbuf_format[0]);
 
-         lp_build_alpha_test(gallivm, key->alpha.func, type, cbuf_format_desc,
+         LLVMValueRef alpha_func = NULL;
+         if (dynamic_state)
+            alpha_func = load_dynamic_state(gallivm, context_type, context_ptr,
+                                            LP_JIT_DYN_DEPTH,
+                                            LP_JIT_DYN_ALPHA_FUNC_SHIFT, 3);
+
+         lp_build_alpha_test(gallivm, key->alpha.func, alpha_func,
+                             type, cbuf_format_desc,
                              &mask, alpha, alpha_ref_value,
                              ((depth_mode & LATE_DEPTH_TEST) != 0) && !key->multisample);
       }
@@ -1315,6 +1439,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
       lp_build_depth_stencil_test(gallivm,
                                   &key->depth,
                                   key->stencil,
+                                  dynamic_state ? &depth_dyn : NULL,
                                   type,
                                   zs_format_desc,
                                   key->multisample ? NULL : &mask,
@@ -2433,6 +2558,50 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
       variant->key.blend.rt[0].blend_enable &&
       util_blend_state_is_dual(&variant->key.blend, 0);
 
+   /*
+    * The twiddle and conversion code below works on 4 or 8 wide vectors.
+    * A 16 wide stamp holds the same quads as two 8 wide loop iterations,
+    * in the same order, so blend it as two 8 wide halves.
+    */
+   if (fs_type.length == 16) {
+      LLVMValueRef half_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][4] = {0};
+      LLVMValueRef half_mask[2];
+      struct lp_type half_type = fs_type;
+
+      assert(num_fs == 1);
+      half_type.length = 8;
+      LLVMTypeRef half_vec_type = lp_build_vec_type(gallivm, half_type);
+
+      for (unsigned i = 0; i < 2; i++)
+         half_mask[i] = lp_build_extract_range(gallivm, fs_mask[0], i * 8, 8);
+
+      /*
+       * Split the outputs by value rather than by aliasing the 16 wide
+       * allocas, so both can still be promoted to registers.
+       */
+      for (unsigned j = 0; j < 1 + dual_source_blend; j++) {
+         unsigned cbuf = j ? 1 : rt;
+         for (unsigned chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+            LLVMValueRef color =
+               LLVMBuildLoad2(builder, lp_build_vec_type(gallivm, fs_type),
+                              fs_out_color[cbuf][chan][0], "");
+            for (unsigned i = 0; i < 2; i++) {
+               half_out_color[cbuf][chan][i] =
+                  lp_build_alloca(gallivm, half_vec_type, "");
+               LLVMBuildStore(builder,
+                              lp_build_extract_range(gallivm, color, i * 8, 8),
+                              half_out_color[cbuf][chan][i]);
+            }
+         }
+      }
+
+      generate_unswizzled_blend(gallivm, rt, variant, out_format, 2,
+                                half_type, half_mask, half_out_color,
+                                context_type, context_ptr, color_type,
+                                color_ptr, stride, partial_mask, do_branch);
+      return;
+   }
+
    const boolean is_1d = variant->key.resource_1d;
    const unsigned num_fullblock_fs = is_1d ? 2 * num_fs : num_fs;
    LLVMValueRef fpstate = 0;
@@ -2488,7 +2657,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
 
    row_type.length = fs_type.length;
    unsigned vector_width =
-      dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+      dst_type.floating ? fs_type.width * fs_type.length : lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -3021,15 +3190,21 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
     * used for SRGB here and I think OpenGL expects this to work as expected
     * (that is incoming values converted to srgb then logic op applied).
     */
+   struct lp_build_blend_dynamic blend_dyn;
+   if (variant->generic)
+      load_blend_dynamic_state(gallivm, context_type, context_ptr, rt,
+                               &blend_dyn);
+
    for (unsigned i = 0; i < src_count; ++i) {
       dst[i] = lp_build_blend_aos(gallivm,
                                   &variant->key.blend,
+                                  variant->generic ? &blend_dyn : NULL,
                                   out_format,
                                   row_type,
                                   rt,
                                   src[i],
                                   has_alpha ? NULL : src_alpha[i],
-                                  src1[i],
+                                  dual_source_blend ? src1[i] : NULL,
                                   has_alpha ? NULL : src1_alpha[i],
                                   dst[i],
                                   partial_mask ? src_mask[i] : NULL,
@@ -3097,8 +3272,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -3170,6 +3344,9 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
    fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   /* only the upper half of the stamp is run for 1d resources */
+   if (key->resource_1d)
+      fs_type.length = MIN2(fs_type.length, 8);
 
    struct lp_type blend_type;
    memset(&blend_type, 0, sizeof blend_type);
@@ -3414,7 +3591,7 @@ generate_fragment(struct llvmpipe_context *lp,
       }
 
       generate_fs_loop(gallivm,
-                       shader, key,
+                       shader, key, variant->generic,
                        builder,
                        fs_type,
                        variant->jit_context_type,
@@ -3697,6 +3874,9 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("variant->potentially_opaque = %u\n", variant->potentially_opaque);
    debug_printf("variant->blit = %u\n", variant->blit);
+   debug_printf("variant->hiz_test = %u\n", variant->hiz_test);
+   debug_printf("variant->hiz_update = %u\n", variant->hiz_update);
+   debug_printf("variant->hiz_invalidate = %u\n", variant->hiz_invalidate);
    debug_printf("shader->kind = %s\n", lp_debug_fs_kind(variant->shader->kind));
    debug_printf("\n");
 }
@@ -3706,33 +3886,72 @@ static void
 lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
                        unsigned char ir_sha1_cache_key[20])
 {
-   struct blob blob = { 0 };
-   unsigned ir_size;
-   void *ir_binary;
-
-   blob_init(&blob);
-   nir_serialize(&blob, variant->shader->base.ir.nir, true);
-   ir_binary = blob.data;
-   ir_size = blob.size;
-
    struct mesa_sha1 ctx;
    _mesa_sha1_init(&ctx);
    _mesa_sha1_update(&ctx, &variant->key, variant->shader->variant_key_size);
-   _mesa_sha1_update(&ctx, ir_binary, ir_size);
+   if (variant->generic)
+      _mesa_sha1_update(&ctx, "generic", 7);
+   _mesa_sha1_update(&ctx, variant->shader->ir_sha1,
+                     sizeof variant->shader->ir_sha1);
    _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
 
-   blob_finish(&blob);
+
+/**
+ * Determine how the variant interacts with the depth bounds kept by setup
+ * and the rasterizer, see lp_rast_depth_bounds().
+ */
+static void
+init_hiz_flags(struct lp_fragment_shader_variant *variant)
+{
+   const struct lp_fragment_shader *shader = variant->shader;
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   const unsigned func = key->depth.func;
+
+   /*
+    * Fragments beyond the depth bounds can only be skipped if failing the
+    * depth test is all that would happen to them.
+    */
+   variant->hiz_test =
+         key->depth.enabled &&
+         (func == PIPE_FUNC_LESS || func == PIPE_FUNC_LEQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !shader->info.base.writes_z &&
+         (!shader->info.base.writes_memory ||
+          shader->info.base.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL]);
+
+   /*
+    * A fully covered block ends up with depth values not above the
+    * primitive's, unless some fragments may be dropped.
+    */
+   variant->hiz_update =
+         variant->hiz_test &&
+         key->depth.writemask &&
+         !key->alpha.enabled &&
+         !key->blend.alpha_to_coverage &&
+         !key->multisample &&
+         !shader->info.base.uses_kill &&
+         !shader->info.base.writes_samplemask;
+
+   variant->hiz_invalidate =
+         key->depth.enabled &&
+         key->depth.writemask &&
+         func != PIPE_FUNC_NEVER &&
+         func != PIPE_FUNC_LESS &&
+         func != PIPE_FUNC_LEQUAL &&
+         func != PIPE_FUNC_EQUAL;
 }
 
 
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Allocate a new fragment shader variant for the given key.  The code is
+ * generated by compile_variant().
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+create_variant(struct llvmpipe_context *lp,
+               struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key)
 {
    struct lp_fragment_shader_variant *variant =
       MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
@@ -3746,13 +3965,109 @@ generate_variant(struct llvmpipe_context *lp,
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
-   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   variant->hash_key = _mesa_hash_data(key, shader->variant_key_size);
+   variant->no = shader->variants_created++;
+
+   init_hiz_flags(variant);
+
+   return variant;
+}
+
+
+/**
+ * Free a variant which compile_variant() failed on.
+ */
+static void
+free_variant(struct llvmpipe_context *lp,
+             struct lp_fragment_shader_variant *variant)
+{
+   lp_fs_reference(lp, &variant->shader, NULL);
+   FREE(variant);
+}
+
+
+/**
+ * Whether the variant samples from a tiled texture.  The blit and linear
+ * paths read textures directly, and only know about the linear layout.
+ */
+static boolean
+samples_tiled_texture(const struct lp_fragment_shader_variant_key *key)
+{
+   const struct lp_sampler_static_state *samplers =
+      lp_fs_variant_key_samplers(key);
+
+   for (unsigned i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); i++) {
+      if (samplers[i].texture_state.tiled)
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+/**
+ * Take the results of compile_variant() from the variant of another
+ * context which generated the shared code.
+ */
+static void
+use_shared_code(struct lp_fragment_shader_variant *variant,
+                struct lp_shared_code *code)
+{
+   const struct lp_fragment_shader_variant *src = code->variant;
+
+   variant->potentially_opaque = src->potentially_opaque;
+   variant->opaque = src->opaque;
+   variant->blit = src->blit;
+   variant->linear_input_mask = src->linear_input_mask;
+   variant->gallivm = code->gallivm;
+   variant->code = code;
+   memcpy(variant->jit_function, src->jit_function,
+          sizeof variant->jit_function);
+   variant->jit_linear = src->jit_linear;
+   variant->jit_linear_blit = src->jit_linear_blit;
+   variant->jit_linear_llvm = src->jit_linear_llvm;
+   variant->unswizzled_cbufs = src->unswizzled_cbufs;
+   variant->nr_instrs = src->nr_instrs;
+}
+
+
+/**
+ * Generate the code of a fragment shader variant from the shader code and
+ * other state indicated by the key.
+ *
+ * This doesn't touch any context state, so that it can run on the
+ * screen's compile threads, with their own LLVM context.
+ */
+static boolean
+compile_variant(struct llvmpipe_screen *screen,
+#if GALLIVM_USE_ORCJIT == 1
+                LLVMOrcThreadSafeContextRef context,
+#else
+                LLVMContextRef context,
+#endif
+                struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+
    struct lp_cached_code cached = { 0 };
    unsigned char ir_sha1_cache_key[20];
    bool needs_caching = false;
-   if (shader->base.ir.nir) {
+   if (shader->base.ir.nir || screen->shared_code) {
       lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
+      struct lp_shared_code *code =
+         lp_shared_code_find(screen, ir_sha1_cache_key);
+      if (code) {
+         use_shared_code(variant, code);
+         LP_COUNT(nr_shared_variants);
+         return TRUE;
+      }
+   }
+
+   if (shader->base.ir.nir) {
       lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
       if (!cached.data_size)
          needs_caching = true;
@@ -3760,16 +4075,16 @@ generate_variant(struct llvmpipe_context *lp,
 
    char module_name[64];
    snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-            shader->no, shader->variants_created);
-   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
+            shader->no, variant->no);
+   variant->gallivm = gallivm_create(module_name, context, &cached);
+   if (!variant->gallivm)
+      return FALSE;
 
-   variant->list_item_global.base = variant;
-   variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
+   /*
+    * Generic variants only stand in until the background compile of the
+    * specialized one finishes, so they are wanted soon rather than fast.
+    */
+   variant->gallivm->fast_compile = variant->generic;
 
    /*
     * Determine whether we are touching all channels in the color buffer.
@@ -3783,9 +4098,11 @@ generate_variant(struct llvmpipe_context *lp,
    }
 
    /* The scissor is ignored here as only tiles inside the scissoring
-    * rectangle will refer to this.
+    * rectangle will refer to this.  Generic variants can't tell, the
+    * state they test and blend with is only known at run time.
     */
    const boolean no_kill =
+         !variant->generic &&
          fullcolormask &&
          !key->stencil[0].enabled &&
          !key->alpha.enabled &&
@@ -3822,6 +4139,7 @@ generate_variant(struct llvmpipe_context *lp,
 
    /* We only care about opaque blits for now */
    if (variant->opaque &&
+       !samples_tiled_texture(key) &&
        (shader->kind == LP_FS_KIND_BLIT_RGBA ||
         shader->kind == LP_FS_KIND_BLIT_RGB1)) {
       const struct lp_sampler_static_state *samp0 =
@@ -3860,14 +4178,13 @@ generate_variant(struct llvmpipe_context *lp,
     * the linear path.
     */
    const boolean linear_pipeline =
+         !variant->generic &&
+         !samples_tiled_texture(key) &&
          !key->stencil[0].enabled &&
          !key->depth.enabled &&
          !shader->info.base.uses_kill &&
          !key->blend.logicop_enable &&
-         (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM);
-
-   memcpy(&variant->key, key, sizeof *key);
+         lp_linear_check_cbuf_format(key->cbuf_format[0], variant->opaque);
 
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
@@ -3878,12 +4195,12 @@ generate_variant(struct llvmpipe_context *lp,
    lp_jit_init_types(variant);
 
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
 
    if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
+      if (variant->opaque && !variant->generic) {
          /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
+         generate_fragment(shader, variant, RAST_WHOLE);
       }
    }
 
@@ -3907,7 +4224,7 @@ generate_variant(struct llvmpipe_context *lp,
          if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
              shader->kind == LP_FS_KIND_BLIT_RGB1 ||
              shader->kind == LP_FS_KIND_LLVM_LINEAR) {
-            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
+            llvmpipe_fs_variant_linear_llvm(shader, variant);
          }
       }
    } else {
@@ -3980,6 +4297,49 @@ generate_variant(struct llvmpipe_context *lp,
 
    gallivm_free_ir(variant->gallivm);
 
+   if (screen->shared_code) {
+      variant->code = lp_shared_code_create(screen, ir_sha1_cache_key,
+                                            variant->gallivm,
+                                            variant, sizeof *variant);
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key,
+                 boolean generic)
+{
+   struct lp_fragment_shader_variant *variant =
+      create_variant(lp, shader, key);
+   if (!variant)
+      return NULL;
+
+   variant->generic = generic;
+
+   MESA_TRACE_FUNC();
+
+   int64_t t0 = os_time_get();
+   if (!compile_variant(llvmpipe_screen(lp->pipe.screen), lp->context,
+                        variant)) {
+      free_variant(lp, variant);
+      return NULL;
+   }
+   int64_t t1 = os_time_get();
+   int64_t dt = t1 - t0;
+   LP_COUNT_ADD(llvm_compile_time, dt);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+
+   lp->counters.fs_compiles++;
+   lp->counters.fs_compile_time += dt;
+
    return variant;
 }
 
@@ -3997,6 +4357,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    pipe_reference_init(&shader->reference, 1);
    shader->no = fs_no++;
    list_inithead(&shader->variants.list);
+   cso_hash_init(&shader->variants_hash);
 
    shader->base.type = templ->type;
    if (templ->type == PIPE_SHADER_IR_TGSI) {
@@ -4010,6 +4371,8 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
       nir_tgsi_scan_shader(templ->ir.nir, &shader->info.base, true);
    }
 
+   lp_shader_ir_sha1(&shader->base, shader->ir_sha1);
+
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
       FREE((void *) shader->base.tokens);
@@ -4129,6 +4492,8 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 
    /* remove from shader's list */
    list_del(&variant->list_item_local.list);
+   cso_hash_erase_data(&variant->shader->variants_hash, variant->hash_key,
+                       &variant->key);
    variant->shader->variants_cached--;
 
    /* remove from context's list */
@@ -4142,7 +4507,12 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
-   gallivm_destroy(variant->gallivm);
+   if (variant->code) {
+      lp_shared_code_reference(llvmpipe_screen(lp->pipe.screen),
+                               &variant->code, NULL);
+   } else {
+      gallivm_destroy(variant->gallivm);
+   }
    lp_fs_reference(lp, &variant->shader, NULL);
 #if GALLIVM_USE_ORCJIT == 1
    if (variant->function_name[RAST_EDGE_TEST])
@@ -4166,6 +4536,7 @@ llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
    if (shader->base.ir.nir)
       ralloc_free(shader->base.ir.nir);
    assert(shader->variants_cached == 0);
+   cso_hash_deinit(&shader->variants_hash);
    FREE((void *) shader->base.tokens);
    FREE(shader);
 }
@@ -4178,6 +4549,8 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    struct lp_fragment_shader *shader = fs;
    struct lp_fs_variant_list_item *li, *next;
 
+   llvmpipe_cancel_fs_compiles(llvmpipe, shader);
+
    /* Delete all the variants */
    LIST_FOR_EACH_ENTRY_SAFE(li, next, &shader->variants.list, list) {
       struct lp_fragment_shader_variant *variant;
@@ -4353,6 +4726,19 @@ force_dst_alpha_one(enum pipe_blendfactor factor, boolean clamped_zero)
 }
 
 
+/**
+ * Alpha test only applies if render buffer 0 is non-integer (or does not
+ * exist).
+ */
+static boolean
+alpha_test_applies(const struct llvmpipe_context *lp)
+{
+   return !lp->framebuffer.nr_cbufs ||
+          !lp->framebuffer.cbufs[0] ||
+          !util_format_is_pure_integer(lp->framebuffer.cbufs[0]->format);
+}
+
+
 /**
  * We need to generate several variants of the fragment pipeline to match
  * all the combinations of the contributing state atoms.
@@ -4408,12 +4794,7 @@ make_variant_key(struct llvmpipe_context *lp,
     */
    key->depth_clamp = lp->rasterizer->depth_clamp;
 
-   /* alpha test only applies if render buffer 0 is non-integer
-    * (or does not exist)
-    */
-   if (!lp->framebuffer.nr_cbufs ||
-       !lp->framebuffer.cbufs[0] ||
-       !util_format_is_pure_integer(lp->framebuffer.cbufs[0]->format)) {
+   if (alpha_test_applies(lp)) {
       key->alpha.enabled = lp->depth_stencil->alpha_enabled;
    }
    if (key->alpha.enabled) {
@@ -4583,7 +4964,7 @@ make_variant_key(struct llvmpipe_context *lp,
           */
          if ((shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW]
               & (1u << (i & 31))) || i > 31) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
+            llvmpipe_sampler_static_texture_state(&fs_sampler[i].texture_state,
                                   lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
@@ -4591,7 +4972,7 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for (unsigned i = 0; i < key->nr_sampler_views; ++i) {
          if ((shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) || i > 31) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
+            llvmpipe_sampler_static_texture_state(&fs_sampler[i].texture_state,
                                  lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
@@ -4622,34 +5003,378 @@ make_variant_key(struct llvmpipe_context *lp,
 }
 
 
+/**
+ * Make the key of the generic variant standing in for the one of 'key'.
+ *
+ * Generic variants do the depth, stencil and alpha tests, and blend, as
+ * the LP_JIT_DYN_x words of the jit context say, see pack_dynamic_state().
+ * Their key enables these whenever the framebuffer allows them, with
+ * otherwise fixed state.  The framebuffer formats, sample counts, logic
+ * op and dual source blending remain in the key, as do the rasterizer
+ * state and the texture formats and targets.  The texture size and mipmap
+ * hints (pot_*, level_zero_only) are dropped.
+ */
+static const struct lp_fragment_shader_variant_key *
+make_generic_key(const struct llvmpipe_context *lp,
+                 const struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key,
+                 char *store)
+{
+   struct lp_fragment_shader_variant_key *generic_key =
+      (struct lp_fragment_shader_variant_key *)store;
+
+   memcpy(generic_key, key, shader->variant_key_size);
+
+   memset(&generic_key->depth, 0, sizeof generic_key->depth);
+   memset(&generic_key->stencil, 0, sizeof generic_key->stencil);
+   generic_key->zsbuf_format = PIPE_FORMAT_NONE;
+   if (lp->framebuffer.zsbuf) {
+      const enum pipe_format zsbuf_format = lp->framebuffer.zsbuf->format;
+      const struct util_format_description *zsbuf_desc =
+         util_format_description(zsbuf_format);
+
+      if (util_format_has_depth(zsbuf_desc)) {
+         generic_key->zsbuf_format = zsbuf_format;
+         generic_key->depth.enabled = 1;
+         generic_key->depth.writemask = 1;
+         generic_key->depth.func = PIPE_FUNC_ALWAYS;
+      }
+      if (util_format_has_stencil(zsbuf_desc)) {
+         generic_key->zsbuf_format = zsbuf_format;
+         for (unsigned i = 0; i < 2; i++) {
+            generic_key->stencil[i].enabled = 1;
+            generic_key->stencil[i].func = PIPE_FUNC_ALWAYS;
+            generic_key->stencil[i].valuemask = 0xff;
+            generic_key->stencil[i].writemask = 0xff;
+         }
+      }
+   }
+
+   generic_key->alpha.enabled = alpha_test_applies(lp);
+   generic_key->alpha.func = generic_key->alpha.enabled ? PIPE_FUNC_ALWAYS : 0;
+
+   const boolean dual_source_blend = key->blend.rt[0].blend_enable &&
+                                     util_blend_state_is_dual(&key->blend, 0);
+   for (unsigned i = 0; i < key->nr_cbufs; i++) {
+      struct pipe_rt_blend_state *blend_rt = &generic_key->blend.rt[i];
+      const enum pipe_format format = key->cbuf_format[i];
+
+      if (format == PIPE_FORMAT_NONE)
+         continue;
+
+      blend_rt->colormask = 0xf;
+
+      /* see lp_build_blend_aos() */
+      if (key->blend.logicop_enable ||
+          dual_source_blend ||
+          util_format_is_pure_integer(format) ||
+          util_format_is_snorm(format))
+         continue;
+
+      blend_rt->blend_enable = 1;
+      blend_rt->rgb_func = PIPE_BLEND_ADD;
+      blend_rt->rgb_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend_rt->rgb_dst_factor = PIPE_BLENDFACTOR_ZERO;
+      blend_rt->alpha_func = PIPE_BLEND_ADD;
+      blend_rt->alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend_rt->alpha_dst_factor = PIPE_BLENDFACTOR_ZERO;
+   }
+
+   struct lp_sampler_static_state *fs_sampler =
+      lp_fs_variant_key_samplers(generic_key);
+   for (unsigned i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); ++i) {
+      fs_sampler[i].texture_state.pot_width = 0;
+      fs_sampler[i].texture_state.pot_height = 0;
+      fs_sampler[i].texture_state.pot_depth = 0;
+      fs_sampler[i].texture_state.level_zero_only = 0;
+   }
+
+   return generic_key;
+}
+
+
+/**
+ * Pack the state of 'key' which generic variants read at run time.
+ */
+static void
+pack_dynamic_state(const struct lp_fragment_shader_variant_key *key,
+                   uint32_t dynamic_state[LP_JIT_DYN_COUNT])
+{
+   memset(dynamic_state, 0, LP_JIT_DYN_COUNT * sizeof *dynamic_state);
+
+   dynamic_state[LP_JIT_DYN_DEPTH] =
+      (key->depth.enabled ? key->depth.func : PIPE_FUNC_ALWAYS)
+         << LP_JIT_DYN_DEPTH_FUNC_SHIFT |
+      (key->depth.enabled && key->depth.writemask)
+         << LP_JIT_DYN_DEPTH_WRITEMASK_SHIFT |
+      (key->alpha.enabled ? key->alpha.func : PIPE_FUNC_ALWAYS)
+         << LP_JIT_DYN_ALPHA_FUNC_SHIFT;
+
+   for (unsigned i = 0; i < 2; i++) {
+      /* without two sided stencil, back faces use the front state */
+      const struct pipe_stencil_state *stencil =
+         &key->stencil[key->stencil[1].enabled ? i : 0];
+
+      if (stencil->enabled) {
+         dynamic_state[LP_JIT_DYN_STENCIL_FRONT + i] =
+            stencil->func << LP_JIT_DYN_STENCIL_FUNC_SHIFT |
+            stencil->fail_op << LP_JIT_DYN_STENCIL_FAIL_OP_SHIFT |
+            stencil->zfail_op << LP_JIT_DYN_STENCIL_ZFAIL_OP_SHIFT |
+            stencil->zpass_op << LP_JIT_DYN_STENCIL_ZPASS_OP_SHIFT |
+            stencil->valuemask << LP_JIT_DYN_STENCIL_VALUEMASK_SHIFT |
+            stencil->writemask << LP_JIT_DYN_STENCIL_WRITEMASK_SHIFT;
+      } else {
+         dynamic_state[LP_JIT_DYN_STENCIL_FRONT + i] =
+            PIPE_FUNC_ALWAYS << LP_JIT_DYN_STENCIL_FUNC_SHIFT |
+            0xff << LP_JIT_DYN_STENCIL_VALUEMASK_SHIFT;
+      }
+   }
+
+   for (unsigned i = 0; i < key->nr_cbufs; i++) {
+      const struct pipe_rt_blend_state *blend_rt = &key->blend.rt[i];
+      uint32_t word = blend_rt->colormask << LP_JIT_DYN_BLEND_COLORMASK_SHIFT;
+
+      if (blend_rt->blend_enable) {
+         word |= blend_rt->rgb_func << LP_JIT_DYN_BLEND_RGB_FUNC_SHIFT |
+                 blend_rt->rgb_src_factor << LP_JIT_DYN_BLEND_RGB_SRC_SHIFT |
+                 blend_rt->rgb_dst_factor << LP_JIT_DYN_BLEND_RGB_DST_SHIFT |
+                 blend_rt->alpha_func << LP_JIT_DYN_BLEND_ALPHA_FUNC_SHIFT |
+                 blend_rt->alpha_src_factor << LP_JIT_DYN_BLEND_ALPHA_SRC_SHIFT |
+                 blend_rt->alpha_dst_factor << LP_JIT_DYN_BLEND_ALPHA_DST_SHIFT;
+      } else {
+         /* src * ONE + dst * ZERO */
+         word |= PIPE_BLEND_ADD << LP_JIT_DYN_BLEND_RGB_FUNC_SHIFT |
+                 PIPE_BLENDFACTOR_ONE << LP_JIT_DYN_BLEND_RGB_SRC_SHIFT |
+                 PIPE_BLENDFACTOR_ZERO << LP_JIT_DYN_BLEND_RGB_DST_SHIFT |
+                 PIPE_BLEND_ADD << LP_JIT_DYN_BLEND_ALPHA_FUNC_SHIFT |
+                 PIPE_BLENDFACTOR_ONE << LP_JIT_DYN_BLEND_ALPHA_SRC_SHIFT |
+                 PIPE_BLENDFACTOR_ZERO << LP_JIT_DYN_BLEND_ALPHA_DST_SHIFT;
+      }
+
+      dynamic_state[LP_JIT_DYN_BLEND + i] = word;
+   }
+}
+
+
+static struct lp_fragment_shader_variant *
+find_variant(struct lp_fragment_shader *shader,
+             const struct lp_fragment_shader_variant_key *key)
+{
+   const unsigned hash_key = _mesa_hash_data(key, shader->variant_key_size);
+   void *data = cso_hash_find_data_from_template(&shader->variants_hash,
+                                                 hash_key, key,
+                                                 shader->variant_key_size);
+   return data ? container_of(data, struct lp_fragment_shader_variant, key)
+               : NULL;
+}
+
+
+/** Put a new variant into the shader's and the context's lists */
+static void
+insert_variant(struct llvmpipe_context *lp,
+               struct lp_fragment_shader_variant *variant)
+{
+   list_add(&variant->list_item_local.list, &variant->shader->variants.list);
+   cso_hash_insert(&variant->shader->variants_hash, variant->hash_key,
+                   &variant->key);
+   list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
+   lp->nr_fs_variants++;
+   lp->nr_fs_instrs += variant->nr_instrs;
+   variant->shader->variants_cached++;
+}
+
+
+/**
+ * A fragment shader variant being compiled on the screen's compile queue.
+ */
+struct lp_fs_compile_job
+{
+   struct list_head list;
+   struct util_queue_fence fence;
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader_variant *variant;
+   int64_t queue_time;
+   int64_t compile_time;
+   boolean compiled;
+   /** The shader was deleted, throw the variant away */
+   boolean cancelled;
+};
+
+
+static void
+fs_compile_job_execute(void *data, void *gdata, int thread_index)
+{
+   MESA_TRACE_FUNC();
+
+   struct lp_fs_compile_job *job = data;
+   struct llvmpipe_screen *screen = job->screen;
+
+   int64_t t0 = os_time_get();
+   job->compiled = compile_variant(screen,
+                                   screen->compile_contexts[thread_index],
+                                   job->variant);
+   job->compile_time = os_time_get() - t0;
+}
+
+
+static boolean
+fs_compile_pending(struct llvmpipe_context *lp,
+                   struct lp_fragment_shader *shader,
+                   const struct lp_fragment_shader_variant_key *key)
+{
+   list_for_each_entry(struct lp_fs_compile_job, job,
+                       &lp->fs_compile_jobs, list) {
+      if (job->variant->shader == shader &&
+          memcmp(&job->variant->key, key, shader->variant_key_size) == 0)
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
+/**
+ * Compile the variant for the given key in the background.  It replaces
+ * the generic one in llvmpipe_finish_fs_compiles().
+ */
+static void
+queue_variant_compile(struct llvmpipe_context *lp,
+                      struct lp_fragment_shader *shader,
+                      const struct lp_fragment_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
+   if (fs_compile_pending(lp, shader, key))
+      return;
+
+   struct lp_fs_compile_job *job = CALLOC_STRUCT(lp_fs_compile_job);
+   if (!job)
+      return;
+
+   job->variant = create_variant(lp, shader, key);
+   if (!job->variant) {
+      FREE(job);
+      return;
+   }
+
+   job->screen = screen;
+   job->queue_time = os_time_get();
+   util_queue_fence_init(&job->fence);
+   list_addtail(&job->list, &lp->fs_compile_jobs);
+
+   lp->counters.fs_async_compiles++;
+   LP_COUNT(nr_fs_async_compiles);
+   LP_COUNT(fs_compile_queue_depth);
+   LP_COUNT_MAX(max_fs_compile_queue_depth,
+                LP_COUNT_GET(fs_compile_queue_depth));
+
+   util_queue_add_job(&screen->compile_queue, job, &job->fence,
+                      fs_compile_job_execute, NULL, 0);
+}
+
+
+/**
+ * Install the variants compiled in the background in place of their
+ * generic stand-ins.  Unless 'wait' is set, only the finished compiles
+ * are handled.
+ */
+void
+llvmpipe_finish_fs_compiles(struct llvmpipe_context *lp, boolean wait)
+{
+   list_for_each_entry_safe(struct lp_fs_compile_job, job,
+                            &lp->fs_compile_jobs, list) {
+      if (!wait && !util_queue_fence_is_signalled(&job->fence))
+         continue;
+
+      util_queue_fence_wait(&job->fence);
+      util_queue_fence_destroy(&job->fence);
+      list_del(&job->list);
+
+      const int64_t fallback_time = os_time_get() - job->queue_time;
+      LP_COUNT_ADD(fs_compile_queue_depth, -1);
+      LP_COUNT_ADD(fs_fallback_time, fallback_time);
+      lp->counters.fs_fallback_time += fallback_time;
+
+      if (job->compiled) {
+         LP_COUNT_ADD(llvm_compile_time, job->compile_time);
+         LP_COUNT_ADD(nr_llvm_compiles, 2);
+         lp->counters.fs_compiles++;
+         lp->counters.fs_compile_time += job->compile_time;
+      }
+
+      struct lp_fragment_shader_variant *variant = job->variant;
+      struct lp_fragment_shader *shader = variant->shader;
+
+      if (!job->compiled) {
+         free_variant(lp, variant);
+      } else if (job->cancelled) {
+         lp_fs_variant_reference(lp, &variant, NULL);
+      } else {
+         struct lp_fragment_shader_variant *generic =
+            find_variant(shader, &variant->key);
+         if (generic) {
+            assert(generic->generic);
+            llvmpipe_remove_shader_variant(lp, generic);
+            lp_fs_variant_reference(lp, &generic, NULL);
+         }
+
+         insert_variant(lp, variant);
+
+         /* Rebind, llvmpipe_update_fs() will pick the new variant */
+         if (shader == lp->fs)
+            lp->dirty |= LP_NEW_FS;
+      }
+
+      FREE(job);
+   }
+}
+
+
+/**
+ * Throw away the background compiles of a shader which is being deleted,
+ * or of all shaders if 'shader' is NULL.
+ */
+void
+llvmpipe_cancel_fs_compiles(struct llvmpipe_context *lp,
+                            struct lp_fragment_shader *shader)
+{
+   list_for_each_entry(struct lp_fs_compile_job, job,
+                       &lp->fs_compile_jobs, list) {
+      if (!shader || job->variant->shader == shader)
+         job->cancelled = TRUE;
+   }
+}
+
+
 /**
  * Update fragment shader state.  This is called just prior to drawing
  * something when some fragment-related state has changed.
+ *
+ * With LP_NUM_COMPILE_THREADS, missing variants are compiled in the
+ * background.  Meanwhile a generic variant is used instead, which reads
+ * the depth, stencil, alpha and blend state at run time, so that it is
+ * shared by all the keys differing only in these.
  */
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader *shader = lp->fs;
 
    char store[LP_FS_MAX_VARIANT_KEY_SIZE];
    const struct lp_fragment_shader_variant_key *key =
       make_variant_key(lp, shader, store);
 
-   struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
    /* Search the variants for one which matches the key */
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   struct lp_fragment_shader_variant *variant = find_variant(shader, key);
 
    if (variant) {
       /* Move this variant to the head of the list to implement LRU
        * deletion of shader's when we have too many.
        */
       list_move_to(&variant->list_item_global.list, &lp->fs_variants_list.list);
+
+      if (variant->generic)
+         queue_variant_compile(lp, shader, key);
    } else {
       /* variant not found, create it now */
 
@@ -4701,26 +5426,56 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          }
       }
 
+      char generic_store[LP_FS_MAX_VARIANT_KEY_SIZE];
+      const struct lp_fragment_shader_variant_key *generic_key = NULL;
+
       /*
-       * Generate the new variant.
+       * There's no point in a generic variant which is no more generic
+       * than the specialized one.
        */
-      int64_t t0 = os_time_get();
-      variant = generate_variant(lp, shader, key);
-      int64_t t1 = os_time_get();
-      int64_t dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
-
-      /* Put the new variant into the list */
-      if (variant) {
-         list_add(&variant->list_item_local.list, &shader->variants.list);
-         list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
-         lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
-         shader->variants_cached++;
+      if (screen->num_compile_threads) {
+         generic_key = make_generic_key(lp, shader, key, generic_store);
+         if (memcmp(generic_key, key, shader->variant_key_size) == 0)
+            generic_key = NULL;
+      }
+
+      if (generic_key) {
+         /*
+          * Use the generic variant until the specialized one is ready,
+          * generating it now if there's none yet.
+          */
+         variant = find_variant(shader, generic_key);
+         if (!variant) {
+            variant = generate_variant(lp, shader, generic_key, TRUE);
+            if (variant)
+               insert_variant(lp, variant);
+            lp->counters.fs_compile_stalls++;
+         } else {
+            list_move_to(&variant->list_item_global.list,
+                         &lp->fs_variants_list.list);
+         }
+
+         queue_variant_compile(lp, shader, key);
+      } else {
+         /*
+          * Generate the new variant.
+          */
+         variant = generate_variant(lp, shader, key, FALSE);
+
+         /* Put the new variant into the list */
+         if (variant)
+            insert_variant(lp, variant);
+         lp->counters.fs_compile_stalls++;
       }
    }
 
+   lp->fs_generic = variant && variant->generic;
+   if (lp->fs_generic) {
+      uint32_t dynamic_state[LP_JIT_DYN_COUNT];
+      pack_dynamic_state(key, dynamic_state);
+      lp_setup_set_fs_dynamic_state(lp->setup, dynamic_state);
+   }
+
    /* Bind this variant */
    lp_setup_set_fs_variant(lp->setup, variant);
 }
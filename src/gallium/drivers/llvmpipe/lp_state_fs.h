@@ -32,6 +32,7 @@
 
 #include "util/list.h"
 #include "pipe/p_compiler.h"
+#include "cso_cache/cso_hash.h"
 #include "pipe/p_state.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
@@ -42,6 +43,7 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_shared_code;
 
 
 /** Indexes into jit_function[] array */
@@ -168,10 +170,25 @@ struct lp_fragment_shader_variant
 
    unsigned opaque:1;
    unsigned blit:1;
+   /*
+    * Stand-in compiled with less specialization, used until the variant
+    * for the same key has been compiled in the background.
+    */
+   unsigned generic:1;
+   /*
+    * Hierarchical depth: whether primitives can be rejected against the
+    * depth bounds, whether fully covered blocks tighten the bounds, and
+    * whether the depth writes may raise the depth values.
+    */
+   unsigned hiz_test:1;
+   unsigned hiz_update:1;
+   unsigned hiz_invalidate:1;
    unsigned linear_input_mask:16;
    struct pipe_reference reference;
 
    struct gallivm_state *gallivm;
+   /* Code shared with the other contexts, which owns gallivm if set */
+   struct lp_shared_code *code;
 
    LLVMTypeRef jit_context_type;
    LLVMTypeRef jit_context_ptr_type;
@@ -210,6 +227,9 @@ struct lp_fragment_shader_variant
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
+   /* Hash of the key, indexing the variant in the shader's variants_hash */
+   unsigned hash_key;
+
    /* For debugging/profiling purposes */
    unsigned no;
 
@@ -230,6 +250,8 @@ struct lp_fragment_shader
    enum lp_fs_kind kind;
 
    struct lp_fs_variant_list_item variants;
+   /* The same variants, indexed by key */
+   struct cso_hash variants_hash;
 
    struct draw_fragment_shader *draw_data;
 
@@ -239,6 +261,9 @@ struct lp_fragment_shader
    unsigned variants_created;
    unsigned variants_cached;
 
+   /** See lp_shader_ir_sha1() */
+   unsigned char ir_sha1[20];
+
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
 };
@@ -258,8 +283,7 @@ void
 llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant);
 
 void
-llvmpipe_fs_variant_linear_llvm(struct llvmpipe_context *lp,
-                                struct lp_fragment_shader *shader,
+llvmpipe_fs_variant_linear_llvm(struct lp_fragment_shader *shader,
                                 struct lp_fragment_shader_variant *variant);
 
 void
@@ -271,6 +295,16 @@ lp_debug_fs_kind(enum lp_fs_kind kind);
 void
 lp_linear_check_variant(struct lp_fragment_shader_variant *variant);
 
+boolean
+lp_linear_check_cbuf_format(enum pipe_format format, boolean opaque);
+
+void
+llvmpipe_finish_fs_compiles(struct llvmpipe_context *lp, boolean wait);
+
+void
+llvmpipe_cancel_fs_compiles(struct llvmpipe_context *lp,
+                            struct lp_fragment_shader *shader);
+
 void
 llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
                     struct lp_fragment_shader *shader);
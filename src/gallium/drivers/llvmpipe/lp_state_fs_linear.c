@@ -117,7 +117,13 @@ blend_premul(struct color_blend *blend)
 
    blend->color += blend->stride;
 
-   for (i = 0; i + 3 < width; i += 4) {
+   i = 0;
+#ifdef LP_LINEAR_HAVE_AVX2
+   if (lp_linear_has_avx2())
+      i = lp_linear_blend_premul_avx2(dst, src, width);
+#endif
+
+   for (; i + 3 < width; i += 4) {
       __m128i tmp;
       tmp = _mm_loadu_si128((const __m128i *)&dst[i]);  /* UNALIGNED READ */
       dstreg.m128 = util_sse2_blend_premul_4(*(const __m128i *)&src[i],
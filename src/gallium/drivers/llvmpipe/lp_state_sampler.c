@@ -268,6 +268,21 @@ llvmpipe_delete_sampler_state(struct pipe_context *pipe,
 }
 
 
+/**
+ * lp_sampler_static_texture_state() for llvmpipe's own shaders, which also
+ * know the tiled layout.
+ */
+void
+llvmpipe_sampler_static_texture_state(struct lp_static_texture_state *state,
+                                      const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+
+   if (view && view->texture)
+      state->tiled = llvmpipe_resource_const(view->texture)->tiled;
+}
+
+
 static void
 prepare_shader_sampling(struct llvmpipe_context *lp,
                         unsigned num,
@@ -288,7 +303,11 @@ prepare_shader_sampling(struct llvmpipe_context *lp,
 
       if (view) {
          struct pipe_resource *tex = view->texture;
-         struct llvmpipe_resource *lp_tex = llvmpipe_resource(tex);
+         /* The draw module's shaders only sample the linear layout */
+         struct llvmpipe_resource *lp_tex =
+            llvmpipe_resource_linear(llvmpipe_resource(tex));
+         if (!lp_tex)
+            lp_tex = llvmpipe_resource(tex);
          unsigned width0 = tex->width0;
          unsigned num_layers = tex->depth0;
          unsigned first_level = 0;
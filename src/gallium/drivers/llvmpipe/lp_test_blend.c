@@ -185,8 +185,9 @@ add_blend_test(struct gallivm_state *gallivm,
    dst = LLVMBuildLoad2(builder, vec_type, dst_ptr, "dst");
    con = LLVMBuildLoad2(builder, vec_type, const_ptr, "const");
 
-   res = lp_build_blend_aos(gallivm, blend, format, type, rt, src, NULL,
-                            src1, NULL, dst, NULL, con, NULL, swizzle, 4);
+   res = lp_build_blend_aos(gallivm, blend, NULL, format, type, rt, src,
+                            NULL, src1, NULL, dst, NULL, con, NULL,
+                            swizzle, 4);
 
    lp_build_name(res, "res");
 
@@ -0,0 +1,491 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and benchmark for the linear path's row kernels.
+ *
+ * The colour buffer conversions must give the same results as
+ * util_format, and the AVX2 kernels the same results as the SSE2 ones.
+ * The benchmark converts rows of a tile from the colour buffer format,
+ * blends them and converts them back, as the linear rasterizer does for
+ * formats other than bgra8.
+ */
+
+
+#include <inttypes.h>
+
+#include "util/detect.h"
+#include "util/u_memory.h"
+#include "util/u_sse.h"
+#include "util/os_time.h"
+#include "util/format/u_format.h"
+
+#include "lp_jit.h"
+#include "lp_limits.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
+#include "lp_test.h"
+
+
+static const enum pipe_format
+formats[] = {
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_B8G8R8X8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_R8G8B8X8_UNORM,
+   PIPE_FORMAT_B5G6R5_UNORM,
+   PIPE_FORMAT_R10G10B10A2_UNORM,
+   PIPE_FORMAT_B10G10R10A2_UNORM,
+};
+
+
+static void
+random_bytes(void *dst, unsigned size)
+{
+   uint8_t *d = dst;
+   for (unsigned i = 0; i < size; i++)
+      d[i] = rand() >> 7;
+}
+
+
+/** bgra8 <-> rgba8, in place */
+static void
+swap_rb(uint8_t *pixels, unsigned width)
+{
+   for (unsigned i = 0; i < width; i++) {
+      const uint8_t b = pixels[i * 4 + 0];
+      pixels[i * 4 + 0] = pixels[i * 4 + 2];
+      pixels[i * 4 + 2] = b;
+   }
+}
+
+
+#if DETECT_ARCH_SSE
+
+/**
+ * Check a format's conversions against util_format, for all row widths
+ * up to a tile.
+ */
+static boolean
+test_format_conversions(unsigned verbose,
+                        const struct lp_linear_format *format,
+                        const char *simd)
+{
+   alignas(16) uint8_t src[TILE_SIZE * 4];
+   alignas(16) uint8_t dst[TILE_SIZE * 4];
+   alignas(16) uint8_t ref[TILE_SIZE * 4];
+   const struct util_format_description *desc =
+      util_format_description(format->format);
+   const unsigned bytes = format->bytes;
+   const char *name = util_format_short_name(format->format);
+
+   for (unsigned width = 1; width <= TILE_SIZE; width++) {
+      if (format->unpack) {
+         random_bytes(src, width * bytes);
+         memset(dst, 0xcd, sizeof dst);
+         memset(ref, 0xcd, sizeof ref);
+
+         format->unpack(dst, src, width);
+         util_format_read_4ub(format->format, ref, 0, src, 0,
+                              0, 0, width, 1);
+         swap_rb(ref, width);
+
+         if (memcmp(dst, ref, sizeof dst) != 0) {
+            if (verbose >= 1)
+               printf("%s %s: unpack mismatch, width %u\n",
+                      name, simd, width);
+            return FALSE;
+         }
+      }
+
+      if (format->pack) {
+         random_bytes(src, width * 4);
+         memset(dst, 0xcd, sizeof dst);
+         memset(ref, 0xcd, sizeof ref);
+
+         format->pack(dst, src, width);
+         swap_rb(src, width);
+         util_format_write_4ub(format->format, src, 0, ref, 0,
+                               0, 0, width, 1);
+
+         /* The X channel is undefined.  Shaders writing bgrx8 directly
+          * leave their alpha there, so the conversions do too.
+          */
+         if (desc->nr_channels == 4 &&
+             desc->channel[3].type == UTIL_FORMAT_TYPE_VOID) {
+            assert(bytes == 4);
+            for (unsigned x = 0; x < width; x++)
+               dst[x * 4 + 3] = ref[x * 4 + 3];
+         }
+
+         if (memcmp(dst, ref, sizeof dst) != 0) {
+            if (verbose >= 1)
+               printf("%s %s: pack mismatch, width %u\n",
+                      name, simd, width);
+            return FALSE;
+         }
+      }
+   }
+
+   return TRUE;
+}
+
+
+static void
+blend_premul_sse2(uint32_t *dst, const uint32_t *src, unsigned width)
+{
+   for (unsigned i = 0; i < width; i += 4) {
+      __m128i d = _mm_load_si128((const __m128i *)&dst[i]);
+      __m128i s = _mm_load_si128((const __m128i *)&src[i]);
+      _mm_store_si128((__m128i *)&dst[i], util_sse2_blend_premul_4(s, d));
+   }
+}
+
+
+/**
+ * Convert, blend and convert back the rows of a tile, reporting pixels
+ * per second.
+ */
+static double
+benchmark_format(const struct lp_linear_format *format, boolean avx2)
+{
+   const unsigned stride = TILE_SIZE * 4;
+   uint8_t *cbuf = align_malloc(TILE_SIZE * stride, 64);
+   uint8_t *tile = align_malloc(TILE_SIZE * stride, 64);
+   uint32_t *src = align_malloc(TILE_SIZE * 4, 64);
+   const unsigned tiles = 64, reps = 8;
+   int64_t best = INT64_MAX;
+
+   random_bytes(cbuf, TILE_SIZE * stride);
+   random_bytes(src, TILE_SIZE * 4);
+
+   for (unsigned r = 0; r < reps; r++) {
+      const int64_t start = os_time_get_nano();
+
+      for (unsigned n = 0; n < tiles; n++) {
+         for (unsigned y = 0; y < TILE_SIZE; y++) {
+            uint8_t *cbuf_row = cbuf + y * stride;
+            uint32_t *tile_row = (uint32_t *)(tile + y * stride);
+            unsigned x = 0;
+
+            if (format->unpack)
+               format->unpack(tile_row, cbuf_row, TILE_SIZE);
+            else if (!format->pack)
+               tile_row = (uint32_t *)cbuf_row;
+
+#ifdef LP_LINEAR_HAVE_AVX2
+            if (avx2)
+               x = lp_linear_blend_premul_avx2(tile_row, src, TILE_SIZE);
+#endif
+            blend_premul_sse2(tile_row + x, src + x, TILE_SIZE - x);
+
+            if (format->pack)
+               format->pack(cbuf_row, tile_row, TILE_SIZE);
+         }
+      }
+
+      best = MIN2(best, os_time_get_nano() - start);
+   }
+
+   align_free(cbuf);
+   align_free(tile);
+   align_free(src);
+
+   return (double)tiles * TILE_SIZE * TILE_SIZE * 1e9 / MAX2(best, 1);
+}
+
+
+#ifdef LP_LINEAR_HAVE_AVX2
+
+/**
+ * Check the AVX2 versions of the row kernels against the SSE2 ones.
+ */
+static boolean
+test_avx2_kernels(unsigned verbose)
+{
+   alignas(16) uint32_t src0[TILE_SIZE];
+   alignas(16) uint32_t src1[TILE_SIZE];
+   alignas(16) uint32_t dst[TILE_SIZE];
+   alignas(16) uint32_t ref[TILE_SIZE];
+
+   for (unsigned width = 1; width <= TILE_SIZE; width++) {
+      const unsigned width4 = align(width, 4);
+      const int weight = rand() & 0xff;
+
+      random_bytes(src0, sizeof src0);
+      random_bytes(src1, sizeof src1);
+
+      /* Premultiplied alpha blending */
+      memcpy(dst, src1, sizeof dst);
+      memcpy(ref, src1, sizeof ref);
+      int i = lp_linear_blend_premul_avx2(dst, src0, width);
+      blend_premul_sse2(dst + i, src0 + i, width4 - i);
+      blend_premul_sse2(ref, src0, width4);
+
+      if (memcmp(dst, ref, width * 4) != 0) {
+         if (verbose >= 1)
+            printf("blend_premul avx2: mismatch, width %u\n", width);
+         return FALSE;
+      }
+
+      /* Combining rows with a constant weight */
+      const __m128i wt = _mm_set1_epi16(weight);
+      i = lp_linear_lerp_rows_avx2(dst, src0, src1, weight, width);
+      for (; i < width; i += 4) {
+         __m128i a = _mm_load_si128((const __m128i *)&src0[i]);
+         __m128i b = _mm_load_si128((const __m128i *)&src1[i]);
+         *(__m128i *)&dst[i] = util_sse2_lerp_epi8_fixed88(a, b, &wt, &wt);
+      }
+      for (i = 0; i < width; i += 4) {
+         __m128i a = _mm_load_si128((const __m128i *)&src0[i]);
+         __m128i b = _mm_load_si128((const __m128i *)&src1[i]);
+         *(__m128i *)&ref[i] = util_sse2_lerp_epi8_fixed88(a, b, &wt, &wt);
+      }
+
+      if (memcmp(dst, ref, width * 4) != 0) {
+         if (verbose >= 1)
+            printf("lerp_rows avx2: mismatch, width %u\n", width);
+         return FALSE;
+      }
+
+      /* Interpolation, see interp_0_8() */
+      struct lp_linear_interp *interp =
+         align_malloc(sizeof *interp, 16);
+      int16_t a0[8], dadx[8];
+      random_bytes(a0, sizeof a0);
+      random_bytes(dadx, sizeof dadx);
+      interp->width = width4;
+      interp->a0 = _mm_loadu_si128((const __m128i *)a0);
+      interp->dadx = _mm_loadu_si128((const __m128i *)dadx);
+      interp->dady = _mm_setzero_si128();
+      lp_linear_interp_0_8_avx2(&interp->base);
+
+      for (unsigned x = 0; x < width4; x++) {
+         for (unsigned c = 0; c < 4; c++) {
+            const unsigned lane = (x & 1) * 4 + c;
+            const int16_t v = a0[lane] + (x >> 1) * dadx[lane];
+            ((uint8_t *)ref)[x * 4 + c] = CLAMP(v >> 7, 0, 255);
+         }
+      }
+
+      boolean ok = memcmp(interp->row, ref, width4 * 4) == 0;
+      align_free(interp);
+      if (!ok) {
+         if (verbose >= 1)
+            printf("interp_0_8 avx2: mismatch, width %u\n", width);
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/* One channel of util_sse2_lerp_epi16() */
+static uint8_t
+lerp_8(uint8_t w, uint8_t a, uint8_t b)
+{
+   const uint16_t res = (uint16_t)((uint16_t)(b - a) * w) >> 8;
+   return a + res;
+}
+
+
+/**
+ * Check the gathering clamped linear texture fetch against the scalar
+ * version of fetch_bgra_clamp_linear().
+ */
+static boolean
+test_avx2_clamp_linear(unsigned verbose)
+{
+   const unsigned tex_width = 37, tex_height = 23;
+   uint32_t *texels = align_malloc(tex_width * tex_height * 4, 16);
+   struct lp_jit_texture texture;
+   struct lp_linear_sampler *samp = align_malloc(sizeof *samp, 16);
+   boolean success = TRUE;
+
+   random_bytes(texels, tex_width * tex_height * 4);
+   memset(&texture, 0, sizeof texture);
+   texture.base = texels;
+   texture.width = tex_width;
+   texture.height = tex_height;
+   texture.row_stride[0] = tex_width * 4;
+
+   for (unsigned n = 0; n < 64 && success; n++) {
+      const int s = (rand() % (tex_width * 3) - tex_width) << 10;
+      const int t = (rand() % (tex_height * 3) - tex_height) << 10;
+      const int dsdx = (rand() % 0x40000) - 0x20000;
+      const int dtdx = (rand() % 0x40000) - 0x20000;
+
+      memset(samp, 0, sizeof *samp);
+      samp->texture = &texture;
+      samp->width = 1 + rand() % TILE_SIZE;
+      samp->s = s;
+      samp->t = t;
+      samp->dsdx = dsdx;
+      samp->dtdx = dtdx;
+
+      const uint32_t *row = lp_linear_fetch_bgra_clamp_linear_avx2(&samp->base);
+
+      for (int x = 0; x < samp->width; x++) {
+         const int sx = s + x * dsdx, tx = t + x * dtdx;
+         const int s0 = sx >> 16, t0 = tx >> 16;
+         const int cs0 = CLAMP(s0, 0, (int)tex_width - 1);
+         const int cs1 = CLAMP(s0 + 1, 0, (int)tex_width - 1);
+         const int ct0 = CLAMP(t0, 0, (int)tex_height - 1);
+         const int ct1 = CLAMP(t0 + 1, 0, (int)tex_height - 1);
+         const uint8_t *t00 = (const uint8_t *)&texels[ct0 * tex_width + cs0];
+         const uint8_t *t01 = (const uint8_t *)&texels[ct0 * tex_width + cs1];
+         const uint8_t *t10 = (const uint8_t *)&texels[ct1 * tex_width + cs0];
+         const uint8_t *t11 = (const uint8_t *)&texels[ct1 * tex_width + cs1];
+         const uint8_t ws = (sx >> 8) & 0xff, wt = (tx >> 8) & 0xff;
+
+         for (unsigned c = 0; c < 4; c++) {
+            const uint8_t ref = lerp_8(ws, lerp_8(wt, t00[c], t10[c]),
+                                           lerp_8(wt, t01[c], t11[c]));
+            if (((const uint8_t *)&row[x])[c] != ref) {
+               if (verbose >= 1)
+                  printf("clamp_linear avx2: mismatch, pixel %d\n", x);
+               success = FALSE;
+               break;
+            }
+         }
+      }
+   }
+
+   align_free(samp);
+   align_free(texels);
+
+   return success;
+}
+
+#endif  // LP_LINEAR_HAVE_AVX2
+
+
+static boolean
+test_formats(unsigned verbose, FILE *fp, boolean benchmark)
+{
+   boolean success = TRUE;
+
+   for (unsigned avx2 = 0; avx2 < 2; avx2++) {
+      const char *simd = avx2 ? "avx2" : "sse2";
+
+      if (avx2 && !lp_linear_has_avx2()) {
+         if (verbose >= 1)
+            printf("%-8s skipped\n", simd);
+         continue;
+      }
+
+      for (unsigned i = 0; i < ARRAY_SIZE(formats); i++) {
+         const struct lp_linear_format *format =
+            lp_linear_get_format_simd(formats[i], avx2);
+         const char *name = util_format_short_name(formats[i]);
+
+         assert(format);
+         const boolean ok = test_format_conversions(verbose, format, simd);
+         success &= ok;
+
+         const double rate = benchmark ? benchmark_format(format, avx2) : 0;
+
+         if (!benchmark && ok)
+            continue;
+
+         printf("%-16s %-8s %10.1f Mpixels/s%s\n",
+                name, simd, rate * 1e-6, ok ? "" : "  MISMATCH");
+         fflush(stdout);
+
+         if (fp) {
+            fprintf(fp, "%s\t%s\t%.0f\t%s\n",
+                    name, simd, rate, ok ? "pass" : "fail");
+            fflush(fp);
+         }
+      }
+
+#ifdef LP_LINEAR_HAVE_AVX2
+      if (avx2) {
+         const boolean ok = test_avx2_kernels(verbose) &&
+                            test_avx2_clamp_linear(verbose);
+         if (benchmark || !ok)
+            printf("%-16s %-8s %s\n", "kernels", simd, ok ? "pass" : "MISMATCH");
+         success &= ok;
+      }
+#endif
+   }
+
+   return success;
+}
+
+#else  // DETECT_ARCH_SSE
+
+static boolean
+test_formats(unsigned verbose, FILE *fp, boolean benchmark)
+{
+   return TRUE;
+}
+
+#endif  // DETECT_ARCH_SSE
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "format\t"
+           "simd\t"
+           "pixels_per_sec\t"
+           "result\n");
+
+   fflush(fp);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   boolean success = TRUE;
+
+   srand(0);
+
+   for (unsigned long i = 0; i < MAX2(n, 1); i++)
+      success &= test_formats(verbose, fp, i == 0);
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 1);
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 16);
+}
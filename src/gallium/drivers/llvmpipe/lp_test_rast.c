@@ -0,0 +1,355 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and benchmark for the triangle coverage functions.
+ *
+ * Streams of random triangles are set up and binned into a scene with
+ * lp_setup_tri_planes() and lp_setup_bin_triangle(), and the binned
+ * commands replayed with the coverage masks computed with each vector
+ * extension the CPU supports.  The fragment shader is replaced by a
+ * function which only records the masks, which must be the same for all
+ * of them.
+ */
+
+
+#include <inttypes.h>
+
+#include "util/u_memory.h"
+#include "util/os_time.h"
+
+#include "lp_rast_priv.h"
+#include "lp_setup_context.h"
+#include "lp_state_fs.h"
+#include "lp_test.h"
+
+
+#define FB_TILES 16
+#define FB_SIZE (FB_TILES * TILE_SIZE)
+
+
+struct rast_test_stream
+{
+   const char *name;
+   unsigned min_size, max_size; /**< triangle size, in pixels */
+   boolean multisample;
+};
+
+
+static const struct rast_test_stream
+streams[] = {
+   { "small", 2, 16, FALSE },
+   { "medium", 16, 120, FALSE },
+   { "large", 128, 512, FALSE },
+   { "ms", 16, 120, TRUE },
+};
+
+
+static const char *
+simd_names[] = {
+   "default",
+   "avx2",
+   "avx512",
+};
+
+
+/** What the shader stand-in saw */
+static uint64_t quad_checksum;
+static uint64_t quad_pixels;
+
+
+static void
+record_quad(const struct lp_jit_context *context,
+            uint32_t x,
+            uint32_t y,
+            uint32_t facing,
+            const void *a0,
+            const void *dadx,
+            const void *dady,
+            uint8_t **color,
+            uint8_t *depth,
+            uint64_t mask,
+            struct lp_jit_thread_data *thread_data,
+            unsigned *stride,
+            unsigned depth_stride,
+            unsigned *color_sample_stride,
+            unsigned depth_sample_stride)
+{
+   uint64_t h = ((uint64_t)x << 48 | (uint64_t)y << 32) ^ mask;
+
+   /* Order independent, the functions may visit the blocks differently */
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdull;
+   h ^= h >> 33;
+   quad_checksum += h;
+   quad_pixels += util_bitcount64(mask);
+}
+
+
+/**
+ * Set up a random triangle within the framebuffer the way
+ * do_triangle_ccw() does, and bin it.  Returns FALSE when the scene is
+ * full.
+ */
+static boolean
+random_triangle(struct lp_setup_context *setup,
+                const struct rast_test_stream *stream)
+{
+   struct lp_scene *scene = setup->scene;
+   int32_t x[3], y[3];
+   int64_t area;
+   struct u_rect bbox;
+
+   do {
+      const float size = stream->min_size +
+         random_float() * (stream->max_size - stream->min_size);
+      const float cx = size / 2 + random_float() * (FB_SIZE - size - 1);
+      const float cy = size / 2 + random_float() * (FB_SIZE - size - 1);
+
+      for (unsigned i = 0; i < 3; i++) {
+         x[i] = (int32_t)((cx + (random_float() - 0.5f) * size) * FIXED_ONE);
+         y[i] = (int32_t)((cy + (random_float() - 0.5f) * size) * FIXED_ONE);
+      }
+
+      area = IMUL64(x[0] - x[1], y[2] - y[0]) -
+             IMUL64(x[2] - x[0], y[0] - y[1]);
+
+      bbox.x0 = MIN3(x[0], x[1], x[2]) >> FIXED_ORDER;
+      bbox.x1 = (MAX3(x[0], x[1], x[2]) - 1) >> FIXED_ORDER;
+      bbox.y0 = MIN3(y[0], y[1], y[2]) >> FIXED_ORDER;
+      bbox.y1 = (MAX3(y[0], y[1], y[2]) - 1) >> FIXED_ORDER;
+   } while (area == 0 || bbox.x1 < bbox.x0 || bbox.y1 < bbox.y0);
+
+   if (area < 0) {
+      int32_t t;
+      t = x[0]; x[0] = x[1]; x[1] = t;
+      t = y[0]; y[0] = y[1]; y[1] = t;
+   }
+
+   const int max_szorig = ((bbox.x1 - (bbox.x0 & ~3)) |
+                           (bbox.y1 - (bbox.y0 & ~3)));
+   const boolean use_32bits = max_szorig <= MAX_FIXED_LENGTH32;
+   unsigned tri_bytes;
+
+   struct lp_rast_triangle *tri =
+      lp_setup_alloc_triangle(scene, 0, 3, &tri_bytes);
+   if (!tri)
+      return FALSE;
+
+   tri->inputs.frontfacing = TRUE;
+   tri->inputs.disable = FALSE;
+   tri->inputs.is_blit = FALSE;
+   tri->inputs.layer = 0;
+   tri->inputs.viewport_index = 0;
+   tri->inputs.view_index = 0;
+
+   lp_setup_tri_planes(GET_PLANES(tri), x, y, FALSE);
+
+   return lp_setup_bin_triangle(setup, tri, use_32bits, FALSE, &bbox, 3, 0);
+}
+
+
+/**
+ * Run the binned commands which compute coverage masks.  Fully covered
+ * tiles are skipped, as shading them doesn't involve any.
+ */
+static void
+replay(struct lp_rasterizer_task *task,
+       const lp_rast_cmd_func *dispatch)
+{
+   struct lp_scene *scene = task->scene;
+
+   for (unsigned y = 0; y < scene->tiles_y; y++) {
+      for (unsigned x = 0; x < scene->tiles_x; x++) {
+         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+
+         task->x = x * TILE_SIZE;
+         task->y = y * TILE_SIZE;
+
+         for (const struct cmd_block *block = bin->head; block;
+              block = block->next) {
+            for (unsigned k = 0; k < block->count; k++) {
+               if (block->cmd[k] != LP_RAST_OP_SHADE_TILE)
+                  dispatch[block->cmd[k]](task, block->arg[k]);
+            }
+         }
+      }
+   }
+}
+
+
+static boolean
+test_stream(unsigned verbose, FILE *fp,
+            const struct rast_test_stream *stream,
+            unsigned n)
+{
+   struct lp_setup_context *setup = CALLOC_STRUCT(lp_setup_context);
+   struct lp_fragment_shader_variant *variant =
+      CALLOC_STRUCT(lp_fragment_shader_variant);
+   struct lp_rast_state *state = align_malloc(sizeof *state, 16);
+   struct pipe_framebuffer_state fb;
+   struct lp_rasterizer_task task;
+   uint64_t ref_checksum = 0, ref_pixels = 0;
+   boolean success = TRUE;
+
+   memset(state, 0, sizeof *state);
+   variant->jit_function[RAST_WHOLE] = record_quad;
+   variant->jit_function[RAST_EDGE_TEST] = record_quad;
+   state->variant = variant;
+
+   /* Just enough of a setup context for lp_setup_bin_triangle() */
+   slab_create(&setup->scene_slab, sizeof(struct lp_scene), 1);
+   lp_scene_block_pool_init(&setup->block_pool, 0);
+   setup->scene_max_size = LP_SCENE_MAX_SIZE;
+   setup->multisample = stream->multisample;
+   setup->fs.current.variant = variant;
+   setup->fs.stored = state;
+   setup->draw_regions[0].x0 = 0;
+   setup->draw_regions[0].y0 = 0;
+   setup->draw_regions[0].x1 = FB_SIZE - 1;
+   setup->draw_regions[0].y1 = FB_SIZE - 1;
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = FB_SIZE;
+   fb.height = FB_SIZE;
+   fb.samples = stream->multisample ? 4 : 1;
+
+   struct lp_scene *scene = lp_scene_create(setup);
+   setup->scene = scene;
+   lp_scene_begin_binning(scene, &fb);
+
+   memset(&task, 0, sizeof task);
+   task.scene = scene;
+   task.state = state;
+   task.width = TILE_SIZE;
+   task.height = TILE_SIZE;
+
+   unsigned nr_tris = 0;
+   while (nr_tris < n && random_triangle(setup, stream))
+      nr_tris++;
+
+   for (unsigned simd = LP_RAST_SIMD_DEFAULT; simd <= LP_RAST_SIMD_AVX512; simd++) {
+      lp_rast_cmd_func dispatch[LP_RAST_OP_MAX];
+      const unsigned reps = 16;
+
+      if (!lp_rast_init_dispatch(dispatch, simd)) {
+         if (verbose >= 1)
+            printf("%-8s %-8s skipped\n", stream->name, simd_names[simd]);
+         continue;
+      }
+
+      /* Warm up, and collect the masks */
+      quad_checksum = 0;
+      quad_pixels = 0;
+      replay(&task, dispatch);
+
+      const uint64_t checksum = quad_checksum;
+      const uint64_t pixels = quad_pixels;
+
+      /* Best of several runs, to filter out interruptions */
+      int64_t best = INT64_MAX;
+      for (unsigned r = 0; r < reps; r++) {
+         const int64_t start = os_time_get_nano();
+         replay(&task, dispatch);
+         best = MIN2(best, os_time_get_nano() - start);
+      }
+
+      const double rate = (double)nr_tris * 1e9 / MAX2(best, 1);
+      boolean ok = TRUE;
+
+      if (simd == LP_RAST_SIMD_DEFAULT) {
+         ref_checksum = checksum;
+         ref_pixels = pixels;
+      } else if (checksum != ref_checksum || pixels != ref_pixels) {
+         ok = FALSE;
+         success = FALSE;
+      }
+
+      printf("%-8s %-8s %10.0f tris/s  %10" PRIu64 " pixels%s\n",
+             stream->name, simd_names[simd], rate, pixels,
+             ok ? "" : "  MISMATCH");
+      fflush(stdout);
+
+      if (fp) {
+         fprintf(fp, "%s\t%s\t%.0f\t%s\n",
+                 stream->name, simd_names[simd], rate,
+                 ok ? "pass" : "fail");
+         fflush(fp);
+      }
+   }
+
+   lp_scene_destroy(scene);
+   slab_destroy(&setup->scene_slab);
+   lp_scene_block_pool_destroy(&setup->block_pool);
+   FREE(setup);
+   align_free(state);
+   FREE(variant);
+
+   return success;
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "stream\t"
+           "simd\t"
+           "tris_per_sec\t"
+           "result\n");
+
+   fflush(fp);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   boolean success = TRUE;
+
+   srand(0);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(streams); i++)
+      success &= test_stream(verbose, fp, &streams[i], MAX2(n, 1));
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 1);
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 10000);
+}
@@ -36,14 +36,18 @@
 #include "pipe/p_defines.h"
 
 #include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+#include "util/u_box.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_transfer.h"
+#include "util/u_dynarray.h"
 
 #include "lp_context.h"
+#include "lp_fence.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
@@ -51,6 +55,9 @@
 #include "lp_state.h"
 #include "lp_rast.h"
 
+#include "gallivm/lp_bld_sample.h"
+#include "draw/draw_context.h"
+
 #include "frontend/sw_winsys.h"
 #include "git_sha1.h"
 
@@ -66,6 +73,42 @@ static simple_mtx_t resource_list_mutex = SIMPLE_MTX_INITIALIZER;
 static unsigned id_counter = 0;
 
 
+/**
+ * Whether to store a texture in the tiled layout described in
+ * lp_bld_sample.h.  Only textures which are merely sampled from qualify,
+ * as rendering, shader images and direct mappings need the linear layout.
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct llvmpipe_screen *screen,
+                          const struct pipe_resource *pt)
+{
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+   unsigned tw, th;
+
+   if (!screen->tiled_textures ||
+       pt->bind != PIPE_BIND_SAMPLER_VIEW ||
+       pt->usage == PIPE_USAGE_STAGING ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT)) ||
+       pt->nr_samples > 1 ||
+       llvmpipe_resource_is_1d(pt))
+      return FALSE;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->block.width != 1 ||
+       desc->block.height != 1 ||
+       desc->block.bits < 8 ||
+       desc->block.bits > 128 ||
+       !util_is_power_of_two_nonzero(desc->block.bits))
+      return FALSE;
+
+   /* Textures smaller than a tile stay in the cache anyway */
+   lp_tiled_tile_size(desc->block.bits / 8, &tw, &th);
+   return pt->width0 >= (1u << tw) && pt->height0 >= (1u << th);
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -134,7 +177,17 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
                                           align(height, align_y));
       block_size = util_format_get_blocksize(pt->format);
 
-      if (util_format_is_compressed(pt->format))
+      if (lpr->tiled) {
+         /* The row stride is the size of a row of tiles */
+         unsigned tile_w_log2, tile_h_log2;
+         lp_tiled_tile_size(block_size, &tile_w_log2, &tile_h_log2);
+
+         nblocksx = align(nblocksx, 1 << tile_w_log2);
+         nblocksy = align(nblocksy, 1 << tile_h_log2);
+         lpr->row_stride[level] =
+            (nblocksx >> tile_w_log2) << LP_TILED_TILE_SIZE_LOG2;
+         nblocksy >>= tile_h_log2;
+      } else if (util_format_is_compressed(pt->format))
          lpr->row_stride[level] = nblocksx * block_size;
       else
          lpr->row_stride[level] = align(nblocksx * block_size,
@@ -260,7 +313,9 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
          if (!llvmpipe_displaytarget_layout(screen, lpr, map_front_private))
             goto fail;
       } else {
-         /* texture map */
+         /* texture map, tiled unless the frontend provides the memory */
+         if (alloc_backing && llvmpipe_texture_can_tile(screen, &lpr->base))
+            lpr->tiled = true;
          if (!llvmpipe_texture_layout(screen, lpr, alloc_backing))
             goto fail;
       }
@@ -302,6 +357,7 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
    }
 
    lpr->id = id_counter++;
+   threaded_resource_init(&lpr->base, false);
 
 #ifdef DEBUG
    simple_mtx_lock(&resource_list_mutex);
@@ -436,6 +492,8 @@ llvmpipe_resource_from_memobj(struct pipe_screen *pscreen,
    }
    lpr->id = id_counter++;
    lpr->imported_memory = true;
+   threaded_resource_init(&lpr->base, false);
+   lpr->tbase.is_shared = true;
 
 #ifdef DEBUG
    simple_mtx_lock(&resource_list_mutex);
@@ -450,6 +508,22 @@ fail:
    return NULL;
 }
 
+
+/**
+ * Free the linear copy of a tiled texture, see llvmpipe_resource_linear().
+ */
+static void
+llvmpipe_resource_drop_linear(struct llvmpipe_resource *lpr)
+{
+   struct llvmpipe_resource *copy = p_atomic_xchg(&lpr->linear_copy, NULL);
+
+   if (copy) {
+      align_free(copy->tex_data);
+      FREE(copy);
+   }
+}
+
+
 static void
 llvmpipe_resource_destroy(struct pipe_screen *pscreen,
                           struct pipe_resource *pt)
@@ -457,6 +531,10 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
    struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
    struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
 
+   threaded_resource_deinit(pt);
+
+   llvmpipe_resource_drop_linear(lpr);
+
    if (!lpr->backable && !lpr->user_ptr) {
       if (lpr->dt) {
          /* display target */
@@ -470,7 +548,7 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
             lpr->tex_data = NULL;
          }
       } else if (lpr->data) {
-         if (!lpr->imported_memory)
+         if (!lpr->imported_memory && !lpr->gave_storage)
             align_free(lpr->data);
       }
    }
@@ -610,6 +688,8 @@ llvmpipe_resource_from_handle(struct pipe_screen *_screen,
    }
 
    lpr->id = id_counter++;
+   threaded_resource_init(&lpr->base, false);
+   lpr->tbase.is_shared = true;
 
 #ifdef DEBUG
    simple_mtx_lock(&resource_list_mutex);
@@ -667,9 +747,15 @@ llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
          goto fail;
 
       lpr->tex_data = user_memory;
-   } else
+   } else {
       lpr->data = user_memory;
+   }
    lpr->user_ptr = true;
+   threaded_resource_init(&lpr->base, false);
+   lpr->tbase.is_user_ptr = true;
+   if (!llvmpipe_resource_is_texture(&lpr->base))
+      util_range_add(&lpr->base, &lpr->tbase.valid_buffer_range,
+                     0, lpr->base.width0);
 #ifdef DEBUG
    simple_mtx_lock(&resource_list_mutex);
    list_addtail(&lpr->list, &resource_list.list);
@@ -682,6 +768,127 @@ fail:
 }
 
 
+/**
+ * Copy a box of a tiled texture level to a linear buffer or, if 'to_tiled',
+ * the other way around.
+ */
+static void
+llvmpipe_tiled_copy(struct llvmpipe_resource *lpr,
+                    unsigned level,
+                    const struct pipe_box *box,
+                    uint8_t *linear,
+                    unsigned stride,
+                    uint64_t layer_stride,
+                    bool to_tiled)
+{
+   const unsigned block_size = util_format_get_blocksize(lpr->base.format);
+   const unsigned row_stride = lpr->row_stride[level];
+   unsigned tw, th;
+
+   lp_tiled_tile_size(block_size, &tw, &th);
+
+   /* A row of texels within a tile is contiguous in both layouts */
+   const unsigned run = 1 << tw;
+   const unsigned x_end = box->x + box->width;
+
+   for (int z = 0; z < box->depth; z++) {
+      uint8_t *image =
+         llvmpipe_get_texture_image_address(lpr, box->z + z, level);
+
+      for (int y = 0; y < box->height; y++) {
+         uint8_t *row = linear + z * layer_stride + y * stride;
+         unsigned x = box->x;
+
+         while (x < x_end) {
+            const unsigned n = MIN2(run - (x & (run - 1)), x_end - x);
+            uint8_t *tiled = image + lp_tiled_offset(block_size, row_stride,
+                                                     x, box->y + y);
+            uint8_t *lin = row + (x - box->x) * block_size;
+
+            if (to_tiled)
+               memcpy(tiled, lin, n * block_size);
+            else
+               memcpy(lin, tiled, n * block_size);
+            x += n;
+         }
+      }
+   }
+}
+
+
+/**
+ * The texture itself or, for tiled textures, a linear copy of it, for
+ * sampling in the draw module.  NULL if the copy can't be allocated.
+ */
+struct llvmpipe_resource *
+llvmpipe_resource_linear(struct llvmpipe_resource *lpr)
+{
+   if (!lpr->tiled)
+      return lpr;
+
+   struct llvmpipe_resource *copy = p_atomic_read(&lpr->linear_copy);
+   if (copy)
+      return copy;
+
+   copy = CALLOC_STRUCT(llvmpipe_resource);
+   if (!copy)
+      return NULL;
+
+   copy->base = lpr->base;
+   copy->screen = lpr->screen;
+   if (!llvmpipe_texture_layout(lpr->screen, copy, TRUE)) {
+      FREE(copy);
+      return NULL;
+   }
+
+   for (unsigned level = 0; level <= lpr->base.last_level; level++) {
+      struct pipe_box box;
+
+      u_box_3d(0, 0, 0,
+               u_minify(lpr->base.width0, level),
+               u_minify(lpr->base.height0, level),
+               lpr->base.target == PIPE_TEXTURE_3D ?
+                  u_minify(lpr->base.depth0, level) : lpr->base.array_size,
+               &box);
+      llvmpipe_tiled_copy(lpr, level, &box,
+                          (uint8_t *)copy->tex_data + copy->mip_offsets[level],
+                          copy->row_stride[level], copy->img_stride[level],
+                          false);
+   }
+
+   /* Another context may have been quicker */
+   struct llvmpipe_resource *other =
+      p_atomic_cmpxchg(&lpr->linear_copy, NULL, copy);
+   if (other) {
+      align_free(copy->tex_data);
+      FREE(copy);
+      return other;
+   }
+
+   return copy;
+}
+
+
+/**
+ * Check if we're mapping a current constant buffer for writing.
+ */
+static void
+check_mapped_constants(struct llvmpipe_context *llvmpipe,
+                       const struct pipe_resource *resource)
+{
+   if (resource->bind & PIPE_BIND_CONSTANT_BUFFER) {
+      unsigned i;
+      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
+         if (resource == llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer) {
+            /* constants may have changed */
+            llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
+            break;
+         }
+      }
+   }
+}
+
+
 void *
 llvmpipe_transfer_map_ms(struct pipe_context *pipe,
                          struct pipe_resource *resource,
@@ -723,29 +930,36 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       }
    }
 
-   /* Check if we're mapping a current constant buffer */
+   /* Unsynchronized maps made on the threaded context's thread must not
+    * touch the context, they check the constants on unmap instead.
+    */
    if ((usage & PIPE_MAP_WRITE) &&
-       (resource->bind & PIPE_BIND_CONSTANT_BUFFER)) {
-      unsigned i;
-      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
-         if (resource == llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer) {
-            /* constants may have changed */
-            llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
-            break;
-         }
-      }
-   }
+       !(usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      check_mapped_constants(llvmpipe, resource);
 
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
       return NULL;
-   pt = &lpt->base;
+   pt = &lpt->base.b;
    pipe_resource_reference(&pt->resource, resource);
    pt->box = *box;
    pt->level = level;
    pt->stride = lpr->row_stride[level];
    pt->layer_stride = lpr->img_stride[level];
    pt->usage = usage;
+
+   if (lpr->tiled) {
+      /* Tiled textures are mapped through a linear copy of the box */
+      pt->stride = box->width * util_format_get_blocksize(lpr->base.format);
+      pt->layer_stride = (uint64_t)pt->stride * box->height;
+      lpt->staging = MALLOC(pt->layer_stride * box->depth);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         return NULL;
+      }
+   }
+
    *transfer = pt;
 
    assert(level < LP_MAX_TEXTURE_LEVELS);
@@ -786,6 +1000,16 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       screen->timestamp++;
    }
 
+   if (lpt->staging) {
+      if (!(usage & (PIPE_MAP_DISCARD_RANGE |
+                     PIPE_MAP_DISCARD_WHOLE_RESOURCE)) ||
+          (usage & PIPE_MAP_FLUSH_EXPLICIT)) {
+         llvmpipe_tiled_copy(lpr, level, box, lpt->staging,
+                             pt->stride, pt->layer_stride, false);
+      }
+      return lpt->staging;
+   }
+
    map +=
       box->y / util_format_get_blockheight(format) * pt->stride +
       box->x / util_format_get_blockwidth(format) * util_format_get_blocksize(format);
@@ -808,20 +1032,48 @@ llvmpipe_transfer_map(struct pipe_context *pipe,
 }
 
 
+static void
+llvmpipe_transfer_flush_region(struct pipe_context *pipe,
+                               struct pipe_transfer *transfer,
+                               const struct pipe_box *box)
+{
+   /* The mapping may outlive draws which cached vertices from the old
+    * contents, see llvmpipe_draw_vbo().
+    */
+   p_atomic_inc(&llvmpipe_screen(pipe->screen)->write_timestamp);
+}
+
+
 static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if ((transfer->usage & PIPE_MAP_WRITE) &&
+       (transfer->usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      check_mapped_constants(llvmpipe_context(pipe), transfer->resource);
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
 
    /* Effectively do the texture_update work here - if texture images
-    * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
+    * need post-processing to put them into hardware layout, this is
+    * where it happens.  For llvmpipe, that's only tiling.
     */
+   if (lpt->staging) {
+      if (transfer->usage & PIPE_MAP_WRITE) {
+         llvmpipe_tiled_copy(llvmpipe_resource(transfer->resource),
+                             transfer->level, &transfer->box, lpt->staging,
+                             transfer->stride, transfer->layer_stride, true);
+         llvmpipe_resource_drop_linear(llvmpipe_resource(transfer->resource));
+      }
+      FREE(lpt->staging);
+   }
+
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
    FREE(transfer);
@@ -845,6 +1097,172 @@ llvmpipe_is_resource_referenced(struct pipe_context *pipe,
 }
 
 
+/**
+ * Storage of a buffer which was replaced while scenes using it were in
+ * flight.
+ */
+struct lp_retired_storage
+{
+   void *data;
+   struct lp_fence *fence;   /**< last scene which may be using data */
+};
+
+
+/**
+ * Free the replaced buffer storage no scene can be using anymore, or
+ * all of it after waiting, if wait is set.
+ */
+void
+llvmpipe_release_retired_storage(struct llvmpipe_context *llvmpipe,
+                                 boolean wait)
+{
+   struct lp_retired_storage *retired =
+      util_dynarray_begin(&llvmpipe->retired_storage);
+   unsigned count = util_dynarray_num_elements(&llvmpipe->retired_storage,
+                                               struct lp_retired_storage);
+   unsigned kept = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      if (wait)
+         lp_fence_wait(retired[i].fence);
+
+      if (lp_fence_signalled(retired[i].fence)) {
+         align_free(retired[i].data);
+         lp_fence_reference(&retired[i].fence, NULL);
+      } else {
+         retired[kept++] = retired[i];
+      }
+   }
+
+   llvmpipe->retired_storage.size = kept * sizeof(*retired);
+}
+
+
+/**
+ * Make the bindings which hold on to a buffer's data pointer, rather
+ * than looking it up at draw time, use the buffer's current storage.
+ */
+static void
+rebind_buffer(struct llvmpipe_context *llvmpipe,
+              struct pipe_resource *buffer)
+{
+   const uint8_t *data = llvmpipe_resource(buffer)->data;
+
+   for (enum pipe_shader_type sh = 0; sh < PIPE_SHADER_TYPES; sh++) {
+      const boolean draw_stage = sh == PIPE_SHADER_VERTEX ||
+                                 sh == PIPE_SHADER_GEOMETRY ||
+                                 sh == PIPE_SHADER_TESS_CTRL ||
+                                 sh == PIPE_SHADER_TESS_EVAL;
+
+      for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->constants[sh]); i++) {
+         const struct pipe_constant_buffer *cb = &llvmpipe->constants[sh][i];
+         if (cb->buffer != buffer)
+            continue;
+
+         if (draw_stage)
+            draw_set_mapped_constant_buffer(llvmpipe->draw, sh, i,
+                                            data + cb->buffer_offset,
+                                            cb->buffer_size);
+         else if (sh == PIPE_SHADER_COMPUTE)
+            llvmpipe->cs_dirty |= LP_CSNEW_CONSTANTS;
+         else
+            llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
+      }
+
+      for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->ssbos[sh]); i++) {
+         const struct pipe_shader_buffer *sb = &llvmpipe->ssbos[sh][i];
+         if (sb->buffer != buffer)
+            continue;
+
+         if (draw_stage)
+            draw_set_mapped_shader_buffer(llvmpipe->draw, sh, i,
+                                          data + sb->buffer_offset,
+                                          sb->buffer_size);
+         else if (sh == PIPE_SHADER_COMPUTE)
+            llvmpipe->cs_dirty |= LP_CSNEW_SSBOS;
+         else
+            llvmpipe->dirty |= LP_NEW_FS_SSBOS;
+      }
+
+      /* The draw module looks up texel buffers and images at draw time */
+      if (draw_stage)
+         continue;
+
+      for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->sampler_views[sh]); i++) {
+         const struct pipe_sampler_view *view = llvmpipe->sampler_views[sh][i];
+         if (!view || view->texture != buffer)
+            continue;
+
+         if (sh == PIPE_SHADER_COMPUTE)
+            llvmpipe->cs_dirty |= LP_CSNEW_SAMPLER_VIEW;
+         else
+            llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+      }
+
+      for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->images[sh]); i++) {
+         if (llvmpipe->images[sh][i].resource != buffer)
+            continue;
+
+         if (sh == PIPE_SHADER_COMPUTE)
+            llvmpipe->cs_dirty |= LP_CSNEW_IMAGES;
+         else
+            llvmpipe->dirty |= LP_NEW_FS_IMAGES;
+      }
+   }
+
+   for (unsigned i = 0; i < llvmpipe->num_so_targets; i++) {
+      if (llvmpipe->so_targets[i] &&
+          llvmpipe->so_targets[i]->target.buffer == buffer)
+         llvmpipe->so_targets[i]->mapping = (void *)data;
+   }
+}
+
+
+/**
+ * Called by the threaded context to rename a buffer.  dst takes over
+ * src's storage, which src keeps pointing at for the unsynchronized
+ * maps the threaded context makes through it.  dst's old storage is
+ * freed once the scenes which may be reading it have been rasterized.
+ */
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_resource *lp_dst = llvmpipe_resource(dst);
+   struct llvmpipe_resource *lp_src = llvmpipe_resource(src);
+   void *old_data = lp_dst->data;
+
+   assert(dst->target == PIPE_BUFFER && src->target == PIPE_BUFFER);
+   assert(lp_dst->size_required == lp_src->size_required);
+   assert(!lp_dst->user_ptr && !lp_dst->imported_memory && !lp_dst->backable);
+   assert(!lp_dst->gave_storage && !lp_src->gave_storage);
+
+   if (lp_setup_is_resource_referenced(llvmpipe->setup, dst)) {
+      struct lp_retired_storage retired = { old_data, NULL };
+
+      /* Submit the scene being binned, so that the rasterizer's last
+       * fence covers all the scenes referencing the buffer.
+       */
+      llvmpipe_flush(pipe, (struct pipe_fence_handle **)&retired.fence,
+                     __func__);
+      util_dynarray_append(&llvmpipe->retired_storage,
+                           struct lp_retired_storage, retired);
+   } else {
+      align_free(old_data);
+   }
+
+   lp_dst->data = lp_src->data;
+   lp_src->gave_storage = true;
+
+   rebind_buffer(llvmpipe, dst);
+}
+
+
 /**
  * Returns the largest possible alignment for a format in llvmpipe
  */
@@ -901,6 +1319,8 @@ llvmpipe_user_buffer_create(struct pipe_screen *screen,
    buffer->base.array_size = 1;
    buffer->user_ptr = true;
    buffer->data = ptr;
+   threaded_resource_init(&buffer->base, false);
+   buffer->tbase.is_user_ptr = true;
 
    return &buffer->base;
 }
@@ -961,6 +1381,11 @@ llvmpipe_memory_barrier(struct pipe_context *pipe,
 {
    /* this may be an overly large hammer for this nut. */
    llvmpipe_finish(pipe, "barrier");
+
+   /* Makes shader and mapped writes visible to the draw module's vertex
+    * cache, see llvmpipe_draw_vbo().
+    */
+   p_atomic_inc(&llvmpipe_screen(pipe->screen)->write_timestamp);
 }
 
 
@@ -1210,7 +1635,7 @@ llvmpipe_init_context_resource_funcs(struct pipe_context *pipe)
    pipe->texture_map = llvmpipe_transfer_map;
    pipe->texture_unmap = llvmpipe_transfer_unmap;
 
-   pipe->transfer_flush_region = u_default_transfer_flush_region;
+   pipe->transfer_flush_region = llvmpipe_transfer_flush_region;
    pipe->buffer_subdata = u_default_buffer_subdata;
    pipe->texture_subdata = u_default_texture_subdata;
 
@@ -31,6 +31,7 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_threaded_context.h"
 #include "lp_limits.h"
 #ifdef DEBUG
 #include "util/list.h"
@@ -62,7 +63,13 @@ struct sw_displaytarget;
  */
 struct llvmpipe_resource
 {
-   struct pipe_resource base;
+   /* The threaded context expects resources to start with its own
+    * subclass of pipe_resource.
+    */
+   union {
+      struct pipe_resource base;
+      struct threaded_resource tbase;
+   };
 
    /** an extra screen pointer to avoid crashing in driver trace */
    struct llvmpipe_screen *screen;
@@ -93,6 +100,11 @@ struct llvmpipe_resource
    void *data;
 
    bool user_ptr;  /** Is this a user-space buffer? */
+   /**
+    * The data belongs to the buffer this one's storage was given to by
+    * llvmpipe_replace_buffer_storage().
+    */
+   bool gave_storage;
    unsigned timestamp;
 
    unsigned id;  /**< temporary, for debugging */
@@ -103,6 +115,14 @@ struct llvmpipe_resource
    uint64_t backing_offset;
    bool backable;
    bool imported_memory;
+
+   /** Stored in the tiled layout described in lp_bld_sample.h */
+   bool tiled;
+   /**
+    * Linear copy of a tiled texture for the draw module, whose shaders
+    * don't know the tiled layout.  Made on first use, dropped on writes.
+    */
+   struct llvmpipe_resource *linear_copy;
 #ifdef DEBUG
    struct list_head list;
 #endif
@@ -111,7 +131,10 @@ struct llvmpipe_resource
 
 struct llvmpipe_transfer
 {
-   struct pipe_transfer base;
+   struct threaded_transfer base;
+
+   /** Linear copy of the mapped box, for tiled textures */
+   void *staging;
 };
 
 
@@ -244,6 +267,10 @@ void *
 llvmpipe_resource_data(struct pipe_resource *resource);
 
 
+struct llvmpipe_resource *
+llvmpipe_resource_linear(struct llvmpipe_resource *lpr);
+
+
 unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
@@ -270,6 +297,18 @@ llvmpipe_is_resource_referenced(struct pipe_context *pipe,
 unsigned
 llvmpipe_get_format_alignment(enum pipe_format format);
 
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id);
+
+void
+llvmpipe_release_retired_storage(struct llvmpipe_context *llvmpipe,
+                                 boolean wait);
+
 
 void *
 llvmpipe_transfer_map_ms(struct pipe_context *pipe,
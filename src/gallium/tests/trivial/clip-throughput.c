@@ -0,0 +1,334 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures the triangle rate of the clipping and culling front end: a
+ * mesh of small triangles, half of them back facing and culled, of
+ * which a given percentage has a vertex behind the near plane and needs
+ * clipping.  The percentage is swept from 0 to 100.
+ *
+ * Each mesh is first drawn with a vertex shader which also writes a cull
+ * distance, which has the draw module clip and cull the triangles one at
+ * a time.  What the plain vertex shader draws is checked against that
+ * reference, and the program exits with 1 if they differ.
+ *
+ * Usage: clip-throughput [draws]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+
+#include "trivial-common.h"
+
+#define TARGET_SIZE 256
+#define CELLS 128
+#define NUM_TRIS (2 * CELLS * CELLS)
+
+struct program
+{
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *ref_vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+static void init_prog(struct program *p, struct pipe_screen *screen)
+{
+	struct pipe_resource tmplt;
+	struct pipe_surface surf_tmpl;
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+
+	p->pipe = screen->context_create(screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffer, rewritten for each percentage */
+	p->vbuf = pipe_buffer_create(screen, PIPE_BIND_VERTEX_BUFFER,
+	                             PIPE_USAGE_DEFAULT,
+	                             NUM_TRIS * 3 * 2 * 4 * sizeof(float));
+
+	/* render target */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = TARGET_SIZE;
+	tmplt.height0 = TARGET_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+	p->target = screen->resource_create(screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = tmplt.format;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = TARGET_SIZE;
+	p->framebuffer.height = TARGET_SIZE;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_BACK;
+	rasterizer.front_ccw = 1;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = TARGET_SIZE / 2.0f;
+	viewport.scale[1] = TARGET_SIZE / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = TARGET_SIZE / 2.0f;
+	viewport.translate[1] = TARGET_SIZE / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* the same, keeping every triangle by its cull distance */
+	p->ref_vs = trivial_create_vs(p->pipe,
+		"VERT\n"
+		"PROPERTY NUM_CULLDIST_ENABLED 1\n"
+		"DCL IN[0]\n"
+		"DCL IN[1]\n"
+		"DCL OUT[0], POSITION\n"
+		"DCL OUT[1], COLOR\n"
+		"DCL OUT[2], CULLDIST[0]\n"
+		"IMM[0] FLT32 { 1.0, 0.0, 0.0, 0.0 }\n"
+		"  0: MOV OUT[0], IN[0]\n"
+		"  1: MOV OUT[1], IN[1]\n"
+		"  2: MOV OUT[2].x, IMM[0].xxxx\n"
+		"  3: END\n");
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+	                                              TGSI_SEMANTIC_COLOR,
+	                                              TGSI_INTERPOLATE_PERSPECTIVE,
+	                                              TRUE);
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_vs_state(p->pipe, p->ref_vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+}
+
+/*
+ * Two triangles per grid cell, alternating between front and back facing
+ * cells.  Triangles are spread evenly over those crossing the near plane
+ * and those which don't.
+ */
+static void write_mesh(struct program *p, unsigned percent)
+{
+	const float size = 2.0f / CELLS;
+	struct pipe_transfer *transfer;
+	float (*vertices)[2][4];
+	unsigned n = 0;
+
+	vertices = pipe_buffer_map(p->pipe, p->vbuf, PIPE_MAP_WRITE, &transfer);
+	for (unsigned y = 0; y < CELLS; y++) {
+		for (unsigned x = 0; x < CELLS; x++) {
+			const float x0 = -1.0f + x * size, y0 = -1.0f + y * size;
+			const float corners[6][2] = {
+				{ x0, y0 }, { x0 + size, y0 }, { x0, y0 + size },
+				{ x0 + size, y0 }, { x0 + size, y0 + size }, { x0, y0 + size },
+			};
+			const bool back = (x + y) & 1;
+
+			for (unsigned t = 0; t < 2; t++, n++) {
+				const bool clipped = (n * 37 % 100) < percent;
+
+				for (unsigned v = 0; v < 3; v++) {
+					/* back facing triangles are wound clockwise */
+					const float *c = corners[t * 3 + (back ? 2 - v : v)];
+					float (*vertex)[4] = vertices[n * 3 + v];
+
+					vertex[0][0] = c[0];
+					vertex[0][1] = c[1];
+					vertex[0][2] = clipped && v == 0 ? -3.0f : 0.0f;
+					vertex[0][3] = 1.0f;
+					vertex[1][0] = (x % 7) / 6.0f;
+					vertex[1][1] = (y % 5) / 4.0f;
+					vertex[1][2] = t;
+					vertex[1][3] = 1.0f;
+				}
+			}
+		}
+	}
+	pipe_buffer_unmap(p->pipe, transfer);
+}
+
+/* Draw the mesh draws times, returning millions of triangles per second */
+static double run(struct program *p, unsigned draws)
+{
+	const union pipe_color_union clear_color = { .f = { 0.0f, 0.0f, 0.0f, 0.0f } };
+	int64_t start;
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, NULL, &clear_color, 1.0, 0);
+
+	start = os_time_get_nano();
+	for (unsigned n = 0; n < draws; n++) {
+		util_draw_vertex_buffer(p->pipe, p->cso,
+		                        p->vbuf, 0, 0,
+		                        PIPE_PRIM_TRIANGLES,
+		                        NUM_TRIS * 3, /* verts */
+		                        2);           /* attribs/vert */
+	}
+	trivial_finish(p->pipe);
+
+	return (double)draws * NUM_TRIS * 1e3 / (os_time_get_nano() - start);
+}
+
+int main(int argc, char** argv)
+{
+	static const unsigned percents[] = { 0, 10, 25, 50, 75, 100 };
+	unsigned draws = argc > 1 ? atoi(argv[1]) : 20;
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct program p;
+	bool ok = true;
+
+	if (!draws) {
+		fprintf(stderr, "usage: %s [draws]\n", argv[0]);
+		return 1;
+	}
+
+	screen = trivial_create_screen(&dev);
+	if (!screen)
+		return 1;
+
+	memset(&p, 0, sizeof(p));
+	init_prog(&p, screen);
+
+	for (unsigned i = 0; i < ARRAY_SIZE(percents); i++) {
+		uint64_t hash, ref;
+		char what[32];
+		double mtris;
+
+		write_mesh(&p, percents[i]);
+
+		cso_set_vertex_shader_handle(p.cso, p.ref_vs);
+		run(&p, 1);
+		ref = trivial_hash_resource(p.pipe, p.target, TRIVIAL_HASH_INIT);
+
+		cso_set_vertex_shader_handle(p.cso, p.vs);
+		/* warm up, compiling the shader variants */
+		run(&p, 1);
+		mtris = run(&p, draws);
+
+		hash = trivial_hash_resource(p.pipe, p.target, TRIVIAL_HASH_INIT);
+		printf("%3u%% clipped %8.2f Mtris/s  hash %016" PRIx64 "\n",
+		       percents[i], mtris, hash);
+		snprintf(what, sizeof(what), "%u%% clipped", percents[i]);
+		ok &= trivial_check(what, hash, ref);
+	}
+
+	close_prog(&p);
+
+	trivial_destroy_screen(dev, screen);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,493 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Checks and times the ways llvmpipe can get a new compute shader going:
+ *
+ *   compiled     LP_NUM_COMPILE_THREADS=0, compiling with optimizations
+ *                before the first launch
+ *   interpreted  LP_PERF=interp_only, interpreting, never compiling
+ *   tiered       LP_NUM_COMPILE_THREADS=1, interpreting until compiled in
+ *                the background
+ *
+ * Each is run on a screen of its own, overriding those variables.  For
+ * each shader a fresh compute state is created and launched, timing the
+ * first launch, which includes all the compiling done on the application
+ * thread.  Then the shader is launched repeatedly, printing the
+ * throughput of the first few launches and of the settled state.
+ *
+ * The shaders cover what the interpreter runs differently from the
+ * compiled code: nested loops left with break and continue, shared
+ * memory with barriers and atomics, and texel fetches.  The alu one
+ * sticks to operations rounded the same either way, leaving out those
+ * the interpreter takes from the C library.  What each writes is checked
+ * against the compiled run, and the program exits with 1 if they differ.
+ * A shader the interpreter can't run is compiled instead, which shows in
+ * its first launch time.
+ *
+ * Usage: cs-tiers [launches]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* u_box_2d */
+#include "util/u_box.h"
+/* u_sampler_view_default_template */
+#include "util/u_sampler.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* nir_builder_init_simple_shader */
+#include "compiler/nir/nir_builder.h"
+
+#include "trivial-common.h"
+
+/* Elements of the buffer the compute shaders write */
+#define NUM_ELEMENTS (1 << 18)
+#define BLOCK_SIZE 64
+#define TEX_SIZE 256
+/* Launches whose throughput is printed separately */
+#define EARLY_LAUNCHES 4
+
+static struct nir_shader *build_shared(struct pipe_screen *screen);
+
+static const struct {
+	const char *name;
+	/* TGSI, or NULL for shaders TGSI can't express */
+	const char *text;
+	struct nir_shader *(*build)(struct pipe_screen *screen);
+} cs_cases[] = {
+	{ "alu",
+	  "COMP\n"
+	  "DCL SV[0], THREAD_ID\n"
+	  "DCL SV[1], BLOCK_ID\n"
+	  "DCL BUFFER[0]\n"
+	  "DCL TEMP[0..1]\n"
+	  "IMM[0] UINT32 { 64, 4, 0, 0 }\n"
+	  "IMM[1] FLT32 { 0.001, 0.5, 3.0, 1000.0 }\n"
+	  "  0: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].xxxx, SV[0].xxxx\n"
+	  "  1: UMUL TEMP[0].y, TEMP[0].xxxx, IMM[0].yyyy\n"
+	  "  2: U2F TEMP[1].x, TEMP[0].xxxx\n"
+	  "  3: MUL TEMP[1].x, TEMP[1].xxxx, IMM[1].xxxx\n"
+	  "  4: SQRT TEMP[1].y, TEMP[1].xxxx\n"
+	  "  5: ADD TEMP[1].z, TEMP[1].yyyy, IMM[1].yyyy\n"
+	  "  6: DIV TEMP[1].x, TEMP[1].xxxx, TEMP[1].zzzz\n"
+	  "  7: MUL TEMP[1].x, TEMP[1].xxxx, IMM[1].zzzz\n"
+	  "  8: FRC TEMP[1].y, TEMP[1].xxxx\n"
+	  "  9: FLR TEMP[1].x, TEMP[1].xxxx\n"
+	  " 10: MAD TEMP[1].x, TEMP[1].yyyy, IMM[1].wwww, TEMP[1].xxxx\n"
+	  " 11: F2I TEMP[1].x, TEMP[1].xxxx\n"
+	  " 12: STORE BUFFER[0].x, TEMP[0].yyyy, TEMP[1].xxxx\n"
+	  " 13: END\n" },
+	/* trip counts differ between neighbouring invocations, and the inner
+	 * loop's between its iterations
+	 */
+	{ "loop",
+	  "COMP\n"
+	  "DCL SV[0], THREAD_ID\n"
+	  "DCL SV[1], BLOCK_ID\n"
+	  "DCL BUFFER[0]\n"
+	  "DCL TEMP[0..2]\n"
+	  "IMM[0] UINT32 { 64, 4, 7, 0 }\n"
+	  "IMM[1] UINT32 { 2654435761, 13, 1, 3 }\n"
+	  "IMM[2] UINT32 { 2, 2654435769, 4294967295, 0 }\n"
+	  "  0: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].xxxx, SV[0].xxxx\n"
+	  "  1: UMUL TEMP[0].y, TEMP[0].xxxx, IMM[0].yyyy\n"
+	  "  2: AND TEMP[0].z, TEMP[0].xxxx, IMM[0].zzzz\n"
+	  "  3: MOV TEMP[1].x, TEMP[0].xxxx\n"
+	  "  4: BGNLOOP\n"
+	  "  5:   USEQ TEMP[0].w, TEMP[0].zzzz, IMM[0].wwww\n"
+	  "  6:   UIF TEMP[0].wwww\n"
+	  "  7:     BRK\n"
+	  "  8:   ENDIF\n"
+	  "  9:   UADD TEMP[0].z, TEMP[0].zzzz, IMM[2].zzzz\n"
+	  " 10:   AND TEMP[2].x, TEMP[1].xxxx, IMM[1].wwww\n"
+	  " 11:   BGNLOOP\n"
+	  " 12:     USEQ TEMP[2].y, TEMP[2].xxxx, IMM[0].wwww\n"
+	  " 13:     UIF TEMP[2].yyyy\n"
+	  " 14:       BRK\n"
+	  " 15:     ENDIF\n"
+	  " 16:     UADD TEMP[2].x, TEMP[2].xxxx, IMM[2].zzzz\n"
+	  " 17:     UMUL TEMP[1].x, TEMP[1].xxxx, IMM[1].xxxx\n"
+	  " 18:     AND TEMP[2].y, TEMP[1].xxxx, IMM[1].zzzz\n"
+	  " 19:     UIF TEMP[2].yyyy\n"
+	  " 20:       CONT\n"
+	  " 21:     ENDIF\n"
+	  " 22:     USHR TEMP[2].z, TEMP[1].xxxx, IMM[1].yyyy\n"
+	  " 23:     XOR TEMP[1].x, TEMP[1].xxxx, TEMP[2].zzzz\n"
+	  " 24:   ENDLOOP\n"
+	  " 25:   AND TEMP[2].y, TEMP[1].xxxx, IMM[2].xxxx\n"
+	  " 26:   UIF TEMP[2].yyyy\n"
+	  " 27:     CONT\n"
+	  " 28:   ENDIF\n"
+	  " 29:   UADD TEMP[1].x, TEMP[1].xxxx, IMM[2].yyyy\n"
+	  " 30: ENDLOOP\n"
+	  " 31: STORE BUFFER[0].x, TEMP[0].yyyy, TEMP[1].xxxx\n"
+	  " 32: END\n" },
+	{ "shared", NULL, build_shared },
+	/* a texel of an rgba8 texture per invocation, packed into one value */
+	{ "txf",
+	  "COMP\n"
+	  "DCL SV[0], THREAD_ID\n"
+	  "DCL SV[1], BLOCK_ID\n"
+	  "DCL BUFFER[0]\n"
+	  "DCL SAMP[0]\n"
+	  "DCL SVIEW[0], 2D, UINT\n"
+	  "DCL TEMP[0..1]\n"
+	  "IMM[0] UINT32 { 64, 4, 255, 8 }\n"
+	  "IMM[1] UINT32 { 0, 256, 65536, 16777216 }\n"
+	  "  0: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].xxxx, SV[0].xxxx\n"
+	  "  1: UMUL TEMP[0].y, TEMP[0].xxxx, IMM[0].yyyy\n"
+	  "  2: AND TEMP[1].x, TEMP[0].xxxx, IMM[0].zzzz\n"
+	  "  3: USHR TEMP[1].y, TEMP[0].xxxx, IMM[0].wwww\n"
+	  "  4: AND TEMP[1].y, TEMP[1].yyyy, IMM[0].zzzz\n"
+	  "  5: MOV TEMP[1].zw, IMM[1].xxxx\n"
+	  "  6: TXF TEMP[1], TEMP[1], SAMP[0], 2D\n"
+	  "  7: UMAD TEMP[1].x, TEMP[1].yyyy, IMM[1].yyyy, TEMP[1].xxxx\n"
+	  "  8: UMAD TEMP[1].x, TEMP[1].zzzz, IMM[1].zzzz, TEMP[1].xxxx\n"
+	  "  9: UMAD TEMP[1].x, TEMP[1].wwww, IMM[1].wwww, TEMP[1].xxxx\n"
+	  " 10: STORE BUFFER[0].x, TEMP[0].yyyy, TEMP[1].xxxx\n"
+	  " 11: END\n" },
+};
+
+/* The ways to run the shaders, the first being the reference */
+static const struct {
+	const char *name;
+	const char *compile_threads;
+	/* LP_PERF, unset if NULL */
+	const char *perf;
+} tiers[] = {
+	{ "compiled", "0", NULL },
+	{ "interpreted", "0", "interp_only" },
+	{ "tiered", "1", NULL },
+};
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+
+	struct pipe_resource *buffer;
+	struct pipe_resource *tex;
+	struct pipe_sampler_view *view;
+	void *sampler;
+};
+
+/*
+ * Each invocation stores a value into shared memory, then after a barrier
+ * adds part of its neighbour's to one shared counter and maxes it into
+ * another.  After a second barrier it writes the neighbour's value mixed
+ * with both.
+ */
+static struct nir_shader *build_shared(struct pipe_screen *screen)
+{
+	const nir_shader_compiler_options *options =
+		screen->get_compiler_options(screen, PIPE_SHADER_IR_NIR,
+		                             PIPE_SHADER_COMPUTE);
+	const unsigned sum = BLOCK_SIZE * 4, max = sum + 4;
+	nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE,
+	                                               options, "shared");
+	nir_ssa_def *local, *global, *value, *n;
+
+	b.shader->info.workgroup_size[0] = BLOCK_SIZE;
+	b.shader->info.workgroup_size[1] = 1;
+	b.shader->info.workgroup_size[2] = 1;
+	b.shader->info.shared_size = max + 4;
+	b.shader->info.num_ssbos = 1;
+
+	local = nir_load_local_invocation_index(&b);
+	global = nir_iadd(&b, nir_imul_imm(&b, nir_channel(&b, nir_load_workgroup_id(&b, 32), 0),
+	                                   BLOCK_SIZE),
+	                  local);
+
+	value = nir_imul_imm(&b, nir_iadd_imm(&b, global, 1), 2654435761u);
+	nir_store_shared(&b, value, nir_imul_imm(&b, local, 4),
+	                 .base = 0, .align_mul = 4);
+	nir_push_if(&b, nir_ieq_imm(&b, local, 0));
+	{
+		nir_store_shared(&b, nir_imm_int(&b, 0), nir_imm_int(&b, sum),
+		                 .base = 0, .align_mul = 4);
+		nir_store_shared(&b, nir_imm_int(&b, 0), nir_imm_int(&b, max),
+		                 .base = 0, .align_mul = 4);
+	}
+	nir_pop_if(&b, NULL);
+
+	nir_scoped_barrier(&b, .execution_scope = NIR_SCOPE_WORKGROUP,
+	                   .memory_scope = NIR_SCOPE_WORKGROUP,
+	                   .memory_semantics = NIR_MEMORY_ACQ_REL,
+	                   .memory_modes = nir_var_mem_shared);
+
+	n = nir_load_shared(&b, 1, 32,
+	                    nir_imul_imm(&b, nir_iand_imm(&b, nir_iadd_imm(&b, local, 1),
+	                                                  BLOCK_SIZE - 1), 4),
+	                    .base = 0, .align_mul = 4);
+	nir_shared_atomic_add(&b, 32, nir_imm_int(&b, sum), nir_iand_imm(&b, n, 0xffff),
+	                      .base = 0);
+	nir_shared_atomic_umax(&b, 32, nir_imm_int(&b, max), n, .base = 0);
+
+	nir_scoped_barrier(&b, .execution_scope = NIR_SCOPE_WORKGROUP,
+	                   .memory_scope = NIR_SCOPE_WORKGROUP,
+	                   .memory_semantics = NIR_MEMORY_ACQ_REL,
+	                   .memory_modes = nir_var_mem_shared);
+
+	value = nir_ixor(&b, n, nir_load_shared(&b, 1, 32, nir_imm_int(&b, sum),
+	                                        .base = 0, .align_mul = 4));
+	value = nir_iadd(&b, value, nir_ushr_imm(&b, nir_load_shared(&b, 1, 32, nir_imm_int(&b, max),
+	                                                             .base = 0, .align_mul = 4), 7));
+	nir_store_ssbo(&b, value, nir_imm_int(&b, 0), nir_imul_imm(&b, global, 4),
+	               .write_mask = 0x1, .align_mul = 4);
+
+	/* as the state tracker would */
+	if (screen->finalize_nir)
+		free(screen->finalize_nir(screen, b.shader));
+
+	return b.shader;
+}
+
+static bool init_prog(struct program *p)
+{
+	struct pipe_shader_buffer sb;
+	struct pipe_sampler_state sampler;
+	struct pipe_sampler_view v_tmplt;
+	struct pipe_resource tmplt;
+	struct pipe_box box;
+	uint32_t *data;
+
+	p->screen = trivial_create_screen(&p->dev);
+	if (!p->screen)
+		return false;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+
+	/* buffer the compute shaders write */
+	p->buffer = pipe_buffer_create(p->screen, PIPE_BIND_SHADER_BUFFER,
+	                               PIPE_USAGE_DEFAULT, NUM_ELEMENTS * 4);
+
+	memset(&sb, 0, sizeof(sb));
+	sb.buffer = p->buffer;
+	sb.buffer_size = NUM_ELEMENTS * 4;
+	p->pipe->set_shader_buffers(p->pipe, PIPE_SHADER_COMPUTE, 0, 1, &sb, 1);
+
+	/* texture the txf shader reads, in a format the interpreter can */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_R8G8B8A8_UINT;
+	tmplt.width0 = TEX_SIZE;
+	tmplt.height0 = TEX_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_SAMPLER_VIEW;
+
+	p->tex = p->screen->resource_create(p->screen, &tmplt);
+
+	data = MALLOC(TEX_SIZE * TEX_SIZE * 4);
+	for (unsigned y = 0; y < TEX_SIZE; y++) {
+		for (unsigned x = 0; x < TEX_SIZE; x++)
+			data[y * TEX_SIZE + x] = (x * 0x9e3779b1) ^ (y * 0x85ebca6b);
+	}
+	u_box_2d(0, 0, TEX_SIZE, TEX_SIZE, &box);
+	p->pipe->texture_subdata(p->pipe, p->tex, 0, PIPE_MAP_WRITE, &box,
+	                         data, TEX_SIZE * 4, 0);
+	FREE(data);
+
+	u_sampler_view_default_template(&v_tmplt, p->tex, p->tex->format);
+	p->view = p->pipe->create_sampler_view(p->pipe, p->tex, &v_tmplt);
+	p->pipe->set_sampler_views(p->pipe, PIPE_SHADER_COMPUTE, 0, 1, 0, false, &p->view);
+
+	memset(&sampler, 0, sizeof(sampler));
+	sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+	sampler.min_img_filter = PIPE_TEX_FILTER_NEAREST;
+	sampler.mag_img_filter = PIPE_TEX_FILTER_NEAREST;
+	p->sampler = p->pipe->create_sampler_state(p->pipe, &sampler);
+	p->pipe->bind_sampler_states(p->pipe, PIPE_SHADER_COMPUTE, 0, 1, &p->sampler);
+
+	return true;
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->pipe) {
+		p->pipe->set_shader_buffers(p->pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL, 0);
+		p->pipe->set_sampler_views(p->pipe, PIPE_SHADER_COMPUTE, 0, 0, 1, false, NULL);
+		p->pipe->bind_sampler_states(p->pipe, PIPE_SHADER_COMPUTE, 0, 0, NULL);
+		p->pipe->delete_sampler_state(p->pipe, p->sampler);
+		pipe_sampler_view_reference(&p->view, NULL);
+		pipe_resource_reference(&p->tex, NULL);
+		pipe_resource_reference(&p->buffer, NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		trivial_destroy_screen(p->dev, p->screen);
+}
+
+static void dispatch(struct program *p)
+{
+	struct pipe_grid_info info;
+
+	memset(&info, 0, sizeof(info));
+	info.work_dim = 1;
+	info.block[0] = BLOCK_SIZE;
+	info.block[1] = 1;
+	info.block[2] = 1;
+	info.grid[0] = NUM_ELEMENTS / BLOCK_SIZE;
+	info.grid[1] = 1;
+	info.grid[2] = 1;
+
+	p->pipe->launch_grid(p->pipe, &info);
+}
+
+static double minvocations(int64_t ns, unsigned launches)
+{
+	return (double)NUM_ELEMENTS * launches * 1e3 / ns;
+}
+
+/* Run the shaders the tier's way, hashing what each writes */
+static bool run_tier(unsigned t, unsigned launches, uint64_t *hashes)
+{
+	const uint32_t zero = 0;
+	struct program *p;
+
+	setenv("LP_NUM_COMPILE_THREADS", tiers[t].compile_threads, 1);
+	if (tiers[t].perf)
+		setenv("LP_PERF", tiers[t].perf, 1);
+	else
+		unsetenv("LP_PERF");
+
+	p = CALLOC_STRUCT(program);
+	if (!init_prog(p)) {
+		close_prog(p);
+		FREE(p);
+		return false;
+	}
+
+	for (unsigned i = 0; i < ARRAY_SIZE(cs_cases); i++) {
+		struct pipe_compute_state state;
+		int64_t start, first, early;
+		void *cs;
+
+		memset(&state, 0, sizeof(state));
+		state.ir_type = PIPE_SHADER_IR_NIR;
+		state.prog = cs_cases[i].text ?
+			trivial_tgsi_to_nir(p->screen, cs_cases[i].text) :
+			cs_cases[i].build(p->screen);
+		if (!state.prog) {
+			fprintf(stderr, "failed to translate the %s shader\n",
+				cs_cases[i].name);
+			close_prog(p);
+			FREE(p);
+			return false;
+		}
+
+		/* clear what the previous shader or tier left */
+		p->pipe->clear_buffer(p->pipe, p->buffer, 0, NUM_ELEMENTS * 4,
+		                      &zero, sizeof(zero));
+
+		start = os_time_get_nano();
+		cs = p->pipe->create_compute_state(p->pipe, &state);
+		p->pipe->bind_compute_state(p->pipe, cs);
+		dispatch(p);
+		trivial_finish(p->pipe);
+		first = os_time_get_nano() - start;
+
+		start = os_time_get_nano();
+		for (unsigned n = 0; n < EARLY_LAUNCHES; n++)
+			dispatch(p);
+		trivial_finish(p->pipe);
+		early = os_time_get_nano() - start;
+
+		/* the rest, by when the background compiles should be done */
+		start = os_time_get_nano();
+		for (unsigned n = EARLY_LAUNCHES; n < launches; n++)
+			dispatch(p);
+		trivial_finish(p->pipe);
+
+		hashes[i] = trivial_hash_resource(p->pipe, p->buffer, TRIVIAL_HASH_INIT);
+
+		printf("%-11s %-6s first launch %8.2f ms  early %8.1f  settled %8.1f Minvocations/s  hash %016" PRIx64 "\n",
+		       tiers[t].name, cs_cases[i].name, first / 1e6,
+		       minvocations(early, EARLY_LAUNCHES),
+		       minvocations(os_time_get_nano() - start,
+				    launches - EARLY_LAUNCHES),
+		       hashes[i]);
+
+		p->pipe->bind_compute_state(p->pipe, NULL);
+		p->pipe->delete_compute_state(p->pipe, cs);
+	}
+
+	close_prog(p);
+	FREE(p);
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned launches = argc > 1 ? atoi(argv[1]) : 200;
+	uint64_t hashes[ARRAY_SIZE(tiers)][ARRAY_SIZE(cs_cases)];
+	bool ok = true;
+
+	if (launches <= EARLY_LAUNCHES) {
+		fprintf(stderr, "usage: %s [launches (> %u)]\n",
+			argv[0], EARLY_LAUNCHES);
+		return 1;
+	}
+
+	/* the first launch must not find the code in the disk cache */
+	setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+
+	for (unsigned t = 0; t < ARRAY_SIZE(tiers); t++) {
+		if (!run_tier(t, launches, hashes[t]))
+			return 1;
+	}
+
+	for (unsigned t = 1; t < ARRAY_SIZE(tiers); t++) {
+		for (unsigned i = 0; i < ARRAY_SIZE(cs_cases); i++) {
+			char what[32];
+
+			snprintf(what, sizeof(what), "%s %s",
+			         tiers[t].name, cs_cases[i].name);
+			ok &= trivial_check(what, hashes[t][i], hashes[0][i]);
+		}
+	}
+
+	return ok ? 0 : 1;
+}
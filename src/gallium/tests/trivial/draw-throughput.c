@@ -0,0 +1,309 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures the rate of small draws, each streaming its vertices into a
+ * buffer mapped with PIPE_MAP_DISCARD_WHOLE_RESOURCE and switching the
+ * blend state, as applications with many small objects do.  This is
+ * bound by the driver's CPU overhead rather than by rasterization.
+ *
+ * The draws are made on a context created without and with
+ * PIPE_CONTEXT_PREFER_THREADED, and GALLIUM_THREAD set, which puts
+ * drivers supporting it behind a u_threaded_context.  What the threaded
+ * context draws is checked against the direct one, the reference, and the
+ * program exits with 1 if they differ.
+ *
+ * Usage: draw-throughput [draws]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+
+#include "trivial-common.h"
+
+#define TARGET_SIZE 256
+#define QUAD_SIZE 16
+
+struct program
+{
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_blend_state blend[2];
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+static void init_prog(struct program *p, struct pipe_screen *screen,
+                      bool threaded)
+{
+	struct pipe_resource tmplt;
+	struct pipe_surface surf_tmpl;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+
+	p->pipe = screen->context_create(screen, NULL,
+	                                 threaded ? PIPE_CONTEXT_PREFER_THREADED : 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffer, rewritten for each quad */
+	p->vbuf = pipe_buffer_create(screen, PIPE_BIND_VERTEX_BUFFER,
+	                             PIPE_USAGE_STREAM, 4 * 2 * 4 * sizeof(float));
+
+	/* render target */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = TARGET_SIZE;
+	tmplt.height0 = TARGET_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+	p->target = screen->resource_create(screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = tmplt.format;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = TARGET_SIZE;
+	p->framebuffer.height = TARGET_SIZE;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* replace, and add to what's there */
+	memset(p->blend, 0, sizeof(p->blend));
+	p->blend[0].rt[0].colormask = PIPE_MASK_RGBA;
+	p->blend[1].rt[0].colormask = PIPE_MASK_RGBA;
+	p->blend[1].rt[0].blend_enable = 1;
+	p->blend[1].rt[0].rgb_func = PIPE_BLEND_ADD;
+	p->blend[1].rt[0].rgb_src_factor = PIPE_BLENDFACTOR_ONE;
+	p->blend[1].rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_ONE;
+	p->blend[1].rt[0].alpha_func = PIPE_BLEND_ADD;
+	p->blend[1].rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+	p->blend[1].rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ONE;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = TARGET_SIZE / 2.0f;
+	viewport.scale[1] = TARGET_SIZE / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = TARGET_SIZE / 2.0f;
+	viewport.translate[1] = TARGET_SIZE / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+	                                              TGSI_SEMANTIC_COLOR,
+	                                              TGSI_INTERPOLATE_PERSPECTIVE,
+	                                              TRUE);
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+}
+
+/* Write quad n, with a colour depending on n, into the vertex buffer */
+static void write_quad(struct program *p, unsigned n)
+{
+	const unsigned per_row = TARGET_SIZE / QUAD_SIZE;
+	const float size = 2.0f * QUAD_SIZE / TARGET_SIZE;
+	const float x0 = -1.0f + (n % per_row) * size;
+	const float y0 = -1.0f + (n / per_row % per_row) * size;
+	const float corners[4][2] = {
+		{ x0, y0 }, { x0 + size, y0 }, { x0 + size, y0 + size }, { x0, y0 + size },
+	};
+	struct pipe_transfer *transfer;
+	float (*vertices)[2][4];
+
+	vertices = pipe_buffer_map(p->pipe, p->vbuf,
+	                           PIPE_MAP_WRITE | PIPE_MAP_DISCARD_WHOLE_RESOURCE,
+	                           &transfer);
+	for (unsigned v = 0; v < 4; v++) {
+		vertices[v][0][0] = corners[v][0];
+		vertices[v][0][1] = corners[v][1];
+		vertices[v][0][2] = 0.0f;
+		vertices[v][0][3] = 1.0f;
+		vertices[v][1][0] = (n % 7) / 64.0f;
+		vertices[v][1][1] = (n % 5) / 64.0f;
+		vertices[v][1][2] = (n % 3) / 64.0f;
+		vertices[v][1][3] = 1.0f / 64.0f;
+	}
+	pipe_buffer_unmap(p->pipe, transfer);
+}
+
+/* Make draws draws, returning thousands of draws per second */
+static double run(struct program *p, unsigned draws)
+{
+	const union pipe_color_union clear_color = { .f = { 0.0f, 0.0f, 0.0f, 0.0f } };
+	int64_t start;
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, NULL, &clear_color, 1.0, 0);
+
+	start = os_time_get_nano();
+	for (unsigned n = 0; n < draws; n++) {
+		write_quad(p, n);
+		cso_set_blend(p->cso, &p->blend[n / 3 % 2]);
+		util_draw_vertex_buffer(p->pipe, p->cso,
+		                        p->vbuf, 0, 0,
+		                        PIPE_PRIM_QUADS,
+		                        4,  /* verts */
+		                        2); /* attribs/vert */
+	}
+	trivial_finish(p->pipe);
+
+	return draws * 1e6 / (os_time_get_nano() - start);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned draws = argc > 1 ? atoi(argv[1]) : 100000;
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	uint64_t ref = 0;
+	bool ok = true;
+
+	if (!draws) {
+		fprintf(stderr, "usage: %s [draws]\n", argv[0]);
+		return 1;
+	}
+
+	screen = trivial_create_screen(&dev);
+	if (!screen)
+		return 1;
+
+	for (unsigned threaded = 0; threaded < 2; threaded++) {
+		struct program p;
+		uint64_t hash;
+		double kdraws;
+
+		if (threaded)
+			setenv("GALLIUM_THREAD", "1", 1);
+
+		memset(&p, 0, sizeof(p));
+		init_prog(&p, screen, threaded);
+
+		/* warm up, compiling the shader variants */
+		run(&p, 64);
+		kdraws = run(&p, draws);
+
+		hash = trivial_hash_resource(p.pipe, p.target, TRIVIAL_HASH_INIT);
+		printf("%-10s %8.1f kdraws/s  hash %016" PRIx64 "\n",
+		       threaded ? "threaded" : "direct", kdraws, hash);
+		if (threaded)
+			ok &= trivial_check("threaded", hash, ref);
+		else
+			ref = hash;
+
+		close_prog(&p);
+	}
+
+	trivial_destroy_screen(dev, screen);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,469 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures the rate of drawing textured quads into render targets of
+ * various formats, as a compositor does, to exercise llvmpipe's linear
+ * rasterizer.  Each format is drawn with and without a depth buffer
+ * bound; llvmpipe only uses the linear rasterizer without, so the second
+ * is the reference.  Both are read back and the largest difference of
+ * any channel, in 8 bit units, is printed.
+ *
+ * Usage: linear-formats [target size [frames]]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_format_read_4ub */
+#include "util/format/u_format.h"
+/* u_box_2d */
+#include "util/u_box.h"
+/* u_sampler_view_default_template */
+#include "util/u_sampler.h"
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_vertex_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* ureg_* for the fragment shader */
+#include "tgsi/tgsi_ureg.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+#include "trivial-common.h"
+
+#define TEX_SIZE 256
+
+static const enum pipe_format target_formats[] = {
+	PIPE_FORMAT_B8G8R8A8_UNORM,
+	PIPE_FORMAT_B8G8R8X8_UNORM,
+	PIPE_FORMAT_R8G8B8A8_UNORM,
+	PIPE_FORMAT_R8G8B8X8_UNORM,
+	PIPE_FORMAT_B5G6R5_UNORM,
+	PIPE_FORMAT_R10G10B10A2_UNORM,
+	PIPE_FORMAT_B10G10R10A2_UNORM,
+};
+
+static const enum pipe_format tex_formats[] = {
+	PIPE_FORMAT_B8G8R8A8_UNORM,
+	PIPE_FORMAT_R8G8B8A8_UNORM,
+};
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_sampler_state sampler;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+	struct pipe_resource *depth;
+	struct pipe_resource *tex;
+	struct pipe_sampler_view *view;
+};
+
+static bool init_prog(struct program *p)
+{
+	p->screen = trivial_create_screen(&p->dev);
+	if (!p->screen)
+		return false;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffer, a quad covering the render target */
+	{
+		const float vertices[4][2][4] = {
+			{ { -1.0f, -1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+			{ {  1.0f, -1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+			{ {  1.0f,  1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+			{ { -1.0f,  1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+		};
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+					     PIPE_USAGE_DEFAULT, sizeof(vertices));
+		pipe_buffer_write(p->pipe, p->vbuf, 0, sizeof(vertices), vertices);
+	}
+
+	/* bilinear filtering, no mipmaps */
+	memset(&p->sampler, 0, sizeof(p->sampler));
+	p->sampler.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+	p->sampler.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+	p->sampler.wrap_r = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+	p->sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+	p->sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+	p->sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader, with the perspective correct texcoord
+	 * interpolation the linear rasterizer wants
+	 */
+	{
+		struct ureg_program *ureg = ureg_create(PIPE_SHADER_FRAGMENT);
+		struct ureg_src sampler, tex;
+		struct ureg_dst out;
+
+		sampler = ureg_DECL_sampler(ureg, 0);
+		ureg_DECL_sampler_view(ureg, 0, TGSI_TEXTURE_2D,
+		                       TGSI_RETURN_TYPE_FLOAT, TGSI_RETURN_TYPE_FLOAT,
+		                       TGSI_RETURN_TYPE_FLOAT, TGSI_RETURN_TYPE_FLOAT);
+		tex = ureg_DECL_fs_input(ureg, TGSI_SEMANTIC_GENERIC, 0,
+		                         TGSI_INTERPOLATE_PERSPECTIVE);
+		out = ureg_DECL_output(ureg, TGSI_SEMANTIC_COLOR, 0);
+		ureg_TEX(ureg, out, TGSI_TEXTURE_2D, tex, sampler);
+		ureg_END(ureg);
+
+		p->fs = ureg_create_shader_and_destroy(ureg, p->pipe);
+	}
+
+	return true;
+}
+
+/* (Re)create the texture with premultiplied alpha contents */
+static void init_texture(struct program *p, enum pipe_format format)
+{
+	struct pipe_resource tmplt;
+	struct pipe_sampler_view v_tmplt;
+	struct pipe_box box;
+	uint8_t *data;
+
+	pipe_sampler_view_reference(&p->view, NULL);
+	pipe_resource_reference(&p->tex, NULL);
+
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = format;
+	tmplt.width0 = TEX_SIZE;
+	tmplt.height0 = TEX_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_SAMPLER_VIEW;
+
+	p->tex = p->screen->resource_create(p->screen, &tmplt);
+
+	data = MALLOC(TEX_SIZE * TEX_SIZE * 4);
+	for (unsigned y = 0; y < TEX_SIZE; y++) {
+		for (unsigned x = 0; x < TEX_SIZE; x++) {
+			uint8_t *texel = &data[(y * TEX_SIZE + x) * 4];
+			const uint32_t bits = (x * 0x9e3779b1) ^ (y * 0x85ebca6b);
+			const unsigned alpha = (x + y) & 0xff;
+
+			for (unsigned c = 0; c < 3; c++)
+				texel[c] = ((bits >> (c * 8)) & 0xff) * alpha / 255;
+			texel[3] = alpha;
+		}
+	}
+	u_box_2d(0, 0, TEX_SIZE, TEX_SIZE, &box);
+	p->pipe->texture_subdata(p->pipe, p->tex, 0, PIPE_MAP_WRITE, &box,
+	                         data, TEX_SIZE * 4, 0);
+	FREE(data);
+
+	u_sampler_view_default_template(&v_tmplt, p->tex, p->tex->format);
+	p->view = p->pipe->create_sampler_view(p->pipe, p->tex, &v_tmplt);
+}
+
+/* (Re)create the render target, and the depth buffer if asked for */
+static void init_target(struct program *p, enum pipe_format format,
+                        unsigned size, bool depth)
+{
+	struct pipe_resource tmplt;
+	struct pipe_surface surf_tmpl;
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_surface_reference(&p->framebuffer.zsbuf, NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->depth, NULL);
+
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = format;
+	tmplt.width0 = size;
+	tmplt.height0 = size;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+	p->target = p->screen->resource_create(p->screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = format;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = size;
+	p->framebuffer.height = size;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	if (depth) {
+		tmplt.format = PIPE_FORMAT_Z32_FLOAT;
+		tmplt.bind = PIPE_BIND_DEPTH_STENCIL;
+		p->depth = p->screen->resource_create(p->screen, &tmplt);
+
+		surf_tmpl.format = tmplt.format;
+		p->framebuffer.zsbuf = p->pipe->create_surface(p->pipe, p->depth, &surf_tmpl);
+	}
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->cso) {
+		cso_destroy_context(p->cso);
+
+		p->pipe->delete_vs_state(p->pipe, p->vs);
+		p->pipe->delete_fs_state(p->pipe, p->fs);
+
+		pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+		pipe_surface_reference(&p->framebuffer.zsbuf, NULL);
+		pipe_sampler_view_reference(&p->view, NULL);
+		pipe_resource_reference(&p->target, NULL);
+		pipe_resource_reference(&p->depth, NULL);
+		pipe_resource_reference(&p->tex, NULL);
+		pipe_resource_reference(&p->vbuf, NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		trivial_destroy_screen(p->dev, p->screen);
+}
+
+/* Copy, or blend the premultiplied texture over the render target */
+static void set_state(struct program *p, unsigned size, bool over)
+{
+	const struct pipe_sampler_state *samplers[] = {&p->sampler};
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+	if (over) {
+		blend.rt[0].blend_enable = 1;
+		blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+		blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_ONE;
+		blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+		blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+		blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+		blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+	}
+
+	/* a depth buffer may be bound, but isn't used */
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = size / 2.0f;
+	viewport.scale[1] = size / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = size / 2.0f;
+	viewport.translate[1] = size / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_samplers(p->cso, PIPE_SHADER_FRAGMENT, 1, samplers);
+	p->pipe->set_sampler_views(p->pipe, PIPE_SHADER_FRAGMENT, 0, 1, 0, false, &p->view);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+}
+
+static void draw(struct program *p)
+{
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_QUADS,
+	                        4,  /* verts */
+	                        2); /* attribs/vert */
+}
+
+/* Clear the render target, then draw frames quads, returning Mpixels/s */
+static double run(struct program *p, unsigned size, unsigned frames)
+{
+	const union pipe_color_union clear_color = { .f = { 0.2f, 0.4f, 0.6f, 0.8f } };
+	int64_t start;
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR | (p->depth ? PIPE_CLEAR_DEPTH : 0),
+	               NULL, &clear_color, 1.0, 0);
+
+	/* warm up, compiling the shader variant */
+	draw(p);
+	trivial_finish(p->pipe);
+
+	start = os_time_get_nano();
+	/* flushing each frame, as llvmpipe would otherwise only rasterize
+	 * the last of the opaque quads
+	 */
+	for (unsigned n = 0; n < frames; n++) {
+		draw(p);
+		p->pipe->flush(p->pipe, NULL, 0);
+	}
+	trivial_finish(p->pipe);
+
+	return (double)size * size * frames * 1e3 / (os_time_get_nano() - start);
+}
+
+/* Read back the render target as rgba8 */
+static uint8_t *read_target(struct program *p, unsigned size)
+{
+	struct pipe_transfer *transfer;
+	struct pipe_box box;
+	uint8_t *pixels = MALLOC(size * size * 4);
+	const void *map;
+
+	u_box_2d(0, 0, size, size, &box);
+	map = p->pipe->texture_map(p->pipe, p->target, 0, PIPE_MAP_READ, &box, &transfer);
+	util_format_read_4ub(p->target->format, pixels, size * 4,
+	                     map, transfer->stride, 0, 0, size, size);
+	p->pipe->texture_unmap(p->pipe, transfer);
+
+	return pixels;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned size = argc > 1 ? atoi(argv[1]) : 512;
+	unsigned frames = argc > 2 ? atoi(argv[2]) : 50;
+	struct program *p;
+
+	if (!size || !frames) {
+		fprintf(stderr, "usage: %s [target size [frames]]\n", argv[0]);
+		return 1;
+	}
+
+	p = CALLOC_STRUCT(program);
+	if (!init_prog(p)) {
+		close_prog(p);
+		FREE(p);
+		return 1;
+	}
+
+	for (unsigned t = 0; t < ARRAY_SIZE(tex_formats); t++) {
+		init_texture(p, tex_formats[t]);
+
+		for (unsigned f = 0; f < ARRAY_SIZE(target_formats); f++) {
+			const enum pipe_format format = target_formats[f];
+
+			if (!p->screen->is_format_supported(p->screen, format,
+			                                    PIPE_TEXTURE_2D, 0, 0,
+			                                    PIPE_BIND_RENDER_TARGET))
+				continue;
+
+			for (unsigned over = 0; over < 2; over++) {
+				double mpix[2];
+				uint8_t *pixels[2];
+				unsigned max_diff = 0;
+
+				/* without and with a depth buffer */
+				for (unsigned depth = 0; depth < 2; depth++) {
+					init_target(p, format, size, depth);
+					set_state(p, size, over);
+					mpix[depth] = run(p, size, frames);
+					pixels[depth] = read_target(p, size);
+				}
+
+				for (unsigned i = 0; i < size * size * 4; i++) {
+					const int diff = pixels[0][i] - pixels[1][i];
+					max_diff = MAX2(max_diff, (unsigned)abs(diff));
+				}
+
+				printf("%-8s -> %-18s %-5s %8.1f Mpixels/s (%8.1f with depth buffer)  max diff %u\n",
+				       util_format_short_name(tex_formats[t]),
+				       util_format_short_name(format),
+				       over ? "over" : "copy", mpix[0], mpix[1], max_diff);
+
+				FREE(pixels[0]);
+				FREE(pixels[1]);
+			}
+		}
+	}
+
+	close_prog(p);
+	FREE(p);
+
+	return 0;
+}
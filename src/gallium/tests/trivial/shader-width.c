@@ -0,0 +1,656 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures fragment and compute shader throughput for different kinds of
+ * shaders, to compare the SIMD widths llvmpipe can run them at.
+ *
+ * Each fragment shader is run over a quad covering the render target, and
+ * each compute shader once per element of a large buffer.  The shaders are
+ * translated to NIR first, as the state tracker would.  Run it with
+ * LP_NATIVE_VECTOR_WIDTH=512 to measure 16 wide execution.
+ *
+ * As the vector width is chosen once per process, the shaders are first
+ * run in a child process at the 256 bit reference width.  What they draw
+ * and compute is checked against that, and the program exits with 1 if
+ * they differ.
+ *
+ * Usage: shader-width [target size [frames]]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* u_box_2d */
+#include "util/u_box.h"
+/* u_sampler_view_default_template */
+#include "util/u_sampler.h"
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_vertex_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+
+#include "trivial-common.h"
+
+#define TEX_SIZE 256
+/* Elements of the buffer the compute shaders write */
+#define NUM_ELEMENTS (1 << 20)
+#define BLOCK_SIZE 64
+/* LP_NATIVE_VECTOR_WIDTH of the reference run */
+#define REF_VECTOR_WIDTH "256"
+
+static const struct {
+	const char *name;
+	const char *text;
+	bool depth_blend;
+} fs_cases[] = {
+	{ "color",
+	  "FRAG\n"
+	  "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+	  "DCL OUT[0], COLOR\n"
+	  "  0: MOV OUT[0], IN[0]\n"
+	  "  1: END\n", false },
+	{ "texture",
+	  "FRAG\n"
+	  "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+	  "DCL OUT[0], COLOR\n"
+	  "DCL SAMP[0]\n"
+	  "DCL SVIEW[0], 2D, FLOAT\n"
+	  "  0: TEX OUT[0], IN[0], SAMP[0], 2D\n"
+	  "  1: END\n", false },
+	{ "alu",
+	  "FRAG\n"
+	  "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+	  "DCL OUT[0], COLOR\n"
+	  "DCL TEMP[0..1]\n"
+	  "IMM[0] FLT32 { 6.2831855, 0.5, 0.25, 1.5 }\n"
+	  "  0: MUL TEMP[0], IN[0].xyyx, IMM[0].xxxx\n"
+	  "  1: SIN TEMP[1].x, TEMP[0].xxxx\n"
+	  "  2: COS TEMP[1].y, TEMP[0].yyyy\n"
+	  "  3: MAD TEMP[0], TEMP[1].xyxy, TEMP[0].wzyx, IMM[0].yzyz\n"
+	  "  4: SIN TEMP[1].z, TEMP[0].zzzz\n"
+	  "  5: COS TEMP[1].w, TEMP[0].wwww\n"
+	  "  6: MAD TEMP[0], TEMP[1], TEMP[0], IMM[0].wwww\n"
+	  "  7: RSQ TEMP[1].x, |TEMP[0].xxxx|\n"
+	  "  8: EX2 TEMP[1].y, TEMP[0].yyyy\n"
+	  "  9: LG2 TEMP[1].z, |TEMP[0].zzzz|\n"
+	  " 10: FRC TEMP[1].w, TEMP[0].wwww\n"
+	  " 11: MAD_SAT OUT[0], TEMP[1], IMM[0].zzzz, IMM[0].yyyy\n"
+	  " 12: END\n", false },
+	/* trip count differs between the pixels of a quad */
+	{ "loop",
+	  "FRAG\n"
+	  "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+	  "DCL OUT[0], COLOR\n"
+	  "DCL TEMP[0..1]\n"
+	  "IMM[0] FLT32 { 61.0, 1.0, 0.0, 0.75 }\n"
+	  "  0: MUL TEMP[0].x, IN[0].xxxx, IMM[0].xxxx\n"
+	  "  1: MOV TEMP[0].y, IMM[0].zzzz\n"
+	  "  2: MOV TEMP[1], IN[0]\n"
+	  "  3: BGNLOOP\n"
+	  "  4:   SGE TEMP[0].z, TEMP[0].yyyy, TEMP[0].xxxx\n"
+	  "  5:   IF TEMP[0].zzzz\n"
+	  "  6:     BRK\n"
+	  "  7:   ENDIF\n"
+	  "  8:   MAD TEMP[1], TEMP[1].yzwx, IMM[0].wwww, TEMP[1]\n"
+	  "  9:   FRC TEMP[1], TEMP[1]\n"
+	  " 10:   ADD TEMP[0].y, TEMP[0].yyyy, IMM[0].yyyy\n"
+	  " 11: ENDLOOP\n"
+	  " 12: MOV OUT[0], TEMP[1]\n"
+	  " 13: END\n", false },
+	/* discards a checkerboard of 3x3 pixel squares */
+	{ "kill",
+	  "FRAG\n"
+	  "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+	  "DCL OUT[0], COLOR\n"
+	  "DCL TEMP[0]\n"
+	  "IMM[0] FLT32 { 85.333336, -0.5, 0.0, 0.0 }\n"
+	  "  0: MUL TEMP[0], IN[0].xyxy, IMM[0].xxxx\n"
+	  "  1: FRC TEMP[0], TEMP[0]\n"
+	  "  2: ADD TEMP[0], TEMP[0], IMM[0].yyyy\n"
+	  "  3: MUL TEMP[0].x, TEMP[0].xxxx, TEMP[0].yyyy\n"
+	  "  4: KILL_IF TEMP[0].xxxx\n"
+	  "  5: MOV OUT[0], IN[0]\n"
+	  "  6: END\n", false },
+	{ "depth+blend",
+	  "FRAG\n"
+	  "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+	  "DCL OUT[0], COLOR\n"
+	  "  0: MOV OUT[0], IN[0].yxzw\n"
+	  "  1: END\n", true },
+};
+
+static const struct {
+	const char *name;
+	const char *text;
+} cs_cases[] = {
+	{ "alu",
+	  "COMP\n"
+	  "DCL SV[0], THREAD_ID\n"
+	  "DCL SV[1], BLOCK_ID\n"
+	  "DCL BUFFER[0]\n"
+	  "DCL TEMP[0..1]\n"
+	  "IMM[0] UINT32 { 64, 4, 0, 0 }\n"
+	  "IMM[1] FLT32 { 0.001, 0.5, 0.25, 1000.0 }\n"
+	  "  0: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].xxxx, SV[0].xxxx\n"
+	  "  1: UMUL TEMP[0].y, TEMP[0].xxxx, IMM[0].yyyy\n"
+	  "  2: U2F TEMP[1].x, TEMP[0].xxxx\n"
+	  "  3: MUL TEMP[1].x, TEMP[1].xxxx, IMM[1].xxxx\n"
+	  "  4: SIN TEMP[1].y, TEMP[1].xxxx\n"
+	  "  5: COS TEMP[1].z, TEMP[1].xxxx\n"
+	  "  6: MAD TEMP[1].x, TEMP[1].yyyy, TEMP[1].zzzz, IMM[1].yyyy\n"
+	  "  7: EX2 TEMP[1].y, TEMP[1].xxxx\n"
+	  "  8: MAD TEMP[1].x, TEMP[1].yyyy, TEMP[1].xxxx, IMM[1].zzzz\n"
+	  "  9: MUL TEMP[1].x, TEMP[1].xxxx, IMM[1].wwww\n"
+	  " 10: F2I TEMP[1].x, TEMP[1].xxxx\n"
+	  " 11: STORE BUFFER[0].x, TEMP[0].yyyy, TEMP[1].xxxx\n"
+	  " 12: END\n" },
+	/* trip count differs between neighbouring invocations */
+	{ "loop",
+	  "COMP\n"
+	  "DCL SV[0], THREAD_ID\n"
+	  "DCL SV[1], BLOCK_ID\n"
+	  "DCL BUFFER[0]\n"
+	  "DCL TEMP[0..1]\n"
+	  "IMM[0] UINT32 { 64, 4, 31, 0 }\n"
+	  "IMM[1] UINT32 { 2654435761, 13, 4294967295, 0 }\n"
+	  "  0: UMAD TEMP[0].x, SV[1].xxxx, IMM[0].xxxx, SV[0].xxxx\n"
+	  "  1: UMUL TEMP[0].y, TEMP[0].xxxx, IMM[0].yyyy\n"
+	  "  2: AND TEMP[0].z, TEMP[0].xxxx, IMM[0].zzzz\n"
+	  "  3: MOV TEMP[1].x, TEMP[0].xxxx\n"
+	  "  4: BGNLOOP\n"
+	  "  5:   USEQ TEMP[0].w, TEMP[0].zzzz, IMM[0].wwww\n"
+	  "  6:   UIF TEMP[0].wwww\n"
+	  "  7:     BRK\n"
+	  "  8:   ENDIF\n"
+	  "  9:   UMUL TEMP[1].x, TEMP[1].xxxx, IMM[1].xxxx\n"
+	  " 10:   USHR TEMP[1].y, TEMP[1].xxxx, IMM[1].yyyy\n"
+	  " 11:   XOR TEMP[1].x, TEMP[1].xxxx, TEMP[1].yyyy\n"
+	  " 12:   UADD TEMP[0].z, TEMP[0].zzzz, IMM[1].zzzz\n"
+	  " 13: ENDLOOP\n"
+	  " 14: STORE BUFFER[0].x, TEMP[0].yyyy, TEMP[1].xxxx\n"
+	  " 15: END\n" },
+};
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_sampler_state sampler;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs[ARRAY_SIZE(fs_cases)];
+	void *cs[ARRAY_SIZE(cs_cases)];
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+	struct pipe_resource *zbuf;
+	struct pipe_resource *tex;
+	struct pipe_resource *buffer;
+	struct pipe_sampler_view *view;
+};
+
+static bool init_prog(struct program *p, unsigned target_size)
+{
+	struct pipe_resource tmplt;
+	struct pipe_sampler_view v_tmplt;
+	struct pipe_surface surf_tmpl;
+	struct pipe_box box;
+	uint32_t *data;
+
+	p->screen = trivial_create_screen(&p->dev);
+	if (!p->screen)
+		return false;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffer, a quad covering the render target with its depth
+	 * sloping along x
+	 */
+	{
+		const float vertices[4][2][4] = {
+			{ { -1.0f, -1.0f, -0.5f, 1.0f }, { 0.0f, 0.0f, 0.2f, 0.5f } },
+			{ {  1.0f, -1.0f,  0.5f, 1.0f }, { 1.0f, 0.0f, 0.4f, 0.5f } },
+			{ {  1.0f,  1.0f,  0.5f, 1.0f }, { 1.0f, 1.0f, 0.6f, 0.5f } },
+			{ { -1.0f,  1.0f, -0.5f, 1.0f }, { 0.0f, 1.0f, 0.8f, 0.5f } },
+		};
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+		                             PIPE_USAGE_DEFAULT, sizeof(vertices));
+		pipe_buffer_write(p->pipe, p->vbuf, 0, sizeof(vertices), vertices);
+	}
+
+	/* bilinear filtering, no mipmaps */
+	memset(&p->sampler, 0, sizeof(p->sampler));
+	p->sampler.wrap_s = PIPE_TEX_WRAP_REPEAT;
+	p->sampler.wrap_t = PIPE_TEX_WRAP_REPEAT;
+	p->sampler.wrap_r = PIPE_TEX_WRAP_REPEAT;
+	p->sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+	p->sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+	p->sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* texture */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = TEX_SIZE;
+	tmplt.height0 = TEX_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_SAMPLER_VIEW;
+
+	p->tex = p->screen->resource_create(p->screen, &tmplt);
+
+	data = MALLOC(TEX_SIZE * TEX_SIZE * 4);
+	for (unsigned y = 0; y < TEX_SIZE; y++) {
+		for (unsigned x = 0; x < TEX_SIZE; x++)
+			data[y * TEX_SIZE + x] = (x * 0x9e3779b1) ^ (y * 0x85ebca6b);
+	}
+	u_box_2d(0, 0, TEX_SIZE, TEX_SIZE, &box);
+	p->pipe->texture_subdata(p->pipe, p->tex, 0, PIPE_MAP_WRITE, &box,
+	                         data, TEX_SIZE * 4, 0);
+	FREE(data);
+
+	u_sampler_view_default_template(&v_tmplt, p->tex, p->tex->format);
+	p->view = p->pipe->create_sampler_view(p->pipe, p->tex, &v_tmplt);
+
+	/* render target and depth buffer */
+	tmplt.width0 = target_size;
+	tmplt.height0 = target_size;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+	p->target = p->screen->resource_create(p->screen, &tmplt);
+
+	tmplt.format = PIPE_FORMAT_Z32_FLOAT;
+	tmplt.bind = PIPE_BIND_DEPTH_STENCIL;
+	p->zbuf = p->screen->resource_create(p->screen, &tmplt);
+
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = target_size;
+	p->framebuffer.height = target_size;
+	p->framebuffer.nr_cbufs = 1;
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+	surf_tmpl.format = PIPE_FORMAT_Z32_FLOAT;
+	p->framebuffer.zsbuf = p->pipe->create_surface(p->pipe, p->zbuf, &surf_tmpl);
+
+	/* buffer the compute shaders write */
+	p->buffer = pipe_buffer_create(p->screen, PIPE_BIND_SHADER_BUFFER,
+	                               PIPE_USAGE_DEFAULT, NUM_ELEMENTS * 4);
+
+	/* shaders */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	for (unsigned i = 0; i < ARRAY_SIZE(fs_cases); i++) {
+		struct pipe_shader_state state;
+
+		memset(&state, 0, sizeof(state));
+		state.type = PIPE_SHADER_IR_NIR;
+		state.ir.nir = trivial_tgsi_to_nir(p->screen, fs_cases[i].text);
+		if (!state.ir.nir)
+			return false;
+		p->fs[i] = p->pipe->create_fs_state(p->pipe, &state);
+	}
+
+	for (unsigned i = 0; i < ARRAY_SIZE(cs_cases); i++) {
+		struct pipe_compute_state state;
+
+		memset(&state, 0, sizeof(state));
+		state.ir_type = PIPE_SHADER_IR_NIR;
+		state.prog = trivial_tgsi_to_nir(p->screen, cs_cases[i].text);
+		if (!state.prog)
+			return false;
+		p->cs[i] = p->pipe->create_compute_state(p->pipe, &state);
+	}
+
+	return true;
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->cso) {
+		cso_destroy_context(p->cso);
+
+		if (p->vs)
+			p->pipe->delete_vs_state(p->pipe, p->vs);
+		for (unsigned i = 0; i < ARRAY_SIZE(fs_cases); i++) {
+			if (p->fs[i])
+				p->pipe->delete_fs_state(p->pipe, p->fs[i]);
+		}
+		for (unsigned i = 0; i < ARRAY_SIZE(cs_cases); i++) {
+			if (p->cs[i])
+				p->pipe->delete_compute_state(p->pipe, p->cs[i]);
+		}
+
+		pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+		pipe_surface_reference(&p->framebuffer.zsbuf, NULL);
+		pipe_sampler_view_reference(&p->view, NULL);
+		pipe_resource_reference(&p->target, NULL);
+		pipe_resource_reference(&p->zbuf, NULL);
+		pipe_resource_reference(&p->tex, NULL);
+		pipe_resource_reference(&p->buffer, NULL);
+		pipe_resource_reference(&p->vbuf, NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		trivial_destroy_screen(p->dev, p->screen);
+}
+
+static void set_fs_state(struct program *p, unsigned target_size, unsigned i)
+{
+	const struct pipe_sampler_state *samplers[] = {&p->sampler};
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+	memset(&depthstencil, 0, sizeof(depthstencil));
+	if (fs_cases[i].depth_blend) {
+		blend.rt[0].blend_enable = 1;
+		blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+		blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+		blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+		blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+		blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+		blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ZERO;
+
+		depthstencil.depth_enabled = 1;
+		depthstencil.depth_writemask = 1;
+		depthstencil.depth_func = PIPE_FUNC_LEQUAL;
+	}
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = target_size / 2.0f;
+	viewport.scale[1] = target_size / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = target_size / 2.0f;
+	viewport.translate[1] = target_size / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_samplers(p->cso, PIPE_SHADER_FRAGMENT, 1, samplers);
+	p->pipe->set_sampler_views(p->pipe, PIPE_SHADER_FRAGMENT, 0, 1, 0, false, &p->view);
+	cso_set_fragment_shader_handle(p->cso, p->fs[i]);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+}
+
+static void clear(struct program *p)
+{
+	union pipe_color_union color = { .f = { 0.25f, 0.5f, 0.75f, 1.0f } };
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTH, NULL,
+		       &color, 1.0, 0);
+}
+
+static void draw(struct program *p)
+{
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_QUADS,
+	                        4,  /* verts */
+	                        2); /* attribs/vert */
+}
+
+static void dispatch(struct program *p, unsigned i)
+{
+	struct pipe_grid_info info;
+
+	memset(&info, 0, sizeof(info));
+	info.work_dim = 1;
+	info.block[0] = BLOCK_SIZE;
+	info.block[1] = 1;
+	info.block[2] = 1;
+	info.grid[0] = NUM_ELEMENTS / BLOCK_SIZE;
+	info.grid[1] = 1;
+	info.grid[2] = 1;
+
+	p->pipe->bind_compute_state(p->pipe, p->cs[i]);
+	p->pipe->launch_grid(p->pipe, &info);
+}
+
+/*
+ * Run the shaders, hashing what each draws or computes, and printing
+ * their throughput if print is set.
+ */
+static bool run_cases(unsigned target_size, unsigned frames, bool print,
+                      uint64_t *hashes)
+{
+	struct pipe_shader_buffer sb;
+	struct program *p;
+
+	p = CALLOC_STRUCT(program);
+	if (!init_prog(p, target_size)) {
+		close_prog(p);
+		FREE(p);
+		return false;
+	}
+
+	for (unsigned i = 0; i < ARRAY_SIZE(fs_cases); i++) {
+		uint64_t hash = TRIVIAL_HASH_INIT;
+		int64_t start;
+		double mpix;
+
+		set_fs_state(p, target_size, i);
+
+		/* warm up, compiling the shader variant */
+		clear(p);
+		draw(p);
+		trivial_finish(p->pipe);
+
+		start = os_time_get_nano();
+		/* flushing each frame, as llvmpipe would otherwise only
+		 * rasterize the last of the opaque quads
+		 */
+		for (unsigned n = 0; n < frames; n++) {
+			draw(p);
+			p->pipe->flush(p->pipe, NULL, 0);
+		}
+		trivial_finish(p->pipe);
+		mpix = (double)target_size * target_size * frames * 1e3 /
+		       (os_time_get_nano() - start);
+
+		hash = trivial_hash_resource(p->pipe, p->target, hash);
+		if (fs_cases[i].depth_blend)
+			hash = trivial_hash_resource(p->pipe, p->zbuf, hash);
+		hashes[i] = hash;
+
+		if (print)
+			printf("fragment %-12s %10.1f Mpixels/s       hash %016" PRIx64 "\n",
+			       fs_cases[i].name, mpix, hash);
+	}
+
+	memset(&sb, 0, sizeof(sb));
+	sb.buffer = p->buffer;
+	sb.buffer_size = NUM_ELEMENTS * 4;
+	p->pipe->set_shader_buffers(p->pipe, PIPE_SHADER_COMPUTE, 0, 1, &sb, 1);
+
+	for (unsigned i = 0; i < ARRAY_SIZE(cs_cases); i++) {
+		uint64_t *hash = &hashes[ARRAY_SIZE(fs_cases) + i];
+		int64_t start;
+		double minv;
+
+		/* warm up, compiling the shader variant */
+		dispatch(p, i);
+		trivial_finish(p->pipe);
+
+		start = os_time_get_nano();
+		for (unsigned n = 0; n < frames; n++)
+			dispatch(p, i);
+		trivial_finish(p->pipe);
+		minv = (double)NUM_ELEMENTS * frames * 1e3 /
+		       (os_time_get_nano() - start);
+
+		*hash = trivial_hash_resource(p->pipe, p->buffer, TRIVIAL_HASH_INIT);
+
+		if (print)
+			printf("compute  %-12s %10.1f Minvocations/s  hash %016" PRIx64 "\n",
+			       cs_cases[i].name, minv, *hash);
+	}
+
+	p->pipe->set_shader_buffers(p->pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL, 0);
+
+	close_prog(p);
+	FREE(p);
+
+	return true;
+}
+
+/* Get the hashes of the reference run, in a child process */
+static bool run_reference(unsigned target_size, unsigned frames,
+                          uint64_t *hashes, size_t size)
+{
+	int fds[2], status;
+	bool ok;
+	pid_t pid;
+
+	if (pipe(fds))
+		return false;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		setenv("LP_NATIVE_VECTOR_WIDTH", REF_VECTOR_WIDTH, 1);
+		ok = run_cases(target_size, frames, false, hashes) &&
+		     write(fds[1], hashes, size) == (ssize_t)size;
+		_exit(ok ? 0 : 1);
+	}
+
+	close(fds[1]);
+	ok = read(fds[0], hashes, size) == (ssize_t)size;
+	close(fds[0]);
+
+	return waitpid(pid, &status, 0) == pid &&
+	       WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned target_size = argc > 1 ? atoi(argv[1]) : 1024;
+	unsigned frames = argc > 2 ? atoi(argv[2]) : 20;
+	uint64_t hashes[ARRAY_SIZE(fs_cases) + ARRAY_SIZE(cs_cases)];
+	uint64_t ref[ARRAY_SIZE(hashes)];
+	bool ok = true;
+
+	if (target_size < 16 || !frames) {
+		fprintf(stderr, "usage: %s [target size (>= 16) [frames]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	/* before this process creates a screen, fixing its vector width */
+	if (!run_reference(target_size, frames, ref, sizeof(ref))) {
+		fprintf(stderr, "the reference run failed\n");
+		return 1;
+	}
+
+	if (!run_cases(target_size, frames, true, hashes))
+		return 1;
+
+	for (unsigned i = 0; i < ARRAY_SIZE(hashes); i++) {
+		char what[32];
+
+		if (i < ARRAY_SIZE(fs_cases))
+			snprintf(what, sizeof(what), "fragment %s", fs_cases[i].name);
+		else
+			snprintf(what, sizeof(what), "compute %s",
+			         cs_cases[i - ARRAY_SIZE(fs_cases)].name);
+		ok &= trivial_check(what, hashes[i], ref[i]);
+	}
+
+	return ok ? 0 : 1;
+}
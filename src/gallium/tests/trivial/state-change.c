@@ -0,0 +1,329 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures state-change throughput when a shader has many variants.
+ *
+ * Each blend state below makes the driver build a different fragment shader
+ * variant.  After all of them have been compiled once, the states are bound
+ * in a scrambled order with a tiny draw after each, so that the time spent
+ * per state change is dominated by looking up the already compiled variant.
+ *
+ * Usage: state-change [variants [state changes]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+#include "trivial-common.h"
+
+#define WIDTH 64
+#define HEIGHT 64
+
+/* How many state changes to queue before flushing */
+#define FLUSH_INTERVAL 256
+
+static const enum pipe_blendfactor factors[] = {
+	PIPE_BLENDFACTOR_SRC_COLOR,
+	PIPE_BLENDFACTOR_INV_SRC_COLOR,
+	PIPE_BLENDFACTOR_SRC_ALPHA,
+	PIPE_BLENDFACTOR_INV_SRC_ALPHA,
+	PIPE_BLENDFACTOR_DST_COLOR,
+	PIPE_BLENDFACTOR_INV_DST_COLOR,
+	PIPE_BLENDFACTOR_DST_ALPHA,
+	PIPE_BLENDFACTOR_INV_DST_ALPHA,
+	PIPE_BLENDFACTOR_CONST_COLOR,
+	PIPE_BLENDFACTOR_INV_CONST_COLOR,
+};
+
+#define NUM_FACTORS ARRAY_SIZE(factors)
+#define MAX_VARIANTS (NUM_FACTORS * NUM_FACTORS * 4)
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+	void **blend;
+	unsigned num_blend;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+static bool init_prog(struct program *p, unsigned num_variants)
+{
+	struct pipe_surface surf_tmpl;
+
+	p->screen = trivial_create_screen(&p->dev);
+	if (!p->screen)
+		return false;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffer, a single triangle covering a few pixels, so that
+	 * rasterization doesn't hide the cost of the state changes
+	 */
+	{
+		const float vertices[3][2][4] = {
+			{ { -0.05f, -0.05f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+			{ {  0.05f, -0.05f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+			{ {  0.0f,   0.05f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+		};
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+					     PIPE_USAGE_DEFAULT, sizeof(vertices));
+		pipe_buffer_write(p->pipe, p->vbuf, 0, sizeof(vertices), vertices);
+	}
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* one blend state per fragment shader variant */
+	p->blend = CALLOC(num_variants, sizeof(void *));
+	for (unsigned i = 0; i < num_variants; i++) {
+		struct pipe_blend_state blend;
+
+		memset(&blend, 0, sizeof(blend));
+		blend.rt[0].blend_enable = 1;
+		blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+		blend.rt[0].rgb_src_factor = factors[i % NUM_FACTORS];
+		blend.rt[0].rgb_dst_factor = factors[(i / NUM_FACTORS) % NUM_FACTORS];
+		blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+		blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+		blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ZERO;
+		blend.rt[0].colormask = PIPE_MASK_RGBA >> (i / (NUM_FACTORS * NUM_FACTORS));
+
+		p->blend[i] = p->pipe->create_blend_state(p->pipe, &blend);
+	}
+	p->num_blend = num_variants;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+		    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+
+	return true;
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->cso) {
+		cso_destroy_context(p->cso);
+
+		for (unsigned i = 0; i < p->num_blend; i++)
+			p->pipe->delete_blend_state(p->pipe, p->blend[i]);
+		FREE(p->blend);
+
+		p->pipe->delete_vs_state(p->pipe, p->vs);
+		p->pipe->delete_fs_state(p->pipe, p->fs);
+
+		pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+		pipe_resource_reference(&p->target, NULL);
+		pipe_resource_reference(&p->vbuf, NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		trivial_destroy_screen(p->dev, p->screen);
+}
+
+static void set_state(struct program *p)
+{
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = WIDTH / 2.0f;
+	viewport.scale[1] = HEIGHT / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = WIDTH / 2.0f;
+	viewport.translate[1] = HEIGHT / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+}
+
+/* Bind the i-th blend state, and draw so that the driver picks a variant */
+static void change_state(struct program *p, unsigned i)
+{
+	p->pipe->bind_blend_state(p->pipe, p->blend[i]);
+
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_TRIANGLES,
+	                        3,
+	                        2); /* attribs/vert */
+}
+
+int main(int argc, char** argv)
+{
+	unsigned num_variants = argc > 1 ? atoi(argv[1]) : 256;
+	unsigned changes = argc > 2 ? atoi(argv[2]) : 100000;
+	struct program *p;
+	int64_t start;
+	double compile_ms, ns;
+	unsigned seed = 1;
+
+	if (!num_variants || num_variants > MAX_VARIANTS || !changes) {
+		fprintf(stderr, "usage: %s [variants (1-%u) [state changes]]\n",
+			argv[0], (unsigned)MAX_VARIANTS);
+		return 1;
+	}
+
+	p = CALLOC_STRUCT(program);
+	if (!init_prog(p, num_variants)) {
+		close_prog(p);
+		FREE(p);
+		return 1;
+	}
+
+	set_state(p);
+
+	/* compile every variant once */
+	start = os_time_get_nano();
+	for (unsigned i = 0; i < num_variants; i++)
+		change_state(p, i);
+	trivial_finish(p->pipe);
+	compile_ms = (os_time_get_nano() - start) / 1e6;
+
+	/* and then only look them up again */
+	start = os_time_get_nano();
+	for (unsigned n = 0; n < changes; n++) {
+		seed = seed * 1103515245 + 12345;
+		change_state(p, (seed >> 8) % num_variants);
+
+		if ((n + 1) % FLUSH_INTERVAL == 0)
+			p->pipe->flush(p->pipe, NULL, 0);
+	}
+	trivial_finish(p->pipe);
+	ns = (double)(os_time_get_nano() - start) / changes;
+
+	printf("%u variants: %.1f ms to compile, %.0f ns/state change, "
+	       "%.3f M state changes/s\n",
+	       num_variants, compile_ms, ns, 1e3 / ns);
+
+	close_prog(p);
+	FREE(p);
+
+	return 0;
+}
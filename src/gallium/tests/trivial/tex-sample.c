@@ -0,0 +1,359 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures texture sampling throughput for various texture sizes.
+ *
+ * A texture which can only be sampled from is drawn with bilinear
+ * filtering onto a quad covering the render target, once as is and once
+ * rotated by 90 degrees, so that neighbouring pixels of a row read texels
+ * from neighbouring rows of the texture.  Textures larger than the render
+ * target are minified.  Run it with LP_TILED_TEXTURES=0 and 1 to compare
+ * the linear and tiled texture layouts of llvmpipe; the image hashes
+ * printed must be the same for both.
+ *
+ * Usage: tex-sample [max texture size [frames]]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* u_box_2d */
+#include "util/u_box.h"
+/* u_sampler_view_default_template */
+#include "util/u_sampler.h"
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+#include "trivial-common.h"
+
+/* Largest render target */
+#define MAX_TARGET_SIZE 1024
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_sampler_state sampler;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf[2];
+	struct pipe_resource *target;
+	struct pipe_resource *tex;
+	struct pipe_sampler_view *view;
+};
+
+static bool init_prog(struct program *p)
+{
+	p->screen = trivial_create_screen(&p->dev);
+	if (!p->screen)
+		return false;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffers, a quad covering the render target, with texture
+	 * coordinates as is and rotated by 90 degrees
+	 */
+	{
+		const float vertices[2][4][2][4] = {
+			{
+				{ { -1.0f, -1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+				{ {  1.0f, -1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+				{ {  1.0f,  1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+				{ { -1.0f,  1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+			},
+			{
+				{ { -1.0f, -1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+				{ {  1.0f, -1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+				{ {  1.0f,  1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 0.0f, 1.0f } },
+				{ { -1.0f,  1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+			},
+		};
+
+		for (unsigned i = 0; i < 2; i++) {
+			p->vbuf[i] = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+						        PIPE_USAGE_DEFAULT, sizeof(vertices[i]));
+			pipe_buffer_write(p->pipe, p->vbuf[i], 0, sizeof(vertices[i]), vertices[i]);
+		}
+	}
+
+	/* bilinear filtering, no mipmaps */
+	memset(&p->sampler, 0, sizeof(p->sampler));
+	p->sampler.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+	p->sampler.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+	p->sampler.wrap_r = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+	p->sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+	p->sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+	p->sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_tex_shader(p->pipe, TGSI_TEXTURE_2D,
+	                                      TGSI_RETURN_TYPE_FLOAT,
+	                                      TGSI_RETURN_TYPE_FLOAT, false,
+	                                      false);
+
+	return true;
+}
+
+/* (Re)create the texture and render target for the given sizes */
+static void init_size(struct program *p, unsigned tex_size, unsigned target_size)
+{
+	struct pipe_resource tmplt;
+	struct pipe_sampler_view v_tmplt;
+	struct pipe_surface surf_tmpl;
+	struct pipe_box box;
+	uint32_t *data;
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_sampler_view_reference(&p->view, NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->tex, NULL);
+
+	/* sampler texture, which can't be rendered to */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = tex_size;
+	tmplt.height0 = tex_size;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_SAMPLER_VIEW;
+
+	p->tex = p->screen->resource_create(p->screen, &tmplt);
+
+	data = MALLOC(tex_size * tex_size * 4);
+	for (unsigned y = 0; y < tex_size; y++) {
+		for (unsigned x = 0; x < tex_size; x++)
+			data[y * tex_size + x] = 0xff000000 | ((x * 0x9e3779b1) ^ (y * 0x85ebca6b));
+	}
+	u_box_2d(0, 0, tex_size, tex_size, &box);
+	p->pipe->texture_subdata(p->pipe, p->tex, 0, PIPE_MAP_WRITE, &box,
+	                         data, tex_size * 4, 0);
+	FREE(data);
+
+	u_sampler_view_default_template(&v_tmplt, p->tex, p->tex->format);
+	p->view = p->pipe->create_sampler_view(p->pipe, p->tex, &v_tmplt);
+
+	/* render target texture */
+	tmplt.width0 = target_size;
+	tmplt.height0 = target_size;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+	p->target = p->screen->resource_create(p->screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = target_size;
+	p->framebuffer.height = target_size;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->cso) {
+		cso_destroy_context(p->cso);
+
+		p->pipe->delete_vs_state(p->pipe, p->vs);
+		p->pipe->delete_fs_state(p->pipe, p->fs);
+
+		pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+		pipe_sampler_view_reference(&p->view, NULL);
+		pipe_resource_reference(&p->target, NULL);
+		pipe_resource_reference(&p->tex, NULL);
+		pipe_resource_reference(&p->vbuf[0], NULL);
+		pipe_resource_reference(&p->vbuf[1], NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		trivial_destroy_screen(p->dev, p->screen);
+}
+
+static void set_state(struct program *p, unsigned target_size)
+{
+	const struct pipe_sampler_state *samplers[] = {&p->sampler};
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = target_size / 2.0f;
+	viewport.scale[1] = target_size / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = target_size / 2.0f;
+	viewport.translate[1] = target_size / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_samplers(p->cso, PIPE_SHADER_FRAGMENT, 1, samplers);
+	p->pipe->set_sampler_views(p->pipe, PIPE_SHADER_FRAGMENT, 0, 1, 0, false, &p->view);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+}
+
+static void draw(struct program *p, unsigned rotated)
+{
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf[rotated], 0, 0,
+	                        PIPE_PRIM_QUADS,
+	                        4,  /* verts */
+	                        2); /* attribs/vert */
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_size = argc > 1 ? atoi(argv[1]) : 4096;
+	unsigned frames = argc > 2 ? atoi(argv[2]) : 20;
+	struct program *p;
+
+	if (max_size < 64 || !frames) {
+		fprintf(stderr, "usage: %s [max texture size (>= 64) [frames]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	p = CALLOC_STRUCT(program);
+	if (!init_prog(p)) {
+		close_prog(p);
+		FREE(p);
+		return 1;
+	}
+
+	for (unsigned size = 64; size <= max_size; size *= 2) {
+		const unsigned target_size = MIN2(size, MAX_TARGET_SIZE);
+
+		init_size(p, size, target_size);
+		set_state(p, target_size);
+
+		for (unsigned rotated = 0; rotated < 2; rotated++) {
+			int64_t start;
+			double mpix;
+
+			/* warm up, compiling the shader variant */
+			draw(p, rotated);
+			trivial_finish(p->pipe);
+
+			start = os_time_get_nano();
+			/* flushing each frame, as llvmpipe would otherwise only
+			 * rasterize the last of the opaque quads
+			 */
+			for (unsigned n = 0; n < frames; n++) {
+				draw(p, rotated);
+				p->pipe->flush(p->pipe, NULL, 0);
+			}
+			trivial_finish(p->pipe);
+			mpix = (double)target_size * target_size * frames * 1e3 /
+			       (os_time_get_nano() - start);
+
+			printf("%5ux%-5u %-7s %8.1f Mpixels/s  hash %016" PRIx64 "\n",
+			       size, size, rotated ? "rotated" : "as is", mpix,
+			       trivial_hash_resource(p->pipe, p->target,
+			                             TRIVIAL_HASH_INIT));
+		}
+	}
+
+	close_prog(p);
+	FREE(p);
+
+	return 0;
+}
@@ -0,0 +1,339 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures how the software rasterizer's throughput scales with the number
+ * of threads, by drawing the same frames with LP_NUM_THREADS set to 1, 2,
+ * 4, ... up to the given maximum.  The program exits with 1 if what any
+ * thread count draws differs from what a single thread draws.
+ *
+ * Usage: tri-scale [max threads [frames [triangles]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+#include "trivial-common.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+static unsigned num_tris = 20000;
+
+static float frand(unsigned *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (float)((*seed >> 8) & 0xffff) / 65536.0f;
+}
+
+static bool init_prog(struct program *p, unsigned num_threads)
+{
+	struct pipe_surface surf_tmpl;
+	char value[16];
+
+	/* the driver reads this when creating the screen */
+	snprintf(value, sizeof(value), "%u", num_threads);
+	setenv("LP_NUM_THREADS", value, 1);
+
+	p->screen = trivial_create_screen(&p->dev);
+	if (!p->screen)
+		return false;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* vertex buffer, the same random triangles for every run */
+	{
+		unsigned size = num_tris * 3 * 2 * 4 * sizeof(float);
+		float (*vertices)[2][4] = MALLOC(size);
+		unsigned seed = 1;
+
+		for (unsigned i = 0; i < num_tris; i++) {
+			float cx = frand(&seed) * 2.0f - 1.0f;
+			float cy = frand(&seed) * 2.0f - 1.0f;
+
+			for (unsigned j = 0; j < 3; j++) {
+				float *pos = vertices[i * 3 + j][0];
+				float *color = vertices[i * 3 + j][1];
+
+				pos[0] = cx + (frand(&seed) - 0.5f) * 0.2f;
+				pos[1] = cy + (frand(&seed) - 0.5f) * 0.2f;
+				pos[2] = frand(&seed);
+				pos[3] = 1.0f;
+				color[0] = frand(&seed);
+				color[1] = frand(&seed);
+				color[2] = frand(&seed);
+				color[3] = 1.0f;
+			}
+		}
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+					     PIPE_USAGE_DEFAULT, size);
+		pipe_buffer_write(p->pipe, p->vbuf, 0, size, vertices);
+		FREE(vertices);
+	}
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+		    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+
+	return true;
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->cso) {
+		cso_destroy_context(p->cso);
+
+		p->pipe->delete_vs_state(p->pipe, p->vs);
+		p->pipe->delete_fs_state(p->pipe, p->fs);
+
+		pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+		pipe_resource_reference(&p->target, NULL);
+		pipe_resource_reference(&p->vbuf, NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		trivial_destroy_screen(p->dev, p->screen);
+}
+
+static void draw_frame(struct program *p)
+{
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	union pipe_color_union clear_color = { .f = { 0.3, 0.1, 0.3, 1.0 } };
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = WIDTH / 2.0f;
+	viewport.scale[1] = HEIGHT / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = WIDTH / 2.0f;
+	viewport.translate[1] = HEIGHT / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, NULL, &clear_color, 0, 0);
+
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_TRIANGLES,
+	                        num_tris * 3,
+	                        2); /* attribs/vert */
+}
+
+/*
+ * Returns the average time per frame in milliseconds, or 0 on failure,
+ * and the hash of the last frame.
+ */
+static double run(unsigned num_threads, unsigned frames, uint64_t *hash)
+{
+	struct program *p = CALLOC_STRUCT(program);
+	double ms = 0.0;
+
+	if (init_prog(p, num_threads)) {
+		/* warm up, so that shader compilation isn't measured */
+		draw_frame(p);
+		trivial_finish(p->pipe);
+
+		int64_t start = os_time_get_nano();
+		for (unsigned i = 0; i < frames; i++) {
+			draw_frame(p);
+			if (i + 1 < frames)
+				p->pipe->flush(p->pipe, NULL, 0);
+		}
+		trivial_finish(p->pipe);
+
+		ms = (os_time_get_nano() - start) / 1e6 / frames;
+
+		*hash = trivial_hash_resource(p->pipe, p->target, TRIVIAL_HASH_INIT);
+	}
+
+	close_prog(p);
+	FREE(p);
+
+	return ms;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_threads = argc > 1 ? atoi(argv[1]) : 128;
+	unsigned frames = argc > 2 ? atoi(argv[2]) : 20;
+	double base = 0.0;
+	uint64_t ref = 0;
+	bool ok = true;
+
+	if (argc > 3)
+		num_tris = atoi(argv[3]);
+
+	if (!max_threads || !frames || !num_tris) {
+		fprintf(stderr, "usage: %s [max threads [frames [triangles]]]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%u triangles, %ux%u, %u frames\n", num_tris, WIDTH, HEIGHT, frames);
+	printf("%8s %12s %12s %8s\n", "threads", "ms/frame", "Mtris/s", "speedup");
+
+	for (unsigned t = 1; ; t = MIN2(t * 2, max_threads)) {
+		uint64_t hash;
+		double ms = run(t, frames, &hash);
+
+		if (ms <= 0.0)
+			return 1;
+
+		if (t == 1) {
+			base = ms;
+			ref = hash;
+		} else {
+			char what[32];
+			snprintf(what, sizeof(what), "%u threads", t);
+			ok &= trivial_check(what, hash, ref);
+		}
+
+		printf("%8u %12.3f %12.3f %7.2fx\n", t, ms,
+		       num_tris / ms / 1e3, base / ms);
+
+		if (t == max_threads)
+			break;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* pipe_shader_state_from_tgsi */
+#include "util/u_inlines.h"
+
+/* u_box_2d */
+#include "util/u_box.h"
+/* util_format_get_stride */
+#include "util/format/u_format.h"
+/* tgsi_text_translate */
+#include "tgsi/tgsi_text.h"
+/* tgsi_to_nir */
+#include "nir/tgsi_to_nir.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+#include "trivial-common.h"
+
+/* Create a software screen, saying so if there is none */
+struct pipe_screen *
+trivial_create_screen(struct pipe_loader_device **dev)
+{
+	struct pipe_screen *screen;
+
+	if (!pipe_loader_sw_probe_null(dev)) {
+		fprintf(stderr, "failed to create a software screen\n");
+		return NULL;
+	}
+
+	screen = pipe_loader_create_screen(*dev);
+	if (!screen) {
+		fprintf(stderr, "failed to create a software screen\n");
+		pipe_loader_release(dev, 1);
+	}
+
+	return screen;
+}
+
+void
+trivial_destroy_screen(struct pipe_loader_device *dev,
+                       struct pipe_screen *screen)
+{
+	screen->destroy(screen);
+	pipe_loader_release(&dev, 1);
+}
+
+/* Flush the context and wait for it to be idle */
+void
+trivial_finish(struct pipe_context *pipe)
+{
+	struct pipe_screen *screen = pipe->screen;
+	struct pipe_fence_handle *fence = NULL;
+
+	pipe->flush(pipe, &fence, 0);
+	screen->fence_finish(screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	screen->fence_reference(screen, &fence, NULL);
+}
+
+/* FNV-1a of the rows of a buffer or of the first level of a 2D texture */
+uint64_t
+trivial_hash_resource(struct pipe_context *pipe, struct pipe_resource *res,
+                      uint64_t hash)
+{
+	const unsigned row_size = util_format_get_stride(res->format, res->width0);
+	struct pipe_transfer *transfer;
+	struct pipe_box box;
+	const uint8_t *map;
+
+	u_box_2d(0, 0, res->width0, res->height0, &box);
+	if (res->target == PIPE_BUFFER)
+		map = pipe->buffer_map(pipe, res, 0, PIPE_MAP_READ, &box, &transfer);
+	else
+		map = pipe->texture_map(pipe, res, 0, PIPE_MAP_READ, &box, &transfer);
+	for (unsigned y = 0; y < res->height0; y++) {
+		const uint8_t *row = map + y * transfer->stride;
+		for (unsigned i = 0; i < row_size; i++)
+			hash = (hash ^ row[i]) * 0x100000001b3ull;
+	}
+	if (res->target == PIPE_BUFFER)
+		pipe->buffer_unmap(pipe, transfer);
+	else
+		pipe->texture_unmap(pipe, transfer);
+
+	return hash;
+}
+
+/* Compare a hash to the reference path's, complaining if they differ */
+bool
+trivial_check(const char *what, uint64_t hash, uint64_t ref)
+{
+	if (hash == ref)
+		return true;
+
+	fprintf(stderr, "%s: hash %016" PRIx64 " differs from the reference %016" PRIx64 "\n",
+		what, hash, ref);
+	return false;
+}
+
+/* Create a vertex shader from TGSI text, exiting if it doesn't parse */
+void *
+trivial_create_vs(struct pipe_context *pipe, const char *text)
+{
+	struct tgsi_token tokens[1000];
+	struct pipe_shader_state state;
+
+	if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens))) {
+		fprintf(stderr, "failed to translate the vertex shader\n");
+		exit(1);
+	}
+	pipe_shader_state_from_tgsi(&state, tokens);
+	return pipe->create_vs_state(pipe, &state);
+}
+
+/* Translate TGSI text to NIR, as st/mesa hands shaders to the driver */
+struct nir_shader *
+trivial_tgsi_to_nir(struct pipe_screen *screen, const char *text)
+{
+	struct tgsi_token tokens[1024];
+
+	if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+		return NULL;
+
+	return tgsi_to_nir(tokens, screen, false);
+}
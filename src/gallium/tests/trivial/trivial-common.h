@@ -0,0 +1,69 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Helpers shared by the trivial programs.  Most of them check what they
+ * draw or compute against a reference path and exit with 1 on a mismatch.
+ */
+
+#ifndef TRIVIAL_COMMON_H
+#define TRIVIAL_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct pipe_context;
+struct pipe_loader_device;
+struct pipe_resource;
+struct pipe_screen;
+struct nir_shader;
+
+/* Initial value for trivial_hash_resource() */
+#define TRIVIAL_HASH_INIT 0xcbf29ce484222325ull
+
+struct pipe_screen *
+trivial_create_screen(struct pipe_loader_device **dev);
+
+void
+trivial_destroy_screen(struct pipe_loader_device *dev,
+                       struct pipe_screen *screen);
+
+void
+trivial_finish(struct pipe_context *pipe);
+
+uint64_t
+trivial_hash_resource(struct pipe_context *pipe, struct pipe_resource *res,
+                      uint64_t hash);
+
+bool
+trivial_check(const char *what, uint64_t hash, uint64_t ref);
+
+void *
+trivial_create_vs(struct pipe_context *pipe, const char *text);
+
+struct nir_shader *
+trivial_tgsi_to_nir(struct pipe_screen *screen, const char *text);
+
+#endif /* TRIVIAL_COMMON_H */
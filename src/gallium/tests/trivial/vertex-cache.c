@@ -0,0 +1,584 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures how much vertex shading a post-transform vertex cache saves,
+ * on indexed grids of pixel sized, transformed and lit triangles:
+ *
+ *   large      one draw of a grid too large for a single draw module
+ *              segment, so neighbouring segments share vertices
+ *   multidraw  many draws of a small grid in one multi-draw call
+ *   instanced  an instanced draw of a medium grid
+ *
+ * For each, the vertex rate and the lookups and hits of the driver's
+ * "lp-vcache-lookups" and "lp-vcache-hits" queries are printed, if it has
+ * them.  Hits are vertex shader invocations saved.
+ *
+ * Each scenario is first drawn without indices, from a copy of the
+ * vertices in index order, where no vertex can be reused.  What the
+ * indexed draws draw is checked against that reference, and the program
+ * exits with 1 if they differ.
+ *
+ * Usage: vertex-cache [repeats]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_fragment_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+
+#include "trivial-common.h"
+
+#define TARGET_SIZE 256
+#define GRID_SIZE 256
+#define NUM_INDICES (6 * (GRID_SIZE - 1) * (GRID_SIZE - 1))
+
+/* the smaller grids are the top left corner of the large one */
+#define MULTIDRAW_GRID_SIZE 16
+#define MULTIDRAW_DRAWS 64
+#define INSTANCED_GRID_SIZE 64
+#define INSTANCES 4
+
+#define GRID_INDICES(size) (6 * ((size) - 1) * ((size) - 1))
+#define NUM_INDICES_ALL (NUM_INDICES + \
+                         GRID_INDICES(MULTIDRAW_GRID_SIZE) + \
+                         GRID_INDICES(INSTANCED_GRID_SIZE))
+
+/* the scenarios, drawing from one index buffer */
+enum scenario {
+	LARGE,
+	MULTIDRAW,
+	INSTANCED,
+	NUM_SCENARIOS
+};
+
+static const char *scenario_names[NUM_SCENARIOS] = {
+	"large", "multidraw", "instanced"
+};
+
+struct program
+{
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *ibuf;
+	struct pipe_resource *ref_vbuf;
+	struct pipe_resource *target;
+
+	/* 0 if the driver doesn't have the queries */
+	unsigned lookups_query_type;
+	unsigned hits_query_type;
+};
+
+/* two triangles per cell of the top left size x size vertices */
+static uint32_t *emit_grid(uint32_t *indices, unsigned size)
+{
+	for (unsigned y = 0; y < size - 1; y++) {
+		for (unsigned x = 0; x < size - 1; x++) {
+			uint32_t i = y * GRID_SIZE + x;
+
+			*indices++ = i;
+			*indices++ = i + 1;
+			*indices++ = i + GRID_SIZE;
+			*indices++ = i + 1;
+			*indices++ = i + GRID_SIZE + 1;
+			*indices++ = i + GRID_SIZE;
+		}
+	}
+	return indices;
+}
+
+static unsigned find_query(struct pipe_screen *screen, const char *name)
+{
+	struct pipe_driver_query_info info;
+
+	if (!screen->get_driver_query_info)
+		return 0;
+
+	for (unsigned i = 0; screen->get_driver_query_info(screen, i, &info); i++) {
+		if (!strcmp(info.name, name))
+			return info.query_type;
+	}
+	return 0;
+}
+
+static void init_prog(struct program *p, struct pipe_screen *screen)
+{
+	struct pipe_resource tmplt;
+	struct pipe_surface surf_tmpl;
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	float (*vertices)[2][4];
+	float (*ref_vertices)[2][4];
+	uint32_t *indices;
+
+	p->pipe = screen->context_create(screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	p->lookups_query_type = find_query(screen, "lp-vcache-lookups");
+	p->hits_query_type = find_query(screen, "lp-vcache-hits");
+
+	/* a grid of vertices, with a colour depending on the position */
+	vertices = MALLOC(GRID_SIZE * GRID_SIZE * sizeof(*vertices));
+	for (unsigned y = 0; y < GRID_SIZE; y++) {
+		for (unsigned x = 0; x < GRID_SIZE; x++) {
+			float (*v)[4] = vertices[y * GRID_SIZE + x];
+
+			v[0][0] = -1.0f + 2.0f * x / (GRID_SIZE - 1);
+			v[0][1] = -1.0f + 2.0f * y / (GRID_SIZE - 1);
+			v[0][2] = 0.0f;
+			v[0][3] = 1.0f;
+			v[1][0] = (x % 17) / 16.0f;
+			v[1][1] = (y % 13) / 12.0f;
+			v[1][2] = ((x + y) % 7) / 6.0f;
+			v[1][3] = 1.0f;
+		}
+	}
+
+	/* the large grid, followed by the multidraw and instanced ones */
+	indices = MALLOC(NUM_INDICES_ALL * sizeof(*indices));
+	{
+		uint32_t *end = emit_grid(indices, GRID_SIZE);
+
+		end = emit_grid(end, MULTIDRAW_GRID_SIZE);
+		emit_grid(end, INSTANCED_GRID_SIZE);
+	}
+
+	/* the vertices in index order, for the reference */
+	ref_vertices = MALLOC(NUM_INDICES_ALL * sizeof(*ref_vertices));
+	for (unsigned i = 0; i < NUM_INDICES_ALL; i++)
+		memcpy(ref_vertices[i], vertices[indices[i]], sizeof(*ref_vertices));
+
+	p->vbuf = pipe_buffer_create_with_data(p->pipe, PIPE_BIND_VERTEX_BUFFER,
+	                                       PIPE_USAGE_DEFAULT,
+	                                       GRID_SIZE * GRID_SIZE * sizeof(*vertices),
+	                                       vertices);
+	p->ibuf = pipe_buffer_create_with_data(p->pipe, PIPE_BIND_INDEX_BUFFER,
+	                                       PIPE_USAGE_DEFAULT,
+	                                       NUM_INDICES_ALL * sizeof(*indices),
+	                                       indices);
+	p->ref_vbuf = pipe_buffer_create_with_data(p->pipe, PIPE_BIND_VERTEX_BUFFER,
+	                                           PIPE_USAGE_DEFAULT,
+	                                           NUM_INDICES_ALL * sizeof(*ref_vertices),
+	                                           ref_vertices);
+	FREE(vertices);
+	FREE(indices);
+	FREE(ref_vertices);
+
+	/* render target */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = TARGET_SIZE;
+	tmplt.height0 = TARGET_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+	p->target = screen->resource_create(screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = tmplt.format;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = TARGET_SIZE;
+	p->framebuffer.height = TARGET_SIZE;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = TARGET_SIZE / 2.0f;
+	viewport.scale[1] = TARGET_SIZE / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = TARGET_SIZE / 2.0f;
+	viewport.translate[1] = TARGET_SIZE / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader, transforming the grid and lighting it with eight
+	 * point lights, so that it is expensive enough to cache
+	 */
+	{
+		static const char text[] =
+			"VERT\n"
+			"DCL IN[0]\n"
+			"DCL IN[1]\n"
+			"DCL OUT[0], POSITION\n"
+			"DCL OUT[1], COLOR\n"
+			"DCL CONST[0][0..11]\n"
+			"DCL TEMP[0..3]\n"
+			"IMM[0] FLT32 { 0.0, 16.0, 1.0, 0.125 }\n"
+			"  0: MUL TEMP[0], CONST[0][0], IN[0].xxxx\n"
+			"  1: MAD TEMP[0], CONST[0][1], IN[0].yyyy, TEMP[0]\n"
+			"  2: MAD TEMP[0], CONST[0][2], IN[0].zzzz, TEMP[0]\n"
+			"  3: MAD TEMP[0], CONST[0][3], IN[0].wwww, TEMP[0]\n"
+			"  4: MOV OUT[0], TEMP[0]\n"
+			"  5: MUL TEMP[3], IN[1], IMM[0].wwww\n"
+			"  6: ADD TEMP[1], CONST[0][4], -TEMP[0]\n"
+			"  7: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			"  8: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			"  9: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 10: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 11: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 12: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 13: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 14: MAD TEMP[3].xyz, CONST[0][4].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 15: ADD TEMP[1], CONST[0][5], -TEMP[0]\n"
+			" 16: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 17: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 18: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 19: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 20: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 21: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 22: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 23: MAD TEMP[3].xyz, CONST[0][5].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 24: ADD TEMP[1], CONST[0][6], -TEMP[0]\n"
+			" 25: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 26: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 27: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 28: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 29: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 30: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 31: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 32: MAD TEMP[3].xyz, CONST[0][6].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 33: ADD TEMP[1], CONST[0][7], -TEMP[0]\n"
+			" 34: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 35: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 36: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 37: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 38: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 39: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 40: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 41: MAD TEMP[3].xyz, CONST[0][7].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 42: ADD TEMP[1], CONST[0][8], -TEMP[0]\n"
+			" 43: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 44: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 45: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 46: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 47: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 48: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 49: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 50: MAD TEMP[3].xyz, CONST[0][8].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 51: ADD TEMP[1], CONST[0][9], -TEMP[0]\n"
+			" 52: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 53: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 54: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 55: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 56: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 57: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 58: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 59: MAD TEMP[3].xyz, CONST[0][9].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 60: ADD TEMP[1], CONST[0][10], -TEMP[0]\n"
+			" 61: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 62: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 63: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 64: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 65: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 66: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 67: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 68: MAD TEMP[3].xyz, CONST[0][10].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 69: ADD TEMP[1], CONST[0][11], -TEMP[0]\n"
+			" 70: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+			" 71: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+			" 72: MUL TEMP[1], TEMP[1], TEMP[2].xxxx\n"
+			" 73: DP3 TEMP[2].x, TEMP[1], IMM[0].xxzx\n"
+			" 74: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+			" 75: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].yyyy\n"
+			" 76: MAD TEMP[3], IN[1], TEMP[2].xxxx, TEMP[3]\n"
+			" 77: MAD TEMP[3].xyz, CONST[0][11].wwww, TEMP[2].yyyy, TEMP[3]\n"
+			" 78: MIN OUT[1], TEMP[3], IMM[0].zzzz\n"
+			" 79: END\n";
+
+		p->vs = trivial_create_vs(p->pipe, text);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+	                                              TGSI_SEMANTIC_COLOR,
+	                                              TGSI_INTERPOLATE_PERSPECTIVE,
+	                                              TRUE);
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+
+	/* the identity transform, and the lights' positions and strengths */
+	{
+		static const float constants[12][4] = {
+			{ 1.0f, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 1.0f, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f, 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+			{ -0.5f, -0.5f, 1.0f, 0.25f },
+			{ 0.5f, -0.5f, 1.0f, 0.125f },
+			{ -0.5f, 0.5f, 1.0f, 0.125f },
+			{ 0.5f, 0.5f, 1.0f, 0.25f },
+			{ 0.0f, 0.0f, 1.0f, 0.25f },
+			{ 0.0f, -1.0f, 0.5f, 0.125f },
+			{ -1.0f, 0.0f, 0.5f, 0.125f },
+			{ 1.0f, 1.0f, 0.5f, 0.25f },
+		};
+		struct pipe_constant_buffer cb;
+
+		memset(&cb, 0, sizeof(cb));
+		cb.user_buffer = constants;
+		cb.buffer_size = sizeof(constants);
+		p->pipe->set_constant_buffer(p->pipe, PIPE_SHADER_VERTEX, 0, false, &cb);
+	}
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->ibuf, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+	pipe_resource_reference(&p->ref_vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+}
+
+/*
+ * Issue the scenario's draws once, returning the number of vertices drawn.
+ * Without indices, vertex i of the reference buffer stands for index i.
+ */
+static unsigned draw_scenario(struct program *p, enum scenario s, bool indexed)
+{
+	struct pipe_draw_start_count_bias draws[MULTIDRAW_DRAWS];
+	struct pipe_draw_info info;
+
+	memset(&info, 0, sizeof(info));
+	info.mode = PIPE_PRIM_TRIANGLES;
+	info.instance_count = 1;
+	if (indexed) {
+		info.index_size = 4;
+		info.index.resource = p->ibuf;
+		info.index_bounds_valid = true;
+		info.min_index = 0;
+		info.max_index = GRID_SIZE * GRID_SIZE - 1;
+	}
+
+	switch (s) {
+	case LARGE:
+		draws[0].start = 0;
+		draws[0].count = NUM_INDICES;
+		draws[0].index_bias = 0;
+		cso_draw_vbo(p->cso, &info, 0, NULL, draws[0]);
+		return NUM_INDICES;
+	case MULTIDRAW:
+		for (unsigned i = 0; i < MULTIDRAW_DRAWS; i++) {
+			draws[i].start = NUM_INDICES;
+			draws[i].count = GRID_INDICES(MULTIDRAW_GRID_SIZE);
+			draws[i].index_bias = 0;
+		}
+		cso_multi_draw(p->cso, &info, 0, draws, MULTIDRAW_DRAWS);
+		return MULTIDRAW_DRAWS * GRID_INDICES(MULTIDRAW_GRID_SIZE);
+	case INSTANCED:
+		info.instance_count = INSTANCES;
+		draws[0].start = NUM_INDICES + GRID_INDICES(MULTIDRAW_GRID_SIZE);
+		draws[0].count = GRID_INDICES(INSTANCED_GRID_SIZE);
+		draws[0].index_bias = 0;
+		cso_draw_vbo(p->cso, &info, 0, NULL, draws[0]);
+		return INSTANCES * GRID_INDICES(INSTANCED_GRID_SIZE);
+	default:
+		return 0;
+	}
+}
+
+static struct pipe_query *begin_query(struct program *p, unsigned type)
+{
+	struct pipe_query *q;
+
+	if (!type)
+		return NULL;
+
+	q = p->pipe->create_query(p->pipe, type, 0);
+	if (q)
+		p->pipe->begin_query(p->pipe, q);
+	return q;
+}
+
+static uint64_t end_query(struct program *p, struct pipe_query *q)
+{
+	union pipe_query_result result;
+
+	if (!q)
+		return 0;
+
+	p->pipe->end_query(p->pipe, q);
+	if (!p->pipe->get_query_result(p->pipe, q, true, &result))
+		result.u64 = 0;
+	p->pipe->destroy_query(p->pipe, q);
+
+	return result.u64;
+}
+
+/* Run a scenario repeats times, returning millions of vertices per second */
+static double run(struct program *p, enum scenario s, bool indexed,
+                  unsigned repeats, uint64_t *lookups, uint64_t *hits)
+{
+	const union pipe_color_union clear_color = { .f = { 0.0f, 0.0f, 0.0f, 0.0f } };
+	struct pipe_query *lookups_query, *hits_query;
+	struct pipe_vertex_buffer vbuf;
+	uint64_t verts = 0;
+	int64_t start;
+
+	memset(&vbuf, 0, sizeof(vbuf));
+	vbuf.stride = 2 * 4 * sizeof(float);
+	vbuf.buffer.resource = indexed ? p->vbuf : p->ref_vbuf;
+	cso_set_vertex_buffers(p->cso, 0, 1, 0, false, &vbuf);
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, NULL, &clear_color, 1.0, 0);
+
+	lookups_query = begin_query(p, p->lookups_query_type);
+	hits_query = begin_query(p, p->hits_query_type);
+
+	start = os_time_get_nano();
+	for (unsigned n = 0; n < repeats; n++)
+		verts += draw_scenario(p, s, indexed);
+	trivial_finish(p->pipe);
+
+	*lookups = end_query(p, lookups_query);
+	*hits = end_query(p, hits_query);
+
+	return (double)verts * 1e3 / (os_time_get_nano() - start);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned repeats = argc > 1 ? atoi(argv[1]) : 20;
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct program p;
+	bool ok = true;
+
+	if (!repeats) {
+		fprintf(stderr, "usage: %s [repeats]\n", argv[0]);
+		return 1;
+	}
+
+	screen = trivial_create_screen(&dev);
+	if (!screen)
+		return 1;
+
+	memset(&p, 0, sizeof(p));
+	init_prog(&p, screen);
+
+	for (unsigned s = 0; s < NUM_SCENARIOS; s++) {
+		uint64_t lookups, hits, hash, ref;
+		double mverts;
+
+		run(&p, s, false, 1, &lookups, &hits);
+		ref = trivial_hash_resource(p.pipe, p.target, TRIVIAL_HASH_INIT);
+
+		/* warm up, compiling the shader variants */
+		run(&p, s, true, 1, &lookups, &hits);
+		mverts = run(&p, s, true, repeats, &lookups, &hits);
+
+		hash = trivial_hash_resource(p.pipe, p.target, TRIVIAL_HASH_INIT);
+		printf("%-10s %8.2f Mverts/s  hash %016" PRIx64,
+		       scenario_names[s], mverts, hash);
+		if (p.lookups_query_type && p.hits_query_type)
+			printf("  lookups %" PRIu64 " hits %" PRIu64 " (%.1f%%)",
+			       lookups, hits, lookups ? 100.0 * hits / lookups : 0.0);
+		printf("\n");
+		ok &= trivial_check(scenario_names[s], hash, ref);
+	}
+
+	close_prog(&p);
+
+	trivial_destroy_screen(dev, screen);
+
+	return ok ? 0 : 1;
+}
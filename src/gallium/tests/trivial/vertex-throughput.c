@@ -0,0 +1,334 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures the vertex rate of large indexed meshes: a grid of pixel
+ * sized triangles covering the render target, drawn a number of times.
+ * This is bound by vertex processing rather than by rasterization.
+ *
+ * For drivers using the draw module, the grid is drawn with
+ * DRAW_NUM_THREADS set to 0, 1, 2, 4... up to the given maximum, each on
+ * a new context.  What each draws is checked against the single threaded
+ * run, the reference, and the program exits with 1 if they differ.
+ *
+ * Usage: vertex-throughput [max threads] [draws]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+
+#include "trivial-common.h"
+
+#define TARGET_SIZE 256
+#define GRID_SIZE 256
+#define NUM_INDICES (6 * (GRID_SIZE - 1) * (GRID_SIZE - 1))
+
+struct program
+{
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct cso_velems_state velem;
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *ibuf;
+	struct pipe_resource *target;
+};
+
+static void init_prog(struct program *p, struct pipe_screen *screen)
+{
+	struct pipe_resource tmplt;
+	struct pipe_surface surf_tmpl;
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_vertex_buffer vbuf;
+	struct pipe_transfer *transfer;
+
+	p->pipe = screen->context_create(screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* a grid of vertices, with a colour depending on the position */
+	p->vbuf = pipe_buffer_create(screen, PIPE_BIND_VERTEX_BUFFER,
+	                             PIPE_USAGE_DEFAULT,
+	                             GRID_SIZE * GRID_SIZE * 2 * 4 * sizeof(float));
+	{
+		float (*vertices)[2][4];
+
+		vertices = pipe_buffer_map(p->pipe, p->vbuf, PIPE_MAP_WRITE, &transfer);
+		for (unsigned y = 0; y < GRID_SIZE; y++) {
+			for (unsigned x = 0; x < GRID_SIZE; x++) {
+				float (*v)[4] = vertices[y * GRID_SIZE + x];
+
+				v[0][0] = -1.0f + 2.0f * x / (GRID_SIZE - 1);
+				v[0][1] = -1.0f + 2.0f * y / (GRID_SIZE - 1);
+				v[0][2] = 0.0f;
+				v[0][3] = 1.0f;
+				v[1][0] = (x % 17) / 16.0f;
+				v[1][1] = (y % 13) / 12.0f;
+				v[1][2] = ((x + y) % 7) / 6.0f;
+				v[1][3] = 1.0f;
+			}
+		}
+		pipe_buffer_unmap(p->pipe, transfer);
+	}
+
+	/* two triangles per grid cell */
+	p->ibuf = pipe_buffer_create(screen, PIPE_BIND_INDEX_BUFFER,
+	                             PIPE_USAGE_DEFAULT,
+	                             NUM_INDICES * sizeof(uint32_t));
+	{
+		uint32_t *indices;
+
+		indices = pipe_buffer_map(p->pipe, p->ibuf, PIPE_MAP_WRITE, &transfer);
+		for (unsigned y = 0; y < GRID_SIZE - 1; y++) {
+			for (unsigned x = 0; x < GRID_SIZE - 1; x++) {
+				uint32_t i = y * GRID_SIZE + x;
+
+				*indices++ = i;
+				*indices++ = i + 1;
+				*indices++ = i + GRID_SIZE;
+				*indices++ = i + 1;
+				*indices++ = i + GRID_SIZE + 1;
+				*indices++ = i + GRID_SIZE;
+			}
+		}
+		pipe_buffer_unmap(p->pipe, transfer);
+	}
+
+	/* render target */
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = TARGET_SIZE;
+	tmplt.height0 = TARGET_SIZE;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.last_level = 0;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+	p->target = screen->resource_create(screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = tmplt.format;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = TARGET_SIZE;
+	p->framebuffer.height = TARGET_SIZE;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&depthstencil, 0, sizeof(depthstencil));
+
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.cull_face = PIPE_FACE_NONE;
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip_near = 1;
+	rasterizer.depth_clip_far = 1;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = TARGET_SIZE / 2.0f;
+	viewport.scale[1] = TARGET_SIZE / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = TARGET_SIZE / 2.0f;
+	viewport.translate[1] = TARGET_SIZE / 2.0f;
+	viewport.translate[2] = 0.5f;
+	viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+	viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+	viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+	viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+
+	/* vertex elements state */
+	memset(&p->velem, 0, sizeof(p->velem));
+	p->velem.count = 2;
+
+	p->velem.velems[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem.velems[0].vertex_buffer_index = 0;
+	p->velem.velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem.velems[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem.velems[1].vertex_buffer_index = 0;
+	p->velem.velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	memset(&vbuf, 0, sizeof(vbuf));
+	vbuf.stride = 2 * 4 * sizeof(float);
+	vbuf.buffer.resource = p->vbuf;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+	                                              TGSI_SEMANTIC_COLOR,
+	                                              TGSI_INTERPOLATE_PERSPECTIVE,
+	                                              TRUE);
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, &p->velem);
+	cso_set_vertex_buffers(p->cso, 0, 1, 0, false, &vbuf);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->ibuf, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+}
+
+/* Draw the grid draws times, returning millions of vertices per second */
+static double run(struct program *p, unsigned draws)
+{
+	const union pipe_color_union clear_color = { .f = { 0.0f, 0.0f, 0.0f, 0.0f } };
+	struct pipe_draw_info info;
+	struct pipe_draw_start_count_bias draw;
+	int64_t start;
+
+	memset(&info, 0, sizeof(info));
+	info.mode = PIPE_PRIM_TRIANGLES;
+	info.index_size = 4;
+	info.index.resource = p->ibuf;
+	info.instance_count = 1;
+	info.index_bounds_valid = true;
+	info.min_index = 0;
+	info.max_index = GRID_SIZE * GRID_SIZE - 1;
+
+	draw.start = 0;
+	draw.count = NUM_INDICES;
+	draw.index_bias = 0;
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, NULL, &clear_color, 1.0, 0);
+
+	start = os_time_get_nano();
+	for (unsigned n = 0; n < draws; n++)
+		cso_draw_vbo(p->cso, &info, 0, NULL, draw);
+	trivial_finish(p->pipe);
+
+	return (double)draws * NUM_INDICES * 1e3 / (os_time_get_nano() - start);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_threads = argc > 1 ? atoi(argv[1]) : 4;
+	unsigned draws = argc > 2 ? atoi(argv[2]) : 20;
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	uint64_t ref = 0;
+	bool ok = true;
+
+	if (!draws) {
+		fprintf(stderr, "usage: %s [max threads] [draws]\n", argv[0]);
+		return 1;
+	}
+
+	screen = trivial_create_screen(&dev);
+	if (!screen)
+		return 1;
+
+	for (unsigned threads = 0; threads <= max_threads;
+	     threads = threads ? threads * 2 : 1) {
+		struct program p;
+		char value[32];
+		uint64_t hash;
+		double mverts;
+
+		/* read when the context's draw module is created */
+		snprintf(value, sizeof(value), "%u", threads);
+		setenv("DRAW_NUM_THREADS", value, 1);
+
+		memset(&p, 0, sizeof(p));
+		init_prog(&p, screen);
+
+		/* warm up, compiling the shader variants */
+		run(&p, 1);
+		mverts = run(&p, draws);
+
+		hash = trivial_hash_resource(p.pipe, p.target, TRIVIAL_HASH_INIT);
+		printf("%2u threads %8.2f Mverts/s  hash %016" PRIx64 "\n",
+		       threads, mverts, hash);
+		if (threads) {
+			snprintf(value, sizeof(value), "%u threads", threads);
+			ok &= trivial_check(value, hash, ref);
+		} else {
+			ref = hash;
+		}
+
+		close_prog(&p);
+	}
+
+	trivial_destroy_screen(dev, screen);
+
+	return ok ? 0 : 1;
+}
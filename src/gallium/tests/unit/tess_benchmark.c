@@ -0,0 +1,190 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures how many patches per second the tessellator generates, for
+ * each domain and spacing, with three distributions of tess factors:
+ *
+ *  uniform  every patch uses the same factors
+ *  terrain  a grid of patches whose level of detail falls off with the
+ *           distance to the viewer, with edges matching their neighbours
+ *  random   every patch has different fractional factors
+ *
+ * The checksum covers every domain point and index generated, so that
+ * changes to the tessellator can be checked against its old output.
+ *
+ * Usage: tess_benchmark [repeats]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tessellator/p_tessellator.h"
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#define GRID_SIZE 64
+#define NUM_PATCHES (GRID_SIZE * GRID_SIZE)
+
+enum distribution {
+   DIST_UNIFORM,
+   DIST_TERRAIN,
+   DIST_RANDOM,
+   NUM_DISTRIBUTIONS
+};
+
+static const char *distribution_names[NUM_DISTRIBUTIONS] = {
+   "uniform", "terrain", "random",
+};
+
+static const struct {
+   enum pipe_prim_type prim_mode;
+   const char *name;
+} domains[] = {
+   { PIPE_PRIM_QUADS, "quads" },
+   { PIPE_PRIM_TRIANGLES, "triangles" },
+   { PIPE_PRIM_LINES, "isolines" },
+};
+
+static const char *spacing_names[] = {
+   [PIPE_TESS_SPACING_FRACTIONAL_ODD] = "fractional_odd",
+   [PIPE_TESS_SPACING_FRACTIONAL_EVEN] = "fractional_even",
+   [PIPE_TESS_SPACING_EQUAL] = "equal",
+};
+
+/* Level of detail of a terrain patch, halving with each ring around the
+ * viewer in the middle of the grid.
+ */
+static float
+terrain_lod(int x, int y)
+{
+   int dx = x - GRID_SIZE / 2;
+   int dy = y - GRID_SIZE / 2;
+   unsigned dist = (unsigned)sqrtf(dx * dx + dy * dy);
+
+   return 32.0f / (1 << MIN2(util_logbase2(dist | 1), 4));
+}
+
+static void
+make_factors(enum distribution dist,
+             struct pipe_tessellation_factors *factors)
+{
+   for (unsigned y = 0; y < GRID_SIZE; y++) {
+      for (unsigned x = 0; x < GRID_SIZE; x++) {
+         struct pipe_tessellation_factors *f = &factors[y * GRID_SIZE + x];
+
+         switch (dist) {
+         case DIST_UNIFORM:
+            for (unsigned i = 0; i < 4; i++)
+               f->outer_tf[i] = 16.0f;
+            f->inner_tf[0] = f->inner_tf[1] = 16.0f;
+            break;
+         case DIST_TERRAIN: {
+            float lod = terrain_lod(x, y);
+            /* shared edges take the finer of the two levels */
+            f->outer_tf[0] = MAX2(lod, terrain_lod(x - 1, y));
+            f->outer_tf[1] = MAX2(lod, terrain_lod(x, y - 1));
+            f->outer_tf[2] = MAX2(lod, terrain_lod(x + 1, y));
+            f->outer_tf[3] = MAX2(lod, terrain_lod(x, y + 1));
+            f->inner_tf[0] = f->inner_tf[1] = lod;
+            break;
+         }
+         default:
+            for (unsigned i = 0; i < 4; i++)
+               f->outer_tf[i] = 1.0f + 31.0f * rand() / RAND_MAX;
+            f->inner_tf[0] = 1.0f + 31.0f * rand() / RAND_MAX;
+            f->inner_tf[1] = 1.0f + 31.0f * rand() / RAND_MAX;
+            break;
+         }
+      }
+   }
+}
+
+int main(int argc, char **argv)
+{
+   unsigned repeats = argc > 1 ? atoi(argv[1]) : 10;
+   struct pipe_tessellation_factors *factors;
+
+   if (!repeats) {
+      fprintf(stderr, "usage: %s [repeats]\n", argv[0]);
+      return 1;
+   }
+
+   factors = MALLOC(NUM_PATCHES * sizeof(*factors));
+   if (!factors)
+      return 1;
+
+   printf("%-10s %-16s %-8s %12s %12s  %s\n", "domain", "spacing",
+          "factors", "kpatches/s", "Mpoints/s", "checksum");
+
+   for (unsigned d = 0; d < ARRAY_SIZE(domains); d++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(spacing_names); s++) {
+         for (unsigned dist = 0; dist < NUM_DISTRIBUTIONS; dist++) {
+            struct pipe_tessellator *ptess =
+               p_tess_init(domains[d].prim_mode, s, false, false);
+            struct pipe_tessellator_data data;
+            uint64_t num_points = 0;
+            uint32_t sum = 0;
+            int64_t start, end;
+
+            srand(7919);
+            make_factors(dist, factors);
+
+            for (unsigned p = 0; p < NUM_PATCHES; p++) {
+               p_tessellate(ptess, &factors[p], &data);
+               sum = _mesa_hash_data_with_seed(&data.num_domain_points, 4, sum);
+               sum = _mesa_hash_data_with_seed(data.domain_points_u,
+                                               data.num_domain_points * 4, sum);
+               sum = _mesa_hash_data_with_seed(data.domain_points_v,
+                                               data.num_domain_points * 4, sum);
+               sum = _mesa_hash_data_with_seed(data.indices,
+                                               data.num_indices * 4, sum);
+            }
+
+            start = os_time_get_nano();
+            for (unsigned r = 0; r < repeats; r++) {
+               for (unsigned p = 0; p < NUM_PATCHES; p++) {
+                  p_tessellate(ptess, &factors[p], &data);
+                  num_points += data.num_domain_points;
+               }
+            }
+            end = os_time_get_nano();
+
+            p_tess_destroy(ptess);
+
+            printf("%-10s %-16s %-8s %12.1f %12.1f  %08x\n",
+                   domains[d].name, spacing_names[s], distribution_names[dist],
+                   (double)repeats * NUM_PATCHES * 1e6 / (end - start),
+                   (double)num_points * 1e3 / (end - start), sum);
+         }
+      }
+   }
+
+   FREE(factors);
+
+   return 0;
+}
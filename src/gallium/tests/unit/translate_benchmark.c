@@ -0,0 +1,184 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures the vertex fetch throughput of each translate backend, for
+ * vertex formats in common use, converting to the 32 bit vectors draw
+ * feeds its vertex shaders.
+ *
+ * Each format is fetched from an interleaved buffer through a shuffled
+ * 32 bit index list, as for an indexed draw.  Backends which don't
+ * handle a format print "-".
+ *
+ * Usage: translate_benchmark [repeats]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "util/detect.h"
+#include "translate/translate.h"
+#include "util/u_memory.h"
+#include "util/format/u_format.h"
+#include "util/os_time.h"
+
+#define NUM_VERTICES 65536
+#define VERTEX_STRIDE 32
+
+struct backend {
+   const char *name;
+   struct translate *(*create)(const struct translate_key *key);
+};
+
+static const struct backend backends[] = {
+   { "generic", translate_generic_create },
+#if DETECT_ARCH_X86 || DETECT_ARCH_X86_64
+   { "sse", translate_sse2_create },
+#endif
+#ifdef DRAW_LLVM_AVAILABLE
+   { "llvm", translate_llvm_create },
+#endif
+};
+
+static const enum pipe_format formats[] = {
+   PIPE_FORMAT_R32G32B32A32_FLOAT,
+   PIPE_FORMAT_R32G32B32_FLOAT,
+   PIPE_FORMAT_R32G32_FLOAT,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_R16G16_FLOAT,
+   PIPE_FORMAT_R16G16B16A16_UNORM,
+   PIPE_FORMAT_R16G16B16A16_SNORM,
+   PIPE_FORMAT_R16G16_SNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_SNORM,
+   PIPE_FORMAT_R10G10B10A2_UNORM,
+   PIPE_FORMAT_R10G10B10A2_SNORM,
+   PIPE_FORMAT_B10G10R10A2_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UINT,
+   PIPE_FORMAT_R16G16B16A16_SINT,
+};
+
+/* Millions of vertices per second, or 0 if the backend can't do it */
+static double
+run(const struct backend *backend, enum pipe_format format,
+    const void *input, const unsigned *elts, void *output, unsigned repeats)
+{
+   struct translate_key key;
+   struct translate *translate;
+   int64_t start, end;
+
+   memset(&key, 0, sizeof(key));
+   key.output_stride = 4 * sizeof(float);
+   key.nr_elements = 1;
+   key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[0].input_format = format;
+   key.element[0].input_buffer = 0;
+   key.element[0].input_offset = 0;
+   key.element[0].instance_divisor = 0;
+   key.element[0].output_offset = 0;
+   if (util_format_is_pure_sint(format))
+      key.element[0].output_format = PIPE_FORMAT_R32G32B32A32_SINT;
+   else if (util_format_is_pure_uint(format))
+      key.element[0].output_format = PIPE_FORMAT_R32G32B32A32_UINT;
+   else
+      key.element[0].output_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+   translate = backend->create(&key);
+   if (!translate)
+      return 0.0;
+
+   translate->set_buffer(translate, 0, input, VERTEX_STRIDE, NUM_VERTICES - 1);
+
+   /* warm up */
+   translate->run_elts(translate, elts, NUM_VERTICES, 0, 0, output);
+
+   start = os_time_get_nano();
+   for (unsigned i = 0; i < repeats; i++)
+      translate->run_elts(translate, elts, NUM_VERTICES, 0, 0, output);
+   end = os_time_get_nano();
+
+   translate->release(translate);
+
+   return (double)repeats * NUM_VERTICES * 1e3 / (end - start);
+}
+
+int main(int argc, char **argv)
+{
+   unsigned repeats = argc > 1 ? atoi(argv[1]) : 100;
+   uint8_t *input;
+   unsigned *elts;
+   float *output;
+
+   if (!repeats) {
+      fprintf(stderr, "usage: %s [repeats]\n", argv[0]);
+      return 1;
+   }
+
+   input = align_malloc(NUM_VERTICES * VERTEX_STRIDE, 64);
+   elts = align_malloc(NUM_VERTICES * sizeof(*elts), 64);
+   output = align_malloc(NUM_VERTICES * 4 * sizeof(float), 64);
+   if (!input || !elts || !output)
+      return 1;
+
+   /* small random values, so that no format sees NaNs or overflows */
+   srand(4359025);
+   for (unsigned i = 0; i < NUM_VERTICES * VERTEX_STRIDE; i++)
+      input[i] = rand() & 0x3f;
+
+   /* every vertex once, in a shuffled order */
+   for (unsigned i = 0; i < NUM_VERTICES; i++)
+      elts[i] = i;
+   for (unsigned i = NUM_VERTICES - 1; i > 0; i--) {
+      unsigned j = rand() % (i + 1);
+      unsigned tmp = elts[i];
+      elts[i] = elts[j];
+      elts[j] = tmp;
+   }
+
+   printf("%-32s", "Mverts/s");
+   for (unsigned b = 0; b < ARRAY_SIZE(backends); b++)
+      printf(" %9s", backends[b].name);
+   printf("\n");
+
+   for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+      printf("%-32s", util_format_name(formats[f]));
+      for (unsigned b = 0; b < ARRAY_SIZE(backends); b++) {
+         double mverts = run(&backends[b], formats[f], input, elts, output,
+                             repeats);
+         if (mverts)
+            printf(" %9.1f", mverts);
+         else
+            printf(" %9s", "-");
+      }
+      printf("\n");
+   }
+
+   align_free(input);
+   align_free(elts);
+   align_free(output);
+
+   return 0;
+}
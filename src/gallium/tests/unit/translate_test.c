@@ -76,6 +76,10 @@ int main(int argc, char** argv)
       create_fn = translate_generic_create;
    else if (!strcmp(argv[1], "x86"))
       create_fn = translate_sse2_create;
+#ifdef DRAW_LLVM_AVAILABLE
+   else if (!strcmp(argv[1], "llvm"))
+      create_fn = translate_llvm_create;
+#endif
    else
    {
       const char *translate_options[] = {
@@ -99,7 +103,7 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|ssse3|sse4.1|avx]\n");
+      printf("Usage: ./translate_test [default|generic|x86|llvm|nosse|sse|sse2|sse3|ssse3|sse4.1|avx]\n");
       return 2;
    }
 
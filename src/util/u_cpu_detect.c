@@ -595,6 +595,128 @@ get_cpu_topology(void)
 #endif
 }
 
+#if DETECT_OS_LINUX && defined(HAS_SCHED_GETAFFINITY)
+/**
+ * Parse a sysfs list such as "0-3,8,10-11" into a mask.
+ */
+static bool
+read_sysfs_list(const char *path, util_affinity_mask mask)
+{
+   char buf[4096];
+   FILE *f = fopen(path, "r");
+
+   if (!f)
+      return false;
+
+   bool ok = fgets(buf, sizeof(buf), f) != NULL;
+   fclose(f);
+   if (!ok)
+      return false;
+
+   memset(mask, 0, sizeof(util_affinity_mask));
+
+   const char *s = buf;
+   while (*s >= '0' && *s <= '9') {
+      char *end;
+      unsigned first = strtoul(s, &end, 10);
+      unsigned last = first;
+
+      if (*end == '-')
+         last = strtoul(end + 1, &end, 10);
+
+      for (unsigned i = first; i <= last && i < UTIL_MAX_CPUS; i++)
+         mask[i / 32] |= 1u << (i % 32);
+
+      s = *end == ',' ? end + 1 : end;
+   }
+
+   return true;
+}
+#endif
+
+static void
+get_numa_topology(void)
+{
+   /* Default. This is OK on UMA systems and whenever detection fails. */
+   util_cpu_caps.num_nodes = 1;
+
+   memset(util_cpu_caps.cpu_to_node, 0xff, sizeof(util_cpu_caps.cpu_to_node));
+
+#if DETECT_OS_LINUX && defined(HAS_SCHED_GETAFFINITY)
+   util_affinity_mask nodes;
+   cpu_set_t available;
+
+   if (!read_sysfs_list("/sys/devices/system/node/online", nodes) ||
+       sched_getaffinity(0, sizeof(available), &available) != 0)
+      return;
+
+   util_affinity_mask *node_affinity_masks = NULL;
+   uint16_t cpu_to_node[UTIL_MAX_CPUS];
+   unsigned num_nodes = 0;
+
+   memset(cpu_to_node, 0xff, sizeof(cpu_to_node));
+
+   for (unsigned n = 0; n < UTIL_MAX_CPUS; n++) {
+      util_affinity_mask mask;
+      char path[64];
+      bool empty = true;
+
+      if (!(nodes[n / 32] & (1u << (n % 32))))
+         continue;
+
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", n);
+      if (!read_sysfs_list(path, mask))
+         continue;
+
+      /* Only keep the CPUs we may run on, and skip nodes without any,
+       * e.g. memory-only nodes or nodes excluded by the affinity mask.
+       */
+      for (unsigned i = 0; i < UTIL_MAX_CPUS; i++) {
+         if (i >= CPU_SETSIZE || !CPU_ISSET(i, &available))
+            mask[i / 32] &= ~(1u << (i % 32));
+         else if (mask[i / 32] & (1u << (i % 32)))
+            empty = false;
+      }
+      if (empty)
+         continue;
+
+      util_affinity_mask *masks =
+         realloc(node_affinity_masks, sizeof(util_affinity_mask) * (num_nodes + 1));
+      if (!masks) {
+         free(node_affinity_masks);
+         return;
+      }
+      node_affinity_masks = masks;
+      memcpy(&node_affinity_masks[num_nodes], mask, sizeof(util_affinity_mask));
+
+      for (unsigned i = 0; i < UTIL_MAX_CPUS; i++) {
+         if (mask[i / 32] & (1u << (i % 32)))
+            cpu_to_node[i] = num_nodes;
+      }
+      num_nodes++;
+   }
+
+   if (num_nodes < 2) {
+      free(node_affinity_masks);
+      return;
+   }
+
+   util_cpu_caps.num_nodes = num_nodes;
+   util_cpu_caps.node_affinity_mask = node_affinity_masks;
+   memcpy(util_cpu_caps.cpu_to_node, cpu_to_node, sizeof(cpu_to_node));
+
+   if (debug_get_option_dump_cpu()) {
+      fprintf(stderr, "CPU <-> NUMA node mapping:\n");
+      for (unsigned i = 0; i < util_cpu_caps.num_nodes; i++) {
+         fprintf(stderr, "  - node %u mask = ", i);
+         for (int j = util_cpu_caps.max_cpus - 1; j >= 0; j -= 32)
+            fprintf(stderr, "%08x ", util_cpu_caps.node_affinity_mask[i][j / 32]);
+         fprintf(stderr, "\n");
+      }
+   }
+#endif
+}
+
 static
 void check_cpu_caps_override(void)
 {
@@ -920,6 +1042,7 @@ _util_cpu_detect_once(void)
    check_max_vector_bits();
 
    get_cpu_topology();
+   get_numa_topology();
 
    if (debug_get_option_dump_cpu()) {
       printf("util_cpu_caps.nr_cpus = %u\n", util_cpu_caps.nr_cpus);
@@ -958,6 +1081,7 @@ _util_cpu_detect_once(void)
       printf("util_cpu_caps.has_avx512vl = %u\n", util_cpu_caps.has_avx512vl);
       printf("util_cpu_caps.has_avx512vbmi = %u\n", util_cpu_caps.has_avx512vbmi);
       printf("util_cpu_caps.num_L3_caches = %u\n", util_cpu_caps.num_L3_caches);
+      printf("util_cpu_caps.num_nodes = %u\n", util_cpu_caps.num_nodes);
       printf("util_cpu_caps.num_cpu_mask_bits = %u\n", util_cpu_caps.num_cpu_mask_bits);
    }
    _util_cpu_caps_state.caps = util_cpu_caps;
@@ -128,6 +128,15 @@ struct util_cpu_caps_t {
    uint16_t cpu_to_L3[UTIL_MAX_CPUS];
    /* Affinity masks for each L3 cache. */
    util_affinity_mask *L3_affinity_mask;
+
+   /**
+    * NUMA nodes having CPUs available to the process.  The affinity masks
+    * only contain the available CPUs, and are only set if there are
+    * multiple nodes.
+    */
+   unsigned num_nodes;
+   uint16_t cpu_to_node[UTIL_MAX_CPUS];
+   util_affinity_mask *node_affinity_mask;
 };
 
 struct _util_cpu_caps_state_t {
@@ -141,6 +150,7 @@ struct _util_cpu_caps_state_t {
 };
 
 #define U_CPU_INVALID_L3 0xffff
+#define U_CPU_INVALID_NODE 0xffff
 
 static inline ATTRIBUTE_CONST const struct util_cpu_caps_t *
 util_get_cpu_caps(void)